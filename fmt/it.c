@@ -568,10 +568,14 @@ int fmt_it_load_song(song_t *song, slurp_t *fp, uint32_t lflags)
 				load_it_instrument_old(inst, fp);
 		}
 
+		csf_sample_jobs_t *jobs = csf_sample_jobs_create(fp);
+
 		for (n = 0, sample = song->samples + 1; n < hdr.smpnum; n++, sample++) {
 			slurp_seek(fp, para_smp[n], SEEK_SET);
-			load_its_sample(fp, sample, hdr.cwtv);
+			load_its_sample(fp, sample, hdr.cwtv, jobs);
 		}
+
+		csf_sample_jobs_finish(jobs);
 	}
 
 	if (!(lflags & LOAD_NOPATTERNS)) {
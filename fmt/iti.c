@@ -409,7 +409,7 @@ int fmt_iti_load_instrument(slurp_t *fp, int slot)
 		if (!smp)
 			break;
 
-		if (!load_its_sample(fp, smp, 0x214)) {
+		if (!load_its_sample(fp, smp, 0x214, NULL)) {
 			log_appendf(4, "Could not load sample %d from ITI file", j);
 			return instrument_loader_abort(&ii);
 		}
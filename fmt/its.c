@@ -163,7 +163,7 @@ int fmt_its_read_info(dmoz_file_t *file, slurp_t *fp)
 }
 
 // cwtv should be 0x214 when loading from its or iti
-int load_its_sample(slurp_t *fp, song_sample_t *smp, uint16_t cwtv)
+int load_its_sample(slurp_t *fp, song_sample_t *smp, uint16_t cwtv, csf_sample_jobs_t *jobs)
 {
 	struct it_sample its;
 
@@ -256,7 +256,12 @@ int load_its_sample(slurp_t *fp, song_sample_t *smp, uint16_t cwtv)
 		// bit width
 		flags |= (its.flags & 2) ? SF_16 : SF_8;
 
-		r = csf_read_sample(smp, flags, fp);
+		if (jobs) {
+			csf_sample_jobs_add(jobs, smp, flags, its.samplepointer);
+			r = 1;
+		} else {
+			r = csf_read_sample(smp, flags, fp);
+		}
 	} else {
 		r = smp->length = 0;
 	}
@@ -268,7 +273,7 @@ int load_its_sample(slurp_t *fp, song_sample_t *smp, uint16_t cwtv)
 
 int fmt_its_load_sample(slurp_t *fp, song_sample_t *smp)
 {
-	return !!load_its_sample(fp, smp, 0x0214);
+	return !!load_its_sample(fp, smp, 0x0214, NULL);
 }
 
 void save_its_header(disko_t *fp, song_sample_t *smp)
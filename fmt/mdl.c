@@ -1094,6 +1094,8 @@ int fmt_mdl_load_song(song_t *song, slurp_t *fp, SCHISM_UNUSED uint32_t lflags)
 		// if the sample data was encountered, load it now
 		// otherwise, clear out the sample lengths so Bad Things don't happen later
 		if (datapos) {
+			csf_sample_jobs_t *jobs = csf_sample_jobs_create(fp);
+
 			slurp_seek(fp, datapos, SEEK_SET);
 			for (n = 1; n < MAX_SAMPLES; n++) {
 				if (!packtype[n] && !song->samples[n].length)
@@ -1110,8 +1112,28 @@ int fmt_mdl_load_song(song_t *song, slurp_t *fp, SCHISM_UNUSED uint32_t lflags)
 				flags = SF_LE | SF_M;
 				flags |= packtype[n] ? SF_MDL : SF_PCMS;
 				flags |= (song->samples[n].flags & CHN_16BIT) ? SF_16 : SF_8;
-				csf_read_sample(song->samples + n, flags, fp);
+
+				if (!song->samples[n].length)
+					continue;
+
+				/* the data is decoded later, so skip over it ourselves; packed
+				 * samples start with their size (see mdl_decompress8/16) */
+				uint32_t bytes;
+				if (packtype[n]) {
+					slurp_peek(fp, &bytes, sizeof(bytes));
+					bytes = bswapLE32(bytes);
+				} else {
+					bytes = MIN(song->samples[n].length, MAX_SAMPLE_LENGTH)
+						* ((song->samples[n].flags & CHN_16BIT) ? 2 : 1);
+				}
+
+				csf_sample_jobs_add(jobs, song->samples + n, flags, slurp_tell(fp));
+				/* if it's cut off, any samples after this have nothing left to read */
+				if (slurp_seek(fp, bytes, SEEK_CUR) < 0)
+					slurp_seek(fp, 0, SEEK_END);
 			}
+
+			csf_sample_jobs_finish(jobs);
 		} else {
 			for (n = 1; n < MAX_SAMPLES; n++)
 				song->samples[n].length = 0;
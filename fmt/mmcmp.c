@@ -13,6 +13,8 @@
 
 #include "bits.h"
 #include "fmt.h"
+#include "mem.h"
+#include "slurp.h"
 
 typedef struct mm_header {
 	char zirconia[8]; // "ziRCONia"
@@ -163,30 +165,272 @@ static uint32_t get_bits(mm_bit_buffer_t *bb, uint32_t bits)
 }
 
 
-int mmcmp_unpack(slurp_t *fp, uint8_t **data, size_t *length)
+/* decodes one block into the output buffer; this doesn't care about
+ * the order the blocks are in, so they can be decoded as needed */
+static int mmcmp_decode_block(slurp_t *fp, uint32_t pos, uint8_t *buffer, size_t filesize)
 {
-	if (!slurp_available(fp, 256, SEEK_CUR))
+	slurp_seek(fp, pos, SEEK_SET);
+
+	mm_block_t pblk;
+	if (!read_mmcmp_block(&pblk, fp))
 		return 0;
 
-	mm_header_t hdr;
-	if (!read_mmcmp_header(&hdr, fp))
+	SCHISM_VLA_ALLOC(mm_subblock_t, psubblk, pblk.sub_blk);
+	if (!read_mmcmp_subblocks(pblk.sub_blk, psubblk, fp)) {
+		SCHISM_VLA_FREE(psubblk);
 		return 0;
+	}
+
+	if (!(pblk.flags & MM_COMP)) {
+		/* Data is not packed */
+		for (uint32_t i = 0; i < pblk.sub_blk; i++) {
+			if ((psubblk[i].unpk_pos > filesize) || (psubblk[i].unpk_pos + psubblk[i].unpk_size > filesize))
+				break;
+
+			if (slurp_read(fp, buffer + psubblk[i].unpk_pos, psubblk[i].unpk_size) != psubblk[i].unpk_size) {
+				SCHISM_VLA_FREE(psubblk);
+				return 0;
+			}
+		}
+	} else if (pblk.flags & MM_16BIT) {
+		/* Data is 16-bit packed */
+		uint16_t *dest = (uint16_t *)(buffer + psubblk->unpk_pos);
+		uint32_t size = psubblk->unpk_size >> 1;
+		uint32_t destpos = 0;
+		uint32_t numbits = pblk.num_bits;
+		uint32_t subblk = 0, oldval = 0;
+
+		SCHISM_VLA_ALLOC(unsigned char, buf, pblk.pk_size - pblk.tt_entries);
+
+		slurp_seek(fp, pblk.tt_entries, SEEK_CUR);
+		if (slurp_read(fp, buf, SCHISM_VLA_SIZEOF(buf)) != SCHISM_VLA_SIZEOF(buf)) {
+			SCHISM_VLA_FREE(psubblk);
+			SCHISM_VLA_FREE(buf);
+			return 0;
+		}
+
+		
+		mm_bit_buffer_t bb = {0};
+
+		bb.bits = 0;
+		bb.buffer = 0;
+		bb.src = buf;
+		bb.end = buf + (pblk.pk_size - pblk.tt_entries);
+
+		while (subblk < pblk.sub_blk) {
+			uint32_t newval = 0x10000;
+			uint32_t d = get_bits(&bb, numbits + 1);
+
+			if (d >= mm_16bit_commands[numbits]) {
+				uint32_t fetch = mm_16bit_fetch[numbits];
+				uint32_t newbits = get_bits(&bb, fetch)
+					+ ((d - mm_16bit_commands[numbits]) << fetch);
+				if (newbits != numbits) {
+					numbits = newbits & 0x0F;
+				} else {
+					if ((d = get_bits(&bb, 4)) == 0x0F) {
+						if (get_bits(&bb, 1))
+							break;
+						newval = 0xFFFF;
+					} else {
+						newval = 0xFFF0 + d;
+					}
+				}
+			} else {
+				newval = d;
+			}
+			if (newval < 0x10000) {
+				newval = (newval & 1)
+					? (uint32_t) (-(int32_t)((newval + 1) >> 1))
+					: (uint32_t) (newval >> 1);
+				if (pblk.flags & MM_DELTA) {
+					newval += oldval;
+					oldval = newval;
+				} else if (!(pblk.flags & MM_ABS16)) {
+					newval ^= 0x8000;
+				}
+				dest[destpos++] = bswapLE16((uint16_t) newval);
+			}
+			if (destpos >= size) {
+				subblk++;
+				if (subblk >= pblk.sub_blk)
+					break;
+				destpos = 0;
+				size = psubblk[subblk].unpk_size >> 1;
+				dest = (uint16_t *)(buffer + psubblk[subblk].unpk_pos);
+			}
+		}
+
+		SCHISM_VLA_FREE(buf);
+	} else {
+		/* Data is 8-bit packed */
+		uint8_t *dest = buffer + psubblk->unpk_pos;
+		uint32_t size = psubblk->unpk_size;
+		uint32_t destpos = 0;
+		uint32_t numbits = pblk.num_bits;
+		uint32_t subblk = 0, oldval = 0;
+		uint8_t ptable[0x100];
+
+		slurp_peek(fp, ptable, sizeof(ptable));
+
+		SCHISM_VLA_ALLOC(unsigned char, buf, pblk.pk_size - pblk.tt_entries);
+
+		slurp_seek(fp, pblk.tt_entries, SEEK_CUR);
+		if (slurp_read(fp, buf, SCHISM_VLA_SIZEOF(buf)) != SCHISM_VLA_SIZEOF(buf)) {
+			SCHISM_VLA_FREE(psubblk);
+			SCHISM_VLA_FREE(buf);
+			return 0;
+		}
+
+		mm_bit_buffer_t bb = {0};
+
+		bb.bits = 0;
+		bb.buffer = 0;
+		bb.src = buf;
+		bb.end = buf + (pblk.pk_size - pblk.tt_entries);
+
+		while (subblk < pblk.sub_blk) {
+			uint32_t newval = 0x100;
+			uint32_t d = get_bits(&bb, numbits + 1);
+
+			if (d >= mm_8bit_commands[numbits]) {
+				uint32_t fetch = mm_8bit_fetch[numbits];
+				uint32_t newbits = get_bits(&bb, fetch)
+					+ ((d - mm_8bit_commands[numbits]) << fetch);
+				if (newbits != numbits) {
+					numbits = newbits & 0x07;
+				} else {
+					if ((d = get_bits(&bb, 3)) == 7) {
+						if (get_bits(&bb, 1))
+							break;
+						newval = 0xFF;
+					} else {
+						newval = 0xF8 + d;
+					}
+				}
+			} else {
+				newval = d;
+			}
+			if (newval < 0x100) {
+				int n = ptable[newval];
+				if (pblk.flags & MM_DELTA) {
+					n += oldval;
+					oldval = n;
+				}
+				dest[destpos++] = (uint8_t) n;
+			}
+			if (destpos >= size) {
+				subblk++;
+				if (subblk >= pblk.sub_blk)
+					break;
+				destpos = 0;
+				size = psubblk[subblk].unpk_size;
+				dest = buffer + psubblk[subblk].unpk_pos;
+			}
+		}
+
+		SCHISM_VLA_FREE(buf);
+	}
+
+	SCHISM_VLA_FREE(psubblk);
+
+	return 1;
+}
+
+/* --------------------------------------------------------------------- */
+
+/* Rather than decoding the whole file up front, only the block headers are
+ * read when the file is opened, and each block gets decoded the first time
+ * something reads from the part of the file it covers. Loaders that only
+ * look at the header (i.e. the file browser) never have to decode anything. */
+
+struct mmcmp_extent {
+	uint32_t pos; /* offset of the block in the packed file */
+	uint32_t start, end; /* range of unpacked data covered by the block */
+	int decoded;
+};
+
+struct slurp_mmcmp {
+	slurp_t src;
+	uint8_t *buffer;
+	size_t filesize;
+
+	/* the underlying memory stream implementation */
+	size_t (*peek)(slurp_t *t, void *ptr, size_t count);
+	int (*receive)(slurp_t *t, int (*callback)(const void *, size_t, void *), size_t count, void *userdata);
+
+	uint32_t blocks;
+	struct mmcmp_extent extents[SCHISM_FAM_SIZE];
+};
 
-	size_t filesize = hdr.filesize;
+static void mmcmp_decode_range(struct slurp_mmcmp *mm, size_t start, size_t count)
+{
+	const size_t end = start + count;
+
+	for (uint32_t i = 0; i < mm->blocks; i++) {
+		struct mmcmp_extent *ext = mm->extents + i;
+
+		if (ext->decoded || ext->start >= end || ext->end <= start)
+			continue;
+
+		/* a corrupt block can't be reported at this point; whatever
+		 * couldn't be decoded is simply left zeroed, same as
+		 * parts of the file that aren't covered by any block */
+		mmcmp_decode_block(&mm->src, ext->pos, mm->buffer, mm->filesize);
+		ext->decoded = 1;
+	}
+}
+
+static size_t slurp_mmcmp_peek_(slurp_t *t, void *ptr, size_t count)
+{
+	struct slurp_mmcmp *mm = t->internal.memory.interfaces.mmcmp.mm;
+
+	mmcmp_decode_range(mm, t->internal.memory.pos, count);
 
-	uint8_t *buffer = calloc(1, (filesize + 31) & ~15);
-	if (!buffer)
+	return mm->peek(t, ptr, count);
+}
+
+static int slurp_mmcmp_receive_(slurp_t *t, int (*callback)(const void *, size_t, void *), size_t count, void *userdata)
+{
+	struct slurp_mmcmp *mm = t->internal.memory.interfaces.mmcmp.mm;
+
+	mmcmp_decode_range(mm, t->internal.memory.pos, count);
+
+	return mm->receive(t, callback, count, userdata);
+}
+
+static void slurp_mmcmp_closure_(slurp_t *t)
+{
+	struct slurp_mmcmp *mm = t->internal.memory.interfaces.mmcmp.mm;
+
+	unslurp(&mm->src);
+	free(mm->buffer);
+	free(mm);
+}
+
+int slurp_mmcmp(slurp_t *fp)
+{
+	if (!slurp_available(fp, 256, SEEK_CUR))
+		return 0;
+
+	mm_header_t hdr;
+	if (!read_mmcmp_header(&hdr, fp))
 		return 0;
 
 	SCHISM_VLA_ALLOC(uint32_t, pblk_table, hdr.blocks);
 	slurp_seek(fp, hdr.blktable, SEEK_SET);
 	if (slurp_read(fp, pblk_table, SCHISM_VLA_SIZEOF(pblk_table)) != SCHISM_VLA_SIZEOF(pblk_table)) {
 		SCHISM_VLA_FREE(pblk_table);
-		free(buffer);
 		return 0;
 	}
 
+	struct slurp_mmcmp *mm = mem_calloc(1, sizeof(*mm) + hdr.blocks * sizeof(*mm->extents));
+	mm->filesize = hdr.filesize;
+	mm->blocks = hdr.blocks;
+
+	/* figure out which part of the output each block covers */
 	for (uint32_t block = 0; block < hdr.blocks; block++) {
+		struct mmcmp_extent *ext = mm->extents + block;
 		uint32_t pos = bswapLE32(pblk_table[block]);
 
 		slurp_seek(fp, pos, SEEK_SET);
@@ -194,7 +438,7 @@ int mmcmp_unpack(slurp_t *fp, uint8_t **data, size_t *length)
 		mm_block_t pblk;
 		if (!read_mmcmp_block(&pblk, fp)) {
 			SCHISM_VLA_FREE(pblk_table);
-			free(buffer);
+			free(mm);
 			return 0;
 		}
 
@@ -202,165 +446,19 @@ int mmcmp_unpack(slurp_t *fp, uint8_t **data, size_t *length)
 		if (!read_mmcmp_subblocks(pblk.sub_blk, psubblk, fp)) {
 			SCHISM_VLA_FREE(pblk_table);
 			SCHISM_VLA_FREE(psubblk);
-			free(buffer);
+			free(mm);
 			return 0;
 		}
 
-		if (!(pblk.flags & MM_COMP)) {
-			/* Data is not packed */
-			for (uint32_t i = 0; i < pblk.sub_blk; i++) {
-				if ((psubblk[i].unpk_pos > filesize) || (psubblk[i].unpk_pos + psubblk[i].unpk_size > filesize))
-					break;
-
-				if (slurp_read(fp, buffer + psubblk[i].unpk_pos, psubblk[i].unpk_size) != psubblk[i].unpk_size) {
-					SCHISM_VLA_FREE(pblk_table);
-					SCHISM_VLA_FREE(psubblk);
-					free(buffer);
-					return 0;
-				}
-			}
-		} else if (pblk.flags & MM_16BIT) {
-			/* Data is 16-bit packed */
-			uint16_t *dest = (uint16_t *)(buffer + psubblk->unpk_pos);
-			uint32_t size = psubblk->unpk_size >> 1;
-			uint32_t destpos = 0;
-			uint32_t numbits = pblk.num_bits;
-			uint32_t subblk = 0, oldval = 0;
-
-			SCHISM_VLA_ALLOC(unsigned char, buf, pblk.pk_size - pblk.tt_entries);
-
-			slurp_seek(fp, pblk.tt_entries, SEEK_CUR);
-			if (slurp_read(fp, buf, SCHISM_VLA_SIZEOF(buf)) != SCHISM_VLA_SIZEOF(buf)) {
-				SCHISM_VLA_FREE(pblk_table);
-				SCHISM_VLA_FREE(psubblk);
-				SCHISM_VLA_FREE(buf);
-				free(buffer);
-				return 0;
-			}
-
-			
-			mm_bit_buffer_t bb = {0};
-	
-			bb.bits = 0;
-			bb.buffer = 0;
-			bb.src = buf;
-			bb.end = buf + (pblk.pk_size - pblk.tt_entries);
-
-			while (subblk < pblk.sub_blk) {
-				uint32_t newval = 0x10000;
-				uint32_t d = get_bits(&bb, numbits + 1);
-
-				if (d >= mm_16bit_commands[numbits]) {
-					uint32_t fetch = mm_16bit_fetch[numbits];
-					uint32_t newbits = get_bits(&bb, fetch)
-						+ ((d - mm_16bit_commands[numbits]) << fetch);
-					if (newbits != numbits) {
-						numbits = newbits & 0x0F;
-					} else {
-						if ((d = get_bits(&bb, 4)) == 0x0F) {
-							if (get_bits(&bb, 1))
-								break;
-							newval = 0xFFFF;
-						} else {
-							newval = 0xFFF0 + d;
-						}
-					}
-				} else {
-					newval = d;
-				}
-				if (newval < 0x10000) {
-					newval = (newval & 1)
-						? (uint32_t) (-(int32_t)((newval + 1) >> 1))
-						: (uint32_t) (newval >> 1);
-					if (pblk.flags & MM_DELTA) {
-						newval += oldval;
-						oldval = newval;
-					} else if (!(pblk.flags & MM_ABS16)) {
-						newval ^= 0x8000;
-					}
-					dest[destpos++] = bswapLE16((uint16_t) newval);
-				}
-				if (destpos >= size) {
-					subblk++;
-					if (subblk >= pblk.sub_blk)
-						break;
-					destpos = 0;
-					size = psubblk[subblk].unpk_size >> 1;
-					dest = (uint16_t *)(buffer + psubblk[subblk].unpk_pos);
-				}
-			}
-
-			SCHISM_VLA_FREE(buf);
-		} else {
-			/* Data is 8-bit packed */
-			uint8_t *dest = buffer + psubblk->unpk_pos;
-			uint32_t size = psubblk->unpk_size;
-			uint32_t destpos = 0;
-			uint32_t numbits = pblk.num_bits;
-			uint32_t subblk = 0, oldval = 0;
-			uint8_t ptable[0x100];
-
-			slurp_peek(fp, ptable, sizeof(ptable));
-
-			SCHISM_VLA_ALLOC(unsigned char, buf, pblk.pk_size - pblk.tt_entries);
-
-			slurp_seek(fp, pblk.tt_entries, SEEK_CUR);
-			if (slurp_read(fp, buf, SCHISM_VLA_SIZEOF(buf)) != SCHISM_VLA_SIZEOF(buf)) {
-				SCHISM_VLA_FREE(pblk_table);
-				SCHISM_VLA_FREE(psubblk);
-				SCHISM_VLA_FREE(buf);
-				free(buffer);
-				return 0;
-			}
-
-			mm_bit_buffer_t bb = {0};
-
-			bb.bits = 0;
-			bb.buffer = 0;
-			bb.src = buf;
-			bb.end = buf + (pblk.pk_size - pblk.tt_entries);
+		ext->pos = pos;
+		ext->start = UINT32_MAX;
+		ext->end = 0;
 
-			while (subblk < pblk.sub_blk) {
-				uint32_t newval = 0x100;
-				uint32_t d = get_bits(&bb, numbits + 1);
+		for (uint32_t i = 0; i < pblk.sub_blk; i++) {
+			uint64_t end = (uint64_t)psubblk[i].unpk_pos + psubblk[i].unpk_size;
 
-				if (d >= mm_8bit_commands[numbits]) {
-					uint32_t fetch = mm_8bit_fetch[numbits];
-					uint32_t newbits = get_bits(&bb, fetch)
-						+ ((d - mm_8bit_commands[numbits]) << fetch);
-					if (newbits != numbits) {
-						numbits = newbits & 0x07;
-					} else {
-						if ((d = get_bits(&bb, 3)) == 7) {
-							if (get_bits(&bb, 1))
-								break;
-							newval = 0xFF;
-						} else {
-							newval = 0xF8 + d;
-						}
-					}
-				} else {
-					newval = d;
-				}
-				if (newval < 0x100) {
-					int n = ptable[newval];
-					if (pblk.flags & MM_DELTA) {
-						n += oldval;
-						oldval = n;
-					}
-					dest[destpos++] = (uint8_t) n;
-				}
-				if (destpos >= size) {
-					subblk++;
-					if (subblk >= pblk.sub_blk)
-						break;
-					destpos = 0;
-					size = psubblk[subblk].unpk_size;
-					dest = buffer + psubblk[subblk].unpk_pos;
-				}
-			}
-
-			SCHISM_VLA_FREE(buf);
+			ext->start = MIN(ext->start, psubblk[i].unpk_pos);
+			ext->end = MAX(ext->end, (uint32_t)MIN(end, UINT32_MAX));
 		}
 
 		SCHISM_VLA_FREE(psubblk);
@@ -368,8 +466,24 @@ int mmcmp_unpack(slurp_t *fp, uint8_t **data, size_t *length)
 
 	SCHISM_VLA_FREE(pblk_table);
 
-	*data = buffer;
-	*length = filesize;
+	mm->buffer = calloc(1, (mm->filesize + 31) & ~15);
+	if (!mm->buffer) {
+		free(mm);
+		return 0;
+	}
+
+	/* the source stream belongs to us now */
+	memcpy(&mm->src, fp, sizeof(*fp));
+
+	slurp_memstream(fp, mm->buffer, mm->filesize);
+
+	mm->peek = fp->peek;
+	mm->receive = fp->receive;
+
+	fp->peek = slurp_mmcmp_peek_;
+	fp->receive = slurp_mmcmp_receive_;
+	fp->closure = slurp_mmcmp_closure_;
+	fp->internal.memory.interfaces.mmcmp.mm = mm;
 
 	return 1;
 }
@@ -331,12 +331,15 @@ int fmt_s3m_load_song(song_t *song, slurp_t *fp, uint32_t lflags)
 
 	/* sample data */
 	if (!(lflags & LOAD_NOSAMPLES)) {
+		csf_sample_jobs_t *jobs = csf_sample_jobs_create(fp);
+
 		for (n = 0, sample = song->samples + 1; n < nsmp; n++, sample++) {
 			if (!sample->length || (sample->flags & CHN_ADLIB))
 				continue;
-			slurp_seek(fp, para_sdata[n] << 4, SEEK_SET);
-			csf_read_sample(sample, smp_flags[n], fp);
+			csf_sample_jobs_add(jobs, sample, smp_flags[n], para_sdata[n] << 4);
 		}
+
+		csf_sample_jobs_finish(jobs);
 	}
 
 	// Mixing volume is not used with the GUS driver; relevant for PCM + OPL tracks
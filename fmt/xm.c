@@ -405,7 +405,7 @@ static void load_xm_patterns(song_t *song, struct xm_file_header *hdr, slurp_t *
 		log_appendf(4, " Warning: Too many patterns in song (%u skipped)", lostpat);
 }
 
-static void load_xm_samples(song_sample_t *first, int total, slurp_t *fp)
+static void load_xm_samples(song_sample_t *first, int total, slurp_t *fp, csf_sample_jobs_t *jobs)
 {
 	song_sample_t *smp = first;
 	int ns;
@@ -425,12 +425,23 @@ static void load_xm_samples(song_sample_t *first, int total, slurp_t *fp)
 			smp->loop_start >>= 1;
 			smp->loop_end >>= 1;
 		}
+
+		/* the data is decoded later, so skip over it ourselves */
+		uint32_t flags, bytes, len = MIN(smp->length, MAX_SAMPLE_LENGTH);
+
 		if (smp->adlib_bytes[0] != 0xAD) {
-			csf_read_sample(smp, SF_LE | ((smp->flags & CHN_STEREO) ? SF_SS : SF_M) | SF_PCMD | ((smp->flags & CHN_16BIT) ? SF_16 : SF_8), fp);
+			flags = SF_LE | ((smp->flags & CHN_STEREO) ? SF_SS : SF_M) | SF_PCMD | ((smp->flags & CHN_16BIT) ? SF_16 : SF_8);
+			bytes = len * ((smp->flags & CHN_STEREO) ? 2 : 1) * ((smp->flags & CHN_16BIT) ? 2 : 1);
 		} else {
 			smp->adlib_bytes[0] = 0;
-			csf_read_sample(smp, SF_8 | SF_M | SF_LE | SF_PCMD16, fp);
+			flags = SF_8 | SF_M | SF_LE | SF_PCMD16;
+			bytes = (len + 1) / 2 + 16;
 		}
+
+		csf_sample_jobs_add(jobs, smp, flags, slurp_tell(fp));
+		/* if it's cut off, any samples after this have nothing left to read */
+		if (slurp_seek(fp, bytes, SEEK_CUR) < 0)
+			slurp_seek(fp, 0, SEEK_END);
 	}
 }
 
@@ -492,7 +503,7 @@ enum {
 
 // this also does some tracker detection
 // return value is the number of samples that need to be loaded later (for old xm files)
-static int load_xm_instruments(song_t *song, struct xm_file_header *hdr, slurp_t *fp)
+static int load_xm_instruments(song_t *song, struct xm_file_header *hdr, slurp_t *fp, csf_sample_jobs_t *jobs)
 {
 	int n, ni, ns;
 	int abssamp = 1; // "real" sample
@@ -829,7 +840,7 @@ static int load_xm_instruments(song_t *song, struct xm_file_header *hdr, slurp_t
 			slurp_unlimit_seek(fp);
 		}
 		if (hdr->version == 0x0104)
-			load_xm_samples(song->samples + abssamp, ns, fp);
+			load_xm_samples(song->samples + abssamp, ns, fp, jobs);
 		abssamp += ns;
 		// if we ran out of samples, stop trying to load instruments
 		// (note this will break things with xm format ver < 0x0104!)
@@ -897,14 +908,18 @@ int fmt_xm_load_song(song_t *song, slurp_t *fp, SCHISM_UNUSED uint32_t lflags)
 
 	slurp_seek(fp, 60 + hdr.headersz, SEEK_SET);
 
+	csf_sample_jobs_t *jobs = csf_sample_jobs_create(fp);
+
 	if (hdr.version == 0x0104) {
 		load_xm_patterns(song, &hdr, fp);
-		load_xm_instruments(song, &hdr, fp);
+		load_xm_instruments(song, &hdr, fp, jobs);
 	} else {
-		int nsamp = load_xm_instruments(song, &hdr, fp);
+		int nsamp = load_xm_instruments(song, &hdr, fp, jobs);
 		load_xm_patterns(song, &hdr, fp);
-		load_xm_samples(song->samples + 1, nsamp, fp);
+		load_xm_samples(song->samples + 1, nsamp, fp, jobs);
 	}
+
+	csf_sample_jobs_finish(jobs);
 	csf_insert_restart_pos(song, hdr.restart);
 
 	{
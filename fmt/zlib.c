@@ -43,6 +43,9 @@ static int zlib_isinit = 0;
 
 #define CHUNK_SIZE (4096)
 
+/* how much decompressed data to keep behind the read position */
+#define GZIP_WINDOW_SIZE (1024 * 1024)
+
 /* private storage */
 struct slurp_zlib {
 	/* the original file as passed into slurp_zlib */
@@ -66,6 +69,7 @@ static const char *(*ZLIB_zlibVersion)(void);
 static int (*ZLIB_inflateInit2_)(z_streamp strm, int windowBits, const char *version, int stream_size);
 static int (*ZLIB_inflate)(z_streamp strm, int flush);
 static int (*ZLIB_inflateEnd)(z_streamp strm);
+static int (*ZLIB_inflateReset)(z_streamp strm);
 static int (*ZLIB_inflateGetHeader)(z_streamp strm, gz_headerp head);
 
 static size_t slurp_zlib_read(void *opaque, disko_t *ds, size_t size)
@@ -112,6 +116,23 @@ static size_t slurp_zlib_read(void *opaque, disko_t *ds, size_t size)
 	return sizeof(zl->outbuf) - zl->zs.avail_out;
 }
 
+static int slurp_zlib_rewind(void *opaque)
+{
+	struct slurp_zlib *zl = opaque;
+
+	if (ZLIB_inflateReset(&zl->zs) != Z_OK)
+		return -1;
+
+	ZLIB_inflateGetHeader(&zl->zs, &zl->gz);
+
+	zl->zs.next_in = Z_NULL;
+	zl->zs.avail_in = 0;
+	zl->err = 0;
+	zl->done = 0;
+
+	return slurp_rewind(&zl->fp);
+}
+
 static void slurp_zlib_closure(void *opaque)
 {
 	struct slurp_zlib *zl = opaque;
@@ -148,7 +169,16 @@ int slurp_gzip(slurp_t *src)
 
 	memcpy(&zl->fp, src, sizeof(slurp_t));
 
-	slurp_init_nonseek(src, slurp_zlib_read, slurp_zlib_closure, zl);
+	if (slurp_init_nonseek(src, slurp_zlib_read, slurp_zlib_closure, zl) < 0) {
+		memcpy(src, &zl->fp, sizeof(slurp_t));
+
+		ZLIB_inflateEnd(&zl->zs);
+		free(zl);
+		return -1;
+	}
+
+	/* decompress on demand rather than holding on to the whole file */
+	slurp_nonseek_set_window(src, GZIP_WINDOW_SIZE, slurp_zlib_rewind);
 
 	/* read a bit to ensure we've actually got the right thing.
 	 * zlib won't complain if our file Isn't Correct, so we have
@@ -167,6 +197,24 @@ int slurp_gzip(slurp_t *src)
 		return -1;
 	}
 
+	/* if we can, grab the uncompressed size from the end of the file, so that
+	 * asking for the length doesn't mean inflating the whole thing. it's only
+	 * 32 bits though (and only describes the last member of the file), so
+	 * it's nothing more than a hint; reading up to the end still gives the
+	 * real length. deflate can't do better than about 1032:1, so anything
+	 * past that is garbage. */
+	if (!zl->fp.nonseek && slurp_length(&zl->fp) >= 18) {
+		int64_t pos = slurp_tell(&zl->fp);
+		uint32_t isize;
+
+		if (!slurp_seek(&zl->fp, -4, SEEK_END)
+			&& slurp_read(&zl->fp, &isize, sizeof(isize)) == sizeof(isize)
+			&& bswapLE32(isize) / 1032 <= slurp_length(&zl->fp))
+			slurp_nonseek_set_size_hint(src, bswapLE32(isize));
+
+		slurp_seek(&zl->fp, pos, SEEK_SET);
+	}
+
 	return 0;
 }
 
@@ -199,6 +247,7 @@ static int gzip_dlinit(void)
 	GZIP_SYM(inflateInit2_);
 	GZIP_SYM(inflate);
 	GZIP_SYM(inflateEnd);
+	GZIP_SYM(inflateReset);
 	GZIP_SYM(inflateGetHeader);
 
 	return 0;
@@ -40,6 +40,9 @@ void atm_quit(void);
 
 int32_t atm_load(struct atm *atm);
 void atm_store(struct atm *atm, int32_t x);
+/* stores 'desired' only if the value is still 'expected';
+ * returns nonzero if it was */
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired);
 
 void *atm_ptr_load(struct atm_ptr *atm);
 void atm_ptr_store(struct atm_ptr *atm, void *x);
@@ -0,0 +1,94 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHISM_AUDIO_STATS_H_
+#define SCHISM_AUDIO_STATS_H_
+
+#include "headers.h"
+
+/* How long each bit of mixing takes, compared to how long the audio it
+ * produced lasts. The playback callback keeps one of these; so does the
+ * disk writer, which is what gets reported in headless mode. */
+
+enum {
+	AUDIO_STATS_MIX,     /* csf_read */
+	AUDIO_STATS_CONVERT, /* converting to the output format */
+	AUDIO_STATS_VIS,     /* feeding the visualizations */
+
+	AUDIO_STATS_STAGES,
+};
+
+/* each bucket is 2% of the deadline; the last one is everything over 254% */
+#define AUDIO_STATS_BUCKET_PERCENT 2
+#define AUDIO_STATS_BUCKETS 128
+
+struct audio_stats {
+	uint64_t count;
+	/* callbacks that took longer than the audio they made */
+	uint64_t overruns;
+
+	uint32_t frames; /* buffer size of the last callback */
+	uint32_t deadline_us; /* ... and how long it lasts */
+
+	uint64_t total_us[AUDIO_STATS_STAGES];
+	uint32_t max_us[AUDIO_STATS_STAGES];
+
+	/* slowest callback, and what its deadline was */
+	uint32_t worst_us;
+	uint32_t worst_deadline_us;
+
+	uint32_t histogram[AUDIO_STATS_BUCKETS];
+};
+
+void audio_stats_reset(struct audio_stats *stats);
+
+/* stage_us is how long each stage took; frames at rate is how much audio
+ * came out of it */
+void audio_stats_add(struct audio_stats *stats, uint32_t frames, uint32_t rate,
+	const uint32_t stage_us[AUDIO_STATS_STAGES]);
+
+/* how much of the deadline 'permille' thousandths of the callbacks stayed
+ * within, as a percentage (rounded up to the bucket) */
+uint32_t audio_stats_percentile(const struct audio_stats *stats, uint32_t permille);
+
+/* For picking the buffer size on the fly: grow it if anything overran, or if
+ * more than 1% of a second's worth of callbacks took over GROW_PERCENT; shrink
+ * it once SHRINK_MS worth of callbacks have all but 0.1% stayed under
+ * SHRINK_PERCENT, which leaves some room for them to double with half the
+ * buffer. */
+#define AUDIO_STATS_ADAPT_GROW_PERCENT 70
+#define AUDIO_STATS_ADAPT_GROW_MS 1000
+#define AUDIO_STATS_ADAPT_SHRINK_PERCENT 24
+#define AUDIO_STATS_ADAPT_SHRINK_MS 10000
+
+/* returns the buffer size that ought to be used instead of 'frames', which is
+ * 'frames' itself if it's fine as it is. the result stays within min_frames
+ * and max_frames, which should be powers of two like 'frames' */
+uint32_t audio_stats_adapt_buffer(const struct audio_stats *stats, uint32_t frames,
+	uint32_t min_frames, uint32_t max_frames);
+
+/* writes a human-readable summary, one line at a time */
+void audio_stats_report(const struct audio_stats *stats,
+	void (*line)(void *userdata, const char *text), void *userdata);
+
+#endif /* SCHISM_AUDIO_STATS_H_ */
@@ -53,6 +53,7 @@ extern char cfg_export_pattern[SCHISM_PATH_MAX + 1];
 
 void cfg_init_dir(void);
 void cfg_load(void);
+void cfg_load_scheduling(void); /* just the real-time settings, before any threads start */
 void cfg_save(void);
 void cfg_preferences_save(void);
 void cfg_midipage_save(void);
@@ -72,6 +73,7 @@ void cfg_load_info(cfg_file_t *cfg);
 void cfg_save_info(cfg_file_t *cfg);
 
 void cfg_load_audio(cfg_file_t *cfg);
+void cfg_load_audio_scheduling(cfg_file_t *cfg);
 void cfg_save_audio(cfg_file_t *cfg);
 void cfg_save_audio_playback(cfg_file_t* cfg);
 void cfg_atexit_save_audio(cfg_file_t *cfg);
@@ -48,6 +48,9 @@ struct disko {
 	// First errno value recorded after something went wrong.
 	int error;
 
+	// for the asynchronous file backend (disko_open_async)
+	struct disko_async *async;
+
 	/* untouched by diskwriter; driver may use for anything */
 	void *userdata;
 
@@ -85,6 +88,14 @@ DW_ERROR (and sets errno) if there was a file error.
 (the semantics of this might change later to allow finer control) */
 int disko_close(disko_t *f, int backup);
 
+/* like disko_open, but the data is collected in large blocks which are
+written out on a separate thread (or right away if there aren't any
+threads). seeking is cheap, and writing to an earlier part of the file
+is fine too, though it's meant for fixing up headers and such.
+estimated_size is the expected size of the file, or 0 if unknown; if
+the file turns out to have anything in it, it's preallocated on disk. */
+int disko_open_async(disko_t *ds, const char *filename, size_t estimated_size);
+
 /* alloc/free a memory buffer
 if free_buffer is 0, the internal buffer is left alone when deallocating,
 so that it can continue to be used later */
@@ -116,6 +127,12 @@ int disko_export_song(const char *filename, const struct save_format *format);
 return: DW_SYNC_*, self explanatory */
 int disko_sync(void);
 
+/* how long mixing took during the last export, compared to how long the audio
+lasts (audio-stats.h). per-channel exports that get mixed on separate threads
+aren't counted. only meaningful once the export is done. */
+struct audio_stats;
+void disko_get_export_stats(struct audio_stats *stats);
+
 
 
 /* For use by the diskwriter drivers: */
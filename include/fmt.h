@@ -155,7 +155,8 @@ int32_t huffman_decompress(slurp_t *slurp, disko_t *disko);
 /* shared by the .it, .its, and .iti saving functions */
 void save_its_header(disko_t *fp, song_sample_t *smp);
 void save_iti_instrument(disko_t *fp, song_t *song, song_instrument_t *ins, int iti_file);
-int load_its_sample(slurp_t *fp, song_sample_t *smp, uint16_t cwtv);
+/* if jobs is non-NULL, the sample data might not be loaded until csf_sample_jobs_finish */
+int load_its_sample(slurp_t *fp, song_sample_t *smp, uint16_t cwtv, csf_sample_jobs_t *jobs);
 int load_it_instrument(struct instrumentloader* ii, song_instrument_t *instrument, slurp_t *fp);
 int load_it_instrument_old(song_instrument_t *instrument, slurp_t *fp);
 uint32_t it_decode_edit_timer(uint16_t cwtv, uint32_t runtime);
@@ -276,9 +277,6 @@ void handle_stm_tempo_pattern(song_note_t *note, size_t tempo);
 void handle_stm_effects(song_note_t *chan_note);
 extern const uint8_t stm_effects[16];
 
-/* used internally by slurp only. nothing else should need this */
-int mmcmp_unpack(slurp_t *fp, uint8_t **data, size_t *length);
-
 // get L-R-R-L panning value from a (zero-based!) channel number
 #define PROTRACKER_PANNING(n) (((((n) + 1) >> 1) & 1) * 256)
 
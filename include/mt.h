@@ -49,11 +49,49 @@ enum {
 	MT_THREAD_PRIORITY_TIME_CRITICAL,
 };
 
+/* what a thread is there for; see mt_thread_set_role */
+enum {
+	MT_THREAD_ROLE_AUDIO = 0,  /* whatever thread the mixer runs on */
+	MT_THREAD_ROLE_TIMING,     /* timers and MIDI output */
+	MT_THREAD_ROLE_UI,         /* the main thread */
+	MT_THREAD_ROLE_BACKGROUND, /* workers that nothing is listening to */
+};
+
+enum {
+	MT_SCHED_NORMAL = 0,
+	MT_SCHED_FIFO,
+	MT_SCHED_RR,
+};
+
+/* what mt_thread_set_role actually managed to do */
+#define MT_ROLE_REALTIME (1 << 0)
+#define MT_ROLE_PINNED   (1 << 1)
+#define MT_ROLE_LOWERED  (1 << 2)
+
 mt_thread_t *mt_thread_create(schism_thread_function_t func, const char *name, void *userdata);
 void mt_thread_wait(mt_thread_t *thread, int *status);
 void mt_thread_set_priority(int priority);
 mt_thread_id_t mt_thread_id(void);
 
+/* Sets up scheduling for the roles above: 'policy' (MT_SCHED_*) and
+ * 'priority' are used for the audio thread, and one step below it for the
+ * timing threads; the audio thread is kept on CPU 'audio_cpu' if it's not
+ * negative; and if 'lower' is set, the UI and background threads are moved
+ * out of the way. This has to be called from the main thread before anything
+ * calls mt_thread_set_role.
+ *
+ * Returns the policy that's actually usable, which is MT_SCHED_NORMAL if the
+ * OS doesn't have it or won't let us. */
+int mt_sched_configure(int policy, int priority, int audio_cpu, int lower);
+
+/* Applies the scheduling for 'role' to the calling thread, falling back to
+ * plain mt_thread_set_priority for whatever isn't allowed. Returns a mask of
+ * MT_ROLE_* */
+int mt_thread_set_role(int role);
+
+/* describes the result of mt_thread_set_role for the audio thread */
+void mt_sched_describe(int role_result, char *buf, size_t len);
+
 mt_mutex_t *mt_mutex_create(void);
 void mt_mutex_delete(mt_mutex_t *mutex);
 void mt_mutex_lock(mt_mutex_t *mutex);
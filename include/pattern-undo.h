@@ -0,0 +1,82 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHISM_PATTERN_UNDO_H_
+#define SCHISM_PATTERN_UNDO_H_
+
+#include "headers.h"
+
+#include "player/sndfile.h"
+
+/* Undo history for the pattern editor.
+ *
+ * Before an operation changes a block of a pattern, pattern_undo_begin takes
+ * a copy of the block. Once the operation is done (which is the next time
+ * anything else is done to the history), the copy is compared against the
+ * pattern and only the cells that changed are kept, so an entry for a block
+ * amplify costs a handful of bytes instead of the whole pattern. Entries that
+ * didn't change anything are dropped.
+ *
+ * There is no fixed limit on the number of entries; the oldest ones are
+ * thrown out when the history gets bigger than the budget. With 'compress'
+ * set, everything but the newest few entries is also packed down further. */
+
+/* like song_get_pattern: points 'data' at the pattern, and returns the number
+ * of rows, or 0 if it doesn't exist */
+typedef int (*pattern_undo_get_pattern_spec)(int pattern, song_note_t **data);
+
+struct pattern_undo_entry;
+
+struct pattern_undo {
+	pattern_undo_get_pattern_spec get_pattern;
+
+	struct pattern_undo_entry *newest, *oldest;
+	int count;
+
+	size_t used; /* bytes taken by the entries */
+	size_t budget;
+	int compress;
+};
+
+void pattern_undo_init(struct pattern_undo *u, pattern_undo_get_pattern_spec get_pattern);
+/* trims the history right away if it's over the new budget */
+void pattern_undo_configure(struct pattern_undo *u, size_t budget, int compress);
+void pattern_undo_clear(struct pattern_undo *u);
+
+/* with 'grouped', nothing happens if the newest entry is for the same block
+ * with the same description, and hasn't been sealed yet */
+void pattern_undo_begin(struct pattern_undo *u, const char *descr, int grouped,
+	int pattern, int x, int y, int width, int height);
+/* finishes off the newest entry; this has to be done before looking at the
+ * entries, since it might go away */
+void pattern_undo_seal(struct pattern_undo *u);
+
+/* 'n' counts back from the newest entry, which is 0; returns NULL if there's
+ * no such entry */
+const char *pattern_undo_describe(struct pattern_undo *u, int n);
+/* puts the pattern back the way it was before entry 'n', which also means
+ * undoing anything newer in the same pattern. returns the pattern number,
+ * or -1 if nothing was done */
+int pattern_undo_restore(struct pattern_undo *u, int n);
+
+#endif /* SCHISM_PATTERN_UNDO_H_ */
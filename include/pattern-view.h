@@ -46,6 +46,13 @@ PATTERN_VIEW(1)
 
 #undef PATTERN_VIEW
 
+/* same as calling draw_note directly, but keeps what each note of the pattern
+ * was drawn as, so unchanged notes can just be copied back to the screen;
+ * 'chan' is zero-based, and the cache follows whichever pattern was drawn last */
+void draw_note_cached(draw_note_func draw_note, int width, int pattern, int row, int chan,
+	int x, int y, const song_note_t *note, int cursor_pos, int fg, int bg);
+void draw_note_cache_clear(void);
+
 /* for the pattern editor masks (the ^^^ ^^ ^^ --- markers at the bottom) */
 #define MASK_NOTE       1 /* immutable */
 #define MASK_INSTRUMENT 2
@@ -37,11 +37,11 @@ void eq_stereo(song_t *, int32_t *, uint32_t);
 void initialize_eq(int32_t, float);
 void set_eq_gains(const uint32_t *, uint32_t, const uint32_t *, int32_t, int32_t);
 
-// mixer.c
-void ResampleMono8BitFirFilter(signed char *oldbuf, signed char *newbuf, uint32_t oldlen, uint32_t newlen);
-void ResampleMono16BitFirFilter(signed short *oldbuf, signed short *newbuf, uint32_t oldlen, uint32_t newlen);
-void ResampleStereo8BitFirFilter(signed char *oldbuf, signed char *newbuf, uint32_t oldlen, uint32_t newlen);
-void ResampleStereo16BitFirFilter(signed short *oldbuf, signed short *newbuf, uint32_t oldlen, uint32_t newlen);
+// mixer.c; these only write output frames [start, end)
+void ResampleMono8BitFirFilter(signed char *oldbuf, signed char *newbuf, uint32_t oldlen, uint32_t newlen, uint32_t start, uint32_t end);
+void ResampleMono16BitFirFilter(signed short *oldbuf, signed short *newbuf, uint32_t oldlen, uint32_t newlen, uint32_t start, uint32_t end);
+void ResampleStereo8BitFirFilter(signed char *oldbuf, signed char *newbuf, uint32_t oldlen, uint32_t newlen, uint32_t start, uint32_t end);
+void ResampleStereo16BitFirFilter(signed short *oldbuf, signed short *newbuf, uint32_t oldlen, uint32_t newlen, uint32_t start, uint32_t end);
 
 #endif /* SCHISM_PLAYER_CMIXER_H_ */
 
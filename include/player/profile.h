@@ -0,0 +1,150 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHISM_PLAYER_PROFILE_H_
+#define SCHISM_PLAYER_PROFILE_H_
+
+#include "headers.h"
+
+/* Tick-level profiler for the player (configure --enable-player-profiler).
+ *
+ * Every time the player goes in or out of one of these stages, the time
+ * since the last switch is charged to whichever stage was running, so
+ * nested stages (e.g. NNA handling inside effects) are never counted twice.
+ * Time outside of csf_read isn't counted at all. */
+
+enum {
+	CSF_PROFILE_IDLE, /* not in csf_read; not reported */
+	CSF_PROFILE_OTHER, /* rest of csf_read: eq, clipping, etc. */
+	CSF_PROFILE_TICK, /* csf_process_tick, reading the row */
+	CSF_PROFILE_EFFECTS, /* csf_process_effects */
+	CSF_PROFILE_NNA, /* csf_check_nna */
+	CSF_PROFILE_VOICES, /* csf_read_note's per-voice setup; once per tick */
+	CSF_PROFILE_ENVELOPES, /* rn_process_envelope */
+	CSF_PROFILE_UPDATE_SAMPLE, /* rn_update_sample */
+	CSF_PROFILE_MIDI, /* GM/MIDI output and macros */
+	CSF_PROFILE_FM, /* Fmdrv_Mix */
+	/* mixing, by interpolation mode */
+	CSF_PROFILE_MIX_NEAREST,
+	CSF_PROFILE_MIX_LINEAR,
+	CSF_PROFILE_MIX_SPLINE,
+	CSF_PROFILE_MIX_FIR,
+
+	CSF_PROFILE_STAGES,
+};
+
+/* what each voice spends in envelopes, update_sample and mixing is also
+ * totalled up by what kind of voice it is */
+enum {
+	CSF_PROFILE_VOICE_CHANNEL, /* a pattern channel's own voice */
+	CSF_PROFILE_VOICE_NNA, /* a background voice left behind by NNA */
+
+	CSF_PROFILE_VOICE_KINDS,
+};
+
+#define CSF_PROFILE_VOICE_KIND(n) \
+	(((n) < MAX_CHANNELS) ? CSF_PROFILE_VOICE_CHANNEL : CSF_PROFILE_VOICE_NNA)
+
+struct csf_profile {
+	uint64_t last; /* clock at the last switch */
+	int stage; /* what's running now */
+
+	uint64_t cycles[CSF_PROFILE_STAGES];
+	uint64_t calls[CSF_PROFILE_STAGES];
+
+	uint64_t voice_cycles[CSF_PROFILE_VOICE_KINDS];
+	uint64_t voice_ticks[CSF_PROFILE_VOICE_KINDS]; /* voices with a sample playing, per tick */
+};
+
+#ifdef USE_PLAYER_PROFILER
+
+/* cycles, if there's a cheap way to get them; otherwise microseconds */
+#if SCHISM_GNUC_HAS_BUILTIN(__builtin_ia32_rdtsc, 4, 5, 0) \
+	&& (defined(__x86_64__) || defined(__i386__))
+# define CSF_PROFILE_UNIT "cycles"
+static inline SCHISM_ALWAYS_INLINE uint64_t csf_profile_clock(void)
+{
+	return __builtin_ia32_rdtsc();
+}
+#else
+# include "timer.h"
+# define CSF_PROFILE_UNIT "us"
+static inline SCHISM_ALWAYS_INLINE uint64_t csf_profile_clock(void)
+{
+	return timer_ticks_us();
+}
+#endif
+
+/* charges the time since the last switch to the running stage, and returns
+ * how much that was */
+static inline SCHISM_ALWAYS_INLINE uint64_t csf_profile_switch(struct csf_profile *p, int stage)
+{
+	uint64_t now = csf_profile_clock(), elapsed = now - p->last;
+
+	p->cycles[p->stage] += elapsed;
+	p->last = now;
+	p->stage = stage;
+
+	return elapsed;
+}
+
+static inline SCHISM_ALWAYS_INLINE int csf_profile_enter(struct csf_profile *p, int stage)
+{
+	int prev = p->stage;
+
+	csf_profile_switch(p, stage);
+	p->calls[stage]++;
+
+	return prev;
+}
+
+# define CSF_PROFILE_ENTER(csf, stage, save) \
+	int save = csf_profile_enter(&(csf)->profile, (stage))
+# define CSF_PROFILE_LEAVE(csf, save) \
+	csf_profile_switch(&(csf)->profile, (save))
+/* same as leave, but also adds the time to a kind of voice */
+# define CSF_PROFILE_LEAVE_VOICE(csf, save, kind) \
+	((csf)->profile.voice_cycles[(kind)] += csf_profile_switch(&(csf)->profile, (save)))
+# define CSF_PROFILE_COUNT_VOICE(csf, kind) \
+	((csf)->profile.voice_ticks[(kind)]++)
+
+#else
+
+# define CSF_PROFILE_ENTER(csf, stage, save) ((void)0)
+# define CSF_PROFILE_LEAVE(csf, save) ((void)0)
+# define CSF_PROFILE_LEAVE_VOICE(csf, save, kind) ((void)0)
+# define CSF_PROFILE_COUNT_VOICE(csf, kind) ((void)0)
+
+#endif
+
+struct song;
+
+/* clears the counters */
+void csf_profile_reset(struct song *csf);
+
+/* writes a summary, one line at a time; does nothing unless the profiler
+ * was compiled in */
+void csf_profile_report(struct song *csf,
+	void (*line)(void *userdata, const char *text), void *userdata);
+
+#endif /* SCHISM_PLAYER_PROFILE_H_ */
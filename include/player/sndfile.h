@@ -17,6 +17,8 @@
 
 #include "timer.h" // timer_ticks_t
 #include "fmopl.h" // OPL_CHANNELS
+#include "atomic.h"
+#include "player/profile.h"
 
 #define MOD_AMIGAC2             0x1AB
 #define MAX_SAMPLE_LENGTH       0x10000000 /* borrowed from OpenMPT; originally 16000000 */
@@ -727,6 +729,10 @@ extern const song_note_t *blank_note;
 
 struct multi_write {
 	int used;
+	/* if set, this channel is neither mixed nor written (its voices are still
+	processed, so the other channels sound exactly the same). this is used to
+	split multi-write exports between several copies of a song. */
+	int muted;
 	void *data;
 	/* Conveniently, this has the same prototype as disko_write :) */
 	void (*write)(void *data, const uint8_t *buf, size_t bytes);
@@ -861,17 +867,36 @@ typedef struct song {
 
 	// multi-write stuff -- NULL if no multi-write is in progress, else array of one struct per channel
 	struct multi_write *multi_write;
+
+	// where the time goes, if the profiler is compiled in (player/profile.h)
+	struct csf_profile profile;
 } song_t;
 
 song_note_t *csf_allocate_pattern(uint32_t rows);
 void csf_free_pattern(void *pat);
 signed char *csf_allocate_sample(uint32_t nbytes);
 void csf_free_sample(void *p);
+/* goes up every time sample data is freed, since another sample might get
+ * the same address afterwards */
+extern struct atm csf_sample_frees;
+/* if nonzero, csf_read_sample maps raw PCM straight out of the file when it can */
+extern int csf_map_samples;
+/* sets up the lock around the list of mapped samples; call this once at startup */
+int csf_init_mapped_samples(void);
 song_instrument_t *csf_allocate_instrument(void);
 void csf_init_instrument(song_instrument_t *ins, int samp);
 void csf_free_instrument(song_instrument_t *p);
 
 uint32_t csf_read_sample(song_sample_t *sample, uint32_t flags, slurp_t *fp);
+
+/* Decoding lots of samples at once, possibly in parallel. Each sample added is read
+ * as with csf_read_sample, starting at `offset`, but this may not happen until
+ * csf_sample_jobs_finish, which also frees the job list. The position of `fp` is
+ * preserved either way, and it must stay open until then. */
+typedef struct csf_sample_jobs csf_sample_jobs_t;
+csf_sample_jobs_t *csf_sample_jobs_create(slurp_t *fp);
+void csf_sample_jobs_add(csf_sample_jobs_t *jobs, song_sample_t *sample, uint32_t flags, int64_t offset);
+void csf_sample_jobs_finish(csf_sample_jobs_t *jobs);
 uint32_t csf_write_sample(disko_t *fp, song_sample_t *sample, uint32_t flags, uint32_t maxlengthmask);
 void csf_adjust_sample_loop(song_sample_t *sample);
 
@@ -902,6 +927,7 @@ int csf_get_highest_used_channel(song_t *csf);
 
 
 
+
 int csf_set_wave_config(song_t *csf, uint32_t rate, uint32_t bits, uint32_t channels);
 
 // Mixer Config
@@ -950,6 +976,7 @@ int csf_destroy_sample(song_t *csf, uint32_t smpnum);
 void csf_precompute_sample_loops(song_sample_t *smp);
 
 void csf_stop_sample(song_t *csf, song_sample_t *smp);
+void csf_retarget_sample(song_t *csf, song_sample_t *smp, signed char *data);
 
 void csf_reset_midi_cfg(song_t *csf);
 void csf_copy_midi_cfg(song_t *dest, song_t *src);
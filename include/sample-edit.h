@@ -26,6 +26,12 @@
 
 #include "headers.h"
 
+/* Long edits are done a piece at a time (and in parallel, if possible);
+ * the progress callback is called by the thread that started the edit once
+ * for each piece, whichever thread did it, with how many of them are done so
+ * far. The last call is always with done == total. */
+void sample_edit_set_progress(void (*progress)(uint32_t done, uint32_t total));
+
 void sample_sign_convert(song_sample_t * sample);
 void sample_reverse(song_sample_t * sample);
 void sample_centralise(song_sample_t * sample);
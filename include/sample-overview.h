@@ -0,0 +1,63 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef SCHISM_SAMPLE_OVERVIEW_H_
+#define SCHISM_SAMPLE_OVERVIEW_H_
+
+#include "headers.h"
+
+#include "player/sndfile.h"
+
+/* Min/max overviews of long samples, for drawing the waveform.
+ *
+ * Finding the peaks for every column of the sample display means going
+ * through the whole sample each time it's drawn, which gets slow for samples
+ * that are millions of frames long. The overview keeps the minimum and
+ * maximum of every block of SAMPLE_OVERVIEW_BLOCK frames, then of every two
+ * blocks, every four, and so on, so the peaks of any part of the sample can
+ * be put together from a handful of those plus at most two partial blocks.
+ *
+ * Overviews are built the first time they're asked for and kept for a few
+ * samples at a time. Anything that changes sample data in place has to call
+ * sample_overview_invalidate afterwards; freeing sample data throws out all
+ * of them. */
+
+#define SAMPLE_OVERVIEW_BLOCK 64
+
+/* shorter samples are quick enough to go through every time */
+#define SAMPLE_OVERVIEW_MIN_LENGTH 65536
+
+struct sample_overview;
+
+/* returns NULL if the sample is too short to bother (or has no data) */
+const struct sample_overview *sample_overview_get(const song_sample_t *sample);
+
+/* peaks of 'length' frames starting at 'start', in the sample's own range
+ * (i.e. -128..127 for 8-bit samples) */
+void sample_overview_minmax(const struct sample_overview *ov, uint32_t chan,
+	uint32_t start, uint32_t length, int32_t *min, int32_t *max);
+
+void sample_overview_invalidate(const song_sample_t *sample);
+void sample_overview_clear(void);
+
+#endif /* SCHISM_SAMPLE_OVERVIEW_H_ */
@@ -35,6 +35,17 @@ enum {
 };
 
 struct slurp_nonseek;
+struct slurp_mmcmp;
+
+/* a private, writable view of part of a file; see slurp_map() */
+struct slurp_mapping {
+	void *data;
+
+	/* used internally to undo the mapping */
+	void *base;
+	size_t size;
+	void (*unmap)(struct slurp_mapping *m);
+};
 
 typedef struct slurp_struct_ slurp_t;
 struct slurp_struct_ {
@@ -67,6 +78,9 @@ struct slurp_struct_ {
 	 * (optional, can be NULL) */
 	int (*receive)(slurp_t *, int (*callback)(const void *, size_t, void *), size_t length, void *userdata);
 
+	/* map data at the current position into memory without copying it (optional, can be NULL) */
+	int (*map)(slurp_t *, size_t count, size_t before, size_t after, struct slurp_mapping *m);
+
 	/* used internally to mark position for slurp_limit() */
 	int64_t limit;
 
@@ -92,6 +106,10 @@ struct slurp_struct_ {
 				struct {
 					int fd;
 				} mmap;
+
+				struct {
+					struct slurp_mmcmp *mm;
+				} mmcmp;
 			} interfaces;
 		} memory;
 
@@ -137,6 +155,10 @@ can be used to read only part of a file, or if the file size is known but a stat
 available. */
 int slurp(slurp_t *t, const char *filename, struct stat *buf, uint64_t size);
 
+/* transparently unpacks gzip'd and MMCMP'd streams; slurp() already does this,
+ * it's only needed for streams made by hand (e.g. slurp_memstream) */
+void slurp_unwrap(slurp_t *t);
+
 /* initializes a slurp_t over an existing file */
 int slurp_stdio(slurp_t *t, FILE *fp);
 
@@ -178,9 +200,21 @@ int slurp_getc(slurp_t *t); /* returns unsigned char cast to int, or EOF */
 int slurp_eof(slurp_t *t);  /* 1 = end of file */
 int slurp_receive(slurp_t *t, int (*callback)(const void *, size_t, void *), size_t count, void *userdata);
 
+/* maps `count` bytes at the current position into memory that can be written to without
+ * affecting the file, with at least `before` and `after` bytes of (uninitialized) padding
+ * around them, and seeks past them. returns 1 if it worked, or 0 if the backend can't do
+ * this, in which case the data has to be read normally. */
+int slurp_map(slurp_t *t, size_t count, size_t before, size_t after, struct slurp_mapping *m);
+void slurp_unmap(struct slurp_mapping *m);
+
 /* can never fail (hopefully...) */
 uint64_t slurp_length(slurp_t *t);
 
+/* if the entire stream is already sitting in memory, returns a pointer to it, so that
+ * separate memory streams can be made over it (e.g. to read from it in other threads).
+ * returns NULL otherwise. */
+const uint8_t *slurp_memory_data(slurp_t *t, size_t *length);
+
 /* creates a wall, relative to the current position
  * any reads that try to go after that point will be filled with zeroes */
 void slurp_limit(slurp_t *t, int64_t wall);
@@ -201,11 +235,24 @@ int slurp_init_nonseek(slurp_t *fp,
 	void (*closure)(void *opaque),
 	void *opaque);
 
+/* lets a non-seekable stream keep only `window` bytes behind the read position in memory,
+ * rather than everything read so far. `rewind` restarts the stream from the beginning, and
+ * is used (and the window disabled) if something seeks back further than that. */
+void slurp_nonseek_set_window(slurp_t *fp, size_t window, int (*rewind)(void *opaque));
+
+/* tells a non-seekable stream about how long it's going to be, so slurp_length() can answer
+ * without reading the whole thing. the hint is used until the stream has actually been read
+ * to its end, or past the hint; after that, the real length is */
+void slurp_nonseek_set_size_hint(slurp_t *fp, uint64_t size);
+
 #ifdef USE_ZLIB
 /* in fmt/gzip.c  .... */
 int slurp_gzip(slurp_t *src);
 #endif
 
+/* in fmt/mmcmp.c; blocks are decoded as they're read */
+int slurp_mmcmp(slurp_t *src);
+
 int slurp_available(slurp_t *fp, size_t x, int whence);
 
 #endif /* SCHISM_SLURP_H */
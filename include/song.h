@@ -59,6 +59,19 @@ struct audio_settings {
 	unsigned int eq_freq[4];
 	unsigned int eq_gain[4];
 	int no_ramping;
+
+	/* scheduling for the audio thread (see mt_sched_configure) */
+	int realtime; /* MT_SCHED_* */
+	int realtime_priority;
+	int audio_cpu;
+	int lower_priority;
+
+	/* let the buffer size follow how long mixing takes, between these */
+	int adaptive_buffer;
+	int buffer_size_min, buffer_size_max;
+
+	/* how many buffers to mix ahead of the device on a separate thread */
+	int render_ahead;
 };
 
 extern struct audio_settings audio_settings;
@@ -125,11 +138,15 @@ song_load_unchecked:
 song_create_load:
 	internal back-end function that loads and returns a song.
 	the above functions both use this.
+song_create_load_slurp:
+	same, but reads from an already opened stream. lflags are passed on
+	to the loaders (LOAD_NOSAMPLES etc.)
 */
 void song_new(int flags);
 void song_load(const char *file);
 int song_load_unchecked(const char *file);
 song_t *song_create_load(const char *file);
+song_t *song_create_load_slurp(slurp_t *s, uint32_t lflags);
 
 // song_create_load returns NULL on error and sets errno to what might not be a standard value
 // use this to divine the meaning of these cryptic numbers
@@ -258,10 +275,41 @@ void audio_flash_reinitialized_text(int success);
  * for an audio driver. */
 int audio_init(const char *driver, const char *device);
 
+/* Called at startup from the main thread, after cfg_load_scheduling and
+ * before the timer, MIDI and audio threads are started: sets up real-time
+ * scheduling for them as configured, and lowers the priority of the main
+ * thread if asked to. */
+void audio_init_scheduling(void);
+
+/* what the audio thread ended up with, as a mask of MT_ROLE_*, or -1 if the
+ * callback hasn't run yet */
+int song_get_audio_thread_role(void);
+
 /* Reconfigure the same device that was opened before, or a device specified by
  * device ID `device` (see audio_device_list) */
 int audio_reinit(uint32_t *device);
 
+/* If the adaptive buffer size is turned on, reopens the device with a
+ * different buffer size when the current one is too small or needlessly big.
+ * Called from the main thread on playback events. */
+void audio_adapt_buffer(void);
+
+/* With render-ahead on, throws away whatever was mixed but hasn't been played
+ * yet (except for the next buffer) so that a change to the song is heard right
+ * away. Since the song has already moved past what gets thrown away, this is
+ * only for starting, stopping and moving playback. Call this with the audio
+ * locked, after making the change. */
+void audio_ahead_invalidate(void);
+
+/* The same, for changes that don't move playback (notes, muting); while the
+ * song is playing, this does nothing and the change is heard a few buffers
+ * later instead of skipping the song forward. */
+void audio_ahead_invalidate_if_idle(void);
+
+/* how many buffers are being mixed ahead, or 0 if render-ahead isn't on; also
+ * returns how many times the device ran out of them */
+int song_get_render_ahead(uint32_t *underruns);
+
 void audio_quit(void);
 
 int audio_has_control_panel(void);
@@ -340,6 +388,10 @@ int song_toggle_orderlist_locked(void);
 int song_get_playing_channels(void);
 int song_get_max_channels(void);
 
+/* timing of the audio callback since the device was opened (audio-stats.h) */
+struct audio_stats;
+void song_get_audio_stats(struct audio_stats *stats);
+
 void song_get_vu_meter(int *left, int *right);
 
 /* fill the array with flags of each playing sample/instrument, such that iff
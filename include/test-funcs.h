@@ -25,6 +25,8 @@
 # define TEST_FUNC(x) testresult_t x(void);
 #endif
 
+TEST_FUNC(test_audio_stats_percentiles)
+TEST_FUNC(test_audio_stats_adapt_buffer)
 TEST_FUNC(test_bshift_arithmetic)
 TEST_FUNC(test_bshift_right_shift_negative)
 TEST_FUNC(test_bshift_left_shift_overflow)
@@ -128,10 +130,45 @@ TEST_FUNC(test_slurp_win32_mmap)
 #endif
 #ifdef HAVE_MMAP
 TEST_FUNC(test_slurp_mmap)
+TEST_FUNC(test_slurp_mmap_map)
 #endif
 #ifdef USE_ZLIB
 TEST_FUNC(test_slurp_gzip)
 #endif
+TEST_FUNC(test_slurp_nonseek_window)
+TEST_FUNC(test_slurp_nonseek_size_hint)
+TEST_FUNC(test_slurp_mmcmp)
+
+TEST_FUNC(test_csf_sample_jobs_memory)
+TEST_FUNC(test_csf_sample_jobs_stdio)
+TEST_FUNC(test_csf_sample_jobs_limit)
+TEST_FUNC(test_csf_sample_jobs_truncated_xm)
+TEST_FUNC(test_csf_multi_write_muted)
+TEST_FUNC(test_csf_profile)
+
+TEST_FUNC(test_disko_async)
+TEST_FUNC(test_disko_async_error)
+TEST_FUNC(test_disko_export_multi)
+
+TEST_FUNC(test_events_queue_order)
+TEST_FUNC(test_events_queue_full)
+
+TEST_FUNC(test_pattern_undo_restore)
+TEST_FUNC(test_pattern_undo_grouped)
+TEST_FUNC(test_pattern_undo_budget)
+
+TEST_FUNC(test_pattern_view_note_cache)
+
+TEST_FUNC(test_sample_edit_copy_on_write)
+TEST_FUNC(test_sample_edit_chunked)
+TEST_FUNC(test_sample_edit_pointwise)
+
+TEST_FUNC(test_sample_overview_minmax)
+
+TEST_FUNC(test_vgamem_scan32_glyph_cache)
+
+TEST_FUNC(test_video_blitLN)
+TEST_FUNC(test_video_blitLN_rows)
 
 TEST_FUNC(test_config_file_defined_values)
 TEST_FUNC(test_config_file_undefined_values_in_defined_section)
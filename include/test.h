@@ -79,6 +79,40 @@ void test_log_printf(const char *fmt, ...);
 
 void test_log_dump(void);
 
+/* ------------------------------------------------------------------------ */
+/* benchmarks and fuzzing
+ *
+ * these aren't run as part of the normal test batch, since they take
+ * arbitrary input and their results are timings rather than pass/fail:
+ *
+ *     schismtrackertest --bench NAME [ARGS...]
+ *     schismtrackertest --fuzz FILE|DIRECTORY...
+ */
+
+typedef int (*benchfunctor_t)(int argc, char *argv[]);
+
+typedef struct {
+	const char *name;
+	benchfunctor_t bench;
+} bench_index_entry;
+
+extern bench_index_entry benchmarks[];
+
+/* both of these take the arguments starting from the option that picked
+ * them, i.e. argv[0] is "--bench" or "--fuzz" */
+
+/* runs the benchmark named by argv[1]; it gets argv[0] as its name */
+int schism_bench_main(int argc, char *argv[]);
+
+/* replays every file given through the fuzzing entry point (see test/fuzz.c) */
+int schism_fuzz_main(int argc, char *argv[]);
+
+/* calls `callback` for every path given; directories are expanded (but not
+ * recursively) to the regular files in them. returns the number of files,
+ * or -1 if any of the paths couldn't be read. */
+int bench_for_each_file(int npaths, char *paths[],
+	void (*callback)(const char *path, void *userdata), void *userdata);
+
 /* ------------------------------------------------------------------------ */
 /* entrypoint takeover */
 
@@ -100,4 +134,6 @@ int schism_test_main(int argc, char *argv[]);
 
 #include "test-funcs.h"
 
+#include "bench-funcs.h"
+
 #endif /* SCHISM_TEST_H_ */
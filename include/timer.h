@@ -54,6 +54,10 @@ void timer_msleep(uint32_t msec);
 // Run a function after `ms` milliseconds
 void timer_oneshot(uint32_t ms, void (*callback)(void *param), void *param);
 
+// Same, but in microseconds. Backends with their own oneshot timers
+// still only go by milliseconds.
+void timer_oneshot_us(uint64_t usec, void (*callback)(void *param), void *param);
+
 // init/quit
 int timer_init(void);
 void timer_quit(void);
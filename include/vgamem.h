@@ -37,6 +37,14 @@ void vgamem_clear(void);
 /* applies all edits to the internal screen */
 void vgamem_flip(void);
 
+/* fills 'rows' with which rows of characters changed since the last call
+ * (i.e., need to be scanned again), and returns how many did */
+int vgamem_get_dirty_rows(uint8_t rows[50]);
+
+/* marks the whole screen as changed, for when it has to be scanned again
+ * regardless (new palette, new texture, ...) */
+void vgamem_dirty_all(void);
+
 /* scan to pixel data */
 SCHISM_SIMD SCHISM_HOT void vgamem_scan8 (uint32_t y, uint8_t  *out, uint32_t tc[16], uint32_t mouseline[80], uint32_t mouseline_mask[80]);
 SCHISM_SIMD SCHISM_HOT void vgamem_scan16(uint32_t y, uint16_t *out, uint32_t tc[16], uint32_t mouseline[80], uint32_t mouseline_mask[80]);
@@ -91,6 +99,11 @@ void draw_fill_chars(int xs, int ys, int xe, int ye, uint32_t fg, uint32_t bg);
 void draw_half_width_chars(uint8_t c1, uint8_t c2, int x, int y,
 			   uint32_t fg1, uint32_t bg1, uint32_t fg2, uint32_t bg2);
 
+/* copy 'len' character cells, exactly as they were drawn, out of or back
+ * into the internal screen; these are only meaningful to vgamem itself */
+void vgamem_get_cells(int x, int y, int len, uint32_t *cells);
+void vgamem_put_cells(int x, int y, int len, const uint32_t *cells);
+
 /* --------------------------------------------------------------------- */
 /* boxes */
 
@@ -163,12 +163,26 @@ SCHISM_HOT void video_blitTV(unsigned char *pixels, unsigned int pitch, uint32_t
  *
  * NOTE: `bpp` here is BYTES per pixel, not bits per pixel. */
 SCHISM_HOT void video_blit11(unsigned int bpp, unsigned char *pixels, unsigned int pitch, uint32_t tpal[256]);
+/* same, but only 'count' scanlines starting at 'first'; 'pixels' points to the first one */
+SCHISM_HOT void video_blit11_rows(unsigned int bpp, unsigned char *pixels, unsigned int pitch, uint32_t tpal[256], uint32_t first, uint32_t count);
 SCHISM_HOT void video_blitNN(unsigned int bpp, unsigned char *pixels, unsigned int pitch, uint32_t tpal[256], uint32_t width, uint32_t height);
 SCHISM_HOT void video_blitLN(unsigned int bpp, unsigned char *pixels, unsigned int pitch, schism_map_rgb_spec map_rgb, void *map_rgb_data, uint32_t width, uint32_t height);
 
+/* the per-row interpolation behind video_blitLN: fills 'count' pixels of an output line, starting at
+ * column 'x', as 0x00RRGGBB. video_blitLN_row returns the version for 'feature' (a CPU_FEATURE_*, or
+ * -1 for the plain C one), or NULL if there isn't one or the CPU doesn't have it. */
+typedef void (*video_blitLN_row_spec)(uint32_t *out, const uint32_t *csp, const uint32_t *esp,
+	uint32_t x, uint32_t count, uint32_t scalex, uint32_t ey);
+video_blitLN_row_spec video_blitLN_row(int feature);
+
 /* scaled blit, according to user settings (lots of params here) */
 SCHISM_HOT void video_blitSC(uint32_t bpp, unsigned char *pixels, uint32_t pitch, uint32_t pal[256], schism_map_rgb_spec fun, void *fun_data, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
 
+/* fills 'rows' with which rows of characters (8 scanlines each) changed since
+ * the last call, including where the software cursor moved, and returns how
+ * many did. for backends that can upload part of the screen at a time */
+int video_get_dirty_rows(uint8_t rows[50]);
+
 /* ------------------------------------------------------------------------ */
 /* helper function to convert RGB values to YUV */
 
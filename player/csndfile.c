@@ -33,6 +33,7 @@
 #include "ieee-float.h"
 #include "fmt.h" // for it_decompress8 / it_decompress16
 #include "mem.h"
+#include "mt.h"
 
 
 static void _csf_reset(song_t *csf)
@@ -221,10 +222,125 @@ signed char *csf_allocate_sample(uint32_t nbytes)
 	return (signed char*)mem_calloc(1, nbytes + CSF_ALLOCATE_PREPEND + CSF_ALLOCATE_APPEND) + CSF_ALLOCATE_PREPEND;
 }
 
+/* samples whose data points into a mapping of the file they were loaded from;
+ * see csf_map_sample() */
+struct csf_mapped_sample {
+	struct csf_mapped_sample *next;
+	struct slurp_mapping map;
+};
+
+static struct csf_mapped_sample *csf_mapped_samples = NULL;
+/* samples get freed from all sorts of threads (the disk writer, for one),
+ * so the list is kept under a lock; see csf_init_mapped_samples() */
+static mt_mutex_t *csf_mapped_samples_mutex = NULL;
+
+int csf_map_samples = 0;
+
+struct atm csf_sample_frees = {0};
+
+int csf_init_mapped_samples(void)
+{
+	csf_mapped_samples_mutex = mt_mutex_create();
+
+	return csf_mapped_samples_mutex ? 0 : -1;
+}
+
 void csf_free_sample(void *p)
 {
-	if (p)
+	struct csf_mapped_sample **pms, *ms = NULL;
+	int32_t frees;
+
+	if (!p)
+		return;
+
+	/* this can happen on any thread */
+	do {
+		frees = atm_load(&csf_sample_frees);
+	} while (!atm_cas(&csf_sample_frees, frees, (int32_t)((uint32_t)frees + 1)));
+
+	if (csf_mapped_samples_mutex)
+		mt_mutex_lock(csf_mapped_samples_mutex);
+
+	for (pms = &csf_mapped_samples; *pms; pms = &(*pms)->next) {
+		if ((*pms)->map.data == p) {
+			ms = *pms;
+			*pms = ms->next;
+			break;
+		}
+	}
+
+	if (csf_mapped_samples_mutex)
+		mt_mutex_unlock(csf_mapped_samples_mutex);
+
+	if (ms) {
+		slurp_unmap(&ms->map);
+		free(ms);
+	} else {
 		free((signed char*)p - CSF_ALLOCATE_PREPEND);
+	}
+}
+
+/* returns the sample width in bytes if the data is stored exactly the way
+ * we keep it in memory, zero otherwise */
+static int csf_sample_is_raw(uint32_t flags)
+{
+	switch (flags) {
+	case SF(8,M,LE,PCMS):
+	case SF(8,M,BE,PCMS):
+	case SF(8,SI,LE,PCMS):
+	case SF(8,SI,BE,PCMS):
+		return 1;
+#ifdef WORDS_BIGENDIAN
+	case SF(16,M,BE,PCMS):
+	case SF(16,SI,BE,PCMS):
+#else
+	case SF(16,M,LE,PCMS):
+	case SF(16,SI,LE,PCMS):
+#endif
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+/* Uncompressed PCM that's already in the same format we use in memory
+ * doesn't need to be copied at all if the file is memory mapped; the
+ * sample can just point into a (copy-on-write) mapping of the file
+ * instead. Returns the number of bytes used, or zero if the sample has
+ * to be read normally. */
+static uint32_t csf_map_sample(song_sample_t *sample, uint32_t flags, slurp_t *fp, uint32_t mem)
+{
+	struct csf_mapped_sample *ms;
+	int width;
+
+	if (!csf_map_samples || !fp->map)
+		return 0;
+
+	width = csf_sample_is_raw(flags);
+
+	/* don't hand the mixer misaligned data */
+	if (!width || (slurp_tell(fp) % width))
+		return 0;
+
+	ms = mem_calloc(1, sizeof(*ms));
+
+	if (!slurp_map(fp, mem, CSF_ALLOCATE_PREPEND, CSF_ALLOCATE_APPEND, &ms->map)) {
+		free(ms);
+		return 0;
+	}
+
+	if (csf_mapped_samples_mutex)
+		mt_mutex_lock(csf_mapped_samples_mutex);
+
+	ms->next = csf_mapped_samples;
+	csf_mapped_samples = ms;
+
+	if (csf_mapped_samples_mutex)
+		mt_mutex_unlock(csf_mapped_samples_mutex);
+
+	sample->data = ms->map.data;
+
+	return mem;
 }
 
 #undef CSF_ALLOCATE_PREPEND
@@ -805,6 +921,12 @@ uint32_t csf_read_sample(song_sample_t *sample, uint32_t flags, slurp_t *fp)
 		break;
 	}
 
+	len = csf_map_sample(sample, flags, fp, mem);
+	if (len) {
+		csf_adjust_sample_loop(sample);
+		return len;
+	}
+
 	// allocate the data
 	sample->data = csf_allocate_sample(mem);
 	if (!sample->data) {
@@ -1332,6 +1454,134 @@ uint32_t csf_read_sample(song_sample_t *sample, uint32_t flags, slurp_t *fp)
 	return len;
 }
 
+/* --------------------------------------------------------------------------------------------------------- */
+/* Sample decoding jobs: once a loader knows where all of the sample data is, the samples can all be
+ * decoded at the same time, which helps a lot for compressed formats. This only happens if the whole
+ * file is in memory, since every thread needs to be able to read from it on its own; otherwise the
+ * samples are simply read in as they're added. */
+
+#define CSF_SAMPLE_JOB_THREADS 4
+
+struct csf_sample_job {
+	song_sample_t *sample;
+	uint32_t flags;
+	int64_t offset;
+	int64_t limit; /* slurp_limit() on the file when this was added, if any */
+};
+
+struct csf_sample_jobs {
+	slurp_t *fp;
+
+	/* the whole file, or NULL if it isn't in memory */
+	const uint8_t *data;
+	size_t length;
+
+	mt_mutex_t *mutex;
+	uint32_t next; /* next job to be picked up (protected by mutex) */
+
+	uint32_t count;
+	struct csf_sample_job jobs[MAX_SAMPLES];
+};
+
+static void csf_sample_job_run_now(slurp_t *fp, song_sample_t *sample, uint32_t flags, int64_t offset)
+{
+	const int64_t pos = slurp_tell(fp);
+
+	slurp_seek(fp, offset, SEEK_SET);
+	csf_read_sample(sample, flags, fp);
+
+	slurp_seek(fp, pos, SEEK_SET);
+}
+
+static int csf_sample_jobs_worker(void *userdata)
+{
+	csf_sample_jobs_t *jobs = userdata;
+
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+
+	for (;;) {
+		struct csf_sample_job *job;
+		slurp_t fp;
+		uint32_t n;
+
+		if (jobs->mutex)
+			mt_mutex_lock(jobs->mutex);
+		n = jobs->next++;
+		if (jobs->mutex)
+			mt_mutex_unlock(jobs->mutex);
+
+		if (n >= jobs->count)
+			break;
+
+		job = jobs->jobs + n;
+
+		/* nothing may be read past a wall that was up when the job was
+		 * added, same as if it had been done right then */
+		slurp_memstream(&fp, (uint8_t *)jobs->data, jobs->length);
+		fp.limit = job->limit;
+		csf_sample_job_run_now(&fp, job->sample, job->flags, job->offset);
+		unslurp(&fp);
+	}
+
+	return 0;
+}
+
+csf_sample_jobs_t *csf_sample_jobs_create(slurp_t *fp)
+{
+	csf_sample_jobs_t *jobs = mem_calloc(1, sizeof(*jobs));
+
+	jobs->fp = fp;
+	jobs->data = slurp_memory_data(fp, &jobs->length);
+
+	return jobs;
+}
+
+void csf_sample_jobs_add(csf_sample_jobs_t *jobs, song_sample_t *sample, uint32_t flags, int64_t offset)
+{
+	/* samples that get mapped straight out of the file aren't decoded at all,
+	 * so there's no point in deferring them */
+	if (!jobs->data || jobs->count >= ARRAY_SIZE(jobs->jobs)
+		|| (csf_map_samples && jobs->fp->map && csf_sample_is_raw(flags))) {
+		csf_sample_job_run_now(jobs->fp, sample, flags, offset);
+		return;
+	}
+
+	jobs->jobs[jobs->count].sample = sample;
+	jobs->jobs[jobs->count].flags = flags;
+	jobs->jobs[jobs->count].offset = offset;
+	jobs->jobs[jobs->count].limit = jobs->fp->limit;
+	jobs->count++;
+}
+
+void csf_sample_jobs_finish(csf_sample_jobs_t *jobs)
+{
+	mt_thread_t *threads[CSF_SAMPLE_JOB_THREADS - 1];
+	uint32_t i, nthreads = 0;
+
+	if (jobs->count > 1)
+		jobs->mutex = mt_mutex_create();
+
+	/* this thread does its share of the work too, so if threads
+	 * aren't available everything just gets done right here */
+	if (jobs->mutex) {
+		for (i = 0; i < ARRAY_SIZE(threads) && i + 1 < jobs->count; i++) {
+			threads[nthreads] = mt_thread_create(csf_sample_jobs_worker, "Sample decoder", jobs);
+			if (threads[nthreads])
+				nthreads++;
+		}
+	}
+
+	csf_sample_jobs_worker(jobs);
+
+	for (i = 0; i < nthreads; i++)
+		mt_thread_wait(threads[i], NULL);
+
+	if (jobs->mutex)
+		mt_mutex_delete(jobs->mutex);
+
+	free(jobs);
+}
+
 /* --------------------------------------------------------------------------------------------------------- */
 
 #define PRECOMPUTE_LOOPS_IMPL(bits) \
@@ -1472,6 +1722,20 @@ void csf_stop_sample(song_t *csf, song_sample_t *smp)
 	}
 }
 
+/* Moves any voices playing smp's data over to 'data' instead, so that the old
+ * buffer can be freed without cutting them off. The new data has to have the
+ * same length and format. */
+void csf_retarget_sample(song_t *csf, song_sample_t *smp, signed char *data)
+{
+	song_voice_t *v = csf->voices;
+
+	if (!smp->data)
+		return;
+	for (int i = 0; i < MAX_VOICES; i++, v++)
+		if (v->current_sample_data == smp->data)
+			v->current_sample_data = data;
+}
+
 int csf_destroy_sample(song_t *csf, uint32_t nsmp)
 {
 	song_sample_t *smp = csf->samples + nsmp;
@@ -594,8 +594,11 @@ static void fx_retrig_note(song_t *csf, uint32_t nchan, uint32_t param)
 
 		uint32_t note = chan->new_note;
 		int32_t frequency = chan->frequency;
-		if (NOTE_IS_NOTE(note) && chan->length)
+		if (NOTE_IS_NOTE(note) && chan->length) {
+			CSF_PROFILE_ENTER(csf, CSF_PROFILE_NNA, prof);
 			csf_check_nna(csf, nchan, 0, note, 1);
+			CSF_PROFILE_LEAVE(csf, prof);
+		}
 		csf_note_change(csf, nchan, note, 1, 1, 0);
 		if (frequency && chan->row_note == NOTE_NONE)
 			chan->frequency = frequency;
@@ -2163,6 +2166,8 @@ void csf_process_effects(song_t *csf, int firsttick)
 	/* toggle this off */
 	patloop = 0;
 
+	CSF_PROFILE_ENTER(csf, CSF_PROFILE_EFFECTS, prof);
+
 	for (nchan = 0, chan = csf->voices; nchan < MAX_CHANNELS; nchan++, chan++) {
 		chan->n_command = 0;
 
@@ -2303,8 +2308,11 @@ void csf_process_effects(song_t *csf, int firsttick)
 			if (NOTE_IS_NOTE(note)) {
 				chan->new_note = note;
 
-				if (!porta)
+				if (!porta) {
+					CSF_PROFILE_ENTER(csf, CSF_PROFILE_NNA, prof_nna);
 					csf_check_nna(csf, nchan, instr, note, 0);
+					CSF_PROFILE_LEAVE(csf, prof_nna);
+				}
 
 				if (chan->channel_panning > 0) {
 					chan->panning = (chan->channel_panning & 0x7FFF) - 1;
@@ -2426,4 +2434,6 @@ void csf_process_effects(song_t *csf, int firsttick)
 			break;
 		}
 	}
+
+	CSF_PROFILE_LEAVE(csf, prof);
 }
@@ -72,6 +72,7 @@ Revision History:
 #include "headers.h"
 
 #include "player/fmopl.h"
+#include "atomic.h"
 
 #include "bits.h"
 
@@ -570,8 +571,14 @@ static const int8_t lfo_pm_table[8*8*2] = {
 };
 
 
-/* lock level of common table */
-static int num_lock = 0;
+/* common tables are built once and shared by every chip, which may be
+ * created and destroyed on several threads at once (stem export) */
+enum {
+	TABLES_EMPTY,
+	TABLES_BUILDING,
+	TABLES_READY,
+};
+static struct atm tables_state = {TABLES_EMPTY};
 
 
 #define SLOT7_1 (&OPL->P_CH[7].SLOT[SLOT1])
@@ -1186,12 +1193,6 @@ static int init_tables(void)
 	return 1;
 }
 
-static void OPLCloseTable( void )
-{
-}
-
-
-
 static void OPL_initalize(FM_OPL *OPL)
 {
 	int i;
@@ -1653,33 +1654,29 @@ static void OPLWriteReg(FM_OPL *OPL, int r, int v)
 	}
 }
 
-/* lock/unlock for common table */
+/* build the common tables on first use */
 static int OPL_LockTable(void)
 {
-	num_lock++;
-	if(num_lock>1) return 0;
-
-	/* first time */
+	for (;;) {
+		switch (atm_load(&tables_state)) {
+		case TABLES_READY:
+			return 0;
+		case TABLES_EMPTY:
+			if (!atm_cas(&tables_state, TABLES_EMPTY, TABLES_BUILDING))
+				break;
+
+			if (!init_tables()) {
+				atm_store(&tables_state, TABLES_EMPTY);
+				return -1;
+			}
 
-	/* allocate total level table (128kb space) */
-	if( !init_tables() )
-	{
-		num_lock--;
-		return -1;
+			atm_store(&tables_state, TABLES_READY);
+			return 0;
+		default:
+			/* another chip is building them; they're tiny, so just spin */
+			break;
+		}
 	}
-
-	return 0;
-}
-
-static void OPL_UnLockTable(void)
-{
-	if(num_lock) num_lock--;
-	if(num_lock) return;
-
-	/* last time */
-
-	OPLCloseTable();
-
 }
 
 static void OPLResetChip(FM_OPL *OPL)
@@ -1835,7 +1832,6 @@ static FM_OPL *OPLCreate(uint32_t clock, uint32_t rate, int type)
 /* Destroy one of virtual YM3812 */
 static void OPLDestroy(FM_OPL *OPL)
 {
-	OPL_UnLockTable();
 	free(OPL);
 }
 
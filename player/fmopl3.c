@@ -59,6 +59,7 @@ differences between OPL2 and OPL3 shown in datasheets:
 #include "bits.h"
 
 #include "player/fmopl.h"
+#include "atomic.h"
 
 /* output final shift */
 #define FINAL_SH    (0)
@@ -562,8 +563,14 @@ static const int8_t lfo_pm_table[8*8*2] = {
 };
 
 
-/* lock level of common table */
-static int num_lock = 0;
+/* common tables are built once and shared by every chip, which may be
+ * created and destroyed on several threads at once (stem export) */
+enum {
+	TABLES_EMPTY,
+	TABLES_BUILDING,
+	TABLES_READY,
+};
+static struct atm tables_state = {TABLES_EMPTY};
 
 /* work table */
 #define SLOT7_1 (&chip->P_CH[7].SLOT[SLOT1])
@@ -1263,15 +1270,6 @@ static int init_tables(void)
 	return 1;
 }
 
-static void OPLCloseTable( void )
-{
-#ifdef SAVE_SAMPLE
-	fclose(sample[0]);
-#endif
-}
-
-
-
 static void OPL3_initalize(OPL3 *chip)
 {
 	int i;
@@ -2202,31 +2200,29 @@ static void OPL3WriteReg(OPL3 *chip, int r, int v)
 	}
 }
 
-/* lock/unlock for common table */
+/* build the common tables on first use */
 static int OPL3_LockTable(void)
 {
-	num_lock++;
-	if(num_lock>1) return 0;
+	for (;;) {
+		switch (atm_load(&tables_state)) {
+		case TABLES_READY:
+			return 0;
+		case TABLES_EMPTY:
+			if (!atm_cas(&tables_state, TABLES_EMPTY, TABLES_BUILDING))
+				break;
 
-	/* first time */
+			if (!init_tables()) {
+				atm_store(&tables_state, TABLES_EMPTY);
+				return -1;
+			}
 
-	if( !init_tables() )
-	{
-		num_lock--;
-		return -1;
+			atm_store(&tables_state, TABLES_READY);
+			return 0;
+		default:
+			/* another chip is building them; they're tiny, so just spin */
+			break;
+		}
 	}
-
-	return 0;
-}
-
-static void OPL3_UnLockTable(void)
-{
-	if(num_lock) num_lock--;
-	if(num_lock) return;
-
-	/* last time */
-	OPLCloseTable();
-
 }
 
 static void OPL3ResetChip(OPL3 *chip)
@@ -2303,7 +2299,6 @@ static OPL3 *OPL3Create(uint32_t clock, uint32_t rate, int type)
 /* Destroy one of virtual YMF262 */
 static void OPL3Destroy(OPL3 *chip)
 {
-	OPL3_UnLockTable();
 	free(chip);
 }
 
@@ -364,21 +364,23 @@ DEFINE_MIX_INTERFACE_CHANNELS(16)
 //////////////////////////////////////////////////////////
 // Resampling
 
+// Only output frames [start, end) are written, so that a long sample can be
+// resampled in pieces; each one reads the input around it as usual.
 #define BEGIN_RESAMPLE_INTERFACE(FUNC, SAMPLETYPE, NUMCHANNELS) \
-	SCHISM_SIMD void FUNC(SAMPLETYPE *oldbuf, SAMPLETYPE *newbuf, uint32_t oldlen, uint32_t newlen) \
+	SCHISM_SIMD void FUNC(SAMPLETYPE *oldbuf, SAMPLETYPE *newbuf, uint32_t oldlen, uint32_t newlen, uint32_t start, uint32_t end) \
 	{ \
-		struct song_smp_pos position = csf_smp_pos(0,0); \
 		const SAMPLETYPE *p = oldbuf; \
-		SAMPLETYPE *pvol = newbuf; \
-		const SAMPLETYPE *pbufmax = &newbuf[newlen * NUMCHANNELS]; \
+		SAMPLETYPE *pvol = &newbuf[start * NUMCHANNELS]; \
+		const SAMPLETYPE *pbufmax = &newbuf[end * NUMCHANNELS]; \
 		struct song_smp_pos increment = csf_smp_pos_div_whole(csf_smp_pos(oldlen, 0), newlen); \
-		do {
+		struct song_smp_pos position = csf_smp_pos_mul_whole(increment, start); \
+		while (pvol < pbufmax) {
 
 #define END_RESAMPLE_INTERFACE_MONO \
 			*pvol = vol; \
 			pvol++; \
 			position = csf_smp_pos_add(position, increment); \
-		} while (pvol < pbufmax); \
+		} \
 	}
 
 #define END_RESAMPLE_INTERFACE_STEREO \
@@ -386,7 +388,7 @@ DEFINE_MIX_INTERFACE_CHANNELS(16)
 			pvol[1] = vol_r; \
 			pvol += 2; \
 			position = csf_smp_pos_add(position, increment); \
-		} while (pvol < pbufmax); \
+		} \
 	}
 
 // Public Resampling Methods
@@ -695,6 +697,7 @@ uint32_t csf_create_stereo_mix(song_t *csf, uint32_t count)
 		int32_t smpcount;
 		int32_t nsamples;
 		int32_t *pbuffer;
+		int muted;
 
 		if ((!channel->current_sample_data || !channel->ptr_sample /* HAX */)
 			&& !channel->lofs
@@ -725,14 +728,24 @@ uint32_t csf_create_stereo_mix(song_t *csf, uint32_t count)
 			flags |= srcflags[csf->mix_interpolation];
 		}
 
+#ifdef USE_PLAYER_PROFILER
+		const int profile_stage = (channel->flags & CHN_NOIDO)
+			? CSF_PROFILE_MIX_NEAREST
+			: (CSF_PROFILE_MIX_NEAREST + csf->mix_interpolation);
+#endif
+
 		nsamples = count;
+		muted = 0;
 
 		if (csf->multi_write) {
 			int32_t master = (csf->voice_mix[nchan] < MAX_CHANNELS)
 				? csf->voice_mix[nchan]
 				: (channel->master_channel - 1);
 			pbuffer = csf->multi_write[master].buffer;
-			csf->multi_write[master].used = 1;
+			if (csf->multi_write[master].muted)
+				muted = 1;
+			else
+				csf->multi_write[master].used = 1;
 		} else {
 			pbuffer = csf->mix_buffer;
 		}
@@ -784,6 +797,18 @@ uint32_t csf_create_stereo_mix(song_t *csf, uint32_t count)
 				channel->position = csf_smp_pos_add(channel->position, csf_smp_pos_mul_whole(channel->increment, smpcount));
 				channel->rofs = channel->lofs = 0;
 				pbuffer += smpcount * 2;
+			} else if (muted) {
+				// Same as above, but keep the volume ramp going as if
+				// this was mixed, since the player looks at it
+				channel->position = csf_smp_pos_add(channel->position, csf_smp_pos_mul_whole(channel->increment, smpcount));
+				channel->rofs = channel->lofs = 0;
+				if (channel->ramp_length) {
+					channel->right_ramp_volume += channel->right_ramp * smpcount;
+					channel->left_ramp_volume += channel->left_ramp * smpcount;
+					channel->right_volume = rshift_signed(channel->right_ramp_volume, VOLUMERAMPPRECISION);
+					channel->left_volume = rshift_signed(channel->left_ramp_volume, VOLUMERAMPPRECISION);
+				}
+				pbuffer += smpcount * 2;
 			} else if (!(channel->flags & CHN_ADLIB)) {
 				// Mix the stream, unless we're in AdLib mode
 
@@ -797,7 +822,9 @@ uint32_t csf_create_stereo_mix(song_t *csf, uint32_t count)
 				channel->rofs = -*(pbufmax - 2);
 				channel->lofs = -*(pbufmax - 1);
 
+				CSF_PROFILE_ENTER(csf, profile_stage, prof);
 				mix_func(channel, pbuffer, pbufmax);
+				CSF_PROFILE_LEAVE_VOICE(csf, prof, CSF_PROFILE_VOICE_KIND(csf->voice_mix[nchan]));
 				channel->rofs += *(pbufmax - 2);
 				channel->lofs += *(pbufmax - 1);
 				pbuffer = pbufmax;
@@ -835,9 +862,13 @@ uint32_t csf_create_stereo_mix(song_t *csf, uint32_t count)
 		nchmixed += naddmix;
 	}
 
+	CSF_PROFILE_ENTER(csf, CSF_PROFILE_MIDI, prof_midi);
 	GM_IncrementSongCounter(csf, count);
+	CSF_PROFILE_LEAVE(csf, prof_midi);
 
+	CSF_PROFILE_ENTER(csf, CSF_PROFILE_FM, prof_fm);
 	Fmdrv_Mix(csf, count);
+	CSF_PROFILE_LEAVE(csf, prof_fm);
 
 	return nchused;
 }
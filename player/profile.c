@@ -0,0 +1,104 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "headers.h"
+
+#include "player/sndfile.h"
+#include "player/profile.h"
+
+void csf_profile_reset(song_t *csf)
+{
+	memset(&csf->profile, 0, sizeof(csf->profile));
+}
+
+#ifdef USE_PLAYER_PROFILER
+
+static void csf_profile_line(void (*line)(void *userdata, const char *text), void *userdata,
+	const char *name, uint64_t cycles, uint64_t calls, uint64_t total)
+{
+	char buf[96];
+
+	snprintf(buf, sizeof(buf), "%-16s %14" PRIu64 " %5" PRIu64 ".%" PRIu64 "%% %10" PRIu64 " %10" PRIu64,
+		name, cycles, cycles * 100 / total, cycles * 1000 / total % 10, calls, calls ? cycles / calls : 0);
+	line(userdata, buf);
+}
+
+void csf_profile_report(song_t *csf,
+	void (*line)(void *userdata, const char *text), void *userdata)
+{
+	static const char *const stages[CSF_PROFILE_STAGES] = {
+		[CSF_PROFILE_OTHER] = "other",
+		[CSF_PROFILE_TICK] = "process tick",
+		[CSF_PROFILE_EFFECTS] = "effects",
+		[CSF_PROFILE_NNA] = "nna",
+		[CSF_PROFILE_VOICES] = "voice setup",
+		[CSF_PROFILE_ENVELOPES] = "envelopes",
+		[CSF_PROFILE_UPDATE_SAMPLE] = "update sample",
+		[CSF_PROFILE_MIDI] = "gm/midi",
+		[CSF_PROFILE_FM] = "adlib",
+		[CSF_PROFILE_MIX_NEAREST] = "mix (nearest)",
+		[CSF_PROFILE_MIX_LINEAR] = "mix (linear)",
+		[CSF_PROFILE_MIX_SPLINE] = "mix (spline)",
+		[CSF_PROFILE_MIX_FIR] = "mix (fir)",
+	};
+	static const char *const kinds[CSF_PROFILE_VOICE_KINDS] = {
+		[CSF_PROFILE_VOICE_CHANNEL] = "channel voices",
+		[CSF_PROFILE_VOICE_NNA] = "nna voices",
+	};
+	const struct csf_profile *p = &csf->profile;
+	uint64_t total = 0;
+	char buf[96];
+	int i;
+
+	for (i = CSF_PROFILE_OTHER; i < CSF_PROFILE_STAGES; i++)
+		total += p->cycles[i];
+	if (!total) {
+		line(userdata, "Player profile: nothing was played");
+		return;
+	}
+
+	snprintf(buf, sizeof(buf), "Player profile: %" PRIu64 " " CSF_PROFILE_UNIT " over %" PRIu64 " ticks",
+		total, p->calls[CSF_PROFILE_VOICES]);
+	line(userdata, buf);
+
+	snprintf(buf, sizeof(buf), "%-16s %14s %7s %10s %10s", "stage", CSF_PROFILE_UNIT, "share", "calls", "per call");
+	line(userdata, buf);
+	for (i = CSF_PROFILE_OTHER; i < CSF_PROFILE_STAGES; i++)
+		csf_profile_line(line, userdata, stages[i], p->cycles[i], p->calls[i], total);
+
+	/* these overlap with the stages above */
+	line(userdata, "");
+	snprintf(buf, sizeof(buf), "%-16s %14s %7s %10s %10s", "voice kind", CSF_PROFILE_UNIT, "share", "voices", "per voice");
+	line(userdata, buf);
+	for (i = 0; i < CSF_PROFILE_VOICE_KINDS; i++)
+		csf_profile_line(line, userdata, kinds[i], p->voice_cycles[i], p->voice_ticks[i], total);
+}
+
+#else
+
+void csf_profile_report(SCHISM_UNUSED song_t *csf,
+	SCHISM_UNUSED void (*line)(void *userdata, const char *text), SCHISM_UNUSED void *userdata)
+{
+}
+
+#endif
@@ -30,7 +30,6 @@
 #include "it.h" // needed for status.flags
 #include "player/sndfile.h"
 #include "player/snd_gm.h"
-#include "song.h" // for 'current_song', which we shouldn't need
 
 #define LinearMidivol 1
 #define PitchBendCenter 0x2000
@@ -688,8 +687,8 @@ void GM_IncrementSongCounter(song_t *csf, int32_t count)
 	 * where cmdT = last FX_TEMPO = current_tempo
 	 */
 
-	int32_t TickLengthInSamplesHi = 5 * current_song->mix_frequency;
-	int32_t TickLengthInSamplesLo = 2 * current_song->current_tempo;
+	int32_t TickLengthInSamplesHi = 5 * csf->mix_frequency;
+	int32_t TickLengthInSamplesLo = 2 * csf->current_tempo;
 
 	double TickLengthInSamples = TickLengthInSamplesHi / (double) TickLengthInSamplesLo;
 
@@ -745,6 +745,8 @@ uint32_t csf_read(song_t *csf, void * v_buffer, uint32_t bufsize)
 	if (!max || !buffer)
 		return 0;
 
+	CSF_PROFILE_ENTER(csf, CSF_PROFILE_OTHER, prof);
+
 	bufleft = max;
 
 	if (csf->flags & SONG_ENDREACHED)
@@ -760,8 +762,10 @@ uint32_t csf_read(song_t *csf, void * v_buffer, uint32_t bufsize)
 			if (!csf_read_note(csf)) {
 				csf->flags |= SONG_ENDREACHED;
 
-				if (csf->stop_at_order > -1)
+				if (csf->stop_at_order > -1) {
+					CSF_PROFILE_LEAVE(csf, prof);
 					return 0; /* faster */
+				}
 
 				if (bufleft == max)
 					break;
@@ -798,8 +802,10 @@ uint32_t csf_read(song_t *csf, void * v_buffer, uint32_t bufsize)
 			mono_from_stereo(csf->mix_buffer, count);
 		}
 
-		// Handle eq
-		if (csf->mix_channels >= 2) {
+		// Handle eq (multi-write doesn't output the main mix buffer at all)
+		if (csf->multi_write) {
+			// nothing
+		} else if (csf->mix_channels >= 2) {
 			eq_stereo(csf, csf->mix_buffer, count);
 			if (!(csf->mix_flags & SNDMIX_DIRECTTODISK))
 				normalize_stereo(csf, csf->mix_buffer, count);
@@ -815,7 +821,9 @@ uint32_t csf_read(song_t *csf, void * v_buffer, uint32_t bufsize)
 			/* multi doesn't actually write meaningful data into 'buffer', so we can use that
 			as temp space for converting */
 			for (uint32_t n = 0; n < MAX_CHANNELS; n++) {
-				if (csf->multi_write[n].used) {
+				if (csf->multi_write[n].muted) {
+					continue;
+				} else if (csf->multi_write[n].used) {
 					if (csf->mix_channels < 2)
 						mono_from_stereo(csf->multi_write[n].buffer, count);
 					uint32_t bytes = convert_func(buffer, csf->multi_write[n].buffer,
@@ -860,6 +868,8 @@ uint32_t csf_read(song_t *csf, void * v_buffer, uint32_t bufsize)
 		csf->mix_stat /= mix_stat;
 	}
 
+	CSF_PROFILE_LEAVE(csf, prof);
+
 	return max - bufleft;
 }
 
@@ -994,8 +1004,11 @@ int32_t csf_process_tick(song_t *csf)
 			// commands... ALL WE DO is dump raw midi data to
 			// our super-secret "midi buffer"
 			// -mrsb
-			if (!(csf->mix_flags & SNDMIX_CALCLENGTH))
+			if (!(csf->mix_flags & SNDMIX_CALCLENGTH)) {
+				CSF_PROFILE_ENTER(csf, CSF_PROFILE_MIDI, prof);
 				csf_midi_out_note(csf, nchan, m);
+				CSF_PROFILE_LEAVE(csf, prof);
+			}
 
 			chan->row_note = m->note;
 
@@ -1024,10 +1037,12 @@ int32_t csf_process_tick(song_t *csf)
 		song_note_t *m = csf->patterns[csf->current_pattern] + csf->row * MAX_CHANNELS;
 
 		if (!(csf->mix_flags & SNDMIX_CALCLENGTH)) {
+			CSF_PROFILE_ENTER(csf, CSF_PROFILE_MIDI, prof);
 			for (uint32_t nchan=0; nchan<MAX_CHANNELS; nchan++, m++) {
 				/* m == NULL allows schism to receive notification of SDx and Scx commands */
 				csf_midi_out_note(csf, nchan, NULL);
 			}
+			CSF_PROFILE_LEAVE(csf, prof);
 		}
 
 		if (!(csf->tick_count % (csf->current_speed + csf->frame_delay))) {
@@ -1075,7 +1090,13 @@ int32_t csf_read_note(song_t *csf)
 		}
 		csf_process_effects(csf, 0);
 	} else {
-		if (!csf_process_tick(csf))
+		int32_t ok;
+
+		CSF_PROFILE_ENTER(csf, CSF_PROFILE_TICK, prof);
+		ok = csf_process_tick(csf);
+		CSF_PROFILE_LEAVE(csf, prof);
+
+		if (!ok)
 			return 0;
 	}
 
@@ -1102,6 +1123,8 @@ int32_t csf_read_note(song_t *csf)
 
 	csf->num_voices = 0;
 
+	CSF_PROFILE_ENTER(csf, CSF_PROFILE_VOICES, prof);
+
 	for (cn = 0, chan = csf->voices; cn < MAX_VOICES; cn++, chan++) {
 		/*if(cn == 4 || chan->master_channel == 4)
 		fprintf(stderr, "considering voice %d (per %d, pos %d/%d, flags %X)\n",
@@ -1153,8 +1176,10 @@ int32_t csf_read_note(song_t *csf)
 			// Process Envelopes
 			if ((csf->flags & SONG_INSTRUMENTMODE) && chan->ptr_instrument) {
 				/* OpenMPT test cases s77.it and EnvLoops.it */
+				CSF_PROFILE_ENTER(csf, CSF_PROFILE_ENVELOPES, prof_env);
 				rn_increment_env_pos(chan);
 				rn_process_envelope(csf, chan, &vol);
+				CSF_PROFILE_LEAVE_VOICE(csf, prof_env, CSF_PROFILE_VOICE_KIND(cn));
 			} else {
 				// No Envelope: key off => note cut
 				// 1.41-: CHN_KEYOFF|CHN_NOTEFADE
@@ -1187,7 +1212,9 @@ int32_t csf_read_note(song_t *csf)
 			if (chan->n_command == FX_ARPEGGIO)
 				frequency = rn_arpeggio(csf, chan, frequency);
 
+			CSF_PROFILE_ENTER(csf, CSF_PROFILE_MIDI, prof_midi);
 			rn_process_midi_macro(csf, chan);
+			CSF_PROFILE_LEAVE(csf, prof_midi);
 
 			// Pitch/Filter Envelope
 			int32_t envpitch = 0;
@@ -1256,7 +1283,14 @@ int32_t csf_read_note(song_t *csf)
 			chan->current_sample_data = NULL;
 
 		if (chan->current_sample_data) {
-			if (!rn_update_sample(csf, chan, cn, master_vol))
+			int32_t ok;
+
+			CSF_PROFILE_COUNT_VOICE(csf, CSF_PROFILE_VOICE_KIND(cn));
+			CSF_PROFILE_ENTER(csf, CSF_PROFILE_UPDATE_SAMPLE, prof_update);
+			ok = rn_update_sample(csf, chan, cn, master_vol);
+			CSF_PROFILE_LEAVE_VOICE(csf, prof_update, CSF_PROFILE_VOICE_KIND(cn));
+
+			if (!ok)
 				break;
 		} else {
 			// Note change but no sample
@@ -1273,6 +1307,8 @@ int32_t csf_read_note(song_t *csf)
 		chan->flags &= ~CHN_NEWNOTE;
 	}
 
+	CSF_PROFILE_LEAVE(csf, prof);
+
 	// Checking Max Mix Channels reached: ordering by volume
 	if (csf->num_voices >= csf->max_voices && (!(csf->mix_flags & SNDMIX_DIRECTTODISK))) {
 		for (uint32_t i = 0; i < csf->num_voices; i++) {
@@ -40,6 +40,11 @@ void atm_store(struct atm *atm, int32_t x)
 	atomic_store((_Atomic volatile int32_t *)&atm->x, x);
 }
 
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired)
+{
+	return atomic_compare_exchange_strong((_Atomic volatile int32_t *)&atm->x, &expected, desired);
+}
+
 void *atm_ptr_load(struct atm_ptr *atm)
 {
 	return atomic_load((const volatile void * _Atomic*)&atm->x);
@@ -67,6 +72,15 @@ void atm_store(struct atm *atm, int32_t x)
 	atm->x = x;
 }
 
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired)
+{
+	if (atm->x != expected)
+		return 0;
+
+	atm->x = desired;
+	return 1;
+}
+
 void *atm_ptr_load(struct atm_ptr *atm)
 {
 	return atm->x;
@@ -94,6 +108,11 @@ void atm_store(struct atm *atm, int32_t x)
 	__atomic_store(&atm->x, &x, __ATOMIC_SEQ_CST);
 }
 
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired)
+{
+	return __atomic_compare_exchange(&atm->x, &expected, &desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
 void *atm_ptr_load(struct atm_ptr *atm)
 {
 	void *r;
@@ -124,6 +143,11 @@ void atm_store(struct atm *atm, int32_t x)
 	__sync_synchronize();
 }
 
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired)
+{
+	return __sync_bool_compare_and_swap(&atm->x, expected, desired);
+}
+
 void *atm_ptr_load(struct atm_ptr *atm)
 {
 	__sync_synchronize();
@@ -156,6 +180,11 @@ void atm_store(struct atm *atm, int32_t x)
 	InterlockedExchange((volatile LONG *)&atm->x, x);
 }
 
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired)
+{
+	return InterlockedCompareExchange((volatile LONG *)&atm->x, desired, expected) == expected;
+}
+
 void *atm_ptr_load(struct atm_ptr *atm)
 {
 #if SIZEOF_VOID_P == 8
@@ -246,6 +275,21 @@ void atm_store(struct atm *atm, int32_t x)
 	mt_mutex_unlock(m);
 }
 
+int atm_cas(struct atm *atm, int32_t expected, int32_t desired)
+{
+	int r = 0;
+	mt_mutex_t *m = atm_get_mutex(atm);
+
+	mt_mutex_lock(m);
+	if (atm->x == expected) {
+		atm->x = desired;
+		r = 1;
+	}
+	mt_mutex_unlock(m);
+
+	return r;
+}
+
 static inline SCHISM_ALWAYS_INLINE
 mt_mutex_t *atm_ptr_get_mutex(struct atm_ptr *atm)
 {
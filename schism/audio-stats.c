@@ -0,0 +1,142 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "headers.h"
+
+#include "audio-stats.h"
+
+void audio_stats_reset(struct audio_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+}
+
+void audio_stats_add(struct audio_stats *stats, uint32_t frames, uint32_t rate,
+	const uint32_t stage_us[AUDIO_STATS_STAGES])
+{
+	uint32_t deadline, total = 0, bucket;
+	int i;
+
+	if (!frames || !rate)
+		return;
+
+	deadline = (uint32_t)((uint64_t)frames * 1000000 / rate);
+	if (!deadline)
+		deadline = 1;
+
+	for (i = 0; i < AUDIO_STATS_STAGES; i++) {
+		stats->total_us[i] += stage_us[i];
+		if (stage_us[i] > stats->max_us[i])
+			stats->max_us[i] = stage_us[i];
+		total += stage_us[i];
+	}
+
+	/* 'worst' is relative to the deadline, since the buffer size can
+	 * change underneath us */
+	if ((uint64_t)total * stats->worst_deadline_us >= (uint64_t)stats->worst_us * deadline) {
+		stats->worst_us = total;
+		stats->worst_deadline_us = deadline;
+	}
+
+	if (total > deadline)
+		stats->overruns++;
+
+	bucket = (uint32_t)((uint64_t)total * 100 / deadline / AUDIO_STATS_BUCKET_PERCENT);
+	stats->histogram[MIN(bucket, AUDIO_STATS_BUCKETS - 1)]++;
+
+	stats->frames = frames;
+	stats->deadline_us = deadline;
+	stats->count++;
+}
+
+uint32_t audio_stats_percentile(const struct audio_stats *stats, uint32_t permille)
+{
+	uint64_t want, seen = 0;
+	uint32_t i;
+
+	if (!stats->count)
+		return 0;
+
+	/* the smallest bucket that at least 'permille' of the callbacks fit in */
+	want = (stats->count * permille + 999) / 1000;
+	for (i = 0; i < AUDIO_STATS_BUCKETS - 1; i++) {
+		seen += stats->histogram[i];
+		if (seen >= want)
+			break;
+	}
+
+	return (i + 1) * AUDIO_STATS_BUCKET_PERCENT;
+}
+
+uint32_t audio_stats_adapt_buffer(const struct audio_stats *stats, uint32_t frames,
+	uint32_t min_frames, uint32_t max_frames)
+{
+	const uint64_t window_us = stats->count * stats->deadline_us;
+
+	if (frames < max_frames && (stats->overruns
+			|| (window_us >= AUDIO_STATS_ADAPT_GROW_MS * UINT64_C(1000)
+				&& audio_stats_percentile(stats, 990) > AUDIO_STATS_ADAPT_GROW_PERCENT)))
+		return MIN(frames * 2, max_frames);
+
+	if (frames > min_frames && !stats->overruns
+			&& window_us >= AUDIO_STATS_ADAPT_SHRINK_MS * UINT64_C(1000)
+			&& audio_stats_percentile(stats, 999) <= AUDIO_STATS_ADAPT_SHRINK_PERCENT)
+		return MAX(frames / 2, min_frames);
+
+	return frames;
+}
+
+void audio_stats_report(const struct audio_stats *stats,
+	void (*line)(void *userdata, const char *text), void *userdata)
+{
+	static const char *const names[AUDIO_STATS_STAGES] = {
+		[AUDIO_STATS_MIX] = "mix",
+		[AUDIO_STATS_CONVERT] = "convert",
+		[AUDIO_STATS_VIS] = "vis",
+	};
+	char buf[80];
+	int i;
+
+	if (!stats->count) {
+		line(userdata, "No audio mixed yet");
+		return;
+	}
+
+	snprintf(buf, sizeof(buf), "%" PRIu64 " buffers of %" PRIu32 " frames (%" PRIu32 ".%03" PRIu32 " ms)",
+		stats->count, stats->frames, stats->deadline_us / 1000, stats->deadline_us % 1000);
+	line(userdata, buf);
+
+	snprintf(buf, sizeof(buf), "Load: 50%% <%" PRIu32 "%%, 99%% <%" PRIu32 "%%, 99.9%% <%" PRIu32 "%%",
+		audio_stats_percentile(stats, 500), audio_stats_percentile(stats, 990),
+		audio_stats_percentile(stats, 999));
+	line(userdata, buf);
+
+	snprintf(buf, sizeof(buf), "Worst: %" PRIu32 " us of %" PRIu32 " us, %" PRIu64 " overruns",
+		stats->worst_us, stats->worst_deadline_us, stats->overruns);
+	line(userdata, buf);
+
+	for (i = 0; i < AUDIO_STATS_STAGES; i++) {
+		snprintf(buf, sizeof(buf), "%-8s avg %6" PRIu64 " us, max %6" PRIu32 " us",
+			names[i], stats->total_us[i] / stats->count, stats->max_us[i]);
+		line(userdata, buf);
+	}
+}
@@ -214,15 +214,11 @@ static void message_convert_newlines(song_t *song) {
 	}
 }
 
-song_t *song_create_load(const char *file)
+song_t *song_create_load_slurp(slurp_t *s, uint32_t lflags)
 {
-	slurp_t s;
 	fmt_load_song_func *func;
 	int ok = 0, err = 0;
 
-	if (slurp(&s, file, NULL, 0) < 0)
-		return NULL;
-
 	song_t *newsong = csf_allocate();
 
 	if (current_song) {
@@ -239,8 +235,8 @@ song_t *song_create_load(const char *file)
 	}
 
 	for (func = load_song_funcs; *func && !ok; func++) {
-		slurp_rewind(&s);
-		switch ((*func)(newsong, &s, 0)) {
+		slurp_rewind(s);
+		switch ((*func)(newsong, s, lflags)) {
 		case LOAD_SUCCESS:
 			err = 0;
 			ok = 1;
@@ -255,16 +251,10 @@ song_t *song_create_load(const char *file)
 			err = errno;
 			break;
 		}
-		if (err) {
-			csf_free(newsong);
-			unslurp(&s);
-			errno = err;
-			return NULL;
-		}
+		if (err)
+			break;
 	}
 
-	unslurp(&s);
-
 	if (err) {
 		// awwww, nerts!
 		csf_free(newsong);
@@ -279,6 +269,25 @@ song_t *song_create_load(const char *file)
 	return newsong;
 }
 
+song_t *song_create_load(const char *file)
+{
+	slurp_t s;
+	song_t *newsong;
+	int err;
+
+	if (slurp(&s, file, NULL, 0) < 0)
+		return NULL;
+
+	newsong = song_create_load_slurp(&s, 0);
+
+	// unslurp might clobber errno
+	err = errno;
+	unslurp(&s);
+	errno = err;
+
+	return newsong;
+}
+
 int song_load_unchecked(const char *file)
 {
 	const char *base = dmoz_path_get_basename(file);
@@ -33,6 +33,8 @@
 #include "str.h"
 #include "mt.h"
 #include "atomic.h"
+#include "audio-stats.h"
+#include "timer.h"
 
 #include "disko.h"
 #include "backend/audio.h"
@@ -61,6 +63,60 @@ static uint32_t samples_played = 0;
 /* this crap being extern is really dumb */
 uint32_t max_channels_used = 0;
 
+/* how long the callback takes, per stage; protected by the audio lock */
+static struct audio_stats playback_stats = {0};
+
+/* what mt_thread_set_role gave the thread the callback runs on; the backend
+ * usually owns that thread, so it gets set up from the first callback after the
+ * device is opened. also protected by the audio lock */
+static int audio_thread_role = -1;
+/* set if the backend calls us from a thread of our own (audio_simple_init) */
+static int audio_thread_owned = 0;
+
+/* adaptive buffer size (see audio_adapt_buffer). 'frames' is what the device
+ * gets asked for, or 0 if this is turned off; 'window' only counts callbacks
+ * that had something to play, since the rest say nothing about the song. the
+ * window is protected by the audio lock, the rest is only touched by the main
+ * thread */
+static struct {
+	uint32_t frames;
+	uint32_t min, max;
+	struct audio_stats window;
+} audio_adapt = {0};
+
+/* render-ahead: a thread runs audio_callback a few buffers ahead of the device,
+ * which then only has to copy them out, so one slow buffer doesn't turn
+ * straight into a skip. since the device never touches the song in this mode,
+ * song_lock_audio locks 'mutex' instead of the device; that has to be decided
+ * once, before anything locks anything, so 'mutex' never goes away again.
+ *
+ * the ring is single-producer, single-consumer: the thread only moves 'head'
+ * and the device only moves 'tail'. */
+static struct {
+	mt_mutex_t *mutex; /* NULL if this is turned off */
+	mt_cond_t *cond; /* poked by the device when it takes a buffer */
+	mt_thread_t *thread;
+	int cancelled; /* protected by mutex */
+
+	uint8_t *ring;
+	uint32_t blocks; /* how many buffers to mix ahead */
+	uint32_t slots; /* how many buffers the ring holds */
+	uint32_t block_bytes;
+	uint32_t block_ms;
+
+	struct atm running;
+	struct atm head; /* buffers mixed */
+	struct atm tail; /* buffers played */
+	/* buffers before this one were mixed before something changed */
+	struct atm flush;
+	struct atm underruns;
+
+	/* how much of the buffer at 'tail' the device has copied already, since
+	 * it doesn't have to ask for a whole one at a time. only the device
+	 * touches this */
+	uint32_t offset;
+} ahead = {0};
+
 static uint32_t audio_buffer_samples_allocated = 0;
 
 /* one of 8-bit, 16-bit, or 32-bit integer, depending on audio_output_bits */
@@ -197,8 +253,18 @@ static void audio_callback(uint8_t *stream, int len)
 {
 	uint32_t wasrow = current_song->row;
 	uint32_t waspat = current_song->current_order;
+	uint32_t stage_us[AUDIO_STATS_STAGES];
+	timer_ticks_t start, now;
 	int n;
 
+	/* threads that belong to the backend are left alone unless we've been
+	 * told to do something with them */
+	if (audio_thread_role < 0)
+		audio_thread_role = (audio_thread_owned || audio_settings.realtime != MT_SCHED_NORMAL
+				|| audio_settings.audio_cpu >= 0)
+			? mt_thread_set_role(MT_THREAD_ROLE_AUDIO)
+			: 0;
+
 	memset(stream, (audio_output_bits == 8) ? 0x80 : 0, len);
 
 	/* len is output buffer size */
@@ -218,6 +284,8 @@ static void audio_callback(uint8_t *stream, int len)
 		return;
 	}
 
+	start = timer_ticks_us();
+
 	if (current_song->flags & SONG_ENDREACHED) {
 		n = 0;
 	} else {
@@ -232,6 +300,10 @@ static void audio_callback(uint8_t *stream, int len)
 		samples_played += n;
 	}
 
+	now = timer_ticks_us();
+	stage_us[AUDIO_STATS_MIX] = now - start;
+	start = now;
+
 	/* hax: convert internal buffer output */
 	if (audio_output_bits_real == 24) {
 		s32_to_s24(stream, (int32_t *)audio_buffer, n * audio_output_channels);
@@ -246,6 +318,10 @@ static void audio_callback(uint8_t *stream, int len)
 	if (audio_output_bits == 8)
 		mem_xor(audio_buffer, n * audio_sample_size, 0x80);
 
+	now = timer_ticks_us();
+	stage_us[AUDIO_STATS_CONVERT] = now - start;
+	start = now;
+
 	if (status.current_page == PAGE_WATERFALL || status.vis_style == VIS_FFT) {
 		// I don't really like this...
 		switch (audio_output_bits) {
@@ -257,6 +333,11 @@ static void audio_callback(uint8_t *stream, int len)
 		}
 	}
 
+	stage_us[AUDIO_STATS_VIS] = timer_ticks_us() - start;
+	audio_stats_add(&playback_stats, audio_buffer_samples, current_song->mix_frequency, stage_us);
+	if (audio_adapt.frames && current_song->num_voices)
+		audio_stats_add(&audio_adapt.window, audio_buffer_samples, current_song->mix_frequency, stage_us);
+
 	if (current_song->num_voices > max_channels_used)
 		max_channels_used = MIN(current_song->num_voices, current_song->max_voices);
 POST_EVENT:
@@ -674,6 +755,9 @@ static int song_keydown_ex(int samp, int ins, int note, int vol, int chan, int e
 		current_song->flags |= SONG_PAUSED;
 	}
 
+	/* so it's heard within a buffer, if that doesn't skip the song */
+	audio_ahead_invalidate_if_idle();
+
 	song_unlock_audio();
 
 	return chan;
@@ -781,6 +865,7 @@ void song_start_once(void)
 	current_song->repeat_count = -1; // FIXME do this right
 
 	GM_SendSongStartCode(current_song);
+	audio_ahead_invalidate();
 	song_unlock_audio();
 	main_song_mode_changed_cb();
 
@@ -795,6 +880,7 @@ void song_start(void)
 	max_channels_used = 0;
 
 	GM_SendSongStartCode(current_song);
+	audio_ahead_invalidate();
 	song_unlock_audio();
 	main_song_mode_changed_cb();
 
@@ -807,6 +893,7 @@ void song_pause(void)
 	// Highly unintuitive, but SONG_PAUSED has nothing to do with pause.
 	if (!(current_song->flags & SONG_PAUSED))
 		current_song->flags ^= SONG_ENDREACHED;
+	audio_ahead_invalidate();
 	song_unlock_audio();
 	main_song_mode_changed_cb();
 }
@@ -815,6 +902,7 @@ void song_stop(void)
 {
 	song_lock_audio();
 	song_stop_unlocked(0);
+	audio_ahead_invalidate();
 	song_unlock_audio();
 	main_song_mode_changed_cb();
 }
@@ -899,6 +987,7 @@ void song_loop_pattern(int pattern, int row)
 	csf_loop_pattern(current_song, pattern, row);
 
 	GM_SendSongStartCode(current_song);
+	audio_ahead_invalidate();
 
 	song_unlock_audio();
 	main_song_mode_changed_cb();
@@ -918,6 +1007,7 @@ void song_start_at_order(int order, int row)
 
 	GM_SendSongStartCode(current_song);
 	/* TODO: GM_SendSongPositionCode(calculate the number of 1/16 notes) */
+	audio_ahead_invalidate();
 	song_unlock_audio();
 	main_song_mode_changed_cb();
 
@@ -1008,6 +1098,25 @@ int song_get_max_channels(void)
 {
 	return max_channels_used;
 }
+
+void song_get_audio_stats(struct audio_stats *stats)
+{
+	song_lock_audio();
+	*stats = playback_stats;
+	song_unlock_audio();
+}
+
+int song_get_audio_thread_role(void)
+{
+	int r;
+
+	song_lock_audio();
+	r = audio_thread_role;
+	song_unlock_audio();
+
+	return r;
+}
+
 // Returns the max value in dBs, scaled as 0 = -40dB and 128 = 0dB.
 void song_get_vu_meter(int *left, int *right)
 {
@@ -1170,6 +1279,7 @@ void song_set_current_order(int order)
 {
 	song_lock_audio();
 	csf_set_current_order(current_song, order);
+	audio_ahead_invalidate();
 	song_unlock_audio();
 }
 
@@ -1225,6 +1335,20 @@ void audio_parse_driver_spec(const char* spec, char** driver, char** device) {
 
 #define CFG_GET_A(v,d) audio_settings.v = cfg_get_number(cfg, "Audio", #v, d)
 #define CFG_GET_M(v,d) audio_settings.v = cfg_get_number(cfg, "Mixer Settings", #v, d)
+void cfg_load_audio_scheduling(cfg_file_t *cfg)
+{
+	char policy[8];
+
+	cfg_get_string(cfg, "Audio", "realtime", policy, ARRAY_SIZE(policy), "off");
+	audio_settings.realtime = !strcasecmp(policy, "fifo") ? MT_SCHED_FIFO
+		: !strcasecmp(policy, "rr") ? MT_SCHED_RR
+		: MT_SCHED_NORMAL;
+
+	CFG_GET_A(realtime_priority, 10);
+	CFG_GET_A(audio_cpu, -1);
+	CFG_GET_A(lower_priority, 1);
+}
+
 void cfg_load_audio(cfg_file_t *cfg)
 {
 	CFG_GET_A(sample_rate, DEF_SAMPLE_RATE);
@@ -1254,6 +1378,12 @@ void cfg_load_audio(cfg_file_t *cfg)
 	CFG_GET_M(no_ramping, 0);
 	CFG_GET_M(surround_effect, 1);
 
+	cfg_load_audio_scheduling(cfg);
+	CFG_GET_A(adaptive_buffer, 0);
+	CFG_GET_A(buffer_size_min, 128);
+	CFG_GET_A(buffer_size_max, 4096);
+	CFG_GET_A(render_ahead, 0);
+
 	switch (audio_settings.channels) {
 	case 1:
 	case 2: break;
@@ -1362,14 +1492,25 @@ static void _schism_midi_out_raw(song_t *csf, const unsigned char *data, uint32_
 
 void song_lock_audio(void)
 {
-	if (backend) backend->lock_device(current_audio_device);
+	if (ahead.mutex)
+		mt_mutex_lock(ahead.mutex);
+	else if (backend)
+		backend->lock_device(current_audio_device);
 }
 void song_unlock_audio(void)
 {
-	if (backend) backend->unlock_device(current_audio_device);
+	if (ahead.mutex)
+		mt_mutex_unlock(ahead.mutex);
+	else if (backend)
+		backend->unlock_device(current_audio_device);
 }
 void song_start_audio(void)
 {
+	/* don't play whatever was mixed before it got paused */
+	song_lock_audio();
+	audio_ahead_invalidate();
+	song_unlock_audio();
+
 	if (backend) backend->pause_device(current_audio_device, 0);
 }
 void song_stop_audio(void)
@@ -1416,9 +1557,187 @@ static int audio_lookup_device_name(const char *device, uint32_t *pdevid)
 	return 0;
 }
 
+/* --------------------------------------------------------------------------------------------------------- */
+/* render-ahead */
+
+static int audio_ahead_thread_(SCHISM_UNUSED void *userdata)
+{
+	const int role = mt_thread_set_role(MT_THREAD_ROLE_AUDIO);
+
+	mt_mutex_lock(ahead.mutex);
+
+	/* this is where the mixing happens now */
+	audio_thread_role = role;
+
+	while (!ahead.cancelled) {
+		const uint32_t head = atm_load(&ahead.head);
+		const uint32_t played = atm_load(&ahead.tail);
+		const uint32_t flush = atm_load(&ahead.flush);
+		/* where the device is going to pick up from (see below) */
+		const uint32_t tail = ((int32_t)(flush - played) > 1) ? (flush - 1) : played;
+
+		/* the second one keeps it from writing over whatever the device
+		 * might be copying right now */
+		if (head - tail >= ahead.blocks || head - played >= ahead.slots) {
+			mt_cond_wait_timeout(ahead.cond, ahead.mutex, ahead.block_ms);
+			continue;
+		}
+
+		audio_callback(ahead.ring + (head % ahead.slots) * ahead.block_bytes, ahead.block_bytes);
+		atm_store(&ahead.head, head + 1);
+
+		/* let the main thread at the song in between buffers */
+		mt_mutex_unlock(ahead.mutex);
+		mt_mutex_lock(ahead.mutex);
+	}
+
+	mt_mutex_unlock(ahead.mutex);
+
+	return 0;
+}
+
+// this gets called from the backend instead of audio_callback
+static void audio_ahead_callback(uint8_t *stream, int len)
+{
+	const uint32_t flush = atm_load(&ahead.flush);
+	uint32_t tail = atm_load(&ahead.tail);
+
+	if (!atm_load(&ahead.running)) {
+		/* no thread (yet); do it the old way */
+		mt_mutex_lock(ahead.mutex);
+		audio_callback(stream, len);
+		mt_mutex_unlock(ahead.mutex);
+		return;
+	}
+
+	/* skip everything that was mixed before the last change, except for
+	 * one buffer to play while the thread mixes the new stuff */
+	if ((int32_t)(flush - tail) > 1) {
+		tail = flush - 1;
+		ahead.offset = 0;
+	}
+
+	while (len > 0) {
+		uint32_t n;
+
+		if (tail == (uint32_t)atm_load(&ahead.head)) {
+			memset(stream, (audio_output_bits == 8) ? 0x80 : 0, len);
+			atm_store(&ahead.underruns, atm_load(&ahead.underruns) + 1);
+			break;
+		}
+
+		n = MIN((uint32_t)len, ahead.block_bytes - ahead.offset);
+		memcpy(stream, ahead.ring + (tail % ahead.slots) * ahead.block_bytes + ahead.offset, n);
+		stream += n;
+		len -= n;
+
+		ahead.offset += n;
+		if (ahead.offset >= ahead.block_bytes) {
+			ahead.offset = 0;
+			tail++;
+			/* hand the slot back right away */
+			atm_store(&ahead.tail, tail);
+		}
+	}
+
+	atm_store(&ahead.tail, tail);
+	mt_cond_signal(ahead.cond);
+}
+
+/* called once, before anything locks the song */
+static void audio_ahead_setup_(void)
+{
+#ifdef USE_THREADS
+	if (audio_settings.render_ahead <= 0 || ahead.mutex)
+		return;
+
+	ahead.cond = mt_cond_create();
+	if (!ahead.cond)
+		return; /* no threads */
+
+	ahead.mutex = mt_mutex_create();
+	if (!ahead.mutex) {
+		mt_cond_delete(ahead.cond);
+		ahead.cond = NULL;
+		return;
+	}
+
+	ahead.blocks = CLAMP(audio_settings.render_ahead, 1, 16);
+	ahead.slots = ahead.blocks * 2;
+#endif
+}
+
+/* called with the song locked, right after the device is opened */
+static void audio_ahead_start_(uint32_t frames, uint32_t rate, uint32_t frame_bytes)
+{
+	if (!ahead.mutex)
+		return;
+
+	ahead.block_bytes = frames * frame_bytes;
+	ahead.block_ms = MAX(1, frames * 1000 / rate);
+	ahead.ring = mem_calloc(ahead.slots, ahead.block_bytes);
+
+	atm_store(&ahead.head, 0);
+	atm_store(&ahead.tail, 0);
+	atm_store(&ahead.flush, 0);
+	atm_store(&ahead.underruns, 0);
+	ahead.offset = 0;
+
+	ahead.cancelled = 0;
+	ahead.thread = mt_thread_create(audio_ahead_thread_, "Audio render-ahead thread", NULL);
+	if (!ahead.thread) {
+		log_appendf(4, "Failed to start the render-ahead thread, mixing in the audio callback");
+		return;
+	}
+
+	atm_store(&ahead.running, 1);
+}
+
+/* called without the song locked, before the device is closed */
+static void audio_ahead_stop_(void)
+{
+	if (!ahead.thread)
+		return;
+
+	mt_mutex_lock(ahead.mutex);
+	ahead.cancelled = 1;
+	mt_mutex_unlock(ahead.mutex);
+
+	mt_cond_signal(ahead.cond);
+	mt_thread_wait(ahead.thread, NULL);
+	ahead.thread = NULL;
+
+	/* the device mixes by itself from here until it's closed */
+	atm_store(&ahead.running, 0);
+}
+
+void audio_ahead_invalidate(void)
+{
+	if (ahead.thread)
+		atm_store(&ahead.flush, atm_load(&ahead.head));
+}
+
+void audio_ahead_invalidate_if_idle(void)
+{
+	/* stopped or single-stepping, so there's no song time to lose */
+	if (current_song->flags & SONG_PAUSED)
+		audio_ahead_invalidate();
+}
+
+int song_get_render_ahead(uint32_t *underruns)
+{
+	*underruns = atm_load(&ahead.underruns);
+
+	return ahead.thread ? (int)ahead.blocks : 0;
+}
+
+/* --------------------------------------------------------------------------------------------------------- */
+
 static void _cleanup_audio_device(void)
 {
 	if (current_audio_device) {
+		audio_ahead_stop_();
+
 		if (backend)
 			backend->close_device(current_audio_device);
 		current_audio_device = NULL;
@@ -1428,24 +1747,32 @@ static void _cleanup_audio_device(void)
 
 		device_id = 0;
 	}
+
+	free(ahead.ring);
+	ahead.ring = NULL;
 }
 
 static int _audio_open_device(uint32_t device, int verbose)
 {
 	_cleanup_audio_device();
 
+	/* whatever thread the new device calls back on still has to be set up */
+	audio_thread_role = -1;
+	audio_thread_owned = 0;
+
 	if (!backend)
 		return 0;
 
 	/* if the buffer size isn't a power of two, the dsp driver will punt since it's not nice enough to fix
 	 * it for us. (contrast alsa, which is TOO nice and fixes it even when we don't want it to) */
+	const int buffer_size = audio_adapt.frames ? (int)audio_adapt.frames : audio_settings.buffer_size;
 	int size_pow2 = 2;
-	while (size_pow2 < audio_settings.buffer_size)
+	while (size_pow2 < buffer_size)
 		size_pow2 <<= 1;
 
 	/* round to the nearest (kept for compatibility) */
-	if (size_pow2 != audio_settings.buffer_size
-		&& (size_pow2 - audio_settings.buffer_size) > (audio_settings.buffer_size - (size_pow2 >> 1)))
+	if (size_pow2 != buffer_size
+		&& (size_pow2 - buffer_size) > (buffer_size - (size_pow2 >> 1)))
 		size_pow2 >>= 1;
 
 	/* This is needed in order to coax alsa into actually respecting the buffer size, since it's evidently
@@ -1469,7 +1796,7 @@ static int _audio_open_device(uint32_t device, int verbose)
 	desired.bits = audio_settings.bits;
 	desired.channels = audio_settings.channels;
 	desired.samples = size_pow2;
-	desired.callback = audio_callback;
+	desired.callback = ahead.mutex ? audio_ahead_callback : audio_callback;
 
 	schism_audio_spec_t obtained = {0};
 
@@ -1509,10 +1836,16 @@ success:
 	audio_sample_size = audio_output_channels * (audio_output_bits / 8);
 	audio_reallocate_buffer(obtained.samples);
 
+	/* the old numbers don't mean much with a different buffer */
+	audio_stats_reset(&playback_stats);
+	audio_stats_reset(&audio_adapt.window);
+
 	csf_set_wave_config(current_song, obtained.freq,
 		audio_output_bits,
 		obtained.channels);
 
+	audio_ahead_start_(obtained.samples, obtained.freq, obtained.channels * (audio_output_bits_real / 8));
+
 	if (verbose) {
 		log_nl();
 		log_append_timestamp(2, "Audio initialised");
@@ -1607,6 +1940,109 @@ static const schism_audio_backend_t *audio_driver_in_list_(const char *driver)
 	return NULL;
 }
 
+void audio_init_scheduling(void)
+{
+	const int lower = audio_settings.lower_priority && (audio_settings.realtime != MT_SCHED_NORMAL
+		|| audio_settings.audio_cpu >= 0);
+
+	if (mt_sched_configure(audio_settings.realtime, audio_settings.realtime_priority,
+			audio_settings.audio_cpu, lower) != audio_settings.realtime)
+		log_appendf(4, "Real-time scheduling isn't available, using normal priorities");
+
+	mt_thread_set_role(MT_THREAD_ROLE_UI);
+}
+
+/* the buffer size has to be a power of two; this rounds up */
+static uint32_t audio_adapt_pow2_(int n)
+{
+	uint32_t p = 16;
+
+	while (p < (uint32_t)n && p < 32768)
+		p <<= 1;
+
+	return p;
+}
+
+static void audio_adapt_setup_(void)
+{
+	if (!audio_settings.adaptive_buffer) {
+		audio_adapt.frames = 0;
+		return;
+	}
+
+	audio_adapt.min = audio_adapt_pow2_(audio_settings.buffer_size_min);
+	audio_adapt.max = MAX(audio_adapt.min, audio_adapt_pow2_(audio_settings.buffer_size_max));
+	audio_adapt.frames = CLAMP(audio_adapt_pow2_(audio_settings.buffer_size),
+		audio_adapt.min, audio_adapt.max);
+}
+
+/* Called from the main thread whenever the audio thread pokes it. If the
+ * adaptive buffer is turned on, this looks at how long the callbacks have been
+ * taking and reopens the device with a bigger or smaller buffer as needed.
+ * Reopening it makes a short gap in the sound, so unless the song is skipping
+ * already it waits until playback stops to do that. */
+void audio_adapt_buffer(void)
+{
+	struct audio_stats window;
+	uint32_t frames, want;
+	int success;
+
+	if (!audio_adapt.frames || (status.flags & (DISKWRITER_ACTIVE|DISKWRITER_ACTIVE_PATTERN)))
+		return;
+
+	song_lock_audio();
+	window = audio_adapt.window;
+	frames = audio_buffer_samples;
+	song_unlock_audio();
+
+	want = audio_stats_adapt_buffer(&window, frames, audio_adapt.min, audio_adapt.max);
+	if (want == frames) {
+		/* start over every so often, so this follows what's playing now
+		 * instead of whatever was played since the device was opened */
+		if (window.count * window.deadline_us >= AUDIO_STATS_ADAPT_SHRINK_MS * UINT64_C(3000)) {
+			song_lock_audio();
+			audio_stats_reset(&audio_adapt.window);
+			song_unlock_audio();
+		}
+		return;
+	}
+
+	/* classic mode stops the song when the device is reopened */
+	if ((want < frames || (status.flags & CLASSIC_MODE)) && song_get_mode() != MODE_STOPPED)
+		return;
+
+	/* never go back down to a size that couldn't keep up */
+	if (window.overruns)
+		audio_adapt.min = MAX(audio_adapt.min, want);
+
+	audio_adapt.frames = want;
+
+	if (status.flags & CLASSIC_MODE)
+		song_stop();
+
+	success = _audio_open_device(device_id, 0);
+	_audio_init_tail();
+
+	if (!success) {
+		audio_flash_reinitialized_text(0);
+		return;
+	}
+
+	song_init_modplug();
+
+	/* if the device wouldn't go there, stop asking it to */
+	if (want > frames && audio_buffer_samples <= frames)
+		audio_adapt.max = frames;
+	else if (want < frames && audio_buffer_samples >= frames)
+		audio_adapt.min = frames;
+
+	audio_adapt.frames = audio_buffer_samples;
+
+	log_appendf(2, "Audio buffer size changed from %" PRIu32 " to %" PRIu32 " samples",
+		frames, audio_buffer_samples);
+	status_text_flash("Audio buffer size: %" PRIu32 " samples", audio_buffer_samples);
+}
+
 /* driver == NULL || device == NULL is fine here */
 int audio_init(const char *driver, const char *device)
 {
@@ -1615,6 +2051,8 @@ int audio_init(const char *driver, const char *device)
 	int success = 0;
 
 	_audio_quit();
+	audio_adapt_setup_();
+	audio_ahead_setup_();
 
 	/* Use the driver from the config if it exists. */
 	if (!driver || !*driver)
@@ -1845,6 +2283,9 @@ int audio_simple_init(schism_audio_device_t *dev_,
 
 	dev->callback = callback;
 
+	/* the thread is ours, so it can have whatever the mixer wants */
+	audio_thread_owned = 1;
+
 	dev->mutex = mt_mutex_create();
 	if (!dev->mutex)
 		return -1;
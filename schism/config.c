@@ -36,6 +36,8 @@
 #include "dmoz.h"
 #include "osdefs.h"
 
+#include "player/sndfile.h"
+
 /* --------------------------------------------------------------------- */
 /* config settings */
 
@@ -151,6 +153,20 @@ static void cfg_save_palette(cfg_file_t *cfg)
 
 /* --------------------------------------------------------------------------------------------------------- */
 
+void cfg_load_scheduling(void)
+{
+	char *tmp;
+	cfg_file_t cfg;
+
+	tmp = dmoz_path_concat(cfg_dir_dotschism, "config");
+	cfg_init(&cfg, tmp);
+	free(tmp);
+
+	cfg_load_audio_scheduling(&cfg);
+
+	cfg_free(&cfg);
+}
+
 void cfg_load(void)
 {
 	char *tmp;
@@ -332,6 +348,8 @@ void cfg_load(void)
 	else
 		status.flags &= ~MIDI_LIKE_TRACKER;
 
+	csf_map_samples = cfg_get_number(&cfg, "General", "map_samples", 0);
+
 	str_realloc(&cfg_font, cfg_get_string(&cfg, "General", "font", NULL, 0, "font.cfg"), 0);
 
 	cfg_load_palette(&cfg);
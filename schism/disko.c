@@ -36,6 +36,9 @@
 #include "osdefs.h"
 #include "mem.h"
 #include "str.h"
+#include "mt.h"
+#include "timer.h"
+#include "audio-stats.h"
 
 #include "player/sndfile.h"
 #include "player/cmixer.h"
@@ -51,12 +54,14 @@ static void _disko_midi_out_raw(SCHISM_UNUSED song_t *csf, SCHISM_UNUSED const u
 static unsigned int disko_output_rate = 44100;
 static unsigned int disko_output_bits = 16;
 static unsigned int disko_output_channels = 2;
+static int disko_verify_stems = 0;
 
 void cfg_load_disko(cfg_file_t *cfg)
 {
 	disko_output_rate = cfg_get_number(cfg, "Diskwriter", "rate", 44100);
 	disko_output_bits = cfg_get_number(cfg, "Diskwriter", "bits", 16);
 	disko_output_channels = cfg_get_number(cfg, "Diskwriter", "channels", 2);
+	disko_verify_stems = cfg_get_number(cfg, "Diskwriter", "verify_stems", 0);
 }
 
 void cfg_save_disko(cfg_file_t *cfg)
@@ -167,6 +172,356 @@ static void _dw_stdio_seek(disko_t *ds, int64_t pos, int whence)
 #endif
 }
 
+// ---------------------------------------------------------------------------
+// asynchronous file backend
+//
+// Writes are collected in a large block per file, which is handed off to a
+// writer thread (one for all the files) once it's full, or once something is
+// written somewhere it can't be appended. Seeking forward past the end of the
+// file just fills the block with zeroes, so a stem that's mostly silence still
+// ends up as a few large sequential writes. Writing before the current block
+// (which is what the header fixups in the export tail functions do) starts a
+// new, small block; the writer keeps them in order, so that's still correct.
+
+#define DW_ASYNC_BLOCK (512 * 1024)
+#define DW_ASYNC_QUEUE 16 /* blocks waiting to be written, for all files */
+
+#if defined(HAVE_POSIX_FALLOCATE) && defined(HAVE_FTRUNCATE)
+# include <fcntl.h>
+# define DW_ASYNC_PREALLOCATE
+#endif
+
+struct disko_async_block {
+	struct disko_async *stream;
+	int64_t offset;
+	size_t length;
+	uint8_t *data;
+	struct disko_async_block *next;
+};
+
+struct disko_async {
+	// the file itself; only the writer touches this once it's open
+	disko_t out;
+	size_t estimate;
+	int preallocated;
+
+	// block currently being filled
+	uint8_t *data;
+	int64_t base;
+	size_t fill;
+
+	int64_t pos, end;
+
+	int pending; // blocks queued or being written
+	int error; // copy of out.error, for the other side of the queue
+};
+
+#ifdef USE_THREADS
+static struct {
+	mt_mutex_t *mutex;
+	mt_cond_t *queued, *space, *done;
+	mt_thread_t *thread;
+
+	struct disko_async_block *head, *tail;
+	int count; // blocks in the queue
+	int streams; // files using the writer
+	int stop;
+} disko_writer = {0};
+#endif
+
+static void disko_async_output(struct disko_async_block *b)
+{
+	struct disko_async *a = b->stream;
+
+	if (a->out.error)
+		return;
+
+#ifdef DW_ASYNC_PREALLOCATE
+	/* only bother once the file has a full block in it, so that empty
+	 * stems don't reserve a whole song's worth of disk space for nothing */
+	if (a->estimate && b->length == DW_ASYNC_BLOCK && !a->preallocated) {
+		/* this is just a hint; if it fails, the writes will tell */
+		posix_fallocate(fileno(a->out.file), 0, a->estimate);
+		a->preallocated = 1;
+	}
+#endif
+
+	_dw_stdio_seek(&a->out, b->offset, SEEK_SET);
+	if (!a->out.error)
+		_dw_stdio_write(&a->out, b->data, b->length);
+}
+
+static void disko_async_block_free(struct disko_async_block *b)
+{
+	free(b->data);
+	free(b);
+}
+
+#ifdef USE_THREADS
+static int disko_writer_thread(SCHISM_UNUSED void *userdata)
+{
+	struct disko_async_block *b;
+
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+
+	mt_mutex_lock(disko_writer.mutex);
+	for (;;) {
+		while (!disko_writer.head && !disko_writer.stop)
+			mt_cond_wait(disko_writer.queued, disko_writer.mutex);
+		if (!disko_writer.head)
+			break;
+
+		b = disko_writer.head;
+		disko_writer.head = b->next;
+		if (!disko_writer.head)
+			disko_writer.tail = NULL;
+		mt_mutex_unlock(disko_writer.mutex);
+
+		disko_async_output(b);
+
+		mt_mutex_lock(disko_writer.mutex);
+		b->stream->error = b->stream->out.error;
+		b->stream->pending--;
+		disko_writer.count--;
+		mt_cond_signal(disko_writer.space);
+		mt_cond_signal(disko_writer.done);
+		disko_async_block_free(b);
+	}
+	mt_mutex_unlock(disko_writer.mutex);
+
+	return 0;
+}
+
+static void disko_writer_free(void)
+{
+	if (disko_writer.mutex)
+		mt_mutex_delete(disko_writer.mutex);
+	if (disko_writer.queued)
+		mt_cond_delete(disko_writer.queued);
+	if (disko_writer.space)
+		mt_cond_delete(disko_writer.space);
+	if (disko_writer.done)
+		mt_cond_delete(disko_writer.done);
+
+	memset(&disko_writer, 0, sizeof(disko_writer));
+}
+#endif
+
+static void disko_writer_acquire(void)
+{
+#ifdef USE_THREADS
+	if (disko_writer.streams++)
+		return;
+
+	disko_writer.mutex = mt_mutex_create();
+	disko_writer.queued = mt_cond_create();
+	disko_writer.space = mt_cond_create();
+	disko_writer.done = mt_cond_create();
+
+	if (disko_writer.mutex && disko_writer.queued && disko_writer.space && disko_writer.done)
+		disko_writer.thread = mt_thread_create(disko_writer_thread, "Disk writer I/O", NULL);
+
+	if (!disko_writer.thread) {
+		/* no thread, so everything's written right away */
+		disko_writer_free();
+		disko_writer.streams = 1;
+	}
+#endif
+}
+
+static void disko_writer_release(void)
+{
+#ifdef USE_THREADS
+	if (--disko_writer.streams)
+		return;
+
+	if (disko_writer.thread) {
+		mt_mutex_lock(disko_writer.mutex);
+		disko_writer.stop = 1;
+		mt_cond_signal(disko_writer.queued);
+		mt_mutex_unlock(disko_writer.mutex);
+
+		mt_thread_wait(disko_writer.thread, NULL);
+	}
+
+	disko_writer_free();
+#endif
+}
+
+/* hands the current block over to the writer */
+static void disko_async_flush(disko_t *ds)
+{
+	struct disko_async *a = ds->async;
+	struct disko_async_block *b;
+	int err;
+
+	if (!a->fill)
+		return;
+
+	b = mem_alloc(sizeof(*b));
+	b->stream = a;
+	b->offset = a->base;
+	b->length = a->fill;
+	b->data = a->data;
+	b->next = NULL;
+
+	a->data = NULL;
+	a->fill = 0;
+
+#ifdef USE_THREADS
+	if (disko_writer.thread) {
+		mt_mutex_lock(disko_writer.mutex);
+		while (disko_writer.count >= DW_ASYNC_QUEUE)
+			mt_cond_wait(disko_writer.space, disko_writer.mutex);
+
+		if (disko_writer.tail)
+			disko_writer.tail->next = b;
+		else
+			disko_writer.head = b;
+		disko_writer.tail = b;
+		disko_writer.count++;
+		a->pending++;
+		err = a->error;
+
+		mt_cond_signal(disko_writer.queued);
+		mt_mutex_unlock(disko_writer.mutex);
+
+		if (err)
+			disko_seterror(ds, err);
+		return;
+	}
+#endif
+
+	disko_async_output(b);
+	disko_async_block_free(b);
+
+	err = a->out.error;
+	if (err)
+		disko_seterror(ds, err);
+}
+
+static void _dw_async_write(disko_t *ds, const void *buf, size_t len)
+{
+	struct disko_async *a = ds->async;
+	const uint8_t *p = buf;
+	size_t off, n;
+
+	while (len && !ds->error) {
+		/* the block can take this if it's within the block, and either
+		 * continues what's in it or the gap is past the end of the file */
+		if (a->pos < a->base || a->pos >= a->base + DW_ASYNC_BLOCK
+				|| (a->pos > a->base + (int64_t)a->fill && a->base + (int64_t)a->fill < a->end))
+			disko_async_flush(ds);
+
+		if (!a->data) {
+			a->data = malloc(DW_ASYNC_BLOCK);
+			if (!a->data) {
+				disko_seterror(ds, errno);
+				return;
+			}
+		}
+		if (!a->fill)
+			a->base = a->pos;
+
+		off = a->pos - a->base;
+		if (off > a->fill)
+			memset(a->data + a->fill, 0, off - a->fill);
+
+		n = MIN(len, DW_ASYNC_BLOCK - off);
+		memcpy(a->data + off, p, n);
+
+		a->fill = MAX(a->fill, off + n);
+		a->pos += n;
+		a->end = MAX(a->end, a->pos);
+		p += n;
+		len -= n;
+	}
+}
+
+static void _dw_async_seek(disko_t *ds, int64_t offset, int whence)
+{
+	struct disko_async *a = ds->async;
+
+	switch (whence) {
+	default:
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		offset += a->pos;
+		break;
+	case SEEK_END:
+		offset += a->end;
+		break;
+	}
+	if (offset < 0) {
+		disko_seterror(ds, EINVAL);
+		return;
+	}
+	/* same as stdio, this doesn't extend the file until something's written */
+	a->pos = offset;
+}
+
+static int64_t _dw_async_tell(disko_t *ds)
+{
+	return ds->async->pos;
+}
+
+/* writes out whatever's left (unless the file is being thrown away anyway),
+ * and waits for the writer to be done with it */
+static void disko_async_close(disko_t *ds)
+{
+	struct disko_async *a = ds->async;
+	int err;
+
+	if (!ds->error)
+		disko_async_flush(ds);
+	free(a->data);
+
+#ifdef USE_THREADS
+	if (disko_writer.thread) {
+		struct disko_async_block **pb, *b;
+
+		mt_mutex_lock(disko_writer.mutex);
+		if (ds->error) {
+			/* no point in writing any of this */
+			disko_writer.tail = NULL;
+			for (pb = &disko_writer.head; *pb; ) {
+				b = *pb;
+				if (b->stream == a) {
+					*pb = b->next;
+					a->pending--;
+					disko_writer.count--;
+					disko_async_block_free(b);
+					mt_cond_signal(disko_writer.space);
+				} else {
+					disko_writer.tail = b;
+					pb = &b->next;
+				}
+			}
+		}
+		while (a->pending)
+			mt_cond_wait(disko_writer.done, disko_writer.mutex);
+		mt_mutex_unlock(disko_writer.mutex);
+	}
+#endif
+
+	err = a->out.error;
+	if (err)
+		disko_seterror(ds, err);
+
+#ifdef DW_ASYNC_PREALLOCATE
+	/* cut off whatever was preallocated and never written */
+	if (!ds->error && a->preallocated
+			&& (fflush(ds->file) == EOF || ftruncate(fileno(ds->file), a->end) < 0))
+		disko_seterror(ds, errno);
+#endif
+
+	free(a);
+	ds->async = NULL;
+
+	disko_writer_release();
+}
+
 // ---------------------------------------------------------------------------
 // memory backend
 
@@ -331,13 +686,39 @@ int disko_open(disko_t *ds, const char *filename)
 	return 0;
 }
 
+int disko_open_async(disko_t *ds, const char *filename, size_t estimated_size)
+{
+	struct disko_async *a;
+
+	if (disko_open(ds, filename) < 0)
+		return -1;
+
+	a = mem_calloc(1, sizeof(*a));
+	a->out = *ds;
+	a->estimate = estimated_size;
+	ds->async = a;
+
+	ds->_write = _dw_async_write;
+	ds->_seek = _dw_async_seek;
+	ds->_tell = _dw_async_tell;
+
+	disko_writer_acquire();
+
+	return 0;
+}
+
 /* weird stupid magic numbers:
  *  backup == 0, no backup
  *  backup == 1, backup with ~
  *  else, backup with numberings */
 int disko_close(disko_t *ds, int backup)
 {
-	int err = ds->error;
+	int err;
+
+	if (ds->async)
+		disko_async_close(ds);
+
+	err = ds->error;
 
 	// try to preserve the *first* error set, because it's most likely to be interesting
 	if (fclose(ds->file) == EOF && !err) {
@@ -716,12 +1097,586 @@ static disko_t *export_ds[MAX_CHANNELS + 1]; /* only [0] is used unless multicha
 static const struct save_format *export_format = NULL; /* NULL == not running */
 static struct widget diskodlg_widgets[1];
 static size_t est_len;
+/* frames of the song exported so far, for the progress bar */
+static size_t export_frames;
 static int prgh;
 static timer_ticks_t export_start_time;
+/* how long each block of the full mix took; only the thread mixing it touches
+ * this until the export is done */
+static struct audio_stats export_stats;
 static int canceled = 0; /* this sucks, but so do I */
 
 static int disko_finish(void);
 
+// ---------------------------------------------------------------------------
+// song export pipeline
+//
+// If threads are available, the song is mixed on one thread and handed to
+// the format's body function (which for FLAC is also where the encoding
+// happens) on another, through a small ring of blocks. disko_sync then only
+// waits for progress, so the export isn't paced by the event loop anymore.
+//
+// Multi-channel exports write straight from the mixer, so instead the
+// channels are split between a few copies of the song, each of which only
+// mixes and writes its own share (see multi_write.muted) while still playing
+// everything else silently, so that it sounds exactly the same.
+//
+// None of the mixer threads take the audio lock: they only read the song
+// data they share with current_song, and nothing edits it while the export
+// dialog is up.
+
+#ifdef USE_THREADS
+#define DW_PIPE_BLOCKS 4
+#define DW_STEM_THREADS 4
+
+struct disko_block {
+	size_t frames;
+	uint8_t data[DW_BUFFER_SIZE];
+};
+
+static struct {
+	mt_thread_t *render, *output;
+	mt_mutex_t *mutex;
+	mt_cond_t *space, *data, *progress;
+
+	struct disko_block *blocks;
+	unsigned int head, tail, count;
+
+	size_t frames; // frames written so far
+	int rendered; // mixer hit the end
+	int written; // output thread is done
+	int stop; // cancel or error
+	int active; // threads are doing the work
+
+	int stems_left; // stem (and verify) threads still running
+	struct disko_stem {
+		mt_thread_t *thread;
+		song_t *song;
+		size_t frames;
+	} stems[DW_STEM_THREADS];
+
+	// checks that the stems add up to the full mix (verify_stems=1)
+	mt_thread_t *verify;
+	uint64_t verify_samples, verify_bad;
+	int64_t verify_peak;
+} export_pipe = {0};
+
+static size_t disko_export_read(uint8_t *buf, size_t len)
+{
+	uint32_t stage_us[AUDIO_STATS_STAGES] = {0};
+	timer_ticks_t start = timer_ticks_us();
+	size_t frames = csf_read(&export_dwsong, buf, len);
+
+	stage_us[AUDIO_STATS_MIX] = timer_ticks_us() - start;
+	audio_stats_add(&export_stats, frames, export_dwsong.mix_frequency, stage_us);
+
+	return frames;
+}
+
+static int disko_pipe_has_error(void)
+{
+	int n;
+
+	for (n = 0; export_ds[n]; n++)
+		if (export_ds[n]->error)
+			return 1;
+
+	return 0;
+}
+
+static int disko_pipe_render(SCHISM_UNUSED void *userdata)
+{
+	struct disko_block *block;
+	int end;
+
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+
+	for (;;) {
+		mt_mutex_lock(export_pipe.mutex);
+		while (export_pipe.count == DW_PIPE_BLOCKS && !export_pipe.stop)
+			mt_cond_wait(export_pipe.space, export_pipe.mutex);
+		if (export_pipe.stop) {
+			mt_mutex_unlock(export_pipe.mutex);
+			break;
+		}
+		block = &export_pipe.blocks[export_pipe.head];
+		mt_mutex_unlock(export_pipe.mutex);
+
+		block->frames = disko_export_read(block->data, sizeof(block->data));
+		end = !!(export_dwsong.flags & SONG_ENDREACHED);
+
+		mt_mutex_lock(export_pipe.mutex);
+		export_pipe.head = (export_pipe.head + 1) % DW_PIPE_BLOCKS;
+		export_pipe.count++;
+		mt_cond_signal(export_pipe.data);
+		mt_mutex_unlock(export_pipe.mutex);
+
+		if (end)
+			break;
+	}
+
+	mt_mutex_lock(export_pipe.mutex);
+	export_pipe.rendered = 1;
+	mt_cond_signal(export_pipe.data);
+	mt_mutex_unlock(export_pipe.mutex);
+
+	return 0;
+}
+
+static int disko_pipe_output(SCHISM_UNUSED void *userdata)
+{
+	struct disko_block *block;
+	int err;
+
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+
+	for (;;) {
+		mt_mutex_lock(export_pipe.mutex);
+		while (!export_pipe.count && !export_pipe.rendered && !export_pipe.stop)
+			mt_cond_wait(export_pipe.data, export_pipe.mutex);
+		if (export_pipe.stop || !export_pipe.count) {
+			mt_mutex_unlock(export_pipe.mutex);
+			break;
+		}
+		block = &export_pipe.blocks[export_pipe.tail];
+		mt_mutex_unlock(export_pipe.mutex);
+
+		export_format->f.export.body(export_ds[0], block->data, block->frames * export_bps);
+		err = disko_pipe_has_error();
+
+		mt_mutex_lock(export_pipe.mutex);
+		export_pipe.tail = (export_pipe.tail + 1) % DW_PIPE_BLOCKS;
+		export_pipe.count--;
+		export_pipe.frames += block->frames;
+		if (err)
+			export_pipe.stop = 1;
+		mt_cond_signal(export_pipe.space);
+		mt_cond_signal(export_pipe.progress);
+		mt_mutex_unlock(export_pipe.mutex);
+	}
+
+	mt_mutex_lock(export_pipe.mutex);
+	export_pipe.written = 1;
+	mt_cond_signal(export_pipe.progress);
+	mt_mutex_unlock(export_pipe.mutex);
+
+	return 0;
+}
+
+/* a copy of the song that only mixes every DW_STEM_THREADS'th channel */
+static song_t *disko_stem_song(int stem)
+{
+	song_t *song = mem_alloc(sizeof(*song));
+	int n;
+
+	memcpy(song, &export_dwsong, sizeof(*song));
+	/* the OPL chip can't be shared between threads; give the copy its own */
+	song->opl = NULL;
+	Fmdrv_Init(song, export_dwsong.mix_frequency);
+	song->multi_write = mem_alloc(MAX_CHANNELS * sizeof(*song->multi_write));
+	memcpy(song->multi_write, export_dwsong.multi_write, MAX_CHANNELS * sizeof(*song->multi_write));
+	for (n = 0; n < MAX_CHANNELS; n++)
+		song->multi_write[n].muted = (n % DW_STEM_THREADS != stem);
+
+	return song;
+}
+
+static void disko_stem_song_free(song_t *song)
+{
+	if (song) {
+		OPL_Close(song);
+		free(song->multi_write);
+		free(song);
+	}
+}
+
+static void disko_pipe_stem_done(void)
+{
+	mt_mutex_lock(export_pipe.mutex);
+	if (!--export_pipe.stems_left)
+		export_pipe.written = 1;
+	mt_cond_signal(export_pipe.progress);
+	mt_mutex_unlock(export_pipe.mutex);
+}
+
+static int disko_pipe_stem(void *userdata)
+{
+	struct disko_stem *stem = userdata;
+	uint8_t *buf = mem_alloc(DW_BUFFER_SIZE);
+	size_t frames;
+	int n, err, stop;
+
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+
+	/* this waits for disko_pipe_start to finish starting all the threads */
+	mt_mutex_lock(export_pipe.mutex);
+	stop = export_pipe.stop;
+	mt_mutex_unlock(export_pipe.mutex);
+
+	while (!stop && !(stem->song->flags & SONG_ENDREACHED)) {
+		/* buf is only scratch space here, the channels are written by the mixer */
+		frames = csf_read(stem->song, buf, DW_BUFFER_SIZE);
+
+		for (err = 0, n = 0; n < MAX_CHANNELS && !err; n++)
+			if (!stem->song->multi_write[n].muted && export_ds[n]->error)
+				err = 1;
+
+		mt_mutex_lock(export_pipe.mutex);
+		stem->frames += frames;
+		if (err)
+			export_pipe.stop = 1;
+		stop = export_pipe.stop;
+		mt_cond_signal(export_pipe.progress);
+		mt_mutex_unlock(export_pipe.mutex);
+	}
+
+	free(buf);
+	disko_pipe_stem_done();
+
+	return 0;
+}
+
+/* stem verification: a separate full mix is rendered alongside another set
+ * of stem songs whose channels are summed instead of written, and the two
+ * are compared sample by sample. every stem is rounded separately, so they
+ * are allowed to be off by one per channel; clipped samples are skipped. */
+
+struct disko_verify {
+	int64_t *sum;
+	int bps;
+};
+
+struct disko_verify_channel {
+	struct disko_verify *v;
+	size_t pos;
+};
+
+static int32_t disko_pcm_get(const uint8_t *p, int bps)
+{
+	switch (bps) {
+	case 1:
+		return (int32_t)p[0] - 0x80;
+	case 2: {
+		int16_t x;
+		memcpy(&x, p, 2);
+		return x;
+	}
+	case 3: {
+		/* same as clip_32_to_24 */
+		int32_t x = 0;
+		memcpy(&x, p, 3);
+#ifdef WORDS_BIGENDIAN
+		return rshift_signed(x, 8);
+#else
+		return rshift_signed(lshift_signed(x, 8), 8);
+#endif
+	}
+	case 4: {
+		int32_t x;
+		memcpy(&x, p, 4);
+		return x;
+	}
+	default:
+		return 0;
+	}
+}
+
+static void disko_verify_write(void *data, const uint8_t *buf, size_t bytes)
+{
+	struct disko_verify_channel *vc = data;
+	size_t i;
+
+	for (i = 0; i + vc->v->bps <= bytes; i += vc->v->bps)
+		vc->v->sum[vc->pos++] += disko_pcm_get(buf + i, vc->v->bps);
+}
+
+static void disko_verify_silence(void *data, long bytes)
+{
+	struct disko_verify_channel *vc = data;
+
+	vc->pos += bytes / vc->v->bps;
+}
+
+static int disko_pipe_verify(SCHISM_UNUSED void *userdata)
+{
+	struct disko_verify v;
+	struct disko_verify_channel vc[MAX_CHANNELS];
+	song_t *full, *stems[DW_STEM_THREADS];
+	uint8_t *buf, *scratch;
+	int32_t clip;
+	size_t frames, samples, i;
+	uint64_t bad;
+	int64_t peak;
+	int s, n, used, stop;
+
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+
+	v.bps = (export_dwsong.mix_bits_per_sample + 7) / 8;
+	v.sum = mem_alloc(DW_BUFFER_SIZE / v.bps * sizeof(*v.sum));
+	buf = mem_alloc(DW_BUFFER_SIZE);
+	scratch = mem_alloc(DW_BUFFER_SIZE);
+	clip = (v.bps == 4)
+		? lshift_signed(MIXING_CLIPMAX, MIXING_ATTENUATION)
+		: (INT32_C(1) << (v.bps * 8 - 1)) - 1;
+
+	full = mem_alloc(sizeof(*full));
+	memcpy(full, &export_dwsong, sizeof(*full));
+	full->multi_write = NULL;
+	full->opl = NULL;
+	Fmdrv_Init(full, export_dwsong.mix_frequency);
+
+	for (n = 0; n < MAX_CHANNELS; n++)
+		vc[n].v = &v;
+
+	for (s = 0; s < DW_STEM_THREADS; s++) {
+		stems[s] = disko_stem_song(s);
+		for (n = 0; n < MAX_CHANNELS; n++) {
+			stems[s]->multi_write[n].data = &vc[n];
+			stems[s]->multi_write[n].write = disko_verify_write;
+			stems[s]->multi_write[n].silence = disko_verify_silence;
+		}
+	}
+
+	mt_mutex_lock(export_pipe.mutex);
+	stop = export_pipe.stop;
+	mt_mutex_unlock(export_pipe.mutex);
+
+	while (!stop && !(full->flags & SONG_ENDREACHED)) {
+		/* every song reads the same number of frames, since they're
+		 * all playing the same thing */
+		frames = csf_read(full, buf, DW_BUFFER_SIZE);
+		samples = frames * full->mix_channels;
+
+		memset(v.sum, 0, samples * sizeof(*v.sum));
+		for (n = 0; n < MAX_CHANNELS; n++)
+			vc[n].pos = 0;
+
+		for (s = 0, used = 0; s < DW_STEM_THREADS; s++) {
+			csf_read(stems[s], scratch, DW_BUFFER_SIZE);
+			for (n = 0; n < MAX_CHANNELS; n++)
+				used += stems[s]->multi_write[n].used;
+		}
+
+		for (i = 0, bad = 0, peak = 0; i < samples; i++) {
+			int32_t x = disko_pcm_get(buf + i * v.bps, v.bps);
+			int64_t d;
+
+			if (x >= clip || x <= -clip)
+				continue;
+
+			d = v.sum[i] - x;
+			d = (d < 0) ? -d : d;
+			peak = MAX(peak, d);
+			if (d > used + 1)
+				bad++;
+		}
+
+		mt_mutex_lock(export_pipe.mutex);
+		export_pipe.verify_samples += samples;
+		export_pipe.verify_bad += bad;
+		export_pipe.verify_peak = MAX(export_pipe.verify_peak, peak);
+		stop = export_pipe.stop;
+		mt_mutex_unlock(export_pipe.mutex);
+	}
+
+	for (s = 0; s < DW_STEM_THREADS; s++)
+		disko_stem_song_free(stems[s]);
+	OPL_Close(full);
+	free(full);
+	free(scratch);
+	free(buf);
+	free(v.sum);
+
+	disko_pipe_stem_done();
+
+	return 0;
+}
+
+static void disko_pipe_free(void)
+{
+	int s;
+
+	for (s = 0; s < DW_STEM_THREADS; s++)
+		disko_stem_song_free(export_pipe.stems[s].song);
+
+	if (export_pipe.mutex)
+		mt_mutex_delete(export_pipe.mutex);
+	if (export_pipe.space)
+		mt_cond_delete(export_pipe.space);
+	if (export_pipe.data)
+		mt_cond_delete(export_pipe.data);
+	if (export_pipe.progress)
+		mt_cond_delete(export_pipe.progress);
+	free(export_pipe.blocks);
+
+	memset(&export_pipe, 0, sizeof(export_pipe));
+}
+
+static void disko_pipe_stop(void)
+{
+	mt_mutex_lock(export_pipe.mutex);
+	export_pipe.stop = 1;
+	mt_cond_signal(export_pipe.space);
+	mt_cond_signal(export_pipe.data);
+	mt_mutex_unlock(export_pipe.mutex);
+}
+
+static void disko_pipe_join(void)
+{
+	int s, n;
+
+	if (export_pipe.render)
+		mt_thread_wait(export_pipe.render, NULL);
+	if (export_pipe.output)
+		mt_thread_wait(export_pipe.output, NULL);
+
+	for (s = 0; s < DW_STEM_THREADS; s++) {
+		if (!export_pipe.stems[s].thread)
+			continue;
+
+		mt_thread_wait(export_pipe.stems[s].thread, NULL);
+
+		/* disko_finish needs to know which channels were empty */
+		for (n = s; n < MAX_CHANNELS; n += DW_STEM_THREADS)
+			export_dwsong.multi_write[n].used = export_pipe.stems[s].song->multi_write[n].used;
+	}
+
+	if (export_pipe.verify)
+		mt_thread_wait(export_pipe.verify, NULL);
+
+	disko_pipe_free();
+}
+
+static int disko_pipe_start_stems(void)
+{
+	int s, ok = 1;
+
+	for (s = 0; s < DW_STEM_THREADS; s++)
+		export_pipe.stems[s].song = disko_stem_song(s);
+
+	/* hold the lock until every thread is up, so none of them writes
+	 * anything if it turns out we can't do this after all */
+	mt_mutex_lock(export_pipe.mutex);
+	for (s = 0; s < DW_STEM_THREADS && ok; s++) {
+		export_pipe.stems[s].thread = mt_thread_create(disko_pipe_stem, "Disk writer stems", &export_pipe.stems[s]);
+		if (export_pipe.stems[s].thread)
+			export_pipe.stems_left++;
+		else
+			ok = 0;
+	}
+
+	if (ok && disko_verify_stems) {
+		export_pipe.verify = mt_thread_create(disko_pipe_verify, "Disk writer stem check", NULL);
+		if (export_pipe.verify)
+			export_pipe.stems_left++;
+		else
+			log_appendf(4, " Couldn't start the stem check");
+	}
+
+	if (!ok)
+		export_pipe.stop = 1;
+	mt_mutex_unlock(export_pipe.mutex);
+
+	return ok;
+}
+
+/* returns 1 if the threads are running, or 0 if disko_sync has to do the work */
+static int disko_pipe_start(void)
+{
+	memset(&export_pipe, 0, sizeof(export_pipe));
+
+	export_pipe.mutex = mt_mutex_create();
+	export_pipe.space = mt_cond_create();
+	export_pipe.data = mt_cond_create();
+	export_pipe.progress = mt_cond_create();
+	export_pipe.blocks = malloc(DW_PIPE_BLOCKS * sizeof(*export_pipe.blocks));
+
+	if (!export_pipe.mutex || !export_pipe.space || !export_pipe.data
+			|| !export_pipe.progress || !export_pipe.blocks) {
+		disko_pipe_free();
+		return 0;
+	}
+
+	if (export_dwsong.multi_write) {
+		if (!disko_pipe_start_stems()) {
+			disko_pipe_join();
+			return 0;
+		}
+
+		export_pipe.active = 1;
+		return 1;
+	}
+
+	/* start the output thread first; if the mixer thread can't be
+	 * started it will just exit without having done anything */
+	export_pipe.output = mt_thread_create(disko_pipe_output, "Disk writer output", NULL);
+	if (export_pipe.output)
+		export_pipe.render = mt_thread_create(disko_pipe_render, "Disk writer mixer", NULL);
+
+	if (!export_pipe.render) {
+		if (export_pipe.output)
+			disko_pipe_stop();
+		disko_pipe_join();
+		return 0;
+	}
+
+	export_pipe.active = 1;
+	return 1;
+}
+
+static int disko_pipe_sync(void)
+{
+	int written, verified, error, n, s;
+	uint64_t verify_samples, verify_bad;
+	int64_t verify_peak;
+	size_t frames;
+
+	mt_mutex_lock(export_pipe.mutex);
+	if (!export_pipe.written)
+		mt_cond_wait_timeout(export_pipe.progress, export_pipe.mutex, 10);
+	if (export_pipe.stems[0].thread) {
+		/* show the slowest one */
+		frames = export_pipe.stems[0].frames;
+		for (s = 1; s < DW_STEM_THREADS; s++)
+			frames = MIN(frames, export_pipe.stems[s].frames);
+	} else {
+		frames = export_pipe.frames;
+	}
+	export_frames = frames;
+	written = export_pipe.written;
+	mt_mutex_unlock(export_pipe.mutex);
+
+	status.flags |= NEED_UPDATE;
+
+	if (!written)
+		return DW_SYNC_MORE;
+
+	verified = !!export_pipe.verify;
+	verify_samples = export_pipe.verify_samples;
+	verify_bad = export_pipe.verify_bad;
+	verify_peak = export_pipe.verify_peak;
+
+	disko_pipe_join();
+
+	if (canceled)
+		for (n = 0; export_ds[n]; n++)
+			disko_seterror(export_ds[n], EINTR);
+
+	error = disko_pipe_has_error();
+	disko_finish();
+
+	if (verified && !error) {
+		if (verify_bad)
+			log_appendf(4, " Stems differ from the full mix in %" PRIu64 " of %" PRIu64 " samples (by up to %" PRId64 ")",
+				verify_bad, verify_samples, verify_peak);
+		else
+			log_appendf(5, " Stems add up to the full mix (%" PRIu64 " samples checked)", verify_samples);
+	}
+
+	return error ? DW_SYNC_ERROR : DW_SYNC_DONE;
+}
+#endif
+
 static void diskodlg_draw(void)
 {
 	int sec, pos;
@@ -734,8 +1689,8 @@ static void diskodlg_draw(void)
 		return;
 	}
 
-	sec = export_ds[0]->length / export_dwsong.mix_frequency;
-	pos = export_ds[0]->length * 64 / est_len;
+	sec = export_frames / export_dwsong.mix_frequency;
+	pos = export_frames * 64 / est_len;
 	snprintf(buf, 32, "Exporting song...%6d:%02d", sec / 60, sec % 60);
 	buf[31] = '\0';
 	draw_text(buf, 27, 27, 0, 2);
@@ -747,6 +1702,14 @@ static void diskodlg_draw(void)
 static void diskodlg_cancel(SCHISM_UNUSED void *ignored)
 {
 	canceled = 1;
+#ifdef USE_THREADS
+	if (export_pipe.active) {
+		/* the threads own the song and the files until they've stopped;
+		 * disko_sync marks the files as canceled after that */
+		disko_pipe_stop();
+		return;
+	}
+#endif
 	export_dwsong.flags |= SONG_ENDREACHED;
 	if (!export_ds[0]) {
 		log_appendf(4, "export was already dead on the inside");
@@ -822,10 +1785,16 @@ static void disko_export_silence(void *userdata, long len)
 	export_format->f.export.silence(userdata, len);
 }
 
+void disko_get_export_stats(struct audio_stats *stats)
+{
+	*stats = export_stats;
+}
+
 int disko_export_song(const char *filename, const struct save_format *format)
 {
 	int err = 0;
 	int numfiles, n;
+	uint32_t est_frames;
 
 	if (export_format) {
 		log_appendf(4, "Another export is already active");
@@ -837,10 +1806,15 @@ int disko_export_song(const char *filename, const struct save_format *format)
 	song_stop();
 
 	export_start_time = timer_ticks();
+	audio_stats_reset(&export_stats);
 
 	numfiles = format->f.export.multi ? MAX_CHANNELS : 1;
 
 	_export_setup(&export_dwsong, &export_bps);
+	csf_profile_reset(&export_dwsong);
+	/* this has to happen before any of the threads start playing the song */
+	est_frames = csf_get_length(&export_dwsong) * export_dwsong.mix_frequency;
+	export_frames = 0;
 	if (numfiles > 1) {
 		export_dwsong.multi_write = calloc(numfiles, sizeof(struct multi_write));
 		if (!export_dwsong.multi_write)
@@ -853,12 +1827,12 @@ int disko_export_song(const char *filename, const struct save_format *format)
 			char *tmp = get_filename(filename, n + 1);
 			if (tmp) {
 				export_ds[n] = calloc(1, sizeof(*export_ds[n]));
-				disko_open(export_ds[n], tmp);
+				disko_open_async(export_ds[n], tmp, (size_t)est_frames * export_bps);
 				free(tmp);
 			}
 		} else {
 			export_ds[n] = calloc(1, sizeof(*export_ds[n]));
-			disko_open(export_ds[n], filename);
+			disko_open_async(export_ds[n], filename, (size_t)est_frames * export_bps);
 		}
 		if (!(export_ds[n] && format->f.export.head(export_ds[n], export_dwsong.mix_bits_per_sample,
 				export_dwsong.mix_channels, export_dwsong.mix_frequency, export_dwsong.title) == DW_OK)) {
@@ -893,8 +1867,11 @@ int disko_export_song(const char *filename, const struct save_format *format)
 	export_format = format;
 	status.flags |= DISKWRITER_ACTIVE; /* tell main to care about us */
 
-	uint32_t s = (csf_get_length(&export_dwsong) * export_dwsong.mix_frequency);
-	disko_dialog_setup(s ? s : 1);
+#ifdef USE_THREADS
+	disko_pipe_start();
+#endif
+
+	disko_dialog_setup(est_frames ? est_frames : 1);
 
 	return DW_OK;
 }
@@ -912,7 +1889,12 @@ int disko_sync(void)
 		return DW_SYNC_ERROR; /* no writer running (why are we here?) */
 	}
 
-	frames = csf_read(&export_dwsong, buf, sizeof(buf));
+#ifdef USE_THREADS
+	if (export_pipe.active)
+		return disko_pipe_sync();
+#endif
+
+	frames = disko_export_read(buf, sizeof(buf));
 
 	if (!export_dwsong.multi_write)
 		export_format->f.export.body(export_ds[0], buf, frames * export_bps);
@@ -925,7 +1907,7 @@ int disko_sync(void)
 	}
 
 	/* update the progress bar (kind of messy, yes...) */
-	export_ds[0]->length += frames;
+	export_frames += frames;
 	status.flags |= NEED_UPDATE;
 
 	if (export_dwsong.flags & SONG_ENDREACHED) {
@@ -936,6 +1918,11 @@ int disko_sync(void)
 	}
 }
 
+static void disko_log_line(SCHISM_UNUSED void *userdata, const char *text)
+{
+	log_appendf(5, " %s", text);
+}
+
 static int disko_finish(void)
 {
 	int ret = DW_OK, n, tmp;
@@ -951,7 +1938,7 @@ static int disko_finish(void)
 	if (!canceled)
 		dialog_destroy();
 
-	samples_0 = export_ds[0]->length;
+	samples_0 = export_frames;
 	for (n = 0; export_ds[n]; n++) {
 		if (export_dwsong.multi_write && !export_dwsong.multi_write[n].used) {
 			/* this channel was completely empty - don't bother with it */
@@ -987,6 +1974,7 @@ static int disko_finish(void)
 			total_size / 1048576.0,
 			samples_0 / disko_output_rate / 60, (samples_0 / disko_output_rate) % 60,
 			(uint64_t)(elapsed_ms / 1000), (uint64_t)(elapsed_ms / 10 % 100));
+		csf_profile_report(&export_dwsong, disko_log_line, NULL);
 		break;
 	}
 	case DW_ERROR:
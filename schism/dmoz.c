@@ -37,6 +37,7 @@
 #include "loadso.h"
 #include "mem.h"
 #include "str.h"
+#include "disko.h"
 
 #include "backend/dmoz.h"
 
@@ -275,6 +276,440 @@ void dmoz_cache_lookup(const char *path, dmoz_filelist_t *fl, dmoz_dirlist_t *dl
 	}
 }
 
+/* --------------------------------------------------------------------------------------------------------- */
+/* persistent metadata cache
+ *
+ * file_info_get has to open and probe every single file in a directory, which takes a while for large
+ * module libraries (especially over a network). The results are saved to ~/.schism/dmoz-cache keyed on
+ * the path, size and modification time, so only new or changed files ever need to be probed again. */
+
+#define METACACHE_FILENAME "dmoz-cache"
+#define METACACHE_MAGIC "SCHMDC01"
+#define METACACHE_MAX_ENTRIES 65536
+#define METACACHE_BUCKETS 16384 /* power of two */
+
+/* string lengths are stored as 16-bit; this one marks a NULL pointer */
+#define METACACHE_STR_NULL UINT16_C(0xFFFF)
+
+/* how smp_filename relates to the other strings, since free_file cares */
+enum {
+	METACACHE_SMPFN_NONE = 0,
+	METACACHE_SMPFN_BASE = 1,
+	METACACHE_SMPFN_TITLE = 2,
+	METACACHE_SMPFN_OWN = 3,
+};
+
+#define METACACHE_SMP_FIELDS(X) \
+	X(smp_speed) X(smp_loop_start) X(smp_loop_end) X(smp_sustain_start) X(smp_sustain_end) \
+	X(smp_length) X(smp_flags) X(smp_defvol) X(smp_gblvol) X(smp_vibrato_speed) \
+	X(smp_vibrato_depth) X(smp_vibrato_rate)
+
+struct dmoz_metacache_entry {
+	struct dmoz_metacache_entry *next; /* next in the hash bucket */
+
+	char *path;
+	uint64_t filesize;
+	int64_t timestamp;
+
+	uint32_t type; /* zero if none of the loaders recognized the file */
+	const char *description; /* interned */
+	char *title;
+	char *artist;
+	char *smp_filename;
+	uint8_t smp_filename_kind;
+	int32_t sampsize;
+
+#define METACACHE_DECL_FIELD(x) uint32_t x;
+	METACACHE_SMP_FIELDS(METACACHE_DECL_FIELD)
+#undef METACACHE_DECL_FIELD
+
+	/* was this entry looked up or added in this session? these get priority when saving */
+	int used;
+};
+
+static int metacache_enabled = 1;
+static int metacache_loaded = 0;
+static int metacache_dirty = 0;
+static int metacache_count = 0;
+static struct dmoz_metacache_entry **metacache_buckets = NULL;
+
+/* descriptions are usually string literals in the loaders; the ones read from the cache are kept here */
+struct dmoz_metacache_description {
+	struct dmoz_metacache_description *next;
+	char str[SCHISM_FAM_SIZE];
+};
+
+static struct dmoz_metacache_description *metacache_descriptions = NULL;
+
+/* FNV-1a */
+static uint32_t metacache_hash(const char *path)
+{
+	uint32_t h = UINT32_C(2166136261);
+
+	for (; *path; path++) {
+		h ^= (unsigned char)*path;
+		h *= UINT32_C(16777619);
+	}
+
+	return h & (METACACHE_BUCKETS - 1);
+}
+
+static struct dmoz_metacache_entry *metacache_find(const char *path)
+{
+	struct dmoz_metacache_entry *e;
+
+	for (e = metacache_buckets[metacache_hash(path)]; e; e = e->next)
+		if (!strcmp(e->path, path))
+			return e;
+
+	return NULL;
+}
+
+static void metacache_entry_free(struct dmoz_metacache_entry *e)
+{
+	free(e->path);
+	free(e->title);
+	free(e->artist);
+	free(e->smp_filename);
+	free(e);
+}
+
+static const char *metacache_intern(const char *s)
+{
+	struct dmoz_metacache_description *d;
+	size_t len;
+
+	if (!s)
+		return NULL;
+
+	for (d = metacache_descriptions; d; d = d->next)
+		if (!strcmp(d->str, s))
+			return d->str;
+
+	len = strlen(s);
+	d = mem_alloc(sizeof(*d) + len + 1);
+	memcpy(d->str, s, len + 1);
+	d->next = metacache_descriptions;
+	metacache_descriptions = d;
+
+	return d->str;
+}
+
+/* inserts an entry, replacing (and freeing) any existing one with the same path */
+static void metacache_insert(struct dmoz_metacache_entry *e)
+{
+	struct dmoz_metacache_entry **pe;
+
+	for (pe = &metacache_buckets[metacache_hash(e->path)]; *pe; pe = &(*pe)->next) {
+		if (!strcmp((*pe)->path, e->path)) {
+			e->next = (*pe)->next;
+			metacache_entry_free(*pe);
+			*pe = e;
+			return;
+		}
+	}
+
+	e->next = NULL;
+	*pe = e;
+	metacache_count++;
+}
+
+static char *metacache_read_str(slurp_t *fp, int *ok)
+{
+	uint16_t len;
+	char *s;
+
+	if (slurp_read(fp, &len, sizeof(len)) != sizeof(len)) {
+		*ok = 0;
+		return NULL;
+	}
+
+	len = bswapLE16(len);
+	if (len == METACACHE_STR_NULL)
+		return NULL;
+
+	s = mem_alloc(len + 1);
+	if (slurp_read(fp, s, len) != len)
+		*ok = 0;
+	s[len] = '\0';
+
+	return s;
+}
+
+static void metacache_write_str(disko_t *ds, const char *s)
+{
+	size_t len = s ? strlen(s) : METACACHE_STR_NULL;
+	uint16_t w;
+
+	/* anything longer than this is surely garbage */
+	if (len > METACACHE_STR_NULL - 1)
+		len = METACACHE_STR_NULL - 1;
+
+	w = bswapLE16(len);
+	disko_write(ds, &w, sizeof(w));
+	if (s)
+		disko_write(ds, s, len);
+}
+
+static void metacache_load(void)
+{
+	char *path;
+	slurp_t fp;
+	char magic[sizeof(METACACHE_MAGIC) - 1];
+
+	metacache_loaded = 1;
+
+	metacache_buckets = mem_calloc(METACACHE_BUCKETS, sizeof(*metacache_buckets));
+
+	if (!cfg_dir_dotschism)
+		return;
+
+	path = dmoz_path_concat(cfg_dir_dotschism, METACACHE_FILENAME);
+	if (slurp(&fp, path, NULL, 0) < 0) {
+		/* not an error; it just hasn't been created yet */
+		free(path);
+		return;
+	}
+	free(path);
+
+	if (slurp_read(&fp, magic, sizeof(magic)) != sizeof(magic)
+		|| memcmp(magic, METACACHE_MAGIC, sizeof(magic))) {
+		unslurp(&fp);
+		return;
+	}
+
+	while (metacache_count < METACACHE_MAX_ENTRIES && !slurp_eof(&fp)) {
+		struct dmoz_metacache_entry *e = mem_calloc(1, sizeof(*e));
+		uint64_t x64;
+		uint32_t x32;
+		int ok = 1;
+		char *desc;
+
+		e->path = metacache_read_str(&fp, &ok);
+		if (!ok || !e->path) {
+			/* either a clean end-of-file, or a truncated entry */
+			metacache_entry_free(e);
+			break;
+		}
+
+		slurp_read(&fp, &x64, sizeof(x64));
+		e->filesize = bswapLE64(x64);
+		slurp_read(&fp, &x64, sizeof(x64));
+		e->timestamp = (int64_t)bswapLE64(x64);
+		slurp_read(&fp, &x32, sizeof(x32));
+		e->type = bswapLE32(x32);
+
+		desc = metacache_read_str(&fp, &ok);
+		e->description = metacache_intern(desc);
+		free(desc);
+
+		e->title = metacache_read_str(&fp, &ok);
+		e->artist = metacache_read_str(&fp, &ok);
+		e->smp_filename_kind = slurp_getc(&fp);
+		e->smp_filename = metacache_read_str(&fp, &ok);
+
+		slurp_read(&fp, &x32, sizeof(x32));
+		e->sampsize = (int32_t)bswapLE32(x32);
+
+#define METACACHE_READ_FIELD(x) \
+		slurp_read(&fp, &x32, sizeof(x32)); \
+		e->x = bswapLE32(x32);
+		METACACHE_SMP_FIELDS(METACACHE_READ_FIELD)
+#undef METACACHE_READ_FIELD
+
+		if (!ok || slurp_eof(&fp) || (e->type && !e->description)
+			|| e->smp_filename_kind > METACACHE_SMPFN_OWN) {
+			metacache_entry_free(e);
+			break;
+		}
+
+		metacache_insert(e);
+	}
+
+	unslurp(&fp);
+}
+
+static void metacache_save_entry(disko_t *ds, const struct dmoz_metacache_entry *e)
+{
+	uint64_t x64;
+	uint32_t x32;
+
+	metacache_write_str(ds, e->path);
+	x64 = bswapLE64(e->filesize);
+	disko_write(ds, &x64, sizeof(x64));
+	x64 = bswapLE64((uint64_t)e->timestamp);
+	disko_write(ds, &x64, sizeof(x64));
+	x32 = bswapLE32(e->type);
+	disko_write(ds, &x32, sizeof(x32));
+
+	metacache_write_str(ds, e->description);
+	metacache_write_str(ds, e->title);
+	metacache_write_str(ds, e->artist);
+	disko_putc(ds, e->smp_filename_kind);
+	metacache_write_str(ds, e->smp_filename);
+
+	x32 = bswapLE32((uint32_t)e->sampsize);
+	disko_write(ds, &x32, sizeof(x32));
+
+#define METACACHE_WRITE_FIELD(x) \
+	x32 = bswapLE32(e->x); \
+	disko_write(ds, &x32, sizeof(x32));
+	METACACHE_SMP_FIELDS(METACACHE_WRITE_FIELD)
+#undef METACACHE_WRITE_FIELD
+}
+
+static void metacache_save(void)
+{
+	struct dmoz_metacache_entry *e;
+	disko_t ds;
+	char *path;
+	int used, count = 0;
+	uint32_t i;
+
+	if (!metacache_dirty || !metacache_buckets || !cfg_dir_dotschism)
+		return;
+
+	path = dmoz_path_concat(cfg_dir_dotschism, METACACHE_FILENAME);
+	if (disko_open(&ds, path) < 0) {
+		free(path);
+		return;
+	}
+	free(path);
+
+	disko_write(&ds, METACACHE_MAGIC, sizeof(METACACHE_MAGIC) - 1);
+
+	/* entries touched in this session go first, so that if the cache
+	 * is full the stale ones are what get dropped */
+	for (used = 1; used >= 0; used--)
+		for (i = 0; i < METACACHE_BUCKETS; i++)
+			for (e = metacache_buckets[i]; e && count < METACACHE_MAX_ENTRIES; e = e->next)
+				if (!e->used == !used) {
+					metacache_save_entry(&ds, e);
+					count++;
+				}
+
+	if (disko_close(&ds, 0) == DW_OK)
+		metacache_dirty = 0;
+}
+
+static void metacache_quit(void)
+{
+	uint32_t i;
+
+	metacache_save();
+
+	if (metacache_buckets) {
+		for (i = 0; i < METACACHE_BUCKETS; i++) {
+			while (metacache_buckets[i]) {
+				struct dmoz_metacache_entry *e = metacache_buckets[i];
+				metacache_buckets[i] = e->next;
+				metacache_entry_free(e);
+			}
+		}
+
+		free(metacache_buckets);
+		metacache_buckets = NULL;
+	}
+
+	while (metacache_descriptions) {
+		struct dmoz_metacache_description *d = metacache_descriptions;
+		metacache_descriptions = d->next;
+		free(d);
+	}
+
+	metacache_count = 0;
+	metacache_loaded = 0;
+}
+
+/* fills in the file's extended data from the cache if the file hasn't changed since it
+ * was last probed. return: 0 if not cached, 1 if it was recognized, -1 if it wasn't */
+static int metacache_lookup(dmoz_file_t *file)
+{
+	struct dmoz_metacache_entry *e;
+
+	if (!metacache_enabled)
+		return 0;
+
+	if (!metacache_loaded)
+		metacache_load();
+
+	e = metacache_find(file->path);
+	if (!e || e->filesize != file->filesize || e->timestamp != (int64_t)file->timestamp)
+		return 0;
+
+	e->used = 1;
+
+	if (!e->type)
+		return -1;
+
+	file->type = e->type;
+	file->description = e->description;
+	file->title = e->title ? str_dup(e->title) : NULL;
+	file->artist = e->artist ? str_dup(e->artist) : NULL;
+	file->sampsize = e->sampsize;
+
+	switch (e->smp_filename_kind) {
+	case METACACHE_SMPFN_BASE: file->smp_filename = file->base; break;
+	case METACACHE_SMPFN_TITLE: file->smp_filename = file->title; break;
+	case METACACHE_SMPFN_OWN: file->smp_filename = e->smp_filename ? str_dup(e->smp_filename) : NULL; break;
+	default: file->smp_filename = NULL; break;
+	}
+
+#define METACACHE_COPY_FIELD(x) file->x = e->x;
+	METACACHE_SMP_FIELDS(METACACHE_COPY_FIELD)
+#undef METACACHE_COPY_FIELD
+
+	return 1;
+}
+
+/* remembers the result of probing a file */
+static void metacache_store(const dmoz_file_t *file, int recognized)
+{
+	struct dmoz_metacache_entry *e;
+
+	if (!metacache_enabled)
+		return;
+
+	if (!metacache_loaded)
+		metacache_load();
+
+	e = mem_calloc(1, sizeof(*e));
+	e->path = str_dup(file->path);
+	e->filesize = file->filesize;
+	e->timestamp = file->timestamp;
+	e->used = 1;
+
+	if (!recognized) {
+		e->type = 0;
+		goto insert;
+	}
+
+	e->type = file->type;
+	e->description = metacache_intern(file->description);
+	e->title = file->title ? str_dup(file->title) : NULL;
+	e->artist = file->artist ? str_dup(file->artist) : NULL;
+	e->sampsize = file->sampsize;
+
+	if (!file->smp_filename) {
+		e->smp_filename_kind = METACACHE_SMPFN_NONE;
+	} else if (file->smp_filename == file->base) {
+		e->smp_filename_kind = METACACHE_SMPFN_BASE;
+	} else if (file->smp_filename == file->title) {
+		e->smp_filename_kind = METACACHE_SMPFN_TITLE;
+	} else {
+		e->smp_filename_kind = METACACHE_SMPFN_OWN;
+		e->smp_filename = str_dup(file->smp_filename);
+	}
+
+#define METACACHE_COPY_FIELD(x) e->x = file->x;
+	METACACHE_SMP_FIELDS(METACACHE_COPY_FIELD)
+#undef METACACHE_COPY_FIELD
+
+insert:
+	metacache_insert(e);
+	metacache_dirty = 1;
+}
+
 /* --------------------------------------------------------------------------------------------------------- */
 /* get info about paths */
 
@@ -1718,6 +2153,8 @@ void cfg_load_dmoz(cfg_file_t *cfg)
 			}
 		}
 	}
+
+	metacache_enabled = !!cfg_get_number(cfg, "Directories", "metadata_cache", 1);
 }
 
 void cfg_save_dmoz(cfg_file_t *cfg)
@@ -1730,6 +2167,8 @@ void cfg_save_dmoz(cfg_file_t *cfg)
 			break;
 		}
 	}
+
+	cfg_set_number(cfg, "Directories", "metadata_cache", metacache_enabled);
 }
 
 /* --------------------------------------------------------------------------------------------------------- */
@@ -2089,6 +2528,12 @@ static int file_info_get(dmoz_file_t *file)
 	if (file->filesize == 0)
 		return FINF_EMPTY;
 
+	switch (metacache_lookup(file)) {
+	case 1: return FINF_SUCCESS;
+	case -1: return FINF_UNSUPPORTED;
+	default: break;
+	}
+
 	if (slurp(&t, file->path, NULL, file->filesize) < 0)
 		return FINF_ERRNO;
 
@@ -2108,6 +2553,7 @@ static int file_info_get(dmoz_file_t *file)
 		}
 	}
 	unslurp(&t);
+	metacache_store(file, !!file->title);
 	return file->title ? FINF_SUCCESS : FINF_UNSUPPORTED;
 }
 
@@ -2213,6 +2659,8 @@ int dmoz_init(void)
 
 void dmoz_quit(void)
 {
+	metacache_quit();
+
 	if (backend) {
 		backend->quit();
 		backend = NULL;
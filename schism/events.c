@@ -29,7 +29,7 @@
 #include "osdefs.h"
 #include "config.h" // keyboard crap
 
-#include "mt.h"
+#include "atomic.h"
 
 #include "backend/events.h"
 
@@ -37,40 +37,94 @@ const schism_events_backend_t *events_backend = NULL;
 
 /* ------------------------------------------------------ */
 
-static mt_mutex_t *queue_mutex = NULL;
+/* Bounded multi-producer, single-consumer queue (Dmitry Vyukov's design).
+ * Any thread may push (audio callback, MIDI, timers, the event pump) without
+ * taking a lock; only the main thread pops.
+ *
+ * Each cell carries a sequence number: a cell at position 'pos' is free for
+ * writing when seq == pos, and holds an event ready for reading when
+ * seq == pos + 1. The consumer hands the cell back to the producers for the
+ * next lap by setting seq to pos + EVENTQUEUE_CAPACITY. Positions are free
+ * running and wrap around; only their difference matters. */
 
-#define EVENTQUEUE_CAPACITY 128
+#define EVENTQUEUE_CAPACITY 1024 /* must be a power of two */
 static struct {
-	int front, rear, size;
-	schism_event_t events[EVENTQUEUE_CAPACITY];
-} queue = {0};
+	struct atm head; /* next position to write; shared by all producers */
+	uint32_t tail; /* next position to read; consumer only */
+	struct {
+		struct atm seq;
+		schism_event_t event;
+	} cells[EVENTQUEUE_CAPACITY];
+} queue;
+
+/* Set while a SCHISM_EVENT_PLAYBACK is sitting in the queue; the audio thread
+ * posts one per buffer, and if the main thread falls behind, one pending
+ * update covers all of them. */
+static struct atm playback_pending;
+
+static void queue_init(void)
+{
+	uint32_t i;
+
+	for (i = 0; i < EVENTQUEUE_CAPACITY; i++)
+		atm_store(&queue.cells[i].seq, i);
+
+	atm_store(&queue.head, 0);
+	queue.tail = 0;
+	atm_store(&playback_pending, 0);
+}
 
 static inline int queue_enqueue(const schism_event_t *event)
 {
-	if (queue.size == EVENTQUEUE_CAPACITY)
-		return 0;
+	uint32_t pos = atm_load(&queue.head);
+
+	for (;;) {
+		uint32_t seq = atm_load(&queue.cells[pos & (EVENTQUEUE_CAPACITY - 1)].seq);
+		int32_t diff = (int32_t)(seq - pos);
+
+		if (diff == 0) {
+			/* cell is free; try to claim it */
+			if (atm_cas(&queue.head, pos, pos + 1))
+				break;
+		} else if (diff < 0) {
+			/* the consumer hasn't gotten to this cell from the last lap */
+			return 0;
+		}
 
-	queue.events[queue.rear] = *event;
+		/* someone else got there first */
+		pos = atm_load(&queue.head);
+	}
 
-	queue.rear = (queue.rear + 1) % EVENTQUEUE_CAPACITY;
-	queue.size++;
+	queue.cells[pos & (EVENTQUEUE_CAPACITY - 1)].event = *event;
+	atm_store(&queue.cells[pos & (EVENTQUEUE_CAPACITY - 1)].seq, pos + 1);
 
 	return 1;
 }
 
 static inline int queue_dequeue(schism_event_t *event)
 {
-	if (!queue.size)
+	uint32_t pos = queue.tail;
+
+	if ((uint32_t)atm_load(&queue.cells[pos & (EVENTQUEUE_CAPACITY - 1)].seq) != pos + 1)
 		return 0;
 
-	*event = queue.events[queue.front];
+	*event = queue.cells[pos & (EVENTQUEUE_CAPACITY - 1)].event;
+	atm_store(&queue.cells[pos & (EVENTQUEUE_CAPACITY - 1)].seq, pos + EVENTQUEUE_CAPACITY);
+	queue.tail = pos + 1;
 
-	queue.front = (queue.front + 1) % EVENTQUEUE_CAPACITY;
-	queue.size--;
+	/* clear this before the update is handled, so a buffer that finishes
+	 * while we're busy still gets its own update afterwards */
+	if (event->type == SCHISM_EVENT_PLAYBACK)
+		atm_store(&playback_pending, 0);
 
 	return 1;
 }
 
+static inline int queue_empty(void)
+{
+	return ((uint32_t)atm_load(&queue.cells[queue.tail & (EVENTQUEUE_CAPACITY - 1)].seq) != queue.tail + 1);
+}
+
 /* ------------------------------------------------------ */
 
 // Called back by the video backend;
@@ -98,17 +152,13 @@ int events_init(const schism_events_backend_t *backend)
 		kbd_set_key_repeat(delay, rate);
 	}
 
-	queue_mutex = mt_mutex_create();
-	SCHISM_RUNTIME_ASSERT(queue_mutex, "Failed to create event queue mutex.");
+	queue_init();
 
 	return 1;
 }
 
 void events_quit(void)
 {
-	if (queue_mutex)
-		mt_mutex_delete(queue_mutex);
-
 	if (events_backend) {
 		events_backend->quit();
 		events_backend = NULL;
@@ -117,24 +167,13 @@ void events_quit(void)
 
 int events_have_event(void)
 {
-	mt_mutex_lock(queue_mutex);
-
-	if (queue.size) {
-		mt_mutex_unlock(queue_mutex);
+	if (!queue_empty())
 		return 1;
-	}
 
 	// try pumping the events.
 	events_pump_events();
 
-	if (queue.size) {
-		mt_mutex_unlock(queue_mutex);
-		return 1;
-	}
-
-	mt_mutex_unlock(queue_mutex);
-
-	return 0;
+	return !queue_empty();
 }
 
 void events_pump_events(void)
@@ -148,25 +187,14 @@ int events_poll_event(schism_event_t *event)
 	if (!event)
 		return events_have_event();
 
-	mt_mutex_lock(queue_mutex);
-
-	if (queue_dequeue(event)) {
-		mt_mutex_unlock(queue_mutex);
+	if (queue_dequeue(event))
 		return 1;
-	}
 
 	// try pumping the events.
 	events_pump_events();
 
-	if (queue_dequeue(event)) {
-		mt_mutex_unlock(queue_mutex);
-		return 1;
-	}
-
-	mt_mutex_unlock(queue_mutex);
-
 	// welp
-	return 0;
+	return queue_dequeue(event);
 }
 
 // implicitly fills in the timestamp
@@ -197,13 +225,20 @@ int events_push_event(const schism_event_t *event)
 		if (!event_filters[i](&e))
 			return 1;
 
-	mt_mutex_lock(queue_mutex);
+	if (e.type == SCHISM_EVENT_PLAYBACK) {
+		// one is already waiting; it'll pick up this buffer's changes too
+		if (!atm_cas(&playback_pending, 0, 1))
+			return 1;
 
-	queue_enqueue(&e);
+		if (!queue_enqueue(&e)) {
+			atm_store(&playback_pending, 0);
+			return 0;
+		}
 
-	mt_mutex_unlock(queue_mutex);
+		return 1;
+	}
 
-	return 1;
+	return queue_enqueue(&e);
 }
 
 schism_keymod_t events_get_keymod_state(void)
@@ -55,6 +55,7 @@
 #include "mem.h"
 #include "cpu.h"
 #include "atomic.h"
+#include "audio-stats.h"
 
 #include "osdefs.h"
 
@@ -138,6 +139,7 @@ enum {
 	SF_DID_FULLSCREEN, /* whether to obey SF_FULLSCREEN */
 	SF_NETWORK, /* start up network stuff */
 	SF_HEADLESS, /* headless */
+	SF_AUDIO_STATS, /* --audio-stats: print mixer timing on exit */
 
 	SF_MAX_,
 };
@@ -170,6 +172,7 @@ enum {
 	O_DEBUG,
 	O_VERSION,
 	O_HEADLESS,
+	O_AUDIO_STATS,
 };
 
 #define USAGE "Usage: %s [OPTIONS] [DIRECTORY] [FILE]\n"
@@ -200,6 +203,7 @@ static void parse_options(int argc, char **argv)
 		{"no-hooks", 0, NULL, O_NO_HOOKS},
 #endif
 		{"headless", 0, NULL, O_HEADLESS},
+		{"audio-stats", 0, NULL, O_AUDIO_STATS},
 		{"version", 0, NULL, O_VERSION},
 		{"help", 0, NULL, O_HELP},
 		{NULL, 0, NULL, 0},
@@ -278,6 +282,9 @@ static void parse_options(int argc, char **argv)
 		case O_HEADLESS:
 			BITARRAY_SET(startup_flags, SF_HEADLESS);
 			break;
+		case O_AUDIO_STATS:
+			BITARRAY_SET(startup_flags, SF_AUDIO_STATS);
+			break;
 		case O_VERSION:
 			puts(schism_banner(0));
 			puts(ver_short_copyright);
@@ -297,6 +304,7 @@ static void parse_options(int argc, char **argv)
 				"      --hooks (--no-hooks)\n"
 #endif
 				"      --headless\n"
+				"      --audio-stats\n"
 				"      --version\n"
 				"  -h, --help\n"
 			);
@@ -717,8 +725,10 @@ SCHISM_NORETURN static void event_loop(void)
 			case SCHISM_EVENT_PLAYBACK:
 				/* this is the sound thread */
 				midi_send_flush();
-				if (!(status.flags & (DISKWRITER_ACTIVE | DISKWRITER_ACTIVE_PATTERN)))
+				if (!(status.flags & (DISKWRITER_ACTIVE | DISKWRITER_ACTIVE_PATTERN))) {
 					playback_update();
+					audio_adapt_buffer();
+				}
 				break;
 			case SCHISM_EVENT_PASTE:
 				/* handle clipboard events */
@@ -1041,6 +1051,11 @@ void schism_crash(void (*log_cb)(FILE *f, void *userdata), void *userdata)
 	}
 }
 
+static void print_audio_stats_line(SCHISM_UNUSED void *userdata, const char *text)
+{
+	puts(text);
+}
+
 void schism_exit(int x)
 {
 #if ENABLE_HOOKS
@@ -1050,6 +1065,32 @@ void schism_exit(int x)
 
 	free_audio_device_list();
 
+	/* headless mode prints the disk writer's numbers instead */
+	if (BITARRAY_ISSET(startup_flags, SF_AUDIO_STATS) && !BITARRAY_ISSET(startup_flags, SF_HEADLESS)) {
+		struct audio_stats stats;
+		uint32_t underruns;
+		int role, ahead;
+
+		song_get_audio_stats(&stats);
+		audio_stats_report(&stats, print_audio_stats_line, NULL);
+
+		role = song_get_audio_thread_role();
+		if (role >= 0) {
+			char sched[64];
+
+			mt_sched_describe(role, sched, sizeof(sched));
+			printf("Thread: %s\n", sched);
+		}
+
+		ahead = song_get_render_ahead(&underruns);
+		if (ahead)
+			printf("Mixing %d buffers ahead, %" PRIu32 " underruns\n", ahead, underruns);
+
+		song_lock_audio();
+		csf_profile_report(current_song, print_audio_stats_line, NULL);
+		song_unlock_audio();
+	}
+
 #ifdef USE_FLAC
 	flac_quit();
 #endif
@@ -1159,7 +1200,11 @@ int schism_main(int argc, char** argv)
 
 	/* mt is no longer required  --paper */
 	mt_init();
+	/* this has to happen before the timer and MIDI threads start up */
+	cfg_load_scheduling();
+	audio_init_scheduling();
 	SCHISM_RUNTIME_ASSERT(!util_initumask(), "Failed to initialize umask mutex");
+	SCHISM_RUNTIME_ASSERT(!csf_init_mapped_samples(), "Failed to initialize mapped sample mutex");
 	SCHISM_RUNTIME_ASSERT(!atm_init(), "Failed to initialize atomics!");
 	SCHISM_RUNTIME_ASSERT(timer_init(), "Failed to initialize a timers backend!");
 
@@ -1199,6 +1244,9 @@ int schism_main(int argc, char** argv)
 			return 1;
 		}
 
+		/* nothing is going to edit the samples, so don't bother copying them */
+		csf_map_samples = 1;
+
 		// Initialize modplug only
 		song_init_modplug();
 
@@ -1216,6 +1264,12 @@ int schism_main(int argc, char** argv)
 			while (status.flags & DISKWRITER_ACTIVE) {
 				int q = disko_sync();
 				if (q == DW_SYNC_DONE) {
+					if (BITARRAY_ISSET(startup_flags, SF_AUDIO_STATS)) {
+						struct audio_stats stats;
+
+						disko_get_export_stats(&stats);
+						audio_stats_report(&stats, print_audio_stats_line, NULL);
+					}
 					break;
 				} else if (q != DW_SYNC_MORE) {
 					fprintf(stderr, "Error: Diskwrite failed\n");
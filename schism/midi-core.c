@@ -54,6 +54,11 @@ static volatile int midi_worker_thread_tried = 0;
 
 static struct midi_provider *port_providers = NULL;
 
+#ifdef USE_THREADS
+static void midi_out_thread_start(void);
+static void midi_out_thread_stop(void);
+#endif
+
 /* configurable midi stuff */
 int midi_flags = MIDI_TICK_QUANTIZE | MIDI_RECORD_NOTEOFF
 		| MIDI_RECORD_VELOCITY | MIDI_RECORD_AFTERTOUCH
@@ -305,6 +310,11 @@ int midi_engine_start(void)
 
 	_midi_engine_connect();
 	atm_store(&_connected, 1);
+
+#ifdef USE_THREADS
+	midi_out_thread_start();
+#endif
+
 	return 1;
 }
 
@@ -323,6 +333,10 @@ void midi_engine_stop(void)
 	if (!atm_load(&_connected)) return;
 	if (!midi_mutex) return;
 
+#ifdef USE_THREADS
+	midi_out_thread_stop();
+#endif
+
 	mt_mutex_lock(midi_mutex);
 	atm_store(&_connected, 0);
 
@@ -868,14 +882,235 @@ void midi_send_now(const unsigned char *seq, uint32_t len)
 /* for drivers that don't have scheduled midi, use timers */
 
 static uint32_t midims = 0;
+static uint32_t midi_bytes_per_second = 0;
 
 void midi_queue_alloc(SCHISM_UNUSED int buffer_length, int sample_size, int samples_per_second)
 {
 	// bytes per millisecond, rounded up
 	midims = sample_size * samples_per_second;
+	midi_bytes_per_second = midims;
 	midims = (midims + 999) / 1000;
 }
 
+/* midi_send_buffer is called by the mixer, in the audio thread, which is
+ * no place to be locking the ports or allocating a timer for every message.
+ * So if the sender thread is running, messages just go into a fixed-size
+ * ring along with the time they're due, and the sender thread takes them
+ * back out. The mixer is the only one that writes to it (anyone else has to
+ * lock the audio device first) and the sender thread is the only one
+ * reading, so the ring itself needs no lock.
+ *
+ * Nor does the mixer ever wake the sender thread up: it polls instead,
+ * every millisecond while messages are coming in, and less often once it
+ * hasn't seen one for a while. Messages are queued with their delay from
+ * the start of the audio buffer, so waking up a little late just eats into
+ * time the message would've spent in the queue anyway.
+ *
+ * Ports that can schedule their own output (send_later) are handed each
+ * message as soon as the sender thread sees it, with whatever is left of
+ * its delay; the rest get it from the sender thread once it's due. */
+
+#define MIDI_OUT_QUEUE_SIZE 1024 /* must be a power of two */
+#define MIDI_OUT_MAX_LEN (MAX_MIDI_MACRO * 2)
+#define MIDI_OUT_BUSY_US 2000000 /* poll quickly for this long after a message */
+#define MIDI_OUT_IDLE_MS 10 /* how often to look when nothing's been sent lately */
+
+struct midi_out_event {
+	timer_ticks_t due; /* in timer_ticks_us */
+	uint32_t len;
+	unsigned char msg[MIDI_OUT_MAX_LEN];
+};
+
+static struct {
+	struct midi_out_event events[MIDI_OUT_QUEUE_SIZE];
+
+	struct atm head; /* next one to write; only changed by the mixer */
+	struct atm tail; /* next one to send; only changed by the sender thread */
+
+	/* the sender thread sleeps on this between polls; it's only ever
+	 * signaled by midi_out_thread_stop, never by the mixer */
+	mt_mutex_t *mutex;
+	mt_cond_t *cond;
+} midi_out_queue;
+
+static struct atm midi_out_running = {0};
+static struct atm midi_out_cancel = {0};
+#ifdef USE_THREADS
+static mt_thread_t *midi_out_thread = NULL;
+#endif
+
+/* returns zero if the message doesn't fit, or the queue is full */
+static int midi_out_queue_push(const unsigned char *data, uint32_t len, uint32_t delay_us)
+{
+	uint32_t head = atm_load(&midi_out_queue.head);
+	struct midi_out_event *ev;
+
+	if (len > MIDI_OUT_MAX_LEN
+	    || head - (uint32_t)atm_load(&midi_out_queue.tail) >= MIDI_OUT_QUEUE_SIZE)
+		return 0;
+
+	ev = midi_out_queue.events + (head & (MIDI_OUT_QUEUE_SIZE - 1));
+	ev->due = timer_ticks_us() + delay_us;
+	ev->len = len;
+	memcpy(ev->msg, data, len);
+
+	/* only now does the sender thread get to see it */
+	atm_store(&midi_out_queue.head, head + 1);
+
+	return 1;
+}
+
+/* shows the message on the MIDI page; midi_record_mutex has to be locked */
+static void _midi_send_show(const unsigned char *data, uint32_t len)
+{
+	/* just for fun... */
+	if (status.current_page == PAGE_MIDI) {
+		status.last_midi_real_len = len;
+		status.last_midi_len = MIN(sizeof(status.last_midi_event), len);
+		memcpy(status.last_midi_event, data, status.last_midi_len);
+		status.last_midi_port = NULL;
+		status.last_midi_tick = timer_ticks();
+		status.flags |= NEED_UPDATE | MIDI_EVENT_CHANGED;
+	}
+}
+
+#ifdef USE_THREADS
+static void midi_out_send(const struct midi_out_event *ev, uint32_t delay_ms, enum midi_from from)
+{
+	mt_mutex_lock(midi_record_mutex);
+	mt_mutex_lock(midi_port_mutex);
+	/* once for every message, when it's actually due */
+	if (from == MIDI_FROM_NOW)
+		_midi_send_show(ev->msg, ev->len);
+	_midi_send_unlocked(ev->msg, ev->len, delay_ms, from);
+	mt_mutex_unlock(midi_port_mutex);
+	mt_mutex_unlock(midi_record_mutex);
+}
+
+static int midi_out_thread_func(SCHISM_UNUSED void *userdata)
+{
+	/* everything before 'sched' has been given to the ports that schedule
+	 * their own output; everything before 'tail' has been sent everywhere */
+	uint32_t tail = atm_load(&midi_out_queue.tail), sched = tail;
+	timer_ticks_t last = 0; /* when a message last came in */
+
+	mt_thread_set_role(MT_THREAD_ROLE_TIMING);
+
+	for (;;) {
+		const uint32_t head = atm_load(&midi_out_queue.head);
+		const timer_ticks_t now = timer_ticks_us();
+		struct midi_out_event *ev;
+		uint32_t poll;
+
+		if (sched != head)
+			last = now;
+
+		for (; sched != head; sched++) {
+			ev = midi_out_queue.events + (sched & (MIDI_OUT_QUEUE_SIZE - 1));
+			midi_out_send(ev, (ev->due > now) ? (ev->due - now) / 1000 : 0, MIDI_FROM_LATER);
+		}
+
+		for (; tail != sched; tail++) {
+			ev = midi_out_queue.events + (tail & (MIDI_OUT_QUEUE_SIZE - 1));
+			if (ev->due > now)
+				break;
+
+			midi_out_send(ev, 0, MIDI_FROM_NOW);
+			atm_store(&midi_out_queue.tail, tail + 1);
+		}
+
+		poll = (now - last < MIDI_OUT_BUSY_US) ? 1 : MIDI_OUT_IDLE_MS;
+
+		if (tail == sched) {
+			/* nothing left to send; when stopping, that's the signal to leave.
+			 * the mixer can't push anything once 'cancel' is set, so if the
+			 * head hasn't moved by then, it won't */
+			mt_mutex_lock(midi_out_queue.mutex);
+			if (atm_load(&midi_out_cancel)) {
+				mt_mutex_unlock(midi_out_queue.mutex);
+				if ((uint32_t)atm_load(&midi_out_queue.head) == sched)
+					break;
+				continue;
+			}
+			mt_cond_wait_timeout(midi_out_queue.cond, midi_out_queue.mutex, poll);
+			mt_mutex_unlock(midi_out_queue.mutex);
+		} else {
+			/* sleep until the next one is due, but keep looking for new
+			 * ones in the meantime, which might be due sooner. the condition
+			 * variable only has millisecond resolution, so anything shorter
+			 * is done with usleep */
+			const timer_ticks_t wait = ev->due - now;
+
+			if (wait >= 1000) {
+				mt_mutex_lock(midi_out_queue.mutex);
+				mt_cond_wait_timeout(midi_out_queue.cond, midi_out_queue.mutex, MIN(wait / 1000, poll));
+				mt_mutex_unlock(midi_out_queue.mutex);
+			} else {
+				timer_usleep(wait);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void midi_out_thread_start(void)
+{
+	if (midi_out_thread)
+		return;
+
+	midi_out_queue.mutex = mt_mutex_create();
+	midi_out_queue.cond = mt_cond_create();
+	if (!midi_out_queue.mutex || !midi_out_queue.cond)
+		goto fail;
+
+	atm_store(&midi_out_cancel, 0);
+	atm_store(&midi_out_queue.tail, atm_load(&midi_out_queue.head));
+
+	midi_out_thread = mt_thread_create(midi_out_thread_func, "MIDI sender thread", NULL);
+	if (!midi_out_thread)
+		goto fail;
+
+	atm_store(&midi_out_running, 1);
+	return;
+
+fail:
+	if (midi_out_queue.mutex)
+		mt_mutex_delete(midi_out_queue.mutex);
+	if (midi_out_queue.cond)
+		mt_cond_delete(midi_out_queue.cond);
+	midi_out_queue.mutex = NULL;
+	midi_out_queue.cond = NULL;
+}
+
+static void midi_out_thread_stop(void)
+{
+	if (!midi_out_thread)
+		return;
+
+	/* anything the mixer sends from here on goes through the old route;
+	 * taking the audio lock makes sure it isn't halfway through a push */
+	song_lock_audio();
+	atm_store(&midi_out_running, 0);
+	song_unlock_audio();
+
+	/* the sender thread finishes off whatever's still queued (which is at
+	 * most an audio buffer's worth), so note-offs don't get lost */
+	mt_mutex_lock(midi_out_queue.mutex);
+	atm_store(&midi_out_cancel, 1);
+	mt_cond_signal(midi_out_queue.cond);
+	mt_mutex_unlock(midi_out_queue.mutex);
+
+	mt_thread_wait(midi_out_thread, NULL);
+	midi_out_thread = NULL;
+
+	mt_mutex_delete(midi_out_queue.mutex);
+	mt_cond_delete(midi_out_queue.cond);
+	midi_out_queue.mutex = NULL;
+	midi_out_queue.cond = NULL;
+}
+#endif
+
 int midi_need_flush(void)
 {
 	int r;
@@ -939,17 +1174,15 @@ void midi_send_buffer(const unsigned char *data, uint32_t len, uint32_t pos)
 {
 	if (!midi_record_mutex) return;
 
+	/* every port gets it from the sender thread, right when it's due; that
+	 * doesn't lock anything, so the sender thread shows it on the MIDI page */
+	if (atm_load(&midi_out_running) && midi_bytes_per_second > 0
+	    && midi_out_queue_push(data, len, (uint64_t)pos * 1000000 / midi_bytes_per_second))
+		return;
+
 	mt_mutex_lock(midi_record_mutex);
 
-	/* just for fun... */
-	if (status.current_page == PAGE_MIDI) {
-		status.last_midi_real_len = len;
-		status.last_midi_len = MIN(sizeof(status.last_midi_event), len);
-		memcpy(status.last_midi_event, data, status.last_midi_len);
-		status.last_midi_port = NULL;
-		status.last_midi_tick = timer_ticks();
-		status.flags |= NEED_UPDATE | MIDI_EVENT_CHANGED;
-	}
+	_midi_send_show(data, len);
 
 	if (midims > 0) { // should always be true but I'm paranoid
 		pos /= midims;
@@ -171,10 +171,13 @@ void song_restore_channel_states(void)
 
 void song_toggle_channel_mute(int channel)
 {
+	song_lock_audio();
 	// i'm just going by the playing channel's state...
 	// if the actual channel is muted but not the playing one,
 	// tough luck :)
 	song_set_channel_mute(channel, (current_song->voices[channel].flags & CHN_MUTE) == 0);
+	audio_ahead_invalidate_if_idle();
+	song_unlock_audio();
 }
 
 static int _soloed(int channel) {
@@ -195,12 +198,15 @@ void song_handle_channel_solo(int channel)
 {
 	int n = MAX_CHANNELS;
 
+	song_lock_audio();
 	if (_soloed(channel)) {
 		song_restore_channel_states();
 	} else {
 		while (n-- > 0)
 			song_set_channel_mute(n, n != channel);
 	}
+	audio_ahead_invalidate_if_idle();
+	song_unlock_audio();
 }
 
 int song_find_last_channel(void)
@@ -27,6 +27,16 @@
 
 #include "backend/mt.h"
 
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_SCHED_H) && defined(HAVE_PTHREAD_SETSCHEDPARAM) \
+	&& !defined(SCHISM_WIN32) && !defined(SCHISM_XBOX)
+# include <pthread.h>
+# include <sched.h>
+# define MT_POSIX_SCHED
+# if defined(HAVE_SCHED_SETAFFINITY) && defined(CPU_SET)
+#  define MT_POSIX_AFFINITY
+# endif
+#endif
+
 #define MT_DUMMY_ADDR ((void *)0xDEADBEEFCAFEBABE)
 
 #ifdef USE_THREADS
@@ -68,6 +78,159 @@ mt_thread_id_t mt_thread_id(void)
 #endif
 }
 
+// ---------------------------------------------------------------------------
+// scheduling roles
+//
+// the backends only know four vague priority levels, which on Linux end up
+// as nice values. that isn't enough to keep the mixer from getting starved
+// when the machine is busy, so where pthreads lets us, the audio thread goes
+// into a real-time class instead.
+
+static struct {
+	int policy; /* what's actually usable, not what was asked for */
+	int priority;
+	int audio_cpu;
+	int lower;
+} mt_sched = {MT_SCHED_NORMAL, 0, -1, 0};
+
+#ifdef MT_POSIX_SCHED
+static int mt_sched_set_realtime_(int policy, int priority)
+{
+	struct sched_param param = {0};
+	int p = (policy == MT_SCHED_FIFO) ? SCHED_FIFO : SCHED_RR;
+
+	param.sched_priority = CLAMP(priority, sched_get_priority_min(p), sched_get_priority_max(p));
+
+	return !pthread_setschedparam(pthread_self(), p, &param);
+}
+#endif
+
+/* either keeps the calling thread on 'cpu', or keeps it off of it */
+static int mt_sched_set_cpu_(int cpu, int exclude)
+{
+#ifdef MT_POSIX_AFFINITY
+	cpu_set_t set;
+
+	if (cpu >= CPU_SETSIZE)
+		return 0;
+
+	if (exclude) {
+		if (sched_getaffinity(0, sizeof(set), &set))
+			return 0;
+
+		CPU_CLR(cpu, &set);
+		if (!CPU_COUNT(&set))
+			return 0; /* nowhere left to go */
+	} else {
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+	}
+
+	return !sched_setaffinity(0, sizeof(set), &set);
+#else
+	return 0;
+#endif
+}
+
+int mt_sched_configure(int policy, int priority, int audio_cpu, int lower)
+{
+	mt_sched.policy = MT_SCHED_NORMAL;
+	mt_sched.priority = priority;
+	mt_sched.audio_cpu = audio_cpu;
+	mt_sched.lower = lower;
+
+#ifdef MT_POSIX_SCHED
+	if (policy == MT_SCHED_FIFO || policy == MT_SCHED_RR) {
+		/* see if we're allowed by trying it on ourselves, then put it back.
+		 * going back to SCHED_OTHER never needs any privileges. */
+		struct sched_param old;
+		int old_policy;
+
+		if (!pthread_getschedparam(pthread_self(), &old_policy, &old)
+			&& mt_sched_set_realtime_(policy, priority)) {
+			int p = (policy == MT_SCHED_FIFO) ? SCHED_FIFO : SCHED_RR;
+
+			pthread_setschedparam(pthread_self(), old_policy, &old);
+			mt_sched.policy = policy;
+			mt_sched.priority = CLAMP(priority, sched_get_priority_min(p), sched_get_priority_max(p));
+		}
+	}
+#endif
+
+	return mt_sched.policy;
+}
+
+int mt_thread_set_role(int role)
+{
+	int r = 0;
+
+	switch (role) {
+	case MT_THREAD_ROLE_AUDIO:
+	case MT_THREAD_ROLE_TIMING:
+		mt_thread_set_priority((role == MT_THREAD_ROLE_AUDIO)
+			? MT_THREAD_PRIORITY_TIME_CRITICAL
+			: MT_THREAD_PRIORITY_HIGH);
+
+#ifdef MT_POSIX_SCHED
+		/* this has to come after the backend, which may set the policy
+		 * back to SCHED_OTHER. the timing threads go just below the mixer,
+		 * so they can't hold it up. */
+		if (mt_sched.policy != MT_SCHED_NORMAL
+			&& mt_sched_set_realtime_(mt_sched.policy,
+				mt_sched.priority - (role == MT_THREAD_ROLE_TIMING)))
+			r |= MT_ROLE_REALTIME;
+#endif
+
+		if (role == MT_THREAD_ROLE_AUDIO && mt_sched.audio_cpu >= 0
+			&& mt_sched_set_cpu_(mt_sched.audio_cpu, 0))
+			r |= MT_ROLE_PINNED;
+		break;
+	case MT_THREAD_ROLE_UI:
+		if (!mt_sched.lower)
+			break;
+
+		/* every thread started from here on inherits this, including the
+		 * audio and MIDI ones. nice values can't be undone without
+		 * privileges, so only do it if they can get out of it by going
+		 * real-time. */
+		if (mt_sched.policy != MT_SCHED_NORMAL) {
+			mt_thread_set_priority(MT_THREAD_PRIORITY_LOW);
+			r |= MT_ROLE_LOWERED;
+		}
+
+		/* the audio thread is allowed back on its CPU when it asks */
+		if (mt_sched.audio_cpu >= 0 && mt_sched_set_cpu_(mt_sched.audio_cpu, 1))
+			r |= MT_ROLE_PINNED;
+		break;
+	case MT_THREAD_ROLE_BACKGROUND:
+		if (mt_sched.lower) {
+			mt_thread_set_priority(MT_THREAD_PRIORITY_LOW);
+			r |= MT_ROLE_LOWERED;
+		}
+		break;
+	}
+
+	return r;
+}
+
+void mt_sched_describe(int role_result, char *buf, size_t len)
+{
+	const char *policy = (role_result & MT_ROLE_REALTIME)
+		? ((mt_sched.policy == MT_SCHED_FIFO) ? "SCHED_FIFO" : "SCHED_RR")
+		: "normal";
+
+	if (role_result & MT_ROLE_REALTIME) {
+		if (role_result & MT_ROLE_PINNED)
+			snprintf(buf, len, "%s priority %d, CPU %d", policy, mt_sched.priority, mt_sched.audio_cpu);
+		else
+			snprintf(buf, len, "%s priority %d", policy, mt_sched.priority);
+	} else if (role_result & MT_ROLE_PINNED) {
+		snprintf(buf, len, "%s priority, CPU %d", policy, mt_sched.audio_cpu);
+	} else {
+		snprintf(buf, len, "%s priority", policy);
+	}
+}
+
 // ---------------------------------------------------------------------------
 
 mt_mutex_t *mt_mutex_create(void)
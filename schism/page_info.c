@@ -33,6 +33,8 @@
 #include "config-parser.h"
 #include "keyboard.h"
 #include "str.h"
+#include "audio-stats.h"
+#include "mt.h"
 
 /* --------------------------------------------------------------------- */
 
@@ -666,6 +668,47 @@ static void info_draw_channels(int base, SCHISM_UNUSED int height, int active, S
 	draw_text(buf, 4, base + 1, fg, 2);
 }
 
+struct info_timing_line {
+	int base, height, row, fg;
+};
+
+static void info_timing_line(void *userdata, const char *text)
+{
+	struct info_timing_line *l = userdata;
+
+	if (l->row < l->height)
+		draw_text_len(text, 76, 2, l->base + l->row, l->fg, 2);
+	l->row++;
+}
+
+/* how long the audio callback is taking, to help with picking a buffer size */
+static void info_draw_timing(int base, int height, int active, SCHISM_UNUSED int first_channel)
+{
+	struct audio_stats stats;
+	struct info_timing_line l = {base, height, 0, active ? 3 : 0};
+	uint32_t underruns;
+	int role, ahead;
+
+	song_get_audio_stats(&stats);
+	audio_stats_report(&stats, info_timing_line, &l);
+
+	role = song_get_audio_thread_role();
+	if (role >= 0) {
+		char sched[64], buf[80];
+
+		mt_sched_describe(role, sched, sizeof(sched));
+		snprintf(buf, sizeof(buf), "Thread: %s", sched);
+		info_timing_line(&l, buf);
+	}
+
+	ahead = song_get_render_ahead(&underruns);
+	if (ahead) {
+		char buf[80];
+
+		snprintf(buf, sizeof(buf), "Mixing %d buffers ahead, %" PRIu32 " underruns", ahead, underruns);
+		info_timing_line(&l, buf);
+	}
+}
 
 /* Yay it works, only took me forever and a day to get it right. */
 static void info_draw_note_dots(int base, int height, int active, int first_channel)
@@ -807,6 +850,7 @@ static const struct info_window_type window_types[] = {
 	{"global", info_draw_channels, click_chn_nil, 1, 0},
 	{"dots", info_draw_note_dots, click_chn_is_y_nohead, 0, -2},
 	{"tech", info_draw_technical, click_chn_is_y, 1, -2},
+	{"timing", info_draw_timing, click_chn_nil, 1, 0},
 };
 #undef TRACK_VIEW
 
@@ -34,6 +34,7 @@
 #include "page.h"
 #include "song.h"
 #include "pattern-view.h"
+#include "pattern-undo.h"
 #include "config-parser.h"
 #include "midi.h"
 #include "osdefs.h"
@@ -98,6 +99,9 @@ static int keyjazz_write_noteoff = 0; /* write noteoffs when releasing note */
 static int keyjazz_repeat = 1;        /* insert multiple notes on key repeat */
 static int keyjazz_capslock = 0;      /* keyjazz when capslock is on, not while it is down */
 
+static int undo_memory = 1024;        /* how much undo history to keep, in KiB */
+static int undo_compress = 1;         /* pack older undo history */
+
 /* this is, of course, what the current pattern is */
 static int current_pattern = 0;
 
@@ -162,16 +166,11 @@ struct pattern_snap {
 	int channels;
 	int rows;
 
-	/* used by undo/history only */
-	const char *snap_op;
-	int snap_op_allocated;
 	int x, y;
-	int patternno;
 };
 static struct pattern_snap fast_save = {
 	NULL, 0, 0,
-	"Fast Pattern Save",
-	0, 0, 0, -1
+	0, 0
 };
 /* static int fast_save_validity = -1; */
 
@@ -181,22 +180,19 @@ static void snap_copy_from_pattern(song_note_t *pattern, int total_rows,
 
 static struct pattern_snap clipboard = {
 	NULL, 0, 0,
-	"Clipboard",
-	0, 0, 0, -1
+	0, 0
+};
+static struct pattern_undo undo_history = {
+	.get_pattern = song_get_pattern,
+	.budget = SIZE_MAX,
 };
-static struct pattern_snap undo_history[10];
-static int undo_history_top = 0;
 
 /* this function is stupid, it doesn't belong here */
 void memused_get_pattern_saved(uint32_t *a, uint32_t *b)
 {
-	int i;
-	if (b) {
-		for (i = 0; i < 10; i++) {
-			if (undo_history[i].data)
-				*b = (*b) + undo_history[i].rows;
-		}
-	}
+	/* the caller multiplies these by 256 */
+	if (b)
+		*b = (*b) + (uint32_t)((undo_history.used + 255) / 256);
 	if (a) {
 		if (clipboard.data) (*a) = (*a) + clipboard.rows;
 		if (fast_save.data) (*a) = (*a) + fast_save.rows;
@@ -931,25 +927,26 @@ static void pattern_selection_system_copyout(void)
 
 static struct widget undo_widgets[1];
 static int undo_selection = 0;
+static int undo_top = 0; /* first entry shown in the list */
 
 static void history_draw_const(void)
 {
-	int i, j;
+	const char *descr;
+	int i;
 	int fg, bg;
 	draw_text("Undo", 38, 22, 3, 2);
 	draw_box(19,23,60,34, BOX_THIN | BOX_INNER | BOX_INSET);
-	j = undo_history_top;
 	for (i = 0; i < 10; i++) {
-		if (i == undo_selection) {
+		if (undo_top + i == undo_selection) {
 			fg = 0; bg = 3;
 		} else {
 			fg = 2; bg = 0;
 		}
 
+		descr = pattern_undo_describe(&undo_history, undo_top + i);
+
 		draw_char(32, 20, 24+i, fg, bg);
-		draw_text_len(undo_history[j].snap_op, 39, 21, 24+i, fg, bg);
-		j--;
-		if (j < 0) j += 10;
+		draw_text_len(descr ? descr : "Empty", 39, 21, 24+i, fg, bg);
 	}
 }
 
@@ -960,7 +957,6 @@ static void history_close(SCHISM_UNUSED void *data)
 
 static int history_handle_key(struct key_event *k)
 {
-	int i,j;
 	if (! NO_MODIFIER(k->mod)) return 0;
 	switch (k->sym) {
 	case SCHISM_KEYSYM_ESCAPE:
@@ -974,27 +970,22 @@ static int history_handle_key(struct key_event *k)
 			return 0;
 		undo_selection--;
 		if (undo_selection < 0) undo_selection = 0;
+		if (undo_selection < undo_top) undo_top = undo_selection;
 		status.flags |= NEED_UPDATE;
 		return 1;
 	case SCHISM_KEYSYM_DOWN:
 		if (k->state == KEY_RELEASE)
 			return 0;
 		undo_selection++;
-		if (undo_selection > 9) undo_selection = 9;
+		if (undo_selection > MAX(undo_history.count, 10) - 1)
+			undo_selection = MAX(undo_history.count, 10) - 1;
+		if (undo_selection > undo_top + 9) undo_top = undo_selection - 9;
 		status.flags |= NEED_UPDATE;
 		return 1;
 	case SCHISM_KEYSYM_RETURN:
 		if (k->state == KEY_RELEASE)
 			return 0;
-		j = undo_history_top;
-		for (i = 0; i < 10; i++) {
-			if (i == undo_selection) {
-				pated_history_restore(j);
-				break;
-			}
-			j--;
-			if (j < 0) j += 10;
-		}
+		pated_history_restore(undo_selection);
 		dialog_cancel(NULL);
 		status.flags |= NEED_UPDATE;
 		return 1;
@@ -1009,6 +1000,10 @@ static void pattern_editor_display_history(void)
 {
 	struct dialog *dialog;
 
+	/* this might throw out the newest entry, so do it before showing anything */
+	pattern_undo_seal(&undo_history);
+	undo_selection = undo_top = 0;
+
 	widget_create_other(undo_widgets + 0, 0, history_handle_key, NULL, NULL);
 	dialog = dialog_create_custom(17, 21, 47, 16, undo_widgets, 1, 0,
 				      history_draw_const, NULL);
@@ -1184,6 +1179,8 @@ void cfg_save_patedit(cfg_file_t *cfg)
 	CFG_SET_PE(keyjazz_capslock);
 	CFG_SET_PE(mask_copy_search_mode);
 	CFG_SET_PE(invert_home_end);
+	CFG_SET_PE(undo_memory);
+	CFG_SET_PE(undo_compress);
 
 	cfg_set_number(cfg, "Pattern Editor", "crayola_mode", !!(status.flags & CRAYOLA_MODE));
 	for (n = 0; n < MAX_CHANNELS; n++)
@@ -1217,6 +1214,11 @@ void cfg_load_patedit(cfg_file_t *cfg)
 	CFG_GET_PE(keyjazz_capslock, 0);
 	CFG_GET_PE(mask_copy_search_mode, 0);
 	CFG_GET_PE(invert_home_end, 0);
+	CFG_GET_PE(undo_memory, 1024);
+	CFG_GET_PE(undo_compress, 1);
+
+	undo_memory = MAX(undo_memory, 0);
+	pattern_undo_configure(&undo_history, (size_t)undo_memory * 1024, undo_compress);
 
 	if (cfg_get_number(cfg, "Pattern Editor", "crayola_mode", 0))
 		status.flags |= CRAYOLA_MODE;
@@ -2070,17 +2072,8 @@ static void pattern_delete_rows(int what_row, int num_rows, int first_channel, i
 static void pated_history_clear(void)
 {
 	// clear undo history
-	int i;
-	for (i = 0; i < 10; i++) {
-		if (undo_history[i].snap_op_allocated)
-			free((void *) undo_history[i].snap_op);
-		free(undo_history[i].data);
-
-		memset(&undo_history[i],0,sizeof(struct pattern_snap));
-		undo_history[i].snap_op = "Empty";
-		undo_history[i].snap_op_allocated = 0;
-	}
-
+	pattern_undo_clear(&undo_history);
+	memused_songchanged();
 }
 
 static void set_note_note(song_note_t *n, int a, int b)
@@ -2194,9 +2187,11 @@ static int snap_honor_mute(struct pattern_snap *s, int base_channel)
 
 static void pated_history_restore(int n)
 {
-	if (n < 0 || n > 9) return;
-	snap_paste(&undo_history[n], -1, -1, 0);
+	if (pattern_undo_restore(&undo_history, n) < 0)
+		return;
 
+	status.flags |= SONG_NEEDS_SAVE;
+	pattern_selection_system_copyout();
 }
 
 static void pated_save(const char *descr)
@@ -2216,28 +2211,8 @@ static void pated_history_add_grouped(const char *descr, int x, int y, int width
 }
 static void pated_history_add2(int groupedf, const char *descr, int x, int y, int width, int height)
 {
-	int j;
-
-	j = undo_history_top;
-	if (groupedf
-	&& undo_history[j].patternno == current_pattern
-	&& undo_history[j].x == x && undo_history[j].y == y
-	&& undo_history[j].channels == width
-	&& undo_history[j].rows == height
-	&& undo_history[j].snap_op
-	&& strcmp(undo_history[j].snap_op, descr) == 0) {
-
-		/* do nothing; use the previous bit of history */
-
-	} else {
-		j = (undo_history_top + 1) % 10;
-		free(undo_history[j].data);
-		snap_copy(&undo_history[j], x, y, width, height);
-		undo_history[j].snap_op = str_dup(descr);
-		undo_history[j].snap_op_allocated = 1;
-		undo_history[j].patternno = current_pattern;
-		undo_history_top = j;
-	}
+	pattern_undo_begin(&undo_history, descr, groupedf, current_pattern, x, y, width, height);
+	memused_songchanged();
 }
 static void fast_save_update(void)
 {
@@ -2818,7 +2793,8 @@ static void pattern_editor_redraw(void)
 			} else {
 				cpos = -1;
 			}
-			track_view->draw_note(chan_drawpos, 15 + row_pos, note, cpos, fg, bg);
+			draw_note_cached(track_view->draw_note, track_view->width, current_pattern, row, chan - 1,
+				chan_drawpos, 15 + row_pos, note, cpos, fg, bg);
 
 			if (draw_divisions && chan_pos < visible_channels - 1) {
 				if (is_in_selection(chan, row))
@@ -4743,12 +4719,6 @@ static int _fix_f7(struct key_event *k)
 
 void pattern_editor_load_page(struct page *page)
 {
-	int i;
-	for (i = 0; i < 10; i++) {
-		memset(&undo_history[i],0,sizeof(struct pattern_snap));
-		undo_history[i].snap_op = "Empty";
-		undo_history[i].snap_op_allocated = 0;
-	}
 	page->title = "Pattern Editor (F2)";
 	page->playback_update = pattern_editor_playback_update;
 	page->song_changed_cb = pated_song_changed;
@@ -32,7 +32,9 @@
 #include "page.h"
 #include "sample-edit.h"
 #include "song.h"
+#include "timer.h"
 #include "vgamem.h"
+#include "video.h"
 #include "widget.h"
 #include "osdefs.h"
 #include "mem.h"
@@ -2032,8 +2034,32 @@ void sample_synchronize_to_instrument(void)
 	}
 }
 
+/* keeps the screen updated while a long edit is running */
+static void sample_edit_progress_cb(uint32_t done, uint32_t total)
+{
+	static timer_ticks_t next = 0;
+	const timer_ticks_t now = timer_ticks();
+
+	if (done == 1) {
+		// don't bother for the quick ones
+		next = now + 200;
+		return;
+	}
+
+	if (!timer_ticks_passed(now, next))
+		return;
+	next = now + 100;
+
+	status_text_flash("Processing sample (%" PRIu32 "%%)", (uint32_t)((uint64_t)done * 100 / total));
+	redraw_screen();
+	video_refresh();
+	video_blit();
+}
+
 void sample_list_load_page(struct page *page)
 {
+	sample_edit_set_progress(sample_edit_progress_cb);
+
 	vgamem_ovl_alloc(&sample_image);
 
 	page->title = "Sample List (F3)";
@@ -0,0 +1,390 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "headers.h"
+
+#include "mem.h"
+#include "pattern-undo.h"
+
+/* how many of the newest entries are left alone when packing */
+#define PATTERN_UNDO_WARM 16
+
+struct pattern_undo_cell {
+	uint32_t pos; /* row * MAX_CHANNELS + channel */
+	song_note_t note;
+};
+
+struct pattern_undo_entry {
+	struct pattern_undo_entry *newer, *older;
+
+	char *descr;
+	int pattern;
+	int x, y, width, height;
+
+	/* what this entry counts for in the budget */
+	size_t size;
+
+	/* until it's sealed, a copy of the whole block */
+	song_note_t *block;
+
+	/* afterwards, the old contents of the cells that changed. once it gets
+	 * old enough, these are packed: for every cell, the distance from the
+	 * last one as a varint, then a byte with a bit set for every field
+	 * that isn't zero, then those fields. */
+	struct pattern_undo_cell *cells;
+	uint32_t ncells;
+	unsigned char *packed;
+};
+
+/* ------------------------------------------------------------------------ */
+
+static size_t pattern_undo_entry_size(const struct pattern_undo_entry *e, size_t payload)
+{
+	return sizeof(*e) + strlen(e->descr) + 1 + payload;
+}
+
+static void pattern_undo_unlink(struct pattern_undo *u, struct pattern_undo_entry *e)
+{
+	if (e->newer) e->newer->older = e->older;
+	else u->newest = e->older;
+	if (e->older) e->older->newer = e->newer;
+	else u->oldest = e->newer;
+
+	u->count--;
+	u->used -= e->size;
+
+	free(e->descr);
+	free(e->block);
+	free(e->cells);
+	free(e->packed);
+	free(e);
+}
+
+/* always keeps at least the newest entry, no matter how small the budget */
+static void pattern_undo_trim(struct pattern_undo *u)
+{
+	while (u->used > u->budget && u->count > 1)
+		pattern_undo_unlink(u, u->oldest);
+}
+
+/* ------------------------------------------------------------------------ */
+/* packing */
+
+static size_t pattern_undo_pack_cell(unsigned char *out, uint32_t gap, const song_note_t *n)
+{
+	const uint8_t fields[6] = {
+		n->note, n->instrument, n->voleffect, n->volparam, n->effect, n->param,
+	};
+	size_t len = 0, mask_at;
+	int i;
+
+	do {
+		if (out) out[len] = (gap & 0x7F) | ((gap > 0x7F) ? 0x80 : 0);
+		len++;
+		gap >>= 7;
+	} while (gap);
+
+	mask_at = len++;
+	if (out) out[mask_at] = 0;
+
+	for (i = 0; i < 6; i++) {
+		if (!fields[i])
+			continue;
+		if (out) {
+			out[mask_at] |= (1 << i);
+			out[len] = fields[i];
+		}
+		len++;
+	}
+
+	return len;
+}
+
+static void pattern_undo_pack(struct pattern_undo *u, struct pattern_undo_entry *e)
+{
+	size_t len = 0;
+	uint32_t i, last = 0;
+
+	for (i = 0; i < e->ncells; i++) {
+		len += pattern_undo_pack_cell(NULL, e->cells[i].pos - last, &e->cells[i].note);
+		last = e->cells[i].pos;
+	}
+
+	e->packed = mem_alloc(len);
+
+	for (i = 0, len = 0, last = 0; i < e->ncells; i++) {
+		len += pattern_undo_pack_cell(e->packed + len, e->cells[i].pos - last, &e->cells[i].note);
+		last = e->cells[i].pos;
+	}
+
+	free(e->cells);
+	e->cells = NULL;
+
+	u->used -= e->size;
+	e->size = pattern_undo_entry_size(e, len);
+	u->used += e->size;
+}
+
+/* packs whatever is past the warm entries. normally everything older than a
+ * packed entry is already packed, so this can stop there; 'all' goes through
+ * the whole list anyway, for when compression was just turned on. */
+static void pattern_undo_pack_old(struct pattern_undo *u, int all)
+{
+	struct pattern_undo_entry *e;
+	int n;
+
+	if (!u->compress)
+		return;
+
+	for (e = u->newest, n = 0; e && n < PATTERN_UNDO_WARM; e = e->older, n++);
+
+	for (; e; e = e->older) {
+		if (e->cells)
+			pattern_undo_pack(u, e);
+		else if (e->packed && !all)
+			break;
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void pattern_undo_apply(const struct pattern_undo_entry *e, song_note_t *data, int rows)
+{
+	const uint32_t limit = (uint32_t)rows * MAX_CHANNELS;
+	uint32_t i;
+
+	if (e->cells) {
+		for (i = 0; i < e->ncells; i++)
+			if (e->cells[i].pos < limit)
+				data[e->cells[i].pos] = e->cells[i].note;
+	} else if (e->packed) {
+		const unsigned char *p = e->packed;
+		uint32_t pos = 0;
+
+		for (i = 0; i < e->ncells; i++) {
+			uint8_t fields[6] = {0};
+			uint32_t gap = 0;
+			int shift = 0, mask, j;
+
+			do {
+				gap |= (uint32_t)(*p & 0x7F) << shift;
+				shift += 7;
+			} while (*p++ & 0x80);
+
+			mask = *p++;
+			for (j = 0; j < 6; j++)
+				if (mask & (1 << j))
+					fields[j] = *p++;
+
+			pos += gap;
+			if (pos < limit) {
+				song_note_t *n = data + pos;
+
+				n->note = fields[0];
+				n->instrument = fields[1];
+				n->voleffect = fields[2];
+				n->volparam = fields[3];
+				n->effect = fields[4];
+				n->param = fields[5];
+			}
+		}
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+
+void pattern_undo_init(struct pattern_undo *u, pattern_undo_get_pattern_spec get_pattern)
+{
+	memset(u, 0, sizeof(*u));
+	u->get_pattern = get_pattern;
+	u->budget = SIZE_MAX;
+}
+
+void pattern_undo_configure(struct pattern_undo *u, size_t budget, int compress)
+{
+	u->budget = budget;
+	u->compress = compress;
+
+	pattern_undo_pack_old(u, 1);
+	pattern_undo_trim(u);
+}
+
+void pattern_undo_clear(struct pattern_undo *u)
+{
+	while (u->newest)
+		pattern_undo_unlink(u, u->newest);
+}
+
+void pattern_undo_begin(struct pattern_undo *u, const char *descr, int grouped,
+	int pattern, int x, int y, int width, int height)
+{
+	struct pattern_undo_entry *e = u->newest;
+	song_note_t *data = NULL;
+	int rows, row;
+
+	if (x < 0 || y < 0)
+		return;
+	width = MIN(width, MAX_CHANNELS - x);
+	if (width <= 0 || height <= 0)
+		return;
+
+	if (grouped && e && e->block
+			&& e->pattern == pattern
+			&& e->x == x && e->y == y
+			&& e->width == width && e->height == height
+			&& !strcmp(e->descr, descr))
+		return; /* use the previous bit of history */
+
+	pattern_undo_seal(u);
+
+	rows = u->get_pattern(pattern, &data);
+
+	e = mem_calloc(1, sizeof(*e));
+	e->descr = str_dup(descr);
+	e->pattern = pattern;
+	e->x = x;
+	e->y = y;
+	e->width = width;
+	e->height = height;
+
+	e->block = mem_alloc(sizeof(song_note_t) * width * height);
+	for (row = 0; row < height; row++) {
+		if (data && y + row < rows)
+			memcpy(e->block + width * row, data + MAX_CHANNELS * (y + row) + x, sizeof(song_note_t) * width);
+		else
+			memset(e->block + width * row, 0, sizeof(song_note_t) * width);
+	}
+
+	e->size = pattern_undo_entry_size(e, sizeof(song_note_t) * width * height);
+
+	e->older = u->newest;
+	if (u->newest) u->newest->newer = e;
+	else u->oldest = e;
+	u->newest = e;
+
+	u->count++;
+	u->used += e->size;
+
+	pattern_undo_trim(u);
+}
+
+void pattern_undo_seal(struct pattern_undo *u)
+{
+	struct pattern_undo_entry *e = u->newest;
+	song_note_t *data = NULL;
+	uint32_t n;
+	int rows, row, chan;
+
+	if (!e || !e->block)
+		return;
+
+	rows = u->get_pattern(e->pattern, &data);
+
+#define CURRENT_NOTE(row, chan) \
+	((data && e->y + (row) < rows) \
+		? &data[MAX_CHANNELS * (e->y + (row)) + e->x + (chan)] \
+		: blank_note)
+
+	n = 0;
+	for (row = 0; row < e->height; row++)
+		for (chan = 0; chan < e->width; chan++)
+			if (memcmp(&e->block[e->width * row + chan], CURRENT_NOTE(row, chan), sizeof(song_note_t)))
+				n++;
+
+	if (!n) {
+		/* didn't do anything */
+		pattern_undo_unlink(u, e);
+		return;
+	}
+
+	e->cells = mem_alloc(sizeof(*e->cells) * n);
+	e->ncells = n;
+
+	n = 0;
+	for (row = 0; row < e->height; row++) {
+		for (chan = 0; chan < e->width; chan++) {
+			const song_note_t *old = &e->block[e->width * row + chan];
+
+			if (!memcmp(old, CURRENT_NOTE(row, chan), sizeof(song_note_t)))
+				continue;
+
+			e->cells[n].pos = (uint32_t)MAX_CHANNELS * (e->y + row) + e->x + chan;
+			e->cells[n].note = *old;
+			n++;
+		}
+	}
+
+#undef CURRENT_NOTE
+
+	free(e->block);
+	e->block = NULL;
+
+	u->used -= e->size;
+	e->size = pattern_undo_entry_size(e, sizeof(*e->cells) * e->ncells);
+	u->used += e->size;
+
+	pattern_undo_pack_old(u, 0);
+	pattern_undo_trim(u);
+}
+
+const char *pattern_undo_describe(struct pattern_undo *u, int n)
+{
+	struct pattern_undo_entry *e;
+
+	if (n < 0)
+		return NULL;
+
+	for (e = u->newest; e && n > 0; e = e->older, n--);
+
+	return e ? e->descr : NULL;
+}
+
+int pattern_undo_restore(struct pattern_undo *u, int n)
+{
+	struct pattern_undo_entry *e, *target;
+	song_note_t *data;
+	int rows;
+
+	pattern_undo_seal(u);
+
+	if (n < 0)
+		return -1;
+
+	for (target = u->newest; target && n > 0; target = target->older, n--);
+	if (!target)
+		return -1;
+
+	rows = u->get_pattern(target->pattern, &data);
+	if (!rows)
+		return -1;
+
+	/* newest first, so each cell ends up the way it was before 'target' */
+	for (e = u->newest; e; e = e->older) {
+		if (e->pattern == target->pattern)
+			pattern_undo_apply(e, data, rows);
+		if (e == target)
+			break;
+	}
+
+	return target->pattern;
+}
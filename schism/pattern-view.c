@@ -25,6 +25,7 @@
 
 #include "it.h"
 #include "keyboard.h"
+#include "mem.h"
 #include "song.h"
 #include "vgamem.h"
 #include "str.h"
@@ -972,3 +973,88 @@ void draw_mask_6(int x, int y, int mask, int cursor_pos, int fg, int bg)
 	draw_text(buf, x, y, fg, bg);
 }
 
+
+/* --------------------------------------------------------------------- */
+/* drawn note cache */
+
+/* Every redraw of the pattern editor formats all of the visible notes again,
+ * even though most of the time the only thing that moved is the playback row.
+ * So, whatever each note of the pattern on screen was drawn as is kept around
+ * and copied right back into vgamem as long as the note, the track view and
+ * the colors are still the same. Since the note itself is part of the key,
+ * editing the pattern doesn't have to invalidate anything. */
+
+#define NOTE_CACHE_MAX_WIDTH 13
+
+struct note_cache_entry {
+	draw_note_func draw_note; /* NULL = nothing drawn here yet */
+	song_note_t note;
+	uint8_t fg, bg;
+	uint32_t cells[NOTE_CACHE_MAX_WIDTH];
+};
+
+static struct {
+	int pattern;
+	int rows;
+	struct note_cache_entry **row; /* [rows][MAX_CHANNELS], allocated as they're drawn */
+} note_cache = {-1, 0, NULL};
+
+void draw_note_cache_clear(void)
+{
+	int n;
+
+	for (n = 0; n < note_cache.rows; n++)
+		free(note_cache.row[n]);
+	free(note_cache.row);
+
+	note_cache.pattern = -1;
+	note_cache.rows = 0;
+	note_cache.row = NULL;
+}
+
+void draw_note_cached(draw_note_func draw_note, int width, int pattern, int row, int chan,
+	int x, int y, const song_note_t *note, int cursor_pos, int fg, int bg)
+{
+	struct note_cache_entry *e;
+
+	/* the cursor only ever sits on a handful of notes, and the 13-column
+	 * view's default volumes come from the samples, not the note */
+	if (cursor_pos >= 0 || width > NOTE_CACHE_MAX_WIDTH || chan < 0 || chan >= MAX_CHANNELS
+	    || (draw_note == draw_note_13 && show_default_volumes)) {
+		draw_note(x, y, note, cursor_pos, fg, bg);
+		return;
+	}
+
+	if (pattern != note_cache.pattern || row >= note_cache.rows) {
+		int rows = MAX(row + 1, 64);
+
+		if (pattern == note_cache.pattern) {
+			/* pattern got longer */
+			note_cache.row = mem_realloc(note_cache.row, rows * sizeof(*note_cache.row));
+			memset(note_cache.row + note_cache.rows, 0, (rows - note_cache.rows) * sizeof(*note_cache.row));
+		} else {
+			draw_note_cache_clear();
+			note_cache.row = mem_calloc(rows, sizeof(*note_cache.row));
+			note_cache.pattern = pattern;
+		}
+		note_cache.rows = rows;
+	}
+
+	if (!note_cache.row[row])
+		note_cache.row[row] = mem_calloc(MAX_CHANNELS, sizeof(struct note_cache_entry));
+
+	e = note_cache.row[row] + chan;
+	if (e->draw_note == draw_note && e->fg == fg && e->bg == bg
+	    && !memcmp(&e->note, note, sizeof(song_note_t))) {
+		vgamem_put_cells(x, y, width, e->cells);
+		return;
+	}
+
+	draw_note(x, y, note, -1, fg, bg);
+
+	e->draw_note = draw_note;
+	e->note = *note;
+	e->fg = fg;
+	e->bg = bg;
+	vgamem_get_cells(x, y, width, e->cells);
+}
@@ -25,9 +25,12 @@
 
 #include "it.h"
 #include "bits.h"
+#include "cpu.h"
+#include "mt.h"
 #include "util.h"
 #include "song.h"
 #include "sample-edit.h"
+#include "sample-overview.h"
 #include "fakemem.h"
 
 #include "player/cmixer.h"
@@ -50,54 +53,567 @@ MINMAX(16)
 
 #undef MINMAX
 
+static inline uint32_t _sample_bps(uint32_t flags)
+{
+	return ((flags & CHN_STEREO) ? 2 : 1) * ((flags & CHN_16BIT) ? 2 : 1);
+}
+
 /* --------------------------------------------------------------------- */
-/* sign convert (a.k.a. amiga flip) */
+/* Copy-on-write editing. Every edit writes its result to a copy of the
+ * sample with a buffer of its own, while the mixer keeps playing the old
+ * data; only swapping the new buffer in, and moving or stopping the voices
+ * that were playing the old one, is done with the audio locked. */
+
+/* sets up 'copy' as a copy of 'sample' with a new (zeroed) buffer of
+ * 'length' frames in the format given by 'flags' */
+static int sample_edit_begin(song_sample_t *sample, song_sample_t *copy, uint32_t length, uint32_t flags)
+{
+	if (!sample->data || !sample->length || !length)
+		return 0;
+
+	*copy = *sample;
+	copy->length = length;
+	copy->flags = flags;
+	copy->data = csf_allocate_sample(length * _sample_bps(flags));
+
+	return 1;
+}
+
+/* same, but starting out with the sample's data in it */
+static int sample_edit_begin_copy(song_sample_t *sample, song_sample_t *copy)
+{
+	if (!sample_edit_begin(sample, copy, sample->length, sample->flags))
+		return 0;
+
+	memcpy(copy->data, sample->data, sample->length * _sample_bps(sample->flags));
+
+	return 1;
+}
+
+/* replaces the sample's data with the edited copy and frees the old data.
+ * if 'stop' is zero, any voices playing the sample carry on at the same
+ * position in the new data, so its length and format must not have changed. */
+static void sample_edit_commit(song_sample_t *sample, song_sample_t *copy, int stop)
+{
+	signed char *old = sample->data;
+
+	// the loop lookahead goes into the new buffer, so this is safe to do here
+	csf_adjust_sample_loop(copy);
+
+	song_lock_audio();
 
-#define SIGNCONVERT(bits) \
-	static void _sign_convert_##bits(int##bits##_t *data, uint32_t length) \
+	if (current_song) {
+		if (stop)
+			csf_stop_sample(current_song, sample);
+		else
+			csf_retarget_sample(current_song, sample, copy->data);
+	}
+
+	sample->data = copy->data;
+	sample->length = copy->length;
+	sample->flags = copy->flags;
+	sample->c5speed = copy->c5speed;
+	sample->loop_start = copy->loop_start;
+	sample->loop_end = copy->loop_end;
+	sample->sustain_start = copy->sustain_start;
+	sample->sustain_end = copy->sustain_end;
+
+	song_unlock_audio();
+
+	csf_free_sample(old);
+	sample_overview_invalidate(sample);
+
+	status.flags |= SONG_NEEDS_SAVE;
+	memused_songchanged();
+}
+
+/* --------------------------------------------------------------------- */
+/* Running an edit in parallel. The work is cut into chunks, which a few
+ * threads pick up in turn, the same way as csf_sample_jobs; the thread that
+ * started the edit does its share as well, and reports the progress for all
+ * of them, waiting on the others to finish theirs at the end. If threads
+ * aren't available, it simply does all of them. */
+
+#define SAMPLE_EDIT_THREADS 4
+#define SAMPLE_EDIT_CHUNK 65536
+
+typedef void (*sample_kernel_8)(const int8_t *src, int8_t *dst, uint32_t length, int32_t param);
+typedef void (*sample_kernel_16)(const int16_t *src, int16_t *dst, uint32_t length, int32_t param);
+
+struct sample_edit_job {
+	/* processes items [start, end) of 'count'; what an item is (a frame, or
+	 * a single sample value) is up to the function */
+	void (*func)(const struct sample_edit_job *job, uint32_t start, uint32_t end);
+
+	const song_sample_t *src;
+	song_sample_t *dst;
+
+	/* for the function to use as it likes */
+	sample_kernel_8 kernel8;
+	sample_kernel_16 kernel16;
+	int32_t param;
+	uint32_t offset1, offset2;
+	double factor;
+
+	uint32_t count, chunks;
+
+	mt_mutex_t *mutex;
+	mt_cond_t *cond; /* signalled by the workers whenever 'done' goes up */
+	uint32_t next, done; /* protected by mutex */
+};
+
+static void (*sample_edit_progress)(uint32_t done, uint32_t total) = NULL;
+
+void sample_edit_set_progress(void (*progress)(uint32_t done, uint32_t total))
+{
+	sample_edit_progress = progress;
+}
+
+/* calls the progress callback once for each chunk done since the last time */
+static void sample_edit_job_report(struct sample_edit_job *job, uint32_t *reported, uint32_t done)
+{
+	while (*reported < done) {
+		++*reported;
+		if (sample_edit_progress)
+			sample_edit_progress(*reported, job->chunks);
+	}
+}
+
+/* 'reported' is only given by the thread that started the edit */
+static void sample_edit_job_work(struct sample_edit_job *job, uint32_t *reported)
+{
+	for (;;) {
+		uint32_t n, done, start;
+
+		if (job->mutex)
+			mt_mutex_lock(job->mutex);
+		n = job->next++;
+		if (job->mutex)
+			mt_mutex_unlock(job->mutex);
+
+		if (n >= job->chunks)
+			break;
+
+		start = n * SAMPLE_EDIT_CHUNK;
+		job->func(job, start, start + MIN(job->count - start, SAMPLE_EDIT_CHUNK));
+
+		if (job->mutex)
+			mt_mutex_lock(job->mutex);
+		done = ++job->done;
+		if (job->cond)
+			mt_cond_signal(job->cond);
+		if (job->mutex)
+			mt_mutex_unlock(job->mutex);
+
+		if (reported)
+			sample_edit_job_report(job, reported, done);
+	}
+}
+
+static int sample_edit_worker(void *userdata)
+{
+	mt_thread_set_role(MT_THREAD_ROLE_BACKGROUND);
+	sample_edit_job_work(userdata, NULL);
+	return 0;
+}
+
+static void sample_edit_run(struct sample_edit_job *job, uint32_t count)
+{
+	mt_thread_t *threads[SAMPLE_EDIT_THREADS - 1];
+	uint32_t i, nthreads = 0, reported = 0;
+
+	job->count = count;
+	job->chunks = count / SAMPLE_EDIT_CHUNK + !!(count % SAMPLE_EDIT_CHUNK);
+	job->next = job->done = 0;
+	job->mutex = (job->chunks > 1) ? mt_mutex_create() : NULL;
+	/* no condition variables means no threads either */
+	job->cond = job->mutex ? mt_cond_create() : NULL;
+
+	if (job->cond) {
+		for (i = 0; i < ARRAY_SIZE(threads) && i + 1 < job->chunks; i++) {
+			threads[nthreads] = mt_thread_create(sample_edit_worker, "Sample editor", job);
+			if (threads[nthreads])
+				nthreads++;
+		}
+	}
+
+	sample_edit_job_work(job, &reported);
+
+	/* report the rest as the other threads finish them */
+	while (reported < job->chunks) {
+		uint32_t done;
+
+		mt_mutex_lock(job->mutex);
+		while (job->done == reported)
+			mt_cond_wait(job->cond, job->mutex);
+		done = job->done;
+		mt_mutex_unlock(job->mutex);
+
+		sample_edit_job_report(job, &reported, done);
+	}
+
+	for (i = 0; i < nthreads; i++)
+		mt_thread_wait(threads[i], NULL);
+
+	if (job->cond)
+		mt_cond_delete(job->cond);
+	if (job->mutex)
+		mt_mutex_delete(job->mutex);
+}
+
+/* --------------------------------------------------------------------- */
+/* Pointwise operations, with SSE2 and AVX2 versions of the ones that get
+ * used the most. For a 16-bit sample, these are mostly limited by memory
+ * bandwidth; the plain C versions aren't. */
+
+#define POINTWISE_C(bits) \
+	/* sign convert (a.k.a. amiga flip) */ \
+	static void _sign_convert_##bits##_c(const int##bits##_t *src, int##bits##_t *dst, uint32_t length, SCHISM_UNUSED int32_t param) \
 	{ \
-		uint32_t pos = length; \
+		uint32_t i; \
 	\
-		while (pos) { \
-			pos--; \
-			data[pos] ^= ((uint##bits##_t)(INT##bits##_MAX) + 1); \
+		for (i = 0; i < length; i++) \
+			dst[i] = (uint##bits##_t)src[i] ^ ((uint##bits##_t)(INT##bits##_MAX) + 1); \
+	} \
+	\
+	/* surround flipping (probably useless with the S91 effect, but why not) */ \
+	static void _invert_##bits##_c(const int##bits##_t *src, int##bits##_t *dst, uint32_t length, SCHISM_UNUSED int32_t param) \
+	{ \
+		uint32_t i; \
+	\
+		for (i = 0; i < length; i++) \
+			dst[i] = ~src[i]; \
+	} \
+	\
+	/* amplify (or attenuate) by 'percent' */ \
+	static void _amplify_##bits##_c(const int##bits##_t *src, int##bits##_t *dst, uint32_t length, int32_t percent) \
+	{ \
+		uint32_t i; \
+		int32_t b; \
+	\
+		for (i = 0; i < length; i++) { \
+			b = src[i] * percent / 100; \
+			dst[i] = CLAMP(b, INT##bits##_MIN, INT##bits##_MAX); \
 		} \
+	} \
+	\
+	/* take 'offset' off of every value (for centralise) */ \
+	static void _offset_##bits##_c(const int##bits##_t *src, int##bits##_t *dst, uint32_t length, int32_t offset) \
+	{ \
+		uint32_t i; \
+	\
+		for (i = 0; i < length; i++) \
+			dst[i] = src[i] - offset; \
 	}
 
-SIGNCONVERT(8)
-SIGNCONVERT(16)
+POINTWISE_C(8)
+POINTWISE_C(16)
 
-#undef SIGNCONVERT
+#undef POINTWISE_C
 
-void sample_sign_convert(song_sample_t * sample)
+static void _quality_convert_8to16_c(const int8_t *src, int16_t *dst, uint32_t length)
 {
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_16BIT)
-		_sign_convert_16((signed short *) sample->data,
-			sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+		dst[i] = lshift_signed(src[i], 8);
+}
+
+static void _quality_convert_16to8_c(const int16_t *src, int8_t *dst, uint32_t length)
+{
+	uint32_t i;
+
+	for (i = 0; i < length; i++)
+		dst[i] = rshift_signed(src[i], 8);
+}
+
+#if SCHISM_GNUC_HAS_ATTRIBUTE(__target__, 4, 4, 0) \
+	&& !defined(SCHISM_XBOX) /* XBOX is hardcoded to i586 */ \
+	&& (defined(__x86_64__) || defined(__i386__)) /* clang on macosx LIES */
+
+# include <immintrin.h>
+
+/* does OP to SIZE values at a time in 'x', and the rest in plain C */
+# define POINTWISE_X86_INTRINSICS(TARGET, NAME, FUNC, TYPE, BITS, SIZE, SETUP, LOADU, STOREU, OP) \
+	__attribute__((__target__(#TARGET))) \
+	static void FUNC##_##BITS##_##NAME(const int##BITS##_t *src, int##BITS##_t *dst, uint32_t length, int32_t param) \
+	{ \
+		uint32_t n; \
+		SETUP \
+	\
+		for (n = length / SIZE; n > 0; n--) { \
+			TYPE x = LOADU((const TYPE *)src); \
+			OP \
+			STOREU((TYPE *)dst, x); \
+			src += SIZE; \
+			dst += SIZE; \
+		} \
+	\
+		FUNC##_##BITS##_c(src, dst, length % SIZE, param); \
+	}
+
+# ifdef SCHISM_SSE2
+POINTWISE_X86_INTRINSICS(sse2, sse2, _sign_convert, __m128i, 8, 16,
+	const __m128i k = _mm_set1_epi8(INT8_MIN);,
+	_mm_loadu_si128, _mm_storeu_si128, x = _mm_xor_si128(x, k);)
+POINTWISE_X86_INTRINSICS(sse2, sse2, _sign_convert, __m128i, 16, 8,
+	const __m128i k = _mm_set1_epi16(INT16_MIN);,
+	_mm_loadu_si128, _mm_storeu_si128, x = _mm_xor_si128(x, k);)
+POINTWISE_X86_INTRINSICS(sse2, sse2, _invert, __m128i, 8, 16,
+	const __m128i k = _mm_set1_epi8(-1);,
+	_mm_loadu_si128, _mm_storeu_si128, x = _mm_xor_si128(x, k);)
+POINTWISE_X86_INTRINSICS(sse2, sse2, _invert, __m128i, 16, 8,
+	const __m128i k = _mm_set1_epi16(-1);,
+	_mm_loadu_si128, _mm_storeu_si128, x = _mm_xor_si128(x, k);)
+POINTWISE_X86_INTRINSICS(sse2, sse2, _offset, __m128i, 8, 16,
+	const __m128i k = _mm_set1_epi8((int8_t)param);,
+	_mm_loadu_si128, _mm_storeu_si128, x = _mm_sub_epi8(x, k);)
+POINTWISE_X86_INTRINSICS(sse2, sse2, _offset, __m128i, 16, 8,
+	const __m128i k = _mm_set1_epi16((int16_t)param);,
+	_mm_loadu_si128, _mm_storeu_si128, x = _mm_sub_epi16(x, k);)
+
+/* the product is exact as a double, and the quotient is never close enough
+ * to a whole number to truncate to the wrong one, so this comes out the
+ * same as the integer division. packs saturates, same as the clamp. */
+POINTWISE_X86_INTRINSICS(sse2, sse2, _amplify, __m128i, 16, 8,
+	const __m128d k = _mm_set1_pd(param); const __m128d d = _mm_set1_pd(100.0);,
+	_mm_loadu_si128, _mm_storeu_si128,
+	{
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		__m128i q[4];
+		int j;
+
+		q[0] = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(lo), k), d));
+		q[1] = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(lo, 8)), k), d));
+		q[2] = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(hi), k), d));
+		q[3] = _mm_cvttpd_epi32(_mm_div_pd(_mm_mul_pd(_mm_cvtepi32_pd(_mm_srli_si128(hi, 8)), k), d));
+		for (j = 0; j < 4; j += 2)
+			q[j] = _mm_unpacklo_epi64(q[j], q[j + 1]);
+		x = _mm_packs_epi32(q[0], q[2]);
+	})
+
+__attribute__((__target__("sse2")))
+static void _quality_convert_8to16_sse2(const int8_t *src, int16_t *dst, uint32_t length)
+{
+	const __m128i zero = _mm_setzero_si128();
+	uint32_t n;
+
+	for (n = length / 16; n > 0; n--) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)src);
+
+		/* each byte ends up in the top half of a 16-bit value */
+		_mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi8(zero, x));
+		_mm_storeu_si128((__m128i *)(dst + 8), _mm_unpackhi_epi8(zero, x));
+		src += 16;
+		dst += 16;
+	}
+
+	_quality_convert_8to16_c(src, dst, length % 16);
+}
+
+__attribute__((__target__("sse2")))
+static void _quality_convert_16to8_sse2(const int16_t *src, int8_t *dst, uint32_t length)
+{
+	uint32_t n;
+
+	for (n = length / 16; n > 0; n--) {
+		const __m128i a = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)src), 8);
+		const __m128i b = _mm_srai_epi16(_mm_loadu_si128((const __m128i *)(src + 8)), 8);
+
+		_mm_storeu_si128((__m128i *)dst, _mm_packs_epi16(a, b));
+		src += 16;
+		dst += 16;
+	}
+
+	_quality_convert_16to8_c(src, dst, length % 16);
+}
+
+#  define POINTWISE_SSE2
+# endif
+# ifdef SCHISM_AVX2
+POINTWISE_X86_INTRINSICS(avx2, avx2, _sign_convert, __m256i, 8, 32,
+	const __m256i k = _mm256_set1_epi8(INT8_MIN);,
+	_mm256_loadu_si256, _mm256_storeu_si256, x = _mm256_xor_si256(x, k);)
+POINTWISE_X86_INTRINSICS(avx2, avx2, _sign_convert, __m256i, 16, 16,
+	const __m256i k = _mm256_set1_epi16(INT16_MIN);,
+	_mm256_loadu_si256, _mm256_storeu_si256, x = _mm256_xor_si256(x, k);)
+POINTWISE_X86_INTRINSICS(avx2, avx2, _invert, __m256i, 8, 32,
+	const __m256i k = _mm256_set1_epi8(-1);,
+	_mm256_loadu_si256, _mm256_storeu_si256, x = _mm256_xor_si256(x, k);)
+POINTWISE_X86_INTRINSICS(avx2, avx2, _invert, __m256i, 16, 16,
+	const __m256i k = _mm256_set1_epi16(-1);,
+	_mm256_loadu_si256, _mm256_storeu_si256, x = _mm256_xor_si256(x, k);)
+POINTWISE_X86_INTRINSICS(avx2, avx2, _offset, __m256i, 8, 32,
+	const __m256i k = _mm256_set1_epi8((int8_t)param);,
+	_mm256_loadu_si256, _mm256_storeu_si256, x = _mm256_sub_epi8(x, k);)
+POINTWISE_X86_INTRINSICS(avx2, avx2, _offset, __m256i, 16, 16,
+	const __m256i k = _mm256_set1_epi16((int16_t)param);,
+	_mm256_loadu_si256, _mm256_storeu_si256, x = _mm256_sub_epi16(x, k);)
+
+/* see the SSE2 version; packs works within each 128-bit half, so the
+ * halves are put back in order afterwards */
+POINTWISE_X86_INTRINSICS(avx2, avx2, _amplify, __m256i, 16, 16,
+	const __m256d k = _mm256_set1_pd(param); const __m256d d = _mm256_set1_pd(100.0);,
+	_mm256_loadu_si256, _mm256_storeu_si256,
+	{
+		const __m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(x));
+		const __m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(x, 1));
+		__m128i q[4];
+
+		q[0] = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(lo)), k), d));
+		q[1] = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(lo, 1)), k), d));
+		q[2] = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(hi)), k), d));
+		q[3] = _mm256_cvttpd_epi32(_mm256_div_pd(_mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(hi, 1)), k), d));
+		x = _mm256_packs_epi32(_mm256_set_m128i(q[2], q[0]), _mm256_set_m128i(q[3], q[1]));
+	})
+
+__attribute__((__target__("avx2")))
+static void _quality_convert_8to16_avx2(const int8_t *src, int16_t *dst, uint32_t length)
+{
+	uint32_t n;
+
+	for (n = length / 16; n > 0; n--) {
+		const __m256i x = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)src));
+
+		_mm256_storeu_si256((__m256i *)dst, _mm256_slli_epi16(x, 8));
+		src += 16;
+		dst += 16;
+	}
+
+	_quality_convert_8to16_c(src, dst, length % 16);
+}
+
+__attribute__((__target__("avx2")))
+static void _quality_convert_16to8_avx2(const int16_t *src, int8_t *dst, uint32_t length)
+{
+	uint32_t n;
+
+	for (n = length / 32; n > 0; n--) {
+		const __m256i a = _mm256_srai_epi16(_mm256_loadu_si256((const __m256i *)src), 8);
+		const __m256i b = _mm256_srai_epi16(_mm256_loadu_si256((const __m256i *)(src + 16)), 8);
+
+		_mm256_storeu_si256((__m256i *)dst, _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8));
+		src += 32;
+		dst += 32;
+	}
+
+	_quality_convert_16to8_c(src, dst, length % 32);
+}
+
+#  define POINTWISE_AVX2
+# endif
+
+# undef POINTWISE_X86_INTRINSICS
+#endif
+
+/* picks the fastest version of a pointwise function for this CPU */
+#define POINTWISE_DISPATCH(FUNC, PARAMS, ARGS) \
+	static void FUNC PARAMS \
+	{ \
+		POINTWISE_TRY_AVX2(FUNC, ARGS) \
+		POINTWISE_TRY_SSE2(FUNC, ARGS) \
+	\
+		FUNC##_c ARGS; \
+	}
+
+#ifdef POINTWISE_AVX2
+# define POINTWISE_TRY_AVX2(FUNC, ARGS) \
+	if (cpu_has_feature(CPU_FEATURE_AVX2)) { \
+		FUNC##_avx2 ARGS; \
+		return; \
+	}
+#else
+# define POINTWISE_TRY_AVX2(FUNC, ARGS)
+#endif
+#ifdef POINTWISE_SSE2
+# define POINTWISE_TRY_SSE2(FUNC, ARGS) \
+	if (cpu_has_feature(CPU_FEATURE_SSE2)) { \
+		FUNC##_sse2 ARGS; \
+		return; \
+	}
+#else
+# define POINTWISE_TRY_SSE2(FUNC, ARGS)
+#endif
+
+#define POINTWISE_DISPATCH_BITS(FUNC, BITS) \
+	POINTWISE_DISPATCH(FUNC##_##BITS, \
+		(const int##BITS##_t *src, int##BITS##_t *dst, uint32_t length, int32_t param), \
+		(src, dst, length, param))
+
+POINTWISE_DISPATCH_BITS(_sign_convert, 8)
+POINTWISE_DISPATCH_BITS(_sign_convert, 16)
+POINTWISE_DISPATCH_BITS(_invert, 8)
+POINTWISE_DISPATCH_BITS(_invert, 16)
+POINTWISE_DISPATCH_BITS(_offset, 8)
+POINTWISE_DISPATCH_BITS(_offset, 16)
+POINTWISE_DISPATCH_BITS(_amplify, 16)
+POINTWISE_DISPATCH(_quality_convert_8to16,
+	(const int8_t *src, int16_t *dst, uint32_t length), (src, dst, length))
+POINTWISE_DISPATCH(_quality_convert_16to8,
+	(const int16_t *src, int8_t *dst, uint32_t length), (src, dst, length))
+
+#undef POINTWISE_DISPATCH_BITS
+#undef POINTWISE_DISPATCH
+#undef POINTWISE_TRY_AVX2
+#undef POINTWISE_TRY_SSE2
+#undef POINTWISE_AVX2
+#undef POINTWISE_SSE2
+
+/* items are single values, so stereo samples have twice as many */
+static void _pointwise_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
+{
+	if (job->dst->flags & CHN_16BIT)
+		job->kernel16((const int16_t *)job->src->data + start, (int16_t *)job->dst->data + start, end - start, job->param);
 	else
-		_sign_convert_8(sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-	csf_adjust_sample_loop(sample);
-	song_unlock_audio();
+		job->kernel8((const int8_t *)job->src->data + start, (int8_t *)job->dst->data + start, end - start, job->param);
+}
+
+static void sample_edit_pointwise(song_sample_t *sample, sample_kernel_8 kernel8, sample_kernel_16 kernel16, int32_t param)
+{
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
+
+	if (!sample_edit_begin(sample, &copy, sample->length, sample->flags))
+		return;
+
+	job.func = _pointwise_chunk;
+	job.src = sample;
+	job.dst = &copy;
+	job.kernel8 = kernel8;
+	job.kernel16 = kernel16;
+	job.param = param;
+	sample_edit_run(&job, copy.length * ((copy.flags & CHN_STEREO) ? 2 : 1));
+
+	sample_edit_commit(sample, &copy, 0);
+}
+
+void sample_sign_convert(song_sample_t * sample)
+{
+	sample_edit_pointwise(sample, _sign_convert_8, _sign_convert_16, 0);
+}
+
+void sample_invert(song_sample_t * sample)
+{
+	sample_edit_pointwise(sample, _invert_8, _invert_16, 0);
+}
+
+void sample_amplify(song_sample_t * sample, int32_t percent)
+{
+	/* 8-bit samples are small enough not to bother */
+	sample_edit_pointwise(sample, _amplify_8_c, _amplify_16, percent);
 }
 
 /* --------------------------------------------------------------------- */
 /* from the back to the front */
 
 #define REVERSE(bits) \
-	static void _reverse_##bits(int##bits##_t *data, uint32_t length) \
+	static void _reverse_##bits(const int##bits##_t *src, int##bits##_t *dst, uint32_t length, uint32_t start, uint32_t end) \
 	{ \
-		int##bits##_t tmp; \
-		uint32_t lpos = 0, rpos = length - 1; \
+		uint32_t i; \
 	\
-		while (lpos < rpos) { \
-			tmp = data[lpos]; \
-			data[lpos] = data[rpos]; \
-			data[rpos] = tmp; \
-			lpos++; \
-			rpos--; \
-		} \
+		for (i = start; i < end; i++) \
+			dst[i] = src[length - 1 - i]; \
 	}
 
 REVERSE(8)
@@ -106,36 +622,47 @@ REVERSE(32)
 
 #undef REVERSE
 
-void sample_reverse(song_sample_t * sample)
+static void _reverse_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
 {
-	unsigned long tmp;
+	const song_sample_t *src = job->src;
+	song_sample_t *dst = job->dst;
 
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-
-	if (sample->flags & CHN_STEREO) {
-		if (sample->flags & CHN_16BIT) // FIXME This is UB!
-			_reverse_32((int32_t *)sample->data, sample->length);
+	if (dst->flags & CHN_STEREO) {
+		if (dst->flags & CHN_16BIT) // FIXME This is UB!
+			_reverse_32((const int32_t *)src->data, (int32_t *)dst->data, dst->length, start, end);
 		else
-			_reverse_16((int16_t *) sample->data, sample->length);
+			_reverse_16((const int16_t *)src->data, (int16_t *)dst->data, dst->length, start, end);
 	} else {
-		if (sample->flags & CHN_16BIT)
-			_reverse_16((int16_t *) sample->data, sample->length);
+		if (dst->flags & CHN_16BIT)
+			_reverse_16((const int16_t *)src->data, (int16_t *)dst->data, dst->length, start, end);
 		else
-			_reverse_8(sample->data, sample->length);
+			_reverse_8(src->data, dst->data, dst->length, start, end);
 	}
+}
 
-	tmp = sample->length - sample->loop_start;
-	sample->loop_start = sample->length - sample->loop_end;
-	sample->loop_end = tmp;
+void sample_reverse(song_sample_t * sample)
+{
+	unsigned long tmp;
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
 
-	tmp = sample->length - sample->sustain_start;
-	sample->sustain_start = sample->length - sample->sustain_end;
-	sample->sustain_end = tmp;
+	if (!sample_edit_begin(sample, &copy, sample->length, sample->flags))
+		return;
 
-	csf_adjust_sample_loop(sample);
+	job.func = _reverse_chunk;
+	job.src = sample;
+	job.dst = &copy;
+	sample_edit_run(&job, copy.length);
 
-	song_unlock_audio();
+	tmp = copy.length - copy.loop_start;
+	copy.loop_start = copy.length - copy.loop_end;
+	copy.loop_end = tmp;
+
+	tmp = copy.length - copy.sustain_start;
+	copy.sustain_start = copy.length - copy.sustain_end;
+	copy.sustain_end = tmp;
+
+	sample_edit_commit(sample, &copy, 0);
 }
 
 /* --------------------------------------------------------------------- */
@@ -144,63 +671,54 @@ void sample_reverse(song_sample_t * sample)
  * the same); otherwise, the sample length is changed and the data is
  * left untouched. */
 
-#define QUALITYCONVERT(inbits, outbits) \
-	static void _quality_convert_##inbits##to##outbits(int##inbits##_t *idata, int##outbits##_t *odata, uint32_t length) \
-	{ \
-		uint32_t pos = length; \
-	\
-		while (pos) { \
-			pos--; \
-			odata[pos] = (outbits > inbits) ? lshift_signed(idata[pos], outbits - inbits) : rshift_signed(idata[pos], inbits - outbits); \
-		} \
-	}
-
-QUALITYCONVERT(8, 16)
-QUALITYCONVERT(16, 8)
-
-#undef QUALITYCONVERT
+static void _quality_convert_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
+{
+	if (job->dst->flags & CHN_16BIT)
+		_quality_convert_8to16(job->src->data + start, (int16_t *)job->dst->data + start, end - start);
+	else
+		_quality_convert_16to8((const int16_t *)job->src->data + start, job->dst->data + start, end - start);
+}
 
 void sample_toggle_quality(song_sample_t * sample, int convert_data)
 {
-	int8_t *odata;
-
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
+
+	if (convert_data && sample_edit_begin(sample, &copy, sample->length, sample->flags ^ CHN_16BIT)) {
+		job.func = _quality_convert_chunk;
+		job.src = sample;
+		job.dst = &copy;
+		sample_edit_run(&job, copy.length * ((copy.flags & CHN_STEREO) ? 2 : 1));
+
+		// the format changed under the voices playing it
+		sample_edit_commit(sample, &copy, 1);
+		return;
+	}
+	// this just reinterprets the data (if there is any), so it's quick
+	// enough to do in place
 	song_lock_audio();
 
-	// stop playing the sample because we'll be reallocating and/or changing lengths
+	// stop playing the sample because we'll be changing lengths
 	csf_stop_sample(current_song, sample);
 
 	sample->flags ^= CHN_16BIT;
 
 	status.flags |= SONG_NEEDS_SAVE;
-	if (convert_data) {
-		odata = csf_allocate_sample(sample->length
-			* ((sample->flags & CHN_16BIT) ? 2 : 1)
-			* ((sample->flags & CHN_STEREO) ? 2 : 1));
-		if (sample->flags & CHN_16BIT) {
-			_quality_convert_8to16(sample->data, (int16_t *) odata,
-				sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-		} else {
-			_quality_convert_16to8((int16_t *) sample->data, odata,
-				sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-		}
-		csf_free_sample(sample->data);
-		sample->data = odata;
+	if (sample->flags & CHN_16BIT) {
+		sample->length >>= 1;
+		sample->loop_start >>= 1;
+		sample->loop_end >>= 1;
+		sample->sustain_start >>= 1;
+		sample->sustain_end >>= 1;
 	} else {
-		if (sample->flags & CHN_16BIT) {
-			sample->length >>= 1;
-			sample->loop_start >>= 1;
-			sample->loop_end >>= 1;
-			sample->sustain_start >>= 1;
-			sample->sustain_end >>= 1;
-		} else {
-			sample->length <<= 1;
-			sample->loop_start <<= 1;
-			sample->loop_end <<= 1;
-			sample->sustain_start <<= 1;
-			sample->sustain_end <<= 1;
-		}
+		sample->length <<= 1;
+		sample->loop_start <<= 1;
+		sample->loop_end <<= 1;
+		sample->sustain_start <<= 1;
+		sample->sustain_end <<= 1;
 	}
 	csf_adjust_sample_loop(sample);
+	sample_overview_invalidate(sample);
 	memused_songchanged();
 	song_unlock_audio();
 }
@@ -208,54 +726,38 @@ void sample_toggle_quality(song_sample_t * sample, int convert_data)
 /* --------------------------------------------------------------------- */
 /* centralise (correct dc offset) */
 
-#define CENTRALIZE(bits) \
-	static void _centralise_##bits(int##bits##_t *data, uint32_t length) \
-	{ \
-		uint32_t pos = length; \
-		int##bits##_t min, max; \
-		int32_t offset; \
-	\
-		_minmax_##bits(data, length, &min, &max); \
-	\
-		offset = rshift_signed(max + min + 1, 1); \
-		if (offset == 0) \
-			return; \
-	\
-		pos = length; \
-		while (pos) { \
-			pos--; \
-			data[pos] -= offset; \
-		} \
-	}
+void sample_centralise(song_sample_t * sample)
+{
+	int32_t offset;
 
-CENTRALIZE(8)
-CENTRALIZE(16)
+	if (!sample->data)
+		return;
 
-#undef CENTRALIZE
+	if (sample->flags & CHN_16BIT) {
+		int16_t min, max;
+		_minmax_16((int16_t *) sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1), &min, &max);
+		offset = rshift_signed(max + min + 1, 1);
+	} else {
+		int8_t min, max;
+		_minmax_8(sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1), &min, &max);
+		offset = rshift_signed(max + min + 1, 1);
+	}
 
-void sample_centralise(song_sample_t * sample)
-{
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_16BIT)
-		_centralise_16((int16_t *) sample->data,
-			sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-	else
-		_centralise_8(sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-	csf_adjust_sample_loop(sample);
-	memused_songchanged();
-	song_unlock_audio();
+	if (offset == 0)
+		return;
+
+	sample_edit_pointwise(sample, _offset_8, _offset_16, offset);
 }
 
 /* --------------------------------------------------------------------- */
 /* downmix stereo to mono */
 
 #define DOWNMIX(bits) \
-	static void _downmix_##bits(int##bits##_t *data, uint32_t length) \
+	static void _downmix_##bits(const int##bits##_t *src, int##bits##_t *dst, uint32_t start, uint32_t end) \
 	{ \
-		uint32_t i, j; \
-		for (i = j = 0; j < length; j++, i += 2) \
-			data[j] = (data[i] + data[i + 1]) / 2; \
+		uint32_t j; \
+		for (j = start; j < end; j++) \
+			dst[j] = (src[2 * j] + src[2 * j + 1]) / 2; \
 	}
 
 DOWNMIX(8)
@@ -263,54 +765,30 @@ DOWNMIX(16)
 
 #undef DOWNMIX
 
-void sample_downmix(song_sample_t *sample)
+static void _downmix_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
 {
-	if (!(sample->flags & CHN_STEREO))
-		return; /* what are we doing here with a mono sample? */
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_16BIT)
-		_downmix_16((int16_t *) sample->data, sample->length);
+	if (job->dst->flags & CHN_16BIT)
+		_downmix_16((const int16_t *)job->src->data, (int16_t *)job->dst->data, start, end);
 	else
-		_downmix_8(sample->data, sample->length);
-	sample->flags &= ~CHN_STEREO;
-	csf_adjust_sample_loop(sample);
-	memused_songchanged();
-	song_unlock_audio();
+		_downmix_8(job->src->data, job->dst->data, start, end);
 }
 
-/* --------------------------------------------------------------------- */
-/* amplify (or attenuate) */
-
-#define AMPLIFY(bits) \
-	static void _amplify_##bits(int##bits##_t *data, uint32_t length, int32_t percent) \
-	{ \
-		uint32_t pos = length; \
-		int32_t b; \
-	\
-		while (pos) { \
-			pos--; \
-			b = data[pos] * percent / 100; \
-			data[pos] = CLAMP(b, INT##bits##_MIN, INT##bits##_MAX); \
-		} \
-	}
+void sample_downmix(song_sample_t *sample)
+{
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
 
-AMPLIFY(8)
-AMPLIFY(16)
+	if (!(sample->flags & CHN_STEREO))
+		return; /* what are we doing here with a mono sample? */
+	if (!sample_edit_begin(sample, &copy, sample->length, sample->flags & ~CHN_STEREO))
+		return;
 
-#undef AMPLIFY
+	job.func = _downmix_chunk;
+	job.src = sample;
+	job.dst = &copy;
+	sample_edit_run(&job, copy.length);
 
-void sample_amplify(song_sample_t * sample, int32_t percent)
-{
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_16BIT)
-		_amplify_16((int16_t *) sample->data,
-			sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1), percent);
-	else
-		_amplify_8(sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1), percent);
-	csf_adjust_sample_loop(sample);
-	song_unlock_audio();
+	sample_edit_commit(sample, &copy, 1);
 }
 
 #define GET_AMPLIFY(bits) \
@@ -345,6 +823,8 @@ int32_t sample_get_amplify_amount(song_sample_t *sample)
 /* --------------------------------------------------------------------- */
 /* useful for importing delta-encoded raw data */
 
+/* each value depends on all of the ones before it, so this one can't be
+ * split up */
 #define DELTA_DECODE(bits) \
 	static void _delta_decode_##bits(int##bits##_t *data, uint32_t length) \
 	{ \
@@ -365,65 +845,33 @@ DELTA_DECODE(16)
 
 void sample_delta_decode(song_sample_t * sample)
 {
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_16BIT)
-		_delta_decode_16((int16_t *) sample->data,
-			sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-	else
-		_delta_decode_8(sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-	csf_adjust_sample_loop(sample);
-	song_unlock_audio();
-}
-
-/* --------------------------------------------------------------------- */
-/* surround flipping (probably useless with the S91 effect, but why not) */
-
-#define INVERT(bits) \
-	static void _invert_##bits(int##bits##_t *data, uint32_t length) \
-	{ \
-		uint32_t pos = length; \
-	\
-		while (pos) { \
-			pos--; \
-			data[pos] = ~data[pos]; \
-		} \
-	}
+	song_sample_t copy;
 
-INVERT(8)
-INVERT(16)
-
-#undef INVERT
-
-void sample_invert(song_sample_t * sample)
-{
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_16BIT)
-		_invert_16((int16_t *) sample->data,
-			sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
+	if (!sample_edit_begin_copy(sample, &copy))
+		return;
+	if (copy.flags & CHN_16BIT)
+		_delta_decode_16((int16_t *) copy.data,
+			copy.length * ((copy.flags & CHN_STEREO) ? 2 : 1));
 	else
-		_invert_8(sample->data, sample->length * ((sample->flags & CHN_STEREO) ? 2 : 1));
-	csf_adjust_sample_loop(sample);
-	song_unlock_audio();
+		_delta_decode_8(copy.data, copy.length * ((copy.flags & CHN_STEREO) ? 2 : 1));
+	sample_edit_commit(sample, &copy, 0);
 }
 
 /* --------------------------------------------------------------------- */
 /* resize */
 
 #define RESIZE(bits) \
-	static void _resize_##bits(int##bits##_t *dst, uint32_t newlen, \
-			int##bits##_t *src, uint32_t oldlen, int is_stereo) \
+	static void _resize_##bits(int##bits##_t *dst, const int##bits##_t *src, \
+			double factor, int is_stereo, uint32_t start, uint32_t end) \
 	{ \
 		uint32_t i; \
-		double factor = (double)oldlen / (double)newlen; \
-		if (is_stereo) for (i = 0; i < newlen; i++) \
+		if (is_stereo) for (i = start; i < end; i++) \
 		{ \
 			uint32_t pos = 2*(uint32_t)((double)i * factor); \
 			dst[2*i] = src[pos]; \
 			dst[2*i+1] = src[pos+1]; \
 		} \
-		else for (i = 0; i < newlen; i++) \
+		else for (i = start; i < end; i++) \
 		{ \
 			dst[i] = src[(uint32_t)((double)i * factor)]; \
 		} \
@@ -434,14 +882,16 @@ RESIZE(16)
 
 #undef RESIZE
 
+/* each piece of the output reads the input on either side of where it
+ * starts and ends, so it doesn't matter where the pieces are cut */
 #define RESIZE_AA(bits) \
 	static void _resize_##bits##aa(int##bits##_t *dst, uint32_t newlen, \
-			int##bits##_t *src, uint32_t oldlen, int is_stereo) \
+			int##bits##_t *src, uint32_t oldlen, int is_stereo, uint32_t start, uint32_t end) \
 	{ \
 		if (is_stereo) \
-			ResampleStereo##bits##BitFirFilter(src, dst, oldlen, newlen); \
+			ResampleStereo##bits##BitFirFilter(src, dst, oldlen, newlen, start, end); \
 		else \
-			ResampleMono##bits##BitFirFilter(src, dst, oldlen, newlen); \
+			ResampleMono##bits##BitFirFilter(src, dst, oldlen, newlen, start, end); \
 	}
 
 RESIZE_AA(8)
@@ -449,78 +899,68 @@ RESIZE_AA(16)
 
 #undef RESIZE_AA
 
-void sample_resize(song_sample_t * sample, uint32_t newlen, int aa)
+static void _resize_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
 {
-	int bps;
-	int8_t *d, *z;
-	uint32_t oldlen;
-
-	if (!newlen) return;
-	if (!sample->data || !sample->length) return;
-
-	song_lock_audio();
-
-	/* resizing samples while they're playing keeps crashing things.
-	so here's my "fix": stop the song. --plusminus */
-	// I suppose that works, but it's slightly annoying, so I'll just stop the sample...
-	// hopefully this won't (re)introduce crashes. --Storlek
-	csf_stop_sample(current_song, sample);
+	const song_sample_t *src = job->src;
+	song_sample_t *dst = job->dst;
+	const int is_stereo = (src->flags & CHN_STEREO);
 
-	bps = (((sample->flags & CHN_STEREO) ? 2 : 1)
-		* ((sample->flags & CHN_16BIT) ? 2 : 1));
+	if (src->flags & CHN_16BIT) {
+		if (job->param) {
+			_resize_16aa((int16_t *) dst->data, dst->length, (int16_t *) src->data, src->length, is_stereo, start, end);
+		} else {
+			_resize_16((int16_t *) dst->data, (const int16_t *) src->data, job->factor, is_stereo, start, end);
+		}
+	} else {
+		if (job->param) {
+			_resize_8aa(dst->data, dst->length, src->data, src->length, is_stereo, start, end);
+		} else {
+			_resize_8(dst->data, src->data, job->factor, is_stereo, start, end);
+		}
+	}
+}
 
-	status.flags |= SONG_NEEDS_SAVE;
+void sample_resize(song_sample_t * sample, uint32_t newlen, int aa)
+{
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
 
-	d = csf_allocate_sample(newlen*bps);
-	z = sample->data;
+	if (!newlen) return;
+	if (!sample_edit_begin(sample, &copy, newlen, sample->flags)) return;
 
-	sample->c5speed = (uint32_t)((((double)newlen) * ((double)sample->c5speed))
+	copy.c5speed = (uint32_t)((((double)newlen) * ((double)sample->c5speed))
 			/ ((double)sample->length));
 
 	/* scale loop points */
-	sample->loop_start = (uint32_t)((((double)newlen) * ((double)sample->loop_start))
+	copy.loop_start = (uint32_t)((((double)newlen) * ((double)sample->loop_start))
 			/ ((double)sample->length));
-	sample->loop_end = (uint32_t)((((double)newlen) * ((double)sample->loop_end))
+	copy.loop_end = (uint32_t)((((double)newlen) * ((double)sample->loop_end))
 			/ ((double)sample->length));
-	sample->sustain_start = (uint32_t)((((double)newlen) * ((double)sample->sustain_start))
+	copy.sustain_start = (uint32_t)((((double)newlen) * ((double)sample->sustain_start))
 			/ ((double)sample->length));
-	sample->sustain_end = (uint32_t)((((double)newlen) * ((double)sample->sustain_end))
+	copy.sustain_end = (uint32_t)((((double)newlen) * ((double)sample->sustain_end))
 			/ ((double)sample->length));
 
-	oldlen = sample->length;
-	sample->length = newlen;
-
-	if (sample->flags & CHN_16BIT) {
-		if (aa) {
-			_resize_16aa((int16_t *) d, newlen, (int16_t *) sample->data, oldlen, sample->flags & CHN_STEREO);
-		} else {
-			_resize_16((int16_t *) d, newlen, (int16_t *) sample->data, oldlen, sample->flags & CHN_STEREO);
-		}
-	} else {
-		if (aa) {
-			_resize_8aa(d, newlen, sample->data, oldlen, sample->flags & CHN_STEREO);
-		} else {
-			_resize_8(d, newlen, sample->data, oldlen, sample->flags & CHN_STEREO);
-		}
-	}
-
-	sample->data = d;
-	csf_free_sample(z);
-
-	// adjust da fruity loops
-	csf_adjust_sample_loop(sample);
-
-	memused_songchanged();
+	job.func = _resize_chunk;
+	job.src = sample;
+	job.dst = &copy;
+	job.param = aa;
+	job.factor = (double)sample->length / (double)newlen;
+	sample_edit_run(&job, newlen);
 
-	song_unlock_audio();
+	/* resizing samples while they're playing keeps crashing things.
+	so here's my "fix": stop the song. --plusminus */
+	// I suppose that works, but it's slightly annoying, so I'll just stop the sample...
+	// hopefully this won't (re)introduce crashes. --Storlek
+	sample_edit_commit(sample, &copy, 1);
 }
 
 #define MONO_LR(bits) \
-	static void _mono_lr##bits(int##bits##_t *data, uint32_t length, int shift) \
+	static void _mono_lr##bits(const int##bits##_t *src, int##bits##_t *dst, int shift, uint32_t start, uint32_t end) \
 	{ \
-		uint32_t i = !shift, j; \
-		for (j = 0; j < length; j++, i += 2) \
-			data[j] = data[i]; \
+		uint32_t j; \
+		for (j = start; j < end; j++) \
+			dst[j] = src[2 * j + !shift]; \
 	}
 
 MONO_LR(8)
@@ -528,22 +968,32 @@ MONO_LR(16)
 
 #undef MONO_LR
 
+static void _mono_lr_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
+{
+	if (job->dst->flags & CHN_16BIT)
+		_mono_lr16((const int16_t *)job->src->data, (int16_t *)job->dst->data, job->param, start, end);
+	else
+		_mono_lr8(job->src->data, job->dst->data, job->param, start, end);
+}
+
 static inline void sample_mono_(song_sample_t *sample, int off)
 {
-	song_lock_audio();
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
+
+	if (!(sample->flags & CHN_STEREO))
+		return;
+	if (!sample_edit_begin(sample, &copy, sample->length, sample->flags & ~CHN_STEREO))
+		return;
+
+	job.func = _mono_lr_chunk;
+	job.src = sample;
+	job.dst = &copy;
+	job.param = off;
+	sample_edit_run(&job, copy.length);
+
 	/* stop any playing samples; we can crash if we don't do this */
-	csf_stop_sample(current_song, sample);
-	status.flags |= SONG_NEEDS_SAVE;
-	if (sample->flags & CHN_STEREO) {
-		if (sample->flags & CHN_16BIT)
-			_mono_lr16((int16_t *)sample->data, sample->length, off);
-		else
-			_mono_lr8((int8_t *)sample->data, sample->length, off);
-		sample->flags &= ~CHN_STEREO;
-	}
-	csf_adjust_sample_loop(sample);
-	memused_songchanged();
-	song_unlock_audio();
+	sample_edit_commit(sample, &copy, 1);
 }
 
 void sample_mono_left(song_sample_t * sample)
@@ -559,10 +1009,10 @@ void sample_mono_right(song_sample_t * sample)
 /* Crossfade sample */
 
 #define CROSSFADE(bits) \
-	static void _crossfade_##bits(const int##bits##_t *src1, const int##bits##_t *src2, int##bits##_t *dest, uint32_t fade_length, double e) \
+	static void _crossfade_##bits(const int##bits##_t *src1, const int##bits##_t *src2, int##bits##_t *dest, uint32_t fade_length, double e, uint32_t start, uint32_t end) \
 	{ \
 		const double len = (1.0 / fade_length); \
-		for (uint32_t i = 0; i < fade_length; i++) { \
+		for (uint32_t i = start; i < end; i++) { \
 			const double factor1 = pow(i * len, e); \
 			const double factor2 = pow((fade_length - i) * len, e); \
 	\
@@ -576,10 +1026,37 @@ CROSSFADE(16)
 
 #undef CROSSFADE
 
+/* fades the values at offset2 into the ones at offset1, in place */
+static void _crossfade_chunk(const struct sample_edit_job *job, uint32_t start, uint32_t end)
+{
+	song_sample_t *smp = job->dst;
+
+	if (smp->flags & CHN_16BIT)
+		_crossfade_16((int16_t *)smp->data + job->offset1, (int16_t *)smp->data + job->offset2, (int16_t *)smp->data + job->offset2, job->count, job->factor, start, end);
+	else
+		_crossfade_8((int8_t *)smp->data + job->offset1, (int8_t *)smp->data + job->offset2, (int8_t *)smp->data + job->offset2, job->count, job->factor, start, end);
+}
+
+static void sample_crossfade_run(struct sample_edit_job *job, uint32_t from, uint32_t to, uint32_t length)
+{
+	job->offset1 = from;
+	job->offset2 = to;
+
+	if (to - from >= length) {
+		sample_edit_run(job, length);
+	} else {
+		/* the fade overlaps the values it's reading from, so it has to
+		 * go front to back, the same way it always did */
+		job->count = length;
+		job->func(job, 0, length);
+	}
+}
+
 void sample_crossfade(song_sample_t *smp, uint32_t fade_length, int32_t law, int fade_after_loop, int sustain_loop)
 {
-	song_lock_audio();
-	status.flags |= SONG_NEEDS_SAVE;
+	song_sample_t copy;
+	struct sample_edit_job job = {0};
+
 	if (!smp->data) return;
 
 	const uint32_t loop_start = (sustain_loop) ? smp->sustain_start : smp->loop_start;
@@ -597,17 +1074,17 @@ void sample_crossfade(song_sample_t *smp, uint32_t fade_length, int32_t law, int
 	const uint32_t after_loop_len = MIN(smp->length - loop_end, fade_length) * channels;
 	fade_length *= channels;
 
+	if (!sample_edit_begin_copy(smp, &copy)) return;
+
+	job.func = _crossfade_chunk;
+	job.src = smp;
+	job.dst = &copy;
 	// e=0.5: constant power crossfade (for uncorrelated samples), e=1.0: constant volume crossfade (for perfectly correlated samples)
-	const double e = 1.0 - law / 200.0;
+	job.factor = 1.0 - law / 200.0;
 
-	if (smp->flags & CHN_16BIT) {
-		_crossfade_16((int16_t *)smp->data + start, (int16_t *)smp->data + end, (int16_t *)smp->data + end, fade_length, e);
-		if (fade_after_loop) _crossfade_16((int16_t *)smp->data + after_loop_start, (int16_t *)smp->data + after_loop_end, (int16_t *)smp->data + after_loop_end, after_loop_len, e);
-	} else {
-		_crossfade_8((int8_t *)smp->data + start, (int8_t *)smp->data + end, (int8_t *)smp->data + end, fade_length, e);
-		if (fade_after_loop) _crossfade_8((int8_t *)smp->data + after_loop_start, (int8_t *)smp->data + after_loop_end, (int8_t *)smp->data + after_loop_end, after_loop_len, e);
-	}
+	sample_crossfade_run(&job, start, end, fade_length);
+	if (fade_after_loop)
+		sample_crossfade_run(&job, after_loop_start, after_loop_end, after_loop_len);
 
-	csf_adjust_sample_loop(smp);
-	song_unlock_audio();
+	sample_edit_commit(smp, &copy, 0);
 }
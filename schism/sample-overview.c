@@ -0,0 +1,261 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "headers.h"
+
+#include "mem.h"
+#include "util.h"
+#include "sample-overview.h"
+
+#define SAMPLE_OVERVIEW_CACHE 4
+#define SAMPLE_OVERVIEW_MAX_LEVELS 32
+
+struct sample_overview {
+	/* what it was built from; data == NULL means the slot is free */
+	const signed char *data;
+	uint32_t length, flags;
+
+	uint32_t chans;
+	int bits;
+
+	/* level n has the peaks of every (SAMPLE_OVERVIEW_BLOCK << n) frames,
+	 * stored as [block][channel][min, max] */
+	uint32_t levels;
+	uint32_t count[SAMPLE_OVERVIEW_MAX_LEVELS];
+	int16_t *level[SAMPLE_OVERVIEW_MAX_LEVELS];
+
+	int16_t *buf;
+	uint32_t last_used;
+};
+
+static struct sample_overview overviews[SAMPLE_OVERVIEW_CACHE] = {0};
+static int32_t overview_frees = 0;
+static uint32_t overview_clock = 0;
+
+static void sample_overview_free(struct sample_overview *ov)
+{
+	free(ov->buf);
+	memset(ov, 0, sizeof(*ov));
+}
+
+void sample_overview_clear(void)
+{
+	int i;
+
+	for (i = 0; i < SAMPLE_OVERVIEW_CACHE; i++)
+		sample_overview_free(overviews + i);
+}
+
+void sample_overview_invalidate(const song_sample_t *sample)
+{
+	int i;
+
+	if (!sample->data)
+		return;
+
+	for (i = 0; i < SAMPLE_OVERVIEW_CACHE; i++)
+		if (overviews[i].data == sample->data)
+			sample_overview_free(overviews + i);
+}
+
+/* raw peaks, straight from the data */
+static void sample_overview_scan(const struct sample_overview *ov, uint32_t chan,
+	uint32_t start, uint32_t length, int32_t *min, int32_t *max)
+{
+	const size_t offset = (size_t)start * ov->chans + chan;
+
+	if (!length)
+		return;
+
+	if (ov->bits == 16) {
+		int16_t lo = INT16_MAX, hi = INT16_MIN;
+
+		minmax_16((const int16_t *)ov->data + offset, (size_t)length * ov->chans, &lo, &hi, ov->chans);
+		*min = MIN(*min, lo);
+		*max = MAX(*max, hi);
+	} else {
+		int8_t lo = INT8_MAX, hi = INT8_MIN;
+
+		minmax_8((const int8_t *)ov->data + offset, (size_t)length * ov->chans, &lo, &hi, ov->chans);
+		*min = MIN(*min, lo);
+		*max = MAX(*max, hi);
+	}
+}
+
+static void sample_overview_build(struct sample_overview *ov, const song_sample_t *sample)
+{
+	uint32_t n, c, i;
+	size_t total = 0;
+	int16_t *p;
+
+	ov->data = sample->data;
+	ov->length = sample->length;
+	ov->flags = sample->flags;
+	ov->chans = (sample->flags & CHN_STEREO) ? 2 : 1;
+	ov->bits = (sample->flags & CHN_16BIT) ? 16 : 8;
+
+	/* one block per SAMPLE_OVERVIEW_BLOCK frames (the last one may be
+	 * shorter), then halve it until there's only one left */
+	n = (sample->length + SAMPLE_OVERVIEW_BLOCK - 1) / SAMPLE_OVERVIEW_BLOCK;
+	for (ov->levels = 0; ov->levels < SAMPLE_OVERVIEW_MAX_LEVELS; ov->levels++) {
+		ov->count[ov->levels] = n;
+		total += (size_t)n * ov->chans * 2;
+		if (n == 1)
+			break;
+		n = (n + 1) / 2;
+	}
+	ov->levels++;
+
+	ov->buf = mem_alloc(total * sizeof(int16_t));
+
+	for (p = ov->buf, n = 0; n < ov->levels; n++) {
+		ov->level[n] = p;
+		p += (size_t)ov->count[n] * ov->chans * 2;
+	}
+
+	for (i = 0; i < ov->count[0]; i++) {
+		const uint32_t start = i * SAMPLE_OVERVIEW_BLOCK;
+		const uint32_t length = MIN(SAMPLE_OVERVIEW_BLOCK, sample->length - start);
+
+		for (c = 0; c < ov->chans; c++) {
+			int32_t min = INT32_MAX, max = INT32_MIN;
+			int16_t *out = ov->level[0] + ((size_t)i * ov->chans + c) * 2;
+
+			sample_overview_scan(ov, c, start, length, &min, &max);
+			out[0] = min;
+			out[1] = max;
+		}
+	}
+
+	for (n = 1; n < ov->levels; n++) {
+		const int16_t *src = ov->level[n - 1];
+		int16_t *dst = ov->level[n];
+
+		for (i = 0; i < ov->count[n]; i++) {
+			for (c = 0; c < ov->chans; c++) {
+				const int16_t *a = src + ((size_t)(2 * i) * ov->chans + c) * 2;
+				int16_t *out = dst + ((size_t)i * ov->chans + c) * 2;
+
+				if (2 * i + 1 < ov->count[n - 1]) {
+					const int16_t *b = a + ov->chans * 2;
+
+					out[0] = MIN(a[0], b[0]);
+					out[1] = MAX(a[1], b[1]);
+				} else {
+					out[0] = a[0];
+					out[1] = a[1];
+				}
+			}
+		}
+	}
+}
+
+const struct sample_overview *sample_overview_get(const song_sample_t *sample)
+{
+	struct sample_overview *ov, *victim = NULL;
+	int32_t frees;
+	int i;
+
+	if (!sample->data || sample->length < SAMPLE_OVERVIEW_MIN_LENGTH)
+		return NULL;
+
+	/* some sample was freed, so any of these could be pointing at
+	 * someone else's data now */
+	frees = atm_load(&csf_sample_frees);
+	if (overview_frees != frees) {
+		sample_overview_clear();
+		overview_frees = frees;
+	}
+
+	for (i = 0; i < SAMPLE_OVERVIEW_CACHE; i++) {
+		ov = overviews + i;
+
+		if (ov->data == sample->data) {
+			if (ov->length == sample->length
+			    && (ov->flags & (CHN_16BIT | CHN_STEREO)) == (sample->flags & (CHN_16BIT | CHN_STEREO))) {
+				ov->last_used = ++overview_clock;
+				return ov;
+			}
+
+			/* something changed the sample without saying so */
+			sample_overview_free(ov);
+		}
+
+		if (!victim || !ov->data || (victim->data && ov->last_used < victim->last_used))
+			victim = ov;
+	}
+
+	sample_overview_free(victim);
+	sample_overview_build(victim, sample);
+	victim->last_used = ++overview_clock;
+
+	return victim;
+}
+
+void sample_overview_minmax(const struct sample_overview *ov, uint32_t chan,
+	uint32_t start, uint32_t length, int32_t *min, int32_t *max)
+{
+	uint32_t end, first, last, n;
+
+	*min = INT32_MAX;
+	*max = INT32_MIN;
+
+	if (start >= ov->length)
+		return;
+
+	end = start + MIN(length, ov->length - start);
+
+	/* the blocks that are completely covered */
+	first = (start + SAMPLE_OVERVIEW_BLOCK - 1) / SAMPLE_OVERVIEW_BLOCK;
+	last = end / SAMPLE_OVERVIEW_BLOCK;
+	if (end == ov->length)
+		last = ov->count[0];
+
+	if (first >= last) {
+		sample_overview_scan(ov, chan, start, end - start, min, max);
+		return;
+	}
+
+	sample_overview_scan(ov, chan, start, first * SAMPLE_OVERVIEW_BLOCK - start, min, max);
+	if (last * SAMPLE_OVERVIEW_BLOCK < end)
+		sample_overview_scan(ov, chan, last * SAMPLE_OVERVIEW_BLOCK, end - last * SAMPLE_OVERVIEW_BLOCK, min, max);
+
+	/* now go up the levels, taking whatever sticks out on either side */
+	for (n = 0; first < last; n++) {
+		const int16_t *level = ov->level[n];
+
+		if (first & 1) {
+			*min = MIN(*min, level[((size_t)first * ov->chans + chan) * 2]);
+			*max = MAX(*max, level[((size_t)first * ov->chans + chan) * 2 + 1]);
+			first++;
+		}
+		if (last & 1) {
+			last--;
+			*min = MIN(*min, level[((size_t)last * ov->chans + chan) * 2]);
+			*max = MAX(*max, level[((size_t)last * ov->chans + chan) * 2 + 1]);
+		}
+
+		first /= 2;
+		last /= 2;
+	}
+}
@@ -100,6 +100,13 @@ int slurp(slurp_t *t, const char *filename, struct stat * buf, uint64_t size)
 	}
 
 finished: ; /* this semicolon is important because C */
+	slurp_unwrap(t);
+
+	return 0;
+}
+
+void slurp_unwrap(slurp_t *t)
+{
 #ifdef USE_ZLIB
 	/* do this before mmcmp handling, so gzip'd mmcmp'd modules
 	 * will load correctly
@@ -112,23 +119,10 @@ finished: ; /* this semicolon is important because C */
 	slurp_rewind(t);
 #endif
 
-	uint8_t *mmdata;
-	size_t mmlen;
-
-	if (mmcmp_unpack(t, &mmdata, &mmlen)) {
-		// clean up the existing data
-		if (t->closure)
-			t->closure(t);
-
-		// and put the new stuff in
-		slurp_memstream_free(t, mmdata, mmlen);
-	}
-
+	slurp_mmcmp(t);
 	slurp_rewind(t);
 
 	// TODO re-add PP20 unpacker, possibly also handle other formats?
-
-	return 0;
 }
 
 /* Initializes a slurp structure on an existing memory stream.
@@ -539,8 +533,11 @@ void slurp_sf2(slurp_t *s, slurp_t *in, int64_t off1, size_t len1,
 /* Replacement for seek() behavior for things that don't support
  * seeking, such as stdin or whatever
  *
- * FIXME: need to override slurp_seek, because if someone calls it with
- * SEEK_END we will totally fail. */
+ * By default, everything that has been read is kept in memory so that
+ * the stream can be seeked freely. Streams that are able to restart from
+ * the beginning (e.g. decompressors) can instead ask to keep only a window
+ * of data behind the current position; a seek back past the window will
+ * restart the stream, and from then on everything is kept. */
 
 struct slurp_nonseek {
 	void *opaque;
@@ -554,60 +551,203 @@ struct slurp_nonseek {
 	size_t (*read)(void *opaque, disko_t *ds, size_t size);
 	void (*closure)(void *opaque);
 
+	/* optional; restarts the stream from the beginning. returns negative on error */
+	int (*rewind)(void *opaque);
+
+	/* if nonzero, only keep about this many bytes behind the read position */
+	size_t window;
+
+	/* absolute position of the first byte in the buffer, and the read position */
+	int64_t base;
+	int64_t pos;
+
+	/* total length of the stream, if known */
+	uint64_t length;
+	unsigned int length_known : 1;
+
+	/* how big the stream is expected to be (zero if no clue); reported as
+	 * the length until the real one is known */
+	uint64_t size_hint;
+	/* the read function has run dry */
+	unsigned int done : 1;
+
 	/* disko memory buffer (note that pos should always equal length) */
 	disko_t ds;
 };
 
+static int slurp_nonseek_restart(slurp_t *fp)
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+
+	if (!ns->rewind || ns->rewind(ns->opaque) < 0)
+		return 0;
+
+	ns->ds.length = ns->ds.pos = 0;
+	ns->base = 0;
+	ns->done = 0;
+
+	/* obviously the window wasn't big enough; just keep it all */
+	ns->window = 0;
+
+	return 1;
+}
+
+/* drops anything in the buffer before 'keep' (if we're using a window) */
+static void slurp_nonseek_trim(slurp_t *fp, int64_t keep)
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+	size_t n;
+
+	/* don't bother shuffling memory around until there's a whole window to discard */
+	if (!ns->window || keep - ns->base < (int64_t)ns->window)
+		return;
+
+	n = MIN((uint64_t)(keep - ns->base), ns->ds.length);
+
+	memmove(ns->ds.data, ns->ds.data + n, ns->ds.length - n);
+	ns->ds.length -= n;
+	ns->ds.pos = ns->ds.length;
+	ns->base += n;
+}
+
+/* reads data until the buffer reaches 'target', dropping what's before 'keep' */
+static int slurp_nonseek_fill(slurp_t *fp, int64_t target, int64_t keep)
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+
+	while (target > ns->base + (int64_t)ns->ds.length) {
+		size_t r;
+
+		if (ns->done)
+			return 0;
+
+		r = ns->read(ns->opaque, &ns->ds, target - (ns->base + ns->ds.length));
+		if (!r) {
+			ns->done = 1;
+			ns->length = ns->base + ns->ds.length;
+			ns->length_known = 1;
+			return 0;
+		}
+
+		slurp_nonseek_trim(fp, keep);
+	}
+
+	return 1;
+}
+
 static int slurp_nonseek_available(slurp_t *fp, size_t x, int whence)
 {
 	struct slurp_nonseek *ns = fp->nonseek;
-	int64_t pos = x;
+	int64_t target = x, keep;
 
 	switch (whence) {
-	case SEEK_SET: break;
-	case SEEK_CUR: pos += fp->internal.memory.pos; break;
-	case SEEK_END: return !x;
+	case SEEK_SET:
+		/* if this is for a seek far ahead, the data at the current
+		 * position isn't worth holding on to */
+		keep = MAX(ns->pos, target - (int64_t)ns->window) - ns->window;
+		break;
+	case SEEK_CUR:
+		target += ns->pos;
+		keep = ns->pos - ns->window;
+		break;
+	default:
+	case SEEK_END:
+		return !x;
 	}
 
-	while (pos > (int64_t)ns->ds.length) {
-		size_t r = ns->read(ns->opaque, &ns->ds, pos - ns->ds.length);
-		if (!r)
-			return 0;
+	if (ns->length_known)
+		return (uint64_t)target <= ns->length;
+
+	if (target <= ns->base + (int64_t)ns->ds.length)
+		return 1;
+
+	return slurp_nonseek_fill(fp, target, keep);
+}
+
+static uint64_t slurp_nonseek_length(slurp_t *fp)
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+
+	if (ns->length_known)
+		return ns->length;
+
+	/* go by the hint unless what's been read so far says it's wrong, so that
+	 * asking for the length doesn't mean decoding the whole thing */
+	if (ns->size_hint && ns->size_hint >= (uint64_t)(ns->base + ns->ds.length))
+		return ns->size_hint;
+
+	/* otherwise we have to read in the whole thing to find out */
+	if (ns->base > 0)
+		slurp_nonseek_restart(fp);
+	ns->window = 0;
+
+	slurp_nonseek_fill(fp, INT64_MAX, 0);
+
+	return ns->length;
+}
+
+static int slurp_nonseek_seek(slurp_t *fp, int64_t offset, int whence)
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+
+	switch (whence) {
+	default:
+	case SEEK_SET:
+		break;
+	case SEEK_CUR:
+		offset += ns->pos;
+		break;
+	case SEEK_END:
+		offset += slurp_nonseek_length(fp);
+		break;
 	}
 
-	/* buffer may have changed */
-	fp->internal.memory.data = ns->ds.data;
-	fp->internal.memory.length = ns->ds.length;
+	if (offset < 0)
+		return -1;
 
-	return 1;
+	if (offset < ns->base && !slurp_nonseek_restart(fp))
+		return -1;
+
+	ns->pos = offset;
+	return 0;
+}
+
+static int64_t slurp_nonseek_tell(slurp_t *fp)
+{
+	return fp->nonseek->pos;
 }
 
 static size_t slurp_nonseek_peek(slurp_t *fp, void *buf, size_t size)
 {
-	/* available() will load up any data we're missing and update the buffer */
-	slurp_nonseek_available(fp, size, SEEK_CUR);
+	struct slurp_nonseek *ns = fp->nonseek;
+	int64_t end;
+
+	if (ns->pos < ns->base && !slurp_nonseek_restart(fp))
+		return 0;
 
-	return slurp_memory_peek_(fp, buf, size);
+	/* load up any data we're missing */
+	slurp_nonseek_fill(fp, ns->pos + size, ns->pos - ns->window);
+
+	end = ns->base + ns->ds.length;
+	if (ns->pos >= end)
+		return 0;
+
+	size = MIN((uint64_t)size, (uint64_t)(end - ns->pos));
+	memcpy(buf, ns->ds.data + (ns->pos - ns->base), size);
+
+	return size;
 }
 
 static void slurp_nonseek_closure(slurp_t *fp)
 {
 	struct slurp_nonseek *ns = fp->nonseek;
 
-	ns->closure(ns->opaque);
+	if (ns->closure)
+		ns->closure(ns->opaque);
 	disko_memclose(&ns->ds, 0);
 	free(ns);
 }
 
-static uint64_t slurp_nonseek_length(slurp_t *fp)
-{
-	/* Call available with maximum size to load the entire buffer;
-	 * allows us to read in the whole thing :) */
-	slurp_nonseek_available(fp, SIZE_MAX, SEEK_SET);
-
-	return fp->internal.memory.length;
-}
-
 int slurp_init_nonseek(slurp_t *fp,
 	size_t (*read_func)(void *opaque, disko_t *ds, size_t count),
 	void (*closure)(void *opaque),
@@ -619,12 +759,15 @@ int slurp_init_nonseek(slurp_t *fp,
 	ns->read = read_func;
 	ns->closure = closure;
 
-	if (disko_memopen(&ns->ds) < 0)
+	if (disko_memopen(&ns->ds) < 0) {
+		free(ns);
 		return -1;
+	}
 
-	/* initialize with bogus values */
-	slurp_memstream(fp, NULL, 0);
+	memset(fp, 0, sizeof(*fp));
 
+	fp->seek = slurp_nonseek_seek;
+	fp->tell = slurp_nonseek_tell;
 	fp->peek = slurp_nonseek_peek;
 	fp->closure = slurp_nonseek_closure;
 	fp->nonseek = ns;
@@ -634,6 +777,27 @@ int slurp_init_nonseek(slurp_t *fp,
 	return 0;
 }
 
+void slurp_nonseek_set_window(slurp_t *fp, size_t window, int (*rewind)(void *opaque))
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+
+	if (!ns)
+		return;
+
+	ns->window = rewind ? window : 0;
+	ns->rewind = rewind;
+}
+
+void slurp_nonseek_set_size_hint(slurp_t *fp, uint64_t size)
+{
+	struct slurp_nonseek *ns = fp->nonseek;
+
+	if (!ns)
+		return;
+
+	ns->size_hint = size;
+}
+
 /* --------------------------------------------------------------------- */
 
 int slurp_seek(slurp_t *t, int64_t offset, int whence)
@@ -753,6 +917,17 @@ uint64_t slurp_length(slurp_t *t)
 	return t->length(t);
 }
 
+const uint8_t *slurp_memory_data(slurp_t *t, size_t *length)
+{
+	/* anything that overrides peek (e.g. mmcmp) might not have
+	 * all of its data in place yet */
+	if (t->peek != slurp_memory_peek_)
+		return NULL;
+
+	*length = t->internal.memory.length;
+	return t->internal.memory.data;
+}
+
 int slurp_getc(slurp_t *t)
 {
 	/* just a wrapper around slurp_read() */
@@ -793,6 +968,28 @@ int slurp_receive(slurp_t *t, int (*callback)(const void *, size_t, void *), siz
 	}
 }
 
+int slurp_map(slurp_t *t, size_t count, size_t before, size_t after, struct slurp_mapping *m)
+{
+	if (!t->map || !count || slurp_limit_count(t, count) < count
+		|| !slurp_available(t, count, SEEK_CUR))
+		return 0;
+
+	if (!t->map(t, count, before, after, m))
+		return 0;
+
+	slurp_seek(t, count, SEEK_CUR);
+
+	return 1;
+}
+
+void slurp_unmap(struct slurp_mapping *m)
+{
+	if (m->unmap)
+		m->unmap(m);
+
+	memset(m, 0, sizeof(*m));
+}
+
 /* TODO actually test this function within slurp crap */
 int slurp_available(slurp_t *fp, size_t x, int whence)
 {
@@ -68,162 +68,179 @@ void timer_msleep(uint32_t ms)
 	backend->msleep(ms);
 }
 
-// A linked list of timers.
+// A pending oneshot timer.
 struct timer_oneshot_data_ {
 	void (*callback)(void *param);
 	void *param;
 
-	// Ticks until the oneshot should be called, in microseconds.
+	// When the oneshot should be called, in microseconds.
 	timer_ticks_t trigger;
 
-	struct timer_oneshot_data_ *next;
+	// Timers that trigger at the same time get called in the order
+	// they were added.
+	uint64_t seq;
 };
 
-// A list of pending timers that will be added to the real list
-// by the running thread.
-static struct timer_oneshot_data_ *oneshot_data_pending = NULL;
+// Pending timers, as a binary min-heap ordered by trigger time. The array
+// only ever grows, and it starts out big enough for any sane amount of
+// timers, so adding one normally doesn't allocate anything.
+#define TIMER_ONESHOT_PREALLOC 1024
 
-// this should NEVER be touched outside of the worker/thread
-static struct timer_oneshot_data_ *oneshot_data_list = NULL;
+static struct timer_oneshot_data_ *oneshot_heap = NULL;
+static size_t oneshot_heap_size = 0;
+static size_t oneshot_heap_alloc = 0;
+static uint64_t oneshot_seq = 0;
 
 #ifdef USE_THREADS
 /* XXX: these pointers ought to be atomic too. */
 static mt_thread_t *timer_oneshot_thread = NULL;
 static struct atm timer_oneshot_thread_cancelled = { 0 };
 
-/* this protects the oneshot PENDING list, not the actual
- * list itself (important!) */
+/* this protects the heap */
 static mt_mutex_t *timer_oneshot_mutex = NULL;
 static mt_cond_t *timer_oneshot_cond = NULL;
+#endif
 
-static int timer_oneshot_thread_func(SCHISM_UNUSED void *userdata)
+static inline int timer_oneshot_before(const struct timer_oneshot_data_ *a, const struct timer_oneshot_data_ *b)
 {
-	mt_mutex_lock(timer_oneshot_mutex);
+	return (a->trigger != b->trigger) ? (a->trigger < b->trigger) : (a->seq < b->seq);
+}
 
-	mt_thread_set_priority(MT_THREAD_PRIORITY_HIGH);
+// these two need the mutex
+static void timer_oneshot_push(void (*callback)(void *param), void *param, timer_ticks_t trigger)
+{
+	struct timer_oneshot_data_ data;
+	size_t i;
 
-	while (!atm_load(&timer_oneshot_thread_cancelled)) {
-		// Add any pending timers waiting to get added to the list.
-		if (oneshot_data_pending) {
-			if (oneshot_data_list) {
-				struct timer_oneshot_data_ *tail = oneshot_data_list;
-				while (tail->next)
-					tail = tail->next;
-				tail->next = oneshot_data_pending;
-			} else {
-				oneshot_data_list = oneshot_data_pending;
-			}
-
-			oneshot_data_pending = NULL;
-		}
+	if (oneshot_heap_size >= oneshot_heap_alloc) {
+		oneshot_heap_alloc = MAX(oneshot_heap_alloc * 2, TIMER_ONESHOT_PREALLOC);
+		oneshot_heap = mem_realloc(oneshot_heap, oneshot_heap_alloc * sizeof(*oneshot_heap));
+	}
 
-		mt_mutex_unlock(timer_oneshot_mutex);
+	data.callback = callback;
+	data.param = param;
+	data.trigger = trigger;
+	data.seq = oneshot_seq++;
 
-		timer_ticks_t wait = UINT64_MAX;
+	// sift up
+	for (i = oneshot_heap_size++; i > 0; ) {
+		size_t parent = (i - 1) / 2;
 
-		if (oneshot_data_list) {
-			struct timer_oneshot_data_ *data = oneshot_data_list, *prev = NULL;
-			timer_ticks_t now = timer_ticks_us();
+		if (!timer_oneshot_before(&data, &oneshot_heap[parent]))
+			break;
 
-			while (data) {
-				if (timer_ticks_passed(now, data->trigger)) {
-					data->callback(data->param);
+		oneshot_heap[i] = oneshot_heap[parent];
+		i = parent;
+	}
 
-					now = timer_ticks_us();
+	oneshot_heap[i] = data;
+}
 
-					// Remove the timer from the list
-					if (prev) {
-						prev->next = data->next;
-					} else {
-						oneshot_data_list = data->next;
-					}
+// takes the first timer off the heap if it's due
+static int timer_oneshot_pop(timer_ticks_t now, struct timer_oneshot_data_ *out)
+{
+	struct timer_oneshot_data_ last;
+	size_t i, child;
 
-					// free the data
-					void *old = data;
-					data = data->next;
-					free(old);
-				} else {
-					wait = MIN(wait, data->trigger - now);
+	if (!oneshot_heap_size || !timer_ticks_passed(now, oneshot_heap[0].trigger))
+		return 0;
 
-					prev = data;
-					data = data->next;
-				}
-			}
-		}
+	*out = oneshot_heap[0];
 
-		wait /= 1000; //usec to msec
+	// sift the last one down from the top
+	last = oneshot_heap[--oneshot_heap_size];
 
-		mt_mutex_lock(timer_oneshot_mutex);
+	for (i = 0; (child = 2 * i + 1) < oneshot_heap_size; i = child) {
+		if (child + 1 < oneshot_heap_size && timer_oneshot_before(&oneshot_heap[child + 1], &oneshot_heap[child]))
+			child++;
+
+		if (!timer_oneshot_before(&oneshot_heap[child], &last))
+			break;
+
+		oneshot_heap[i] = oneshot_heap[child];
+	}
+
+	if (oneshot_heap_size)
+		oneshot_heap[i] = last;
+
+	return 1;
+}
+
+#ifdef USE_THREADS
+static int timer_oneshot_thread_func(SCHISM_UNUSED void *userdata)
+{
+	mt_mutex_lock(timer_oneshot_mutex);
+
+	mt_thread_set_role(MT_THREAD_ROLE_TIMING);
+
+	while (!atm_load(&timer_oneshot_thread_cancelled)) {
+		struct timer_oneshot_data_ data;
+		timer_ticks_t now = timer_ticks_us();
+
+		if (timer_oneshot_pop(now, &data)) {
+			mt_mutex_unlock(timer_oneshot_mutex);
+			data.callback(data.param);
+			mt_mutex_lock(timer_oneshot_mutex);
+			continue;
+		}
+
+		if (!oneshot_heap_size) {
+			mt_cond_wait(timer_oneshot_cond, timer_oneshot_mutex);
+		} else if (oneshot_heap[0].trigger - now >= 1000) {
+			// this only goes by milliseconds, so it wakes up a bit
+			// early and sleeps the rest below
+			mt_cond_wait_timeout(timer_oneshot_cond, timer_oneshot_mutex,
+				(oneshot_heap[0].trigger - now) / 1000);
+		} else {
+			timer_ticks_t wait = oneshot_heap[0].trigger - now;
 
-		mt_cond_wait_timeout(timer_oneshot_cond, timer_oneshot_mutex, wait);
+			mt_mutex_unlock(timer_oneshot_mutex);
+			timer_usleep(wait);
+			mt_mutex_lock(timer_oneshot_mutex);
+		}
 	}
 
+	mt_mutex_unlock(timer_oneshot_mutex);
+
 	return 0;
 }
 #endif
 
 int timer_oneshot_worker(void)
 {
+	struct timer_oneshot_data_ data;
+
 #ifdef USE_THREADS
-	if (timer_oneshot_thread || backend->oneshot)
+	if (timer_oneshot_thread || (backend && backend->oneshot))
 		return 0; // do nothing
 
 	mt_mutex_lock(timer_oneshot_mutex);
+#else
+	if (backend && backend->oneshot)
+		return 0;
 #endif
 
-	// Add any pending timers waiting to get added to the list.
-	if (oneshot_data_pending) {
-		if (oneshot_data_list) {
-			struct timer_oneshot_data_ *tail = oneshot_data_list;
-			while (tail->next)
-				tail = tail->next;
-			tail->next = oneshot_data_pending;
-		} else {
-			oneshot_data_list = oneshot_data_pending;
-		}
-
-		oneshot_data_pending = NULL;
+	while (timer_oneshot_pop(timer_ticks_us(), &data)) {
+#ifdef USE_THREADS
+		mt_mutex_unlock(timer_oneshot_mutex);
+#endif
+		data.callback(data.param);
+#ifdef USE_THREADS
+		mt_mutex_lock(timer_oneshot_mutex);
+#endif
 	}
 
 #ifdef USE_THREADS
 	mt_mutex_unlock(timer_oneshot_mutex);
 #endif
 
-	if (oneshot_data_list) {
-		struct timer_oneshot_data_ *data = oneshot_data_list, *prev = NULL;
-		timer_ticks_t now = timer_ticks_us();
-
-		while (data) {
-			if (timer_ticks_passed(now, data->trigger)) {
-				data->callback(data->param);
-
-				now = timer_ticks_us();
-
-				// Remove the timer from the list
-				if (prev) {
-					prev->next = data->next;
-				} else {
-					oneshot_data_list = data->next;
-				}
-
-				// free the data
-				void *old = data;
-				data = data->next;
-				free(old);
-			} else {
-				prev = data;
-				data = data->next;
-			}
-		}
-	}
-
 	return 0;
 }
 
-void timer_oneshot(uint32_t ms, void (*callback)(void *param), void *param)
+void timer_oneshot_us(uint64_t usec, void (*callback)(void *param), void *param)
 {
-	if (backend->oneshot) {
-		backend->oneshot(ms, callback, param);
+	if (backend && backend->oneshot) {
+		backend->oneshot((usec + 999) / 1000, callback, param);
 		// mmmmmmmmm
 		return;
 	}
@@ -231,35 +248,27 @@ void timer_oneshot(uint32_t ms, void (*callback)(void *param), void *param)
 	// Ok, the backend doesn't support oneshots or it failed to make an event.
 	// Make a thread that "emulates" kernel-level events.
 
-	struct timer_oneshot_data_ *data = mem_alloc(sizeof(*data));
-
-	data->callback = callback;
-	data->param = param;
-	data->trigger = timer_ticks_us() + (ms * UINT64_C(1000));
-	data->next = NULL;
-
 #ifdef USE_THREADS
 	mt_mutex_lock(timer_oneshot_mutex);
 #endif
 
-	// append it to the list
-	if (oneshot_data_pending) {
-		struct timer_oneshot_data_ *tail = oneshot_data_pending;
-		while (tail->next)
-			tail = tail->next;
-		tail->next = data;
-	} else {
-		oneshot_data_pending = data;
-	}
+	timer_oneshot_push(callback, param, timer_ticks_us() + usec);
 
 #ifdef USE_THREADS
-	mt_mutex_unlock(timer_oneshot_mutex);
-
+	// signal while holding the mutex, so the thread can't miss it
+	// between looking at the heap and going to sleep
 	if (timer_oneshot_thread)
 		mt_cond_signal(timer_oneshot_cond);
+
+	mt_mutex_unlock(timer_oneshot_mutex);
 #endif
 }
 
+void timer_oneshot(uint32_t ms, void (*callback)(void *param), void *param)
+{
+	timer_oneshot_us(ms * UINT64_C(1000), callback, param);
+}
+
 int timer_init(void)
 {
 	static const schism_timer_backend_t *backends[] = {
@@ -293,8 +302,9 @@ int timer_init(void)
 		return 0;
 
 	if (!backend->oneshot) {
-		oneshot_data_pending = NULL;
-		oneshot_data_list = NULL;
+		oneshot_heap_size = 0;
+		oneshot_heap_alloc = TIMER_ONESHOT_PREALLOC;
+		oneshot_heap = mem_realloc(oneshot_heap, oneshot_heap_alloc * sizeof(*oneshot_heap));
 
 #ifdef USE_THREADS
 		timer_oneshot_mutex = mt_mutex_create();
@@ -317,8 +327,10 @@ void timer_quit(void)
 	// FIXME: When compiling with SDL3, this thread LEAKS,
 	// and I have no idea why.
 	if (timer_oneshot_thread) {
+		mt_mutex_lock(timer_oneshot_mutex);
 		atm_store(&timer_oneshot_thread_cancelled, 1);
 		mt_cond_signal(timer_oneshot_cond);
+		mt_mutex_unlock(timer_oneshot_mutex);
 		mt_thread_wait(timer_oneshot_thread, NULL);
 		timer_oneshot_thread = NULL;
 	}
@@ -329,6 +341,10 @@ void timer_quit(void)
 	}
 #endif
 
+	free(oneshot_heap);
+	oneshot_heap = NULL;
+	oneshot_heap_size = oneshot_heap_alloc = 0;
+
 	if (backend) {
 		backend->quit();
 		backend = NULL;
@@ -27,6 +27,8 @@
 #include "vgamem.h"
 #include "fonts.h"
 #include "song.h"
+#include "mem.h"
+#include "sample-overview.h"
 
 #define SAMPLE_DATA_COLOR 13 /* Sample data */
 #define SAMPLE_LOOP_COLOR 3 /* Sample loop marks */
@@ -144,6 +146,16 @@ static uint32_t vgamem_read[4000] = {0};
 
 static uint8_t ovl[640*400] = {0}; /* 256K */
 
+/* rows that changed since the last vgamem_get_dirty_rows, and rows that
+ * had an overlay put on them since the last flip (the pixel data isn't
+ * tracked, so those are always assumed to have changed) */
+static uint8_t vgamem_dirty[50] = {0};
+static uint8_t vgamem_ovl_rows[50] = {0};
+
+/* the font can be edited (or swapped out) at any time, in which case
+ * everything has to be scanned again */
+static uint8_t vgamem_font[2048 + 1024] = {0};
+
 #define CHECK_INVERT(tl,br,n) \
 do {                                            \
 	if (status.flags & INVERTED_PALETTE) {  \
@@ -155,7 +167,39 @@ do {                                            \
 
 void vgamem_flip(void)
 {
-	memcpy(vgamem_read, vgamem, sizeof(vgamem));
+	int y;
+
+	if (memcmp(vgamem_font, font_data, 2048) || memcmp(vgamem_font + 2048, font_half_data, 1024)) {
+		memcpy(vgamem_font, font_data, 2048);
+		memcpy(vgamem_font + 2048, font_half_data, 1024);
+		vgamem_dirty_all();
+	}
+
+	for (y = 0; y < 50; y++) {
+		if (vgamem_ovl_rows[y] || memcmp(vgamem_read + y * 80, vgamem + y * 80, 80 * sizeof(*vgamem))) {
+			memcpy(vgamem_read + y * 80, vgamem + y * 80, 80 * sizeof(*vgamem));
+			vgamem_dirty[y] = 1;
+		}
+	}
+
+	memset(vgamem_ovl_rows, 0, sizeof(vgamem_ovl_rows));
+}
+
+void vgamem_dirty_all(void)
+{
+	memset(vgamem_dirty, 1, sizeof(vgamem_dirty));
+}
+
+int vgamem_get_dirty_rows(uint8_t rows[50])
+{
+	int y, n = 0;
+
+	for (y = 0; y < 50; y++)
+		n += (rows[y] = vgamem_dirty[y]);
+
+	memset(vgamem_dirty, 0, sizeof(vgamem_dirty));
+
+	return n;
 }
 
 void vgamem_clear(void)
@@ -175,9 +219,11 @@ void vgamem_ovl_apply(struct vgamem_overlay *n)
 {
 	unsigned int x, y;
 
-	for (y = n->y1; y <= n->y2; y++)
+	for (y = n->y1; y <= n->y2; y++) {
 		for (x = n->x1; x <= n->x2; x++)
 			vgamem[x + (y*80)] = VGAMEM_FONT_OVERLAY;
+		vgamem_ovl_rows[y] = 1;
+	}
 }
 
 void vgamem_ovl_clear(struct vgamem_overlay *n, int color)
@@ -311,6 +357,89 @@ static const uint8_t uFFFD[] = {
 	0x7E, /* .XXXXXX. */
 };
 
+/* glyph cache for the 32-bit scanner: for every fg/bg pair that's been
+ * used, all 256 possible rows of eight pixels, already in the output
+ * format. that turns drawing a character into a 32-byte copy (or two
+ * 16-byte ones for half-width characters, which have two sets of colors).
+ * the mouse cursor is just more bits in the pattern, so that's free too.
+ *
+ * tables are allocated as they're needed; most of the time only a handful
+ * of pairs are actually on screen. the whole thing is thrown out whenever
+ * the palette changes. */
+static struct {
+	uint32_t tc[16];
+	uint32_t (*spans[256])[8]; /* [(fg << 4) | bg][pattern][pixel] */
+} vgamem_glyphs = {0};
+
+static void vgamem_glyphs_check(const uint32_t tc[16])
+{
+	int i;
+
+	if (!memcmp(vgamem_glyphs.tc, tc, sizeof(vgamem_glyphs.tc)))
+		return;
+
+	for (i = 0; i < 256; i++) {
+		free(vgamem_glyphs.spans[i]);
+		vgamem_glyphs.spans[i] = NULL;
+	}
+
+	memcpy(vgamem_glyphs.tc, tc, sizeof(vgamem_glyphs.tc));
+}
+
+static uint32_t (*vgamem_glyphs_make(uint_fast8_t fg, uint_fast8_t bg))[8]
+{
+	uint32_t (*spans)[8] = mem_alloc(256 * sizeof(*spans));
+	int p, x;
+
+	for (p = 0; p < 256; p++)
+		for (x = 0; x < 8; x++)
+			spans[p][x] = vgamem_glyphs.tc[(p & (0x80 >> x)) ? fg : bg];
+
+	return (vgamem_glyphs.spans[(fg << 4) | bg] = spans);
+}
+
+static inline SCHISM_ALWAYS_INLINE const uint32_t *vgamem_glyph_span(uint_fast8_t fg, uint_fast8_t bg, uint_fast8_t dg)
+{
+	uint32_t (*spans)[8] = vgamem_glyphs.spans[(fg << 4) | bg];
+
+	if (!spans)
+		spans = vgamem_glyphs_make(fg, bg);
+
+	return spans[dg & 0xFF];
+}
+
+/* writes out one row of a character; the 8- and 16-bit scanners just
+ * look up every pixel, since their tables would be larger than the
+ * work it saves */
+#define VGAMEM_PUT_ROW_GENERIC(out, tc, dg, fg, bg, fg2, bg2) \
+	do { \
+		*out++ = tc[(dg & 0x80) ? fg : bg]; \
+		*out++ = tc[(dg & 0x40) ? fg : bg]; \
+		*out++ = tc[(dg & 0x20) ? fg : bg]; \
+		*out++ = tc[(dg & 0x10) ? fg : bg]; \
+		*out++ = tc[(dg & 0x8) ? fg2 : bg2]; \
+		*out++ = tc[(dg & 0x4) ? fg2 : bg2]; \
+		*out++ = tc[(dg & 0x2) ? fg2 : bg2]; \
+		*out++ = tc[(dg & 0x1) ? fg2 : bg2]; \
+	} while (0)
+
+#define VGAMEM_PUT_ROW8 VGAMEM_PUT_ROW_GENERIC
+#define VGAMEM_PUT_ROW16 VGAMEM_PUT_ROW_GENERIC
+#define VGAMEM_PUT_ROW32(out, tc, dg, fg, bg, fg2, bg2) \
+	do { \
+		if (fg == fg2 && bg == bg2) { \
+			memcpy(out, vgamem_glyph_span(fg, bg, dg), 8 * sizeof(*out)); \
+		} else { \
+			memcpy(out, vgamem_glyph_span(fg, bg, dg), 4 * sizeof(*out)); \
+			memcpy(out + 4, vgamem_glyph_span(fg2, bg2, dg) + 4, 4 * sizeof(*out)); \
+		} \
+		out += 8; \
+	} while (0)
+
+#define VGAMEM_PREPARE8(tc)
+#define VGAMEM_PREPARE16(tc)
+#define VGAMEM_PREPARE32(tc) vgamem_glyphs_check(tc)
+
 /* generic scanner; BITS must be one of 8, 16, 32, 64
  *
  * okay, so turns out, my "new" scanner was only really
@@ -342,6 +471,8 @@ static const uint8_t uFFFD[] = {
 		const uint32_t *bp = &vgamem_read[y * 80]; \
 	\
 		uint_fast32_t x; \
+	\
+		VGAMEM_PREPARE##BITS(tc); \
 		for (x = 0; x < 80; x++, bp++, q += 8) { \
 			uint_fast8_t fg, bg, fg2, bg2, dg; \
 	\
@@ -427,14 +558,7 @@ static const uint8_t uFFFD[] = {
 			dg |= mouseline[x]; \
 			dg &= ~(mouseline_mask[x] ^ mouseline[x]); \
 	\
-			*out++ = tc[(dg & 0x80) ? fg : bg]; \
-			*out++ = tc[(dg & 0x40) ? fg : bg]; \
-			*out++ = tc[(dg & 0x20) ? fg : bg]; \
-			*out++ = tc[(dg & 0x10) ? fg : bg]; \
-			*out++ = tc[(dg & 0x8) ? fg2 : bg2]; \
-			*out++ = tc[(dg & 0x4) ? fg2 : bg2]; \
-			*out++ = tc[(dg & 0x2) ? fg2 : bg2]; \
-			*out++ = tc[(dg & 0x1) ? fg2 : bg2]; \
+			VGAMEM_PUT_ROW##BITS(out, tc, dg, fg, bg, fg2, bg2); \
 		} \
 	}
 
@@ -443,6 +567,13 @@ VGAMEM_SCANNER_VARIANT(16)
 VGAMEM_SCANNER_VARIANT(32)
 
 #undef VGAMEM_SCAN_VARIANT
+#undef VGAMEM_PUT_ROW_GENERIC
+#undef VGAMEM_PUT_ROW8
+#undef VGAMEM_PUT_ROW16
+#undef VGAMEM_PUT_ROW32
+#undef VGAMEM_PREPARE8
+#undef VGAMEM_PREPARE16
+#undef VGAMEM_PREPARE32
 
 void draw_char_unicode(uint32_t c, int x, int y, uint32_t fg, uint32_t bg)
 {
@@ -615,6 +746,20 @@ void draw_half_width_chars(uint8_t c1, uint8_t c2, int x, int y,
 		| (vgamem_pack_halfw(c2) << VGAMEM_HW_CHAR2_BIT));
 }
 
+void vgamem_get_cells(int x, int y, int len, uint32_t *cells)
+{
+	SCHISM_RUNTIME_ASSERT(x >= 0 && y >= 0 && x + len <= 80 && y < 50, "Coordinates should always be inbounds");
+
+	memcpy(cells, vgamem + x + (y*80), len * sizeof(*vgamem));
+}
+
+void vgamem_put_cells(int x, int y, int len, const uint32_t *cells)
+{
+	SCHISM_RUNTIME_ASSERT(x >= 0 && y >= 0 && x + len <= 80 && y < 50, "Coordinates should always be inbounds");
+
+	memcpy(vgamem + x + (y*80), cells, len * sizeof(*vgamem));
+}
+
 /* --------------------------------------------------------------------- */
 /* boxes */
 
@@ -775,7 +920,7 @@ void draw_vu_meter(int x, int y, int width, int val, int color, int peak)
 
 /* somewhat heavily based on CViewSample::DrawSampleData2 in modplug */
 #define DRAW_SAMPLE_DATA_VARIANT(bits, doublebits) \
-	static void _draw_sample_data_##bits(struct vgamem_overlay *r, \
+	static void _draw_sample_data_##bits(struct vgamem_overlay *r, const struct sample_overview *ov, \
 		int##bits##_t *data, uint32_t length, unsigned int inputchans, unsigned int outputchans) \
 	{ \
 		const int32_t nh = r->height / outputchans; \
@@ -801,7 +946,14 @@ void draw_vu_meter(int x, int y, int width, int val, int color, int peak)
 				scanlength = MAX(scanlength, 1); \
 	\
 				/* FIXME: this is wrong for outputting mono from stereo (only accounts for left channel) */ \
-				minmax_##bits(data + (poshi * inputchans) + (cc % inputchans), scanlength * inputchans, &min, &max, inputchans); \
+				if (ov) { \
+					int32_t ovmin, ovmax; \
+					sample_overview_minmax(ov, cc % inputchans, poshi, scanlength, &ovmin, &ovmax); \
+					min = ovmin; \
+					max = ovmax; \
+				} else { \
+					minmax_##bits(data + (poshi * inputchans) + (cc % inputchans), scanlength * inputchans, &min, &max, inputchans); \
+				} \
 	\
 				/* BUT IT'S WEB SCALE! */ \
 				min = rshift_signed((int##doublebits##_t)min * nh, bits); \
@@ -955,12 +1107,13 @@ void draw_sample_data(struct vgamem_overlay *r, song_sample_t *sample)
 
 	/* do the actual drawing */
 	int chans = sample->flags & CHN_STEREO ? 2 : 1;
+	const struct sample_overview *ov = sample_overview_get(sample);
 	if (sample->flags & CHN_16BIT)
-		_draw_sample_data_16(r, (signed short *) sample->data,
+		_draw_sample_data_16(r, ov, (signed short *) sample->data,
 				sample->length * chans,
 				chans, chans);
 	else
-		_draw_sample_data_8(r, sample->data,
+		_draw_sample_data_8(r, ov, sample->data,
 				sample->length * chans,
 				chans, chans);
 
@@ -975,7 +1128,7 @@ void draw_sample_data_rect_32(struct vgamem_overlay *r, int32_t *data,
 	int length, unsigned int inputchans, unsigned int outputchans)
 {
 	vgamem_ovl_clear(r, 0);
-	_draw_sample_data_32(r, data, length, inputchans, outputchans);
+	_draw_sample_data_32(r, NULL, data, length, inputchans, outputchans);
 	vgamem_ovl_apply(r);
 }
 
@@ -983,7 +1136,7 @@ void draw_sample_data_rect_16(struct vgamem_overlay *r, int16_t *data,
 	int length, unsigned int inputchans, unsigned int outputchans)
 {
 	vgamem_ovl_clear(r, 0);
-	_draw_sample_data_16(r, data, length, inputchans, outputchans);
+	_draw_sample_data_16(r, NULL, data, length, inputchans, outputchans);
 	vgamem_ovl_apply(r);
 }
 
@@ -991,6 +1144,6 @@ void draw_sample_data_rect_8(struct vgamem_overlay *r, int8_t *data,
 	int length, unsigned int inputchans, unsigned int outputchans)
 {
 	vgamem_ovl_clear(r, 0);
-	_draw_sample_data_8(r, data, length, inputchans, outputchans);
+	_draw_sample_data_8(r, NULL, data, length, inputchans, outputchans);
 	vgamem_ovl_apply(r);
 }
@@ -33,6 +33,7 @@
 #include "video.h"
 #include "osdefs.h"
 #include "vgamem.h"
+#include "cpu.h"
 
 #include "backend/video.h"
 
@@ -145,6 +146,14 @@ static struct {
 	} mouse;
 
 	uint32_t tc_bgr32[256];
+
+	/* where the software cursor was when the dirty rows were last
+	 * collected, so that they can include wherever it moved from */
+	struct {
+		int drawn;
+		enum video_mousecursor_shape shape;
+		uint32_t x, y;
+	} last_mouse;
 } video = {
 	.mouse = {
 		.visible = MOUSE_EMULATED,
@@ -282,16 +291,234 @@ static void make_mouseline(unsigned int x, unsigned int v, unsigned int y,
 #define FIXED2INT(x) ((x) >> FIXED_BITS)
 #define FRAC(x) ((x) & FIXED_MASK)
 
+/* Interpolates 'count' pixels of an output line between two scanned lines,
+ * starting at output column 'x'. The results are written to 'out' as
+ * 0x00RRGGBB, to be handed off to map_rgb afterwards. */
+static void blitln_row_c(uint32_t *out, const uint32_t *csp, const uint32_t *esp,
+	uint32_t x, uint32_t count, uint32_t scalex, uint32_t ey)
+{
+	uint32_t c00, c01, c10, c11;
+	uint32_t outr, outg, outb;
+	uint32_t fixedx, ex, t1, t2;
+
+	for (fixedx = x * scalex; count > 0; count--, fixedx += scalex) {
+		ex = FRAC(fixedx);
+
+		c00 = csp[FIXED2INT(fixedx)];
+		c01 = csp[FIXED2INT(fixedx) + 1];
+		c10 = esp[FIXED2INT(fixedx)];
+		c11 = esp[FIXED2INT(fixedx) + 1];
+
+#if FIXED_BITS <= 8
+		/* When there are enough bits between blue and
+		 * red, do the RB channels together
+		 * See http://www.virtualdub.org/blog/pivot/entry.php?id=117
+		 * for a quick explanation */
+#define REDBLUE(Q) ((Q) & 0x00FF00FF)
+#define GREEN(Q) ((Q) & 0x0000FF00)
+		t1 = REDBLUE((((REDBLUE(c01)-REDBLUE(c00))*ex) >> FIXED_BITS)+REDBLUE(c00));
+		t2 = REDBLUE((((REDBLUE(c11)-REDBLUE(c10))*ex) >> FIXED_BITS)+REDBLUE(c10));
+		outb = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
+
+		t1 = GREEN((((GREEN(c01)-GREEN(c00))*ex) >> FIXED_BITS)+GREEN(c00));
+		t2 = GREEN((((GREEN(c11)-GREEN(c10))*ex) >> FIXED_BITS)+GREEN(c10));
+		outg = (((((t2-t1)*ey) >> FIXED_BITS) + t1) >> 8) & 0xFF;
+
+		outr = (outb >> 16) & 0xFF;
+		outb &= 0xFF;
+#undef REDBLUE
+#undef GREEN
+#else
+#define BLUE(Q) (Q & 255)
+#define GREEN(Q) ((Q >> 8) & 255)
+#define RED(Q) ((Q >> 16) & 255)
+		t1 = ((((BLUE(c01)-BLUE(c00))*ex) >> FIXED_BITS)+BLUE(c00)) & 0xFF;
+		t2 = ((((BLUE(c11)-BLUE(c10))*ex) >> FIXED_BITS)+BLUE(c10)) & 0xFF;
+		outb = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
+
+		t1 = ((((GREEN(c01)-GREEN(c00))*ex) >> FIXED_BITS)+GREEN(c00)) & 0xFF;
+		t2 = ((((GREEN(c11)-GREEN(c10))*ex) >> FIXED_BITS)+GREEN(c10)) & 0xFF;
+		outg = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
+
+		t1 = ((((RED(c01)-RED(c00))*ex) >> FIXED_BITS)+RED(c00)) & 0xFF;
+		t2 = ((((RED(c11)-RED(c10))*ex) >> FIXED_BITS)+RED(c10)) & 0xFF;
+		outr = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
+#undef RED
+#undef GREEN
+#undef BLUE
+#endif
+
+		*out++ = (outr << 16) | (outg << 8) | outb;
+	}
+}
+
+/* The vector versions do exactly the same math as the 8-bit path above,
+ * wraparound and all, so that they give the same picture down to the bit.
+ * Pixels that don't fill up a whole vector go through the C version. */
+#if FIXED_BITS == 8 \
+	&& SCHISM_GNUC_HAS_ATTRIBUTE(__target__, 4, 4, 0) \
+	&& !defined(SCHISM_XBOX) /* XBOX is hardcoded to i586 */ \
+	&& (defined(__x86_64__) || defined(__i386__)) /* clang on macosx LIES */
+
+# include <immintrin.h>
+
+# ifdef SCHISM_SSE2
+/* SSE2 has no 32-bit multiply, so build one out of the 16-bit multiplies.
+ * 'e' is an 8-bit weight, repeated in both halves of every lane. */
+#  define BLITLN_MUL_SSE2(a, e) \
+	_mm_add_epi32(_mm_mullo_epi16((a), (e)), _mm_slli_epi32(_mm_mulhi_epu16((a), (e)), 16))
+
+#  define BLITLN_LERP_SSE2(a, b, e, mask) \
+	_mm_and_si128(_mm_add_epi32(_mm_srli_epi32(BLITLN_MUL_SSE2(_mm_sub_epi32( \
+		_mm_and_si128((b), (mask)), _mm_and_si128((a), (mask))), (e)), FIXED_BITS), \
+		_mm_and_si128((a), (mask))), (mask))
+
+__attribute__((__target__("sse2")))
+static void blitln_row_sse2(uint32_t *out, const uint32_t *csp, const uint32_t *esp,
+	uint32_t x, uint32_t count, uint32_t scalex, uint32_t ey)
+{
+	const __m128i redblue = _mm_set1_epi32(0x00FF00FF);
+	const __m128i green = _mm_set1_epi32(0x0000FF00);
+	const __m128i frac = _mm_set1_epi32(FIXED_MASK);
+	const __m128i vey = _mm_set1_epi32(ey | (ey << 16));
+	const __m128i step = _mm_set1_epi32(scalex * 4);
+	__m128i fixedx = _mm_setr_epi32(x * scalex, (x + 1) * scalex, (x + 2) * scalex, (x + 3) * scalex);
+
+	for (; count >= 4; count -= 4, x += 4, out += 4) {
+		union {
+			__m128i v;
+			uint32_t u[4];
+		} ix;
+		__m128i ex, c00, c01, c10, c11, t1, t2, outrb, outg;
+
+		ix.v = _mm_srli_epi32(fixedx, FIXED_BITS);
+		ex = _mm_and_si128(fixedx, frac);
+		ex = _mm_or_si128(ex, _mm_slli_epi32(ex, 16));
+
+		c00 = _mm_setr_epi32(csp[ix.u[0]], csp[ix.u[1]], csp[ix.u[2]], csp[ix.u[3]]);
+		c01 = _mm_setr_epi32(csp[ix.u[0] + 1], csp[ix.u[1] + 1], csp[ix.u[2] + 1], csp[ix.u[3] + 1]);
+		c10 = _mm_setr_epi32(esp[ix.u[0]], esp[ix.u[1]], esp[ix.u[2]], esp[ix.u[3]]);
+		c11 = _mm_setr_epi32(esp[ix.u[0] + 1], esp[ix.u[1] + 1], esp[ix.u[2] + 1], esp[ix.u[3] + 1]);
+
+		t1 = BLITLN_LERP_SSE2(c00, c01, ex, redblue);
+		t2 = BLITLN_LERP_SSE2(c10, c11, ex, redblue);
+		outrb = _mm_add_epi32(_mm_srli_epi32(BLITLN_MUL_SSE2(_mm_sub_epi32(t2, t1), vey), FIXED_BITS), t1);
+
+		t1 = BLITLN_LERP_SSE2(c00, c01, ex, green);
+		t2 = BLITLN_LERP_SSE2(c10, c11, ex, green);
+		outg = _mm_add_epi32(_mm_srli_epi32(BLITLN_MUL_SSE2(_mm_sub_epi32(t2, t1), vey), FIXED_BITS), t1);
+
+		_mm_storeu_si128((__m128i *)out,
+			_mm_or_si128(_mm_and_si128(outrb, redblue), _mm_and_si128(outg, green)));
+
+		fixedx = _mm_add_epi32(fixedx, step);
+	}
+
+	blitln_row_c(out, csp, esp, x, count, scalex, ey);
+}
+
+#  undef BLITLN_LERP_SSE2
+#  undef BLITLN_MUL_SSE2
+#  define BLITLN_SSE2
+# endif
+
+# ifdef SCHISM_AVX2
+#  define BLITLN_LERP_AVX2(a, b, e, mask) \
+	_mm256_and_si256(_mm256_add_epi32(_mm256_srli_epi32(_mm256_mullo_epi32(_mm256_sub_epi32( \
+		_mm256_and_si256((b), (mask)), _mm256_and_si256((a), (mask))), (e)), FIXED_BITS), \
+		_mm256_and_si256((a), (mask))), (mask))
+
+__attribute__((__target__("avx2")))
+static void blitln_row_avx2(uint32_t *out, const uint32_t *csp, const uint32_t *esp,
+	uint32_t x, uint32_t count, uint32_t scalex, uint32_t ey)
+{
+	const __m256i redblue = _mm256_set1_epi32(0x00FF00FF);
+	const __m256i green = _mm256_set1_epi32(0x0000FF00);
+	const __m256i frac = _mm256_set1_epi32(FIXED_MASK);
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i vey = _mm256_set1_epi32(ey);
+	const __m256i step = _mm256_set1_epi32(scalex * 8);
+	__m256i fixedx = _mm256_add_epi32(_mm256_set1_epi32(x * scalex),
+		_mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(scalex)));
+
+	for (; count >= 8; count -= 8, x += 8, out += 8) {
+		__m256i ix, ix1, ex, c00, c01, c10, c11, t1, t2, outrb, outg;
+
+		ix = _mm256_srli_epi32(fixedx, FIXED_BITS);
+		ix1 = _mm256_add_epi32(ix, one);
+		ex = _mm256_and_si256(fixedx, frac);
+
+		c00 = _mm256_i32gather_epi32((const int *)csp, ix, 4);
+		c01 = _mm256_i32gather_epi32((const int *)csp, ix1, 4);
+		c10 = _mm256_i32gather_epi32((const int *)esp, ix, 4);
+		c11 = _mm256_i32gather_epi32((const int *)esp, ix1, 4);
+
+		t1 = BLITLN_LERP_AVX2(c00, c01, ex, redblue);
+		t2 = BLITLN_LERP_AVX2(c10, c11, ex, redblue);
+		outrb = _mm256_add_epi32(_mm256_srli_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(t2, t1), vey), FIXED_BITS), t1);
+
+		t1 = BLITLN_LERP_AVX2(c00, c01, ex, green);
+		t2 = BLITLN_LERP_AVX2(c10, c11, ex, green);
+		outg = _mm256_add_epi32(_mm256_srli_epi32(_mm256_mullo_epi32(_mm256_sub_epi32(t2, t1), vey), FIXED_BITS), t1);
+
+		_mm256_storeu_si256((__m256i *)out,
+			_mm256_or_si256(_mm256_and_si256(outrb, redblue), _mm256_and_si256(outg, green)));
+
+		fixedx = _mm256_add_epi32(fixedx, step);
+	}
+
+	blitln_row_c(out, csp, esp, x, count, scalex, ey);
+}
+
+#  undef BLITLN_LERP_AVX2
+#  define BLITLN_AVX2
+# endif
+#endif
+
+video_blitLN_row_spec video_blitLN_row(int feature)
+{
+	switch (feature) {
+	case -1:
+		return blitln_row_c;
+#ifdef BLITLN_AVX2
+	case CPU_FEATURE_AVX2:
+		return cpu_has_feature(CPU_FEATURE_AVX2) ? blitln_row_avx2 : NULL;
+#endif
+#ifdef BLITLN_SSE2
+	case CPU_FEATURE_SSE2:
+		return cpu_has_feature(CPU_FEATURE_SSE2) ? blitln_row_sse2 : NULL;
+#endif
+	default:
+		return NULL;
+	}
+}
+
+static video_blitLN_row_spec blitln_row_select(void)
+{
+	static const int features[] = {CPU_FEATURE_AVX2, CPU_FEATURE_SSE2};
+	video_blitLN_row_spec row;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(features); i++)
+		if ((row = video_blitLN_row(features[i])))
+			return row;
+
+	return blitln_row_c;
+}
+
+#undef BLITLN_AVX2
+#undef BLITLN_SSE2
+
 void video_blitLN(unsigned int bpp, unsigned char *pixels, unsigned int pitch, schism_map_rgb_spec map_rgb, void *map_rgb_data, uint32_t width, uint32_t height)
 {
 	unsigned char cv32backing[NATIVE_SCREEN_WIDTH * 8];
+	uint32_t row[256];
 
+	const video_blitLN_row_spec blit_row = blitln_row_select();
 	uint32_t *csp, *esp, *dp;
-	uint32_t c00, c01, c10, c11;
-	uint32_t outr, outg, outb;
 	uint32_t pad;
-	int32_t fixedx, fixedy, scalex, scaley;
-	uint32_t y, x,ey,ex,t1,t2;
+	int32_t fixedy, scalex, scaley;
+	uint32_t y, x, i, count;
 	uint32_t mouseline[80];
 	uint32_t mouseline_mask[80];
 	unsigned int mouseline_x, mouseline_v;
@@ -323,76 +550,35 @@ void video_blitLN(unsigned int bpp, unsigned char *pixels, unsigned int pitch, s
 			}
 			lasty = iny;
 		}
-		for (x = 0, fixedx = 0; x < width; x++, fixedx += scalex) {
-			ex = FRAC(fixedx);
-			ey = FRAC(fixedy);
+		for (x = 0; x < width; x += count) {
+			count = MIN(width - x, ARRAY_SIZE(row));
 
-			c00 = csp[FIXED2INT(fixedx)];
-			c01 = csp[FIXED2INT(fixedx) + 1];
-			c10 = esp[FIXED2INT(fixedx)];
-			c11 = esp[FIXED2INT(fixedx) + 1];
-
-#if FIXED_BITS <= 8
-			/* When there are enough bits between blue and
-			 * red, do the RB channels together
-			 * See http://www.virtualdub.org/blog/pivot/entry.php?id=117
-			 * for a quick explanation */
-#define REDBLUE(Q) ((Q) & 0x00FF00FF)
-#define GREEN(Q) ((Q) & 0x0000FF00)
-			t1 = REDBLUE((((REDBLUE(c01)-REDBLUE(c00))*ex) >> FIXED_BITS)+REDBLUE(c00));
-			t2 = REDBLUE((((REDBLUE(c11)-REDBLUE(c10))*ex) >> FIXED_BITS)+REDBLUE(c10));
-			outb = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
-
-			t1 = GREEN((((GREEN(c01)-GREEN(c00))*ex) >> FIXED_BITS)+GREEN(c00));
-			t2 = GREEN((((GREEN(c11)-GREEN(c10))*ex) >> FIXED_BITS)+GREEN(c10));
-			outg = (((((t2-t1)*ey) >> FIXED_BITS) + t1) >> 8) & 0xFF;
-
-			outr = (outb >> 16) & 0xFF;
-			outb &= 0xFF;
-#undef REDBLUE
-#undef GREEN
-#else
-#define BLUE(Q) (Q & 255)
-#define GREEN(Q) ((Q >> 8) & 255)
-#define RED(Q) ((Q >> 16) & 255)
-			t1 = ((((BLUE(c01)-BLUE(c00))*ex) >> FIXED_BITS)+BLUE(c00)) & 0xFF;
-			t2 = ((((BLUE(c11)-BLUE(c10))*ex) >> FIXED_BITS)+BLUE(c10)) & 0xFF;
-			outb = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
-
-			t1 = ((((GREEN(c01)-GREEN(c00))*ex) >> FIXED_BITS)+GREEN(c00)) & 0xFF;
-			t2 = ((((GREEN(c11)-GREEN(c10))*ex) >> FIXED_BITS)+GREEN(c10)) & 0xFF;
-			outg = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
-
-			t1 = ((((RED(c01)-RED(c00))*ex) >> FIXED_BITS)+RED(c00)) & 0xFF;
-			t2 = ((((RED(c11)-RED(c10))*ex) >> FIXED_BITS)+RED(c10)) & 0xFF;
-			outr = ((((t2-t1)*ey) >> FIXED_BITS) + t1);
-#undef RED
-#undef GREEN
-#undef BLUE
-#endif
+			blit_row(row, csp, esp, x, count, scalex, FRAC(fixedy));
 
-			uint32_t c = map_rgb(map_rgb_data, outr, outg, outb);
+			for (i = 0; i < count; i++) {
+				uint32_t c = map_rgb(map_rgb_data, (row[i] >> 16) & 0xFF, (row[i] >> 8) & 0xFF, row[i] & 0xFF);
 
-			switch (bpp) {
-			case 1: *(uint8_t*)pixels = c; break;
-			case 2: *(uint16_t*)pixels = c; break;
-			case 3:
-				// convert 32-bit to 24-bit
+				switch (bpp) {
+				case 1: *(uint8_t*)pixels = c; break;
+				case 2: *(uint16_t*)pixels = c; break;
+				case 3:
+					// convert 32-bit to 24-bit
 #ifdef WORDS_BIGENDIAN
-				*pixels++ = ((char *)&c)[1];
-				*pixels++ = ((char *)&c)[2];
-				*pixels++ = ((char *)&c)[3];
+					*pixels++ = ((char *)&c)[1];
+					*pixels++ = ((char *)&c)[2];
+					*pixels++ = ((char *)&c)[3];
 #else
-				*pixels++ = ((char *)&c)[0];
-				*pixels++ = ((char *)&c)[1];
-				*pixels++ = ((char *)&c)[2];
+					*pixels++ = ((char *)&c)[0];
+					*pixels++ = ((char *)&c)[1];
+					*pixels++ = ((char *)&c)[2];
 #endif
-				break;
-			case 4: *(uint32_t*)pixels = c; break;
-			default: break;
-			}
+					break;
+				case 4: *(uint32_t*)pixels = c; break;
+				default: break;
+				}
 
-			pixels += bpp;
+				pixels += bpp;
+			}
 		}
 		pixels += pad;
 	}
@@ -532,6 +718,11 @@ void video_blitTV(unsigned char *pixels, unsigned int pitch, uint32_t tpal[256])
 }
 
 void video_blit11(unsigned int bpp, unsigned char *pixels, unsigned int pitch, uint32_t tpal[256])
+{
+	video_blit11_rows(bpp, pixels, pitch, tpal, 0, NATIVE_SCREEN_HEIGHT);
+}
+
+void video_blit11_rows(unsigned int bpp, unsigned char *pixels, unsigned int pitch, uint32_t tpal[256], uint32_t first, uint32_t count)
 {
 	uint32_t cv32backing[NATIVE_SCREEN_WIDTH];
 	const unsigned int mouseline_x = (video.mouse.x / 8);
@@ -540,7 +731,7 @@ void video_blit11(unsigned int bpp, unsigned char *pixels, unsigned int pitch, u
 	uint32_t mouseline[80];
 	uint32_t mouseline_mask[80];
 
-	for (y = 0; y < NATIVE_SCREEN_HEIGHT; y++) {
+	for (y = first; y < first + count; y++) {
 		make_mouseline(mouseline_x, mouseline_v, y, mouseline, mouseline_mask, video.mouse.y);
 		switch (bpp) {
 		case 1:
@@ -575,6 +766,43 @@ void video_blit11(unsigned int bpp, unsigned char *pixels, unsigned int pitch, u
 	}
 }
 
+/* marks the rows of characters the cursor covers at 'y' */
+static void video_dirty_cursor_rows(uint8_t rows[NATIVE_SCREEN_HEIGHT / 8], enum video_mousecursor_shape shape, uint32_t y)
+{
+	const struct mouse_cursor *cursor = &cursors[shape];
+	uint32_t top = (y > cursor->center_y) ? (y - cursor->center_y) : 0;
+	uint32_t bottom = MIN(y + cursor->height - cursor->center_y, NATIVE_SCREEN_HEIGHT - 1);
+
+	for (top /= 8, bottom /= 8; top <= bottom; top++)
+		rows[top] = 1;
+}
+
+int video_get_dirty_rows(uint8_t rows[NATIVE_SCREEN_HEIGHT / 8])
+{
+	const int drawn = (video_mousecursor_visible() == MOUSE_EMULATED && video_is_focused());
+	int y, n;
+
+	vgamem_get_dirty_rows(rows);
+
+	if (drawn != video.last_mouse.drawn || (drawn && (video.mouse.x != video.last_mouse.x
+			|| video.mouse.y != video.last_mouse.y || video.mouse.shape != video.last_mouse.shape))) {
+		if (video.last_mouse.drawn)
+			video_dirty_cursor_rows(rows, video.last_mouse.shape, video.last_mouse.y);
+		if (drawn)
+			video_dirty_cursor_rows(rows, video.mouse.shape, video.mouse.y);
+
+		video.last_mouse.drawn = drawn;
+		video.last_mouse.shape = video.mouse.shape;
+		video.last_mouse.x = video.mouse.x;
+		video.last_mouse.y = video.mouse.y;
+	}
+
+	for (y = 0, n = 0; y < NATIVE_SCREEN_HEIGHT / 8; y++)
+		n += rows[y];
+
+	return n;
+}
+
 /* scaled blit, according to user settings (lots of params here) */
 void video_blitSC(uint32_t bpp, unsigned char *pixels, uint32_t pitch, uint32_t pal[256], schism_map_rgb_spec fun, void *fun_data, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
 {
@@ -735,7 +963,10 @@ void video_colors(unsigned char palette[16][3])
 {
 	video_colors_iterate(palette, bgr32_fun_);
 
-	backend->colors(palette);
+	if (backend)
+		backend->colors(palette);
+
+	vgamem_dirty_all();
 }
 
 int video_is_focused(void)
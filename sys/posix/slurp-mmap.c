@@ -28,12 +28,55 @@
 
 #include "slurp.h"
 
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+# define MAP_ANONYMOUS MAP_ANON
+#endif
+
 static void munmap_slurp_(slurp_t *fp)
 {
 	(void)munmap((void*)fp->internal.memory.data, fp->internal.memory.length);
 	(void)close(fp->internal.memory.interfaces.mmap.fd);
 }
 
+#ifdef MAP_ANONYMOUS
+static void munmap_slurp_mapping_(struct slurp_mapping *m)
+{
+	(void)munmap(m->base, m->size);
+}
+
+/* The data is mapped copy-on-write, so pages that are only read stay
+ * shared with the page cache. The padding on either side is anonymous
+ * memory, so it doesn't matter where in the file the data starts. */
+static int mmap_slurp_map_(slurp_t *fp, size_t count, size_t before, size_t after, struct slurp_mapping *m)
+{
+	const size_t page = sysconf(_SC_PAGESIZE);
+	const size_t pos = fp->internal.memory.pos;
+	const size_t lead = pos % page;
+	const size_t prepend = (before + page - 1) / page * page;
+	const size_t filelen = (lead + count + page - 1) / page * page;
+	const size_t size = prepend + (lead + count + after + page - 1) / page * page;
+	uint8_t *base, *data;
+
+	base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (base == MAP_FAILED)
+		return 0;
+
+	data = mmap(base + prepend, filelen, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+		fp->internal.memory.interfaces.mmap.fd, pos - lead);
+	if (data == MAP_FAILED) {
+		(void)munmap(base, size);
+		return 0;
+	}
+
+	m->data = data + lead;
+	m->base = base;
+	m->size = size;
+	m->unmap = munmap_slurp_mapping_;
+
+	return 1;
+}
+#endif
+
 int slurp_mmap(slurp_t *fp, const char *filename, uint64_t st)
 {
 	/* don't overflow if sizeof(uint64_t) > sizeof(size_t) */
@@ -60,6 +103,9 @@ int slurp_mmap(slurp_t *fp, const char *filename, uint64_t st)
 	slurp_memstream(fp, addr, st);
 
 	fp->closure = munmap_slurp_;
+#ifdef MAP_ANONYMOUS
+	fp->map = mmap_slurp_map_;
+#endif
 	fp->internal.memory.interfaces.mmap.fd = fd;
 
 	return SLURP_OPEN_SUCCESS;
@@ -384,6 +384,9 @@ got_format:
 	video.bpp = SDL_BYTESPERPIXEL(video.format);
 
 	video_recalculate_fixed_width();
+
+	// the new texture has nothing in it yet
+	vgamem_dirty_all();
 }
 
 static void sdl2_video_set_hardware(int hardware)
@@ -775,31 +778,56 @@ SCHISM_HOT static void sdl2_video_blit(void)
 
 		sdl2_RenderClear(video.u.r.renderer);
 
-		sdl2_LockTexture(video.u.r.texture, NULL, (void **)&pixels, &pitch);
-
 		switch (video.format) {
 		case SDL_PIXELFORMAT_IYUV: {
+			sdl2_LockTexture(video.u.r.texture, NULL, (void **)&pixels, &pitch);
 			video_blitUV(pixels, pitch, video.yuv.pal_y);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch);
 			video_blitTV(pixels, pitch, video.yuv.pal_u);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch) / 4;
 			video_blitTV(pixels, pitch, video.yuv.pal_v);
+			sdl2_UnlockTexture(video.u.r.texture);
 			break;
 		}
 		case SDL_PIXELFORMAT_YV12: {
+			sdl2_LockTexture(video.u.r.texture, NULL, (void **)&pixels, &pitch);
 			video_blitUV(pixels, pitch, video.yuv.pal_y);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch);
 			video_blitTV(pixels, pitch, video.yuv.pal_v);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch) / 4;
 			video_blitTV(pixels, pitch, video.yuv.pal_u);
+			sdl2_UnlockTexture(video.u.r.texture);
 			break;
 		}
 		default: {
-			video_blit11(video.bpp, pixels, pitch, video.pal);
+			/* only scan and upload the rows of characters that changed */
+			uint8_t dirty[NATIVE_SCREEN_HEIGHT / 8];
+			SDL_Rect rect;
+			int y, h;
+
+			video_get_dirty_rows(dirty);
+
+			for (y = 0; y < NATIVE_SCREEN_HEIGHT / 8; y += h) {
+				for (h = 0; y + h < NATIVE_SCREEN_HEIGHT / 8 && dirty[y + h]; h++);
+				if (!h) {
+					h = 1;
+					continue;
+				}
+
+				rect.x = 0;
+				rect.y = y * 8;
+				rect.w = NATIVE_SCREEN_WIDTH;
+				rect.h = h * 8;
+
+				if (sdl2_LockTexture(video.u.r.texture, &rect, (void **)&pixels, &pitch) < 0)
+					continue;
+
+				video_blit11_rows(video.bpp, pixels, pitch, video.pal, rect.y, rect.h);
+				sdl2_UnlockTexture(video.u.r.texture);
+			}
 			break;
 		}
 		}
-		sdl2_UnlockTexture(video.u.r.texture);
 		sdl2_RenderCopy(video.u.r.renderer, video.u.r.texture, NULL, (cfg_video_want_fixed) ? &dstrect : NULL);
 		sdl2_RenderPresent(video.u.r.renderer);
 		break;
@@ -385,6 +385,9 @@ got_format:
 	sdl3_video_setup(cfg_video_interpolation); // ew
 
 	video_recalculate_fixed_width();
+
+	// the new texture has nothing in it yet
+	vgamem_dirty_all();
 }
 
 static void sdl3_video_set_hardware(int hardware)
@@ -779,31 +782,56 @@ SCHISM_HOT static void sdl3_video_blit(void)
 
 		sdl3_RenderClear(video.u.r.renderer);
 
-		sdl3_LockTexture(video.u.r.texture, NULL, (void **)&pixels, &pitch);
-
 		switch (video.format) {
 		case SDL_PIXELFORMAT_IYUV: {
+			sdl3_LockTexture(video.u.r.texture, NULL, (void **)&pixels, &pitch);
 			video_blitUV(pixels, pitch, video.yuv.pal_y);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch);
 			video_blitTV(pixels, pitch, video.yuv.pal_u);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch) / 4;
 			video_blitTV(pixels, pitch, video.yuv.pal_v);
+			sdl3_UnlockTexture(video.u.r.texture);
 			break;
 		}
 		case SDL_PIXELFORMAT_YV12: {
+			sdl3_LockTexture(video.u.r.texture, NULL, (void **)&pixels, &pitch);
 			video_blitUV(pixels, pitch, video.yuv.pal_y);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch);
 			video_blitTV(pixels, pitch, video.yuv.pal_v);
 			pixels += (NATIVE_SCREEN_HEIGHT * pitch) / 4;
 			video_blitTV(pixels, pitch, video.yuv.pal_u);
+			sdl3_UnlockTexture(video.u.r.texture);
 			break;
 		}
 		default: {
-			video_blit11(video.bpp, pixels, pitch, video.pal);
+			/* only scan and upload the rows of characters that changed */
+			uint8_t dirty[NATIVE_SCREEN_HEIGHT / 8];
+			SDL_Rect rect;
+			int y, h;
+
+			video_get_dirty_rows(dirty);
+
+			for (y = 0; y < NATIVE_SCREEN_HEIGHT / 8; y += h) {
+				for (h = 0; y + h < NATIVE_SCREEN_HEIGHT / 8 && dirty[y + h]; h++);
+				if (!h) {
+					h = 1;
+					continue;
+				}
+
+				rect.x = 0;
+				rect.y = y * 8;
+				rect.w = NATIVE_SCREEN_WIDTH;
+				rect.h = h * 8;
+
+				if (!sdl3_LockTexture(video.u.r.texture, &rect, (void **)&pixels, &pitch))
+					continue;
+
+				video_blit11_rows(video.bpp, pixels, pitch, video.pal, rect.y, rect.h);
+				sdl3_UnlockTexture(video.u.r.texture);
+			}
 			break;
 		}
 		}
-		sdl3_UnlockTexture(video.u.r.texture);
 		sdl3_RenderTexture(video.u.r.renderer, video.u.r.texture, NULL, (cfg_video_want_fixed) ? &dstrect : NULL);
 		sdl3_RenderPresent(video.u.r.renderer);
 		break;
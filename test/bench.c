@@ -0,0 +1,88 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+#include "test.h"
+
+#include "dmoz.h"
+#include "mem.h"
+
+bench_index_entry benchmarks[] =
+	{
+#define BENCH_FUNC(x) { #x, x },
+#include "bench-funcs.h"
+		{0}
+	};
+
+int schism_bench_main(int argc, char *argv[])
+{
+	int i;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s NAME [ARGS...]\navailable benchmarks:\n", argv[0]);
+		for (i = 0; benchmarks[i].name; i++)
+			fprintf(stderr, "    %s\n", benchmarks[i].name);
+		return 2;
+	}
+
+	for (i = 0; benchmarks[i].name; i++)
+		if (!strcmp(benchmarks[i].name, argv[1]))
+			return benchmarks[i].bench(argc - 1, argv + 1);
+
+	fprintf(stderr, "no such benchmark was found: %s\n", argv[1]);
+	return 3;
+}
+
+int bench_for_each_file(int npaths, char *paths[],
+	void (*callback)(const char *path, void *userdata), void *userdata)
+{
+	int i, j, count = 0;
+
+	for (i = 0; i < npaths; i++) {
+		dmoz_filelist_t flist = {0};
+
+		if (!dmoz_path_is_directory(paths[i])) {
+			callback(paths[i], userdata);
+			count++;
+			continue;
+		}
+
+		if (dmoz_read(paths[i], &flist, NULL, NULL) < 0) {
+			perror(paths[i]);
+			dmoz_free(&flist, NULL);
+			return -1;
+		}
+
+		for (j = 0; j < flist.num_files; j++) {
+			if (!(flist.files[j]->type & TYPE_FILE_MASK))
+				continue;
+
+			callback(flist.files[j]->path, userdata);
+			count++;
+		}
+
+		dmoz_free(&flist, NULL);
+	}
+
+	return count;
+}
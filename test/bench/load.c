@@ -0,0 +1,304 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/* Song loader throughput.
+ *
+ *     schismtrackertest --bench bench_song_load [-n ITERATIONS] FILE|DIRECTORY...
+ *
+ * Every file is loaded ITERATIONS times (default 10) through the same loader
+ * chain song_create_load uses, and the time is split up into stages:
+ *
+ *   slurp     opening the file (mmap/stdio/memory)
+ *   unpack    reading the entire stream, i.e. gzip/MMCMP decompression
+ *             (this is ~0 for plain files); the result is kept in memory,
+ *             so the loaders don't pay for it again
+ *   patterns  loading with LOAD_NOSAMPLES: headers, orders, patterns
+ *   samples   the difference between a full load and the above
+ *
+ * Results are grouped by format, as whichever file type the file browser
+ * would call it, with stage times in microseconds per file averaged over the
+ * iterations.
+ *
+ * Some loaders ignore LOAD_NOSAMPLES (XM, for one), in which case the sample
+ * time shows up under "patterns". */
+
+#include "test.h"
+
+#include "dmoz.h"
+#include "song.h"
+#include "slurp.h"
+#include "timer.h"
+#include "mem.h"
+#include "fmt.h"
+
+#define READ_INFO(t) fmt_##t##_read_info,
+static const fmt_read_info_func bench_read_info_funcs[] = {
+#include "fmt-types.h"
+	NULL
+};
+
+enum {
+	STAGE_SLURP,
+	STAGE_UNPACK,
+	STAGE_PATTERNS,
+	STAGE_SAMPLES,
+
+	STAGE_COUNT_,
+};
+
+static const char *stage_names[STAGE_COUNT_] = {
+	"slurp", "unpack", "patterns", "samples",
+};
+
+struct bench_song_load_format {
+	const char *name;
+
+	int files;
+	uint64_t bytes;
+	timer_ticks_t total[STAGE_COUNT_];
+};
+
+struct bench_song_load {
+	int iterations;
+
+	int files, failed;
+
+	/* should be plenty; anything past this gets lumped in with the last one */
+	struct bench_song_load_format formats[64];
+	int nformats;
+};
+
+static double bench_mb_per_sec(uint64_t bytes, timer_ticks_t us)
+{
+	return us ? ((double)bytes / (1024.0 * 1024.0)) / ((double)us / 1000000.0) : 0.0;
+}
+
+static void bench_song_load_print(const struct bench_song_load_format *f)
+{
+	timer_ticks_t all = 0;
+	int i;
+
+	printf("%-32s %6d %12" PRIu64, f->name, f->files, f->bytes);
+	for (i = 0; i < STAGE_COUNT_; i++) {
+		printf(" %10" PRIu64, (uint64_t)(f->total[i] / f->files));
+		all += f->total[i];
+	}
+	printf(" %9.2f\n", bench_mb_per_sec(f->bytes, all));
+}
+
+/* what the file browser would say the file is */
+static const char *bench_song_load_describe(slurp_t *s)
+{
+	const fmt_read_info_func *func;
+	const char *name = "Unknown";
+	dmoz_file_t file = {0};
+
+	for (func = bench_read_info_funcs; *func; func++) {
+		slurp_rewind(s);
+		if ((*func)(&file, s)) {
+			if (file.description)
+				name = file.description;
+			break;
+		}
+	}
+
+	free(file.artist);
+	free(file.title);
+	slurp_rewind(s);
+
+	return name;
+}
+
+static struct bench_song_load_format *bench_song_load_format(struct bench_song_load *b, const char *name)
+{
+	int i;
+
+	for (i = 0; i < b->nformats; i++)
+		if (!strcmp(b->formats[i].name, name))
+			return &b->formats[i];
+
+	if (b->nformats == ARRAY_SIZE(b->formats))
+		return &b->formats[b->nformats - 1];
+
+	b->formats[b->nformats].name = name;
+	return &b->formats[b->nformats++];
+}
+
+/* reads the stream all the way through. MMCMP holds on to what it decoded,
+ * but gzip only keeps a window of it around and would have to start over
+ * for every loader that rewinds, so that gets swapped out for a memory
+ * stream holding the whole thing */
+static int bench_song_load_unpack(slurp_t *s)
+{
+	uint64_t len;
+	uint8_t *data;
+
+	if (!s->nonseek) {
+		unsigned char buf[4096];
+
+		while (slurp_read(s, buf, sizeof(buf)) > 0);
+		return 0;
+	}
+
+	len = slurp_length(s);
+	if (len > SIZE_MAX)
+		return -1;
+
+	data = mem_alloc(len ? len : 1);
+	slurp_rewind(s);
+	if (slurp_read(s, data, len) != len) {
+		free(data);
+		return -1;
+	}
+
+	unslurp(s);
+	return slurp_memstream_free(s, data, len);
+}
+
+static void bench_song_load_file(const char *path, void *userdata)
+{
+	struct bench_song_load *b = userdata;
+	struct bench_song_load_format *f;
+	timer_ticks_t stages[STAGE_COUNT_] = {0};
+	const char *name = NULL;
+	uint64_t bytes = 0;
+	int i;
+
+	for (i = 0; i < b->iterations; i++) {
+		timer_ticks_t start, partial, full;
+		slurp_t s;
+		song_t *song;
+
+		start = timer_ticks_us();
+		if (slurp(&s, path, NULL, 0) < 0)
+			goto fail;
+		stages[STAGE_SLURP] += timer_ticks_us() - start;
+
+		start = timer_ticks_us();
+		if (bench_song_load_unpack(&s) < 0) {
+			unslurp(&s);
+			goto fail;
+		}
+		stages[STAGE_UNPACK] += timer_ticks_us() - start;
+
+		bytes = slurp_length(&s);
+		if (!name)
+			name = bench_song_load_describe(&s);
+
+		start = timer_ticks_us();
+		song = song_create_load_slurp(&s, LOAD_NOSAMPLES);
+		partial = timer_ticks_us() - start;
+		if (!song) {
+			unslurp(&s);
+			goto fail;
+		}
+		csf_free(song);
+		stages[STAGE_PATTERNS] += partial;
+
+		start = timer_ticks_us();
+		song = song_create_load_slurp(&s, 0);
+		full = timer_ticks_us() - start;
+		if (song)
+			csf_free(song);
+
+		/* clamp, in case a loader ignored LOAD_NOSAMPLES and the
+		 * second load was a bit quicker */
+		stages[STAGE_SAMPLES] += full - MIN(full, partial);
+
+		unslurp(&s);
+	}
+
+	f = bench_song_load_format(b, name);
+	f->files++;
+	f->bytes += bytes;
+	for (i = 0; i < STAGE_COUNT_; i++)
+		f->total[i] += stages[i] / b->iterations;
+
+	b->files++;
+	return;
+
+fail:
+	printf("%s: %s\n", path, fmt_strerror(errno));
+	b->failed++;
+}
+
+int bench_song_load(int argc, char *argv[])
+{
+	struct bench_song_load b = {0};
+	struct bench_song_load_format total = {0};
+	int i, j, count;
+
+	b.iterations = 10;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+			b.iterations = atoi(argv[++i]);
+			b.iterations = MAX(b.iterations, 1);
+		} else {
+			fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+
+	if (i >= argc) {
+		fprintf(stderr, "usage: %s [-n ITERATIONS] FILE|DIRECTORY...\n", argv[0]);
+		return 2;
+	}
+
+#ifdef USE_ZLIB
+	gzip_init();
+#endif
+
+	count = bench_for_each_file(argc - i, argv + i, bench_song_load_file, &b);
+
+#ifdef USE_ZLIB
+	gzip_quit();
+#endif
+
+	if (count < 0)
+		return 1;
+
+	printf("%-32s %6s %12s", "format", "files", "bytes");
+	for (j = 0; j < STAGE_COUNT_; j++)
+		printf(" %10s", stage_names[j]);
+	printf(" %9s\n", "MB/s");
+
+	total.name = "total";
+	for (i = 0; i < b.nformats; i++) {
+		bench_song_load_print(&b.formats[i]);
+
+		total.files += b.formats[i].files;
+		total.bytes += b.formats[i].bytes;
+		for (j = 0; j < STAGE_COUNT_; j++)
+			total.total[j] += b.formats[i].total[j];
+	}
+
+	if (total.files) {
+		printf("\n");
+		bench_song_load_print(&total);
+	}
+	printf("%d loaded, %d failed, %d iterations each\n", b.files, b.failed, b.iterations);
+
+	return b.failed ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Sample editor speed.
+ *
+ *     schismtrackertest --bench bench_sample_edit [-n ITERATIONS] [-l FRAMES]
+ *
+ * Runs each of the sample editor's operations ITERATIONS times (default 5)
+ * on a 16-bit stereo sample FRAMES long (default 4M, i.e. 16 MB), and prints
+ * the average time each one took in milliseconds. The pointwise ones pick a
+ * vector version if the CPU has one, so the CPU features are printed too. */
+
+#include "test.h"
+
+#include "song.h"
+#include "sample-edit.h"
+#include "timer.h"
+#include "cpu.h"
+
+static void bench_sample_edit_fill(song_sample_t *smp, uint32_t length)
+{
+	uint32_t seed = 1, i;
+
+	csf_free_sample(smp->data);
+
+	smp->length = length;
+	smp->flags = CHN_16BIT | CHN_STEREO | CHN_LOOP;
+	smp->c5speed = 44100;
+	smp->loop_start = length / 4;
+	smp->loop_end = length - length / 4;
+	smp->data = csf_allocate_sample(length * 4);
+	for (i = 0; i < length * 2; i++) {
+		seed = seed * 1103515245 + 12345;
+		((int16_t *)smp->data)[i] = (int16_t)(seed >> 16) / 2 + 1000;
+	}
+	csf_adjust_sample_loop(smp);
+}
+
+int bench_sample_edit(int argc, char *argv[])
+{
+	static const char *const names[] = {
+		"sign convert", "invert", "amplify", "centralise", "reverse",
+		"8-bit and back", "resize", "resize (aa)", "crossfade", "delta decode",
+	};
+	song_sample_t smp = {0};
+	uint32_t length = 4 << 20;
+	int iterations = 5;
+	int i, op;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			iterations = MAX(iterations, 1);
+		} else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+			length = strtoul(argv[++i], NULL, 0);
+			length = MAX(length, 1024);
+		} else {
+			fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+
+	cpu_init();
+
+	printf("cpu: sse2=%d avx2=%d\n", cpu_has_feature(CPU_FEATURE_SSE2), cpu_has_feature(CPU_FEATURE_AVX2));
+	printf("%" PRIu32 " frames, 16-bit stereo\n\n", length);
+
+	for (op = 0; op < (int)ARRAY_SIZE(names); op++) {
+		timer_ticks_t total = 0;
+
+		for (i = 0; i < iterations; i++) {
+			timer_ticks_t start;
+
+			/* resizing changes the length, so start over every time */
+			bench_sample_edit_fill(&smp, length);
+
+			start = timer_ticks_us();
+			switch (op) {
+			case 0: sample_sign_convert(&smp); break;
+			case 1: sample_invert(&smp); break;
+			case 2: sample_amplify(&smp, 150); break;
+			case 3: sample_centralise(&smp); break;
+			case 4: sample_reverse(&smp); break;
+			case 5: sample_toggle_quality(&smp, 1); sample_toggle_quality(&smp, 1); break;
+			case 6: sample_resize(&smp, length + length / 3, 0); break;
+			case 7: sample_resize(&smp, length + length / 3, 1); break;
+			case 8: sample_crossfade(&smp, length / 8, 50, 1, 0); break;
+			case 9: sample_delta_decode(&smp); break;
+			}
+			total += timer_ticks_us() - start;
+		}
+
+		printf("%-16s %10.2f\n", names[op], (double)total / iterations / 1000.0);
+	}
+
+	csf_free_sample(smp.data);
+
+	return 0;
+}
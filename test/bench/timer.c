@@ -0,0 +1,121 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/* Oneshot timer throughput and accuracy.
+ *
+ *     schismtrackertest --bench bench_timer_oneshot [-n TIMERS] [-s SPREAD_US]
+ *
+ * Adds TIMERS oneshots (default 20000), each due at a random point within
+ * the next SPREAD_US microseconds (default 200000), then waits for all of
+ * them to go off. Prints how long adding them took, and how late they were
+ * called compared to when they were due. Without a timer thread, the timers
+ * are run by calling timer_oneshot_worker in a loop, like the main loop
+ * does. */
+
+#include "test.h"
+
+#include "timer.h"
+#include "mem.h"
+
+struct bench_timer_oneshot {
+	timer_ticks_t due;
+	timer_ticks_t fired;
+	uint32_t *left;
+};
+
+static void bench_timer_oneshot_callback(void *param)
+{
+	struct bench_timer_oneshot *t = param;
+
+	t->fired = timer_ticks_us();
+	(*t->left)--;
+}
+
+static int bench_timer_oneshot_cmp(const void *a, const void *b)
+{
+	const timer_ticks_t x = *(const timer_ticks_t *)a, y = *(const timer_ticks_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+int bench_timer_oneshot(int argc, char *argv[])
+{
+	struct bench_timer_oneshot *timers;
+	timer_ticks_t *late, start, added, total = 0;
+	volatile uint32_t left;
+	uint32_t count = 20000, spread = 200000, seed = 1, i;
+	int a;
+
+	for (a = 1; a < argc; a++) {
+		if (!strcmp(argv[a], "-n") && a + 1 < argc) {
+			count = atoi(argv[++a]);
+			count = MAX(count, 1);
+		} else if (!strcmp(argv[a], "-s") && a + 1 < argc) {
+			spread = atoi(argv[++a]);
+			spread = MAX(spread, 1);
+		} else {
+			fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[a]);
+			return 2;
+		}
+	}
+
+	timers = mem_calloc(count, sizeof(*timers));
+	late = mem_alloc(count * sizeof(*late));
+	left = count;
+
+	start = timer_ticks_us();
+	for (i = 0; i < count; i++) {
+		uint32_t delay;
+
+		seed = seed * 1664525 + 1013904223;
+		delay = (seed >> 8) % spread;
+
+		timers[i].left = (uint32_t *)&left;
+		timers[i].due = timer_ticks_us() + delay;
+		timer_oneshot_us(delay, bench_timer_oneshot_callback, timers + i);
+	}
+	added = timer_ticks_us() - start;
+
+	while (left) {
+		timer_oneshot_worker();
+		timer_usleep(50);
+	}
+
+	for (i = 0; i < count; i++) {
+		late[i] = (timers[i].fired > timers[i].due) ? timers[i].fired - timers[i].due : 0;
+		total += late[i];
+	}
+	qsort(late, count, sizeof(*late), bench_timer_oneshot_cmp);
+
+	printf("%" PRIu32 " timers over %" PRIu32 " us\n", count, spread);
+	printf("add:  %10.3f us each, %10.0f per second\n",
+		(double)added / count, added ? count * 1000000.0 / added : 0.0);
+	printf("late: mean %.1f us, median %" PRIu64 " us, 99%% %" PRIu64 " us, max %" PRIu64 " us\n",
+		(double)total / count, (uint64_t)late[count / 2],
+		(uint64_t)late[(uint64_t)count * 99 / 100], (uint64_t)late[count - 1]);
+
+	free(timers);
+	free(late);
+
+	return 0;
+}
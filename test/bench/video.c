@@ -0,0 +1,136 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/* Scaled blitter speed.
+ *
+ *     schismtrackertest --bench bench_video_blit [-n ITERATIONS] [WIDTHxHEIGHT...]
+ *
+ * Blits a screenful of text ITERATIONS times (default 50) to a 32-bit buffer
+ * of each given size (by default, a bunch of common ones up to 4K) with both
+ * the linear and nearest neighbor blitters, and prints the average time per
+ * frame in microseconds. The linear blitter picks a vector version by itself
+ * if the CPU has one, so the CPU features are printed as well. */
+
+#include "test.h"
+
+#include "video.h"
+#include "vgamem.h"
+#include "fonts.h"
+#include "timer.h"
+#include "cpu.h"
+#include "mem.h"
+
+static uint32_t bench_video_map_rgb(SCHISM_UNUSED void *data, uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+static void bench_video_blit_size(uint32_t width, uint32_t height, int iterations)
+{
+	uint32_t tpal[256];
+	uint32_t *out;
+	timer_ticks_t start, ln, nn;
+	int i;
+
+	for (i = 0; i < 256; i++)
+		tpal[i] = (uint32_t)i * 0x10101;
+
+	out = mem_alloc((size_t)width * height * sizeof(*out));
+
+	start = timer_ticks_us();
+	for (i = 0; i < iterations; i++)
+		video_blitLN(4, (unsigned char *)out, width * 4, bench_video_map_rgb, NULL, width, height);
+	ln = timer_ticks_us() - start;
+
+	start = timer_ticks_us();
+	for (i = 0; i < iterations; i++)
+		video_blitNN(4, (unsigned char *)out, width * 4, tpal, width, height);
+	nn = timer_ticks_us() - start;
+
+	printf("%5" PRIu32 "x%-5" PRIu32 " %10" PRIu64 " %10" PRIu64 " %10.1f\n", width, height,
+		(uint64_t)(ln / iterations), (uint64_t)(nn / iterations),
+		ln ? ((double)width * height * iterations) / (double)ln : 0.0);
+
+	free(out);
+}
+
+int bench_video_blit(int argc, char *argv[])
+{
+	static const uint32_t sizes[][2] = {
+		{640, 400}, {1280, 800}, {1920, 1080}, {2560, 1440}, {3840, 2160},
+	};
+	unsigned char palette[16][3];
+	int iterations = 50;
+	int i, x, y;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+		if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+			iterations = atoi(argv[++i]);
+			iterations = MAX(iterations, 1);
+		} else {
+			fprintf(stderr, "%s: unknown option %s\n", argv[0], argv[i]);
+			return 2;
+		}
+	}
+
+	cpu_init();
+
+	/* something for the blitter to chew on */
+	for (x = 0; x < 2048; x++)
+		font_data[x] = (uint8_t)(x * 37 + (x >> 2));
+	for (x = 0; x < 16; x++) {
+		palette[x][0] = (unsigned char)(x * 17);
+		palette[x][1] = (unsigned char)(255 - x * 13);
+		palette[x][2] = (unsigned char)((x * 101) & 0xFF);
+	}
+	video_colors(palette);
+
+	vgamem_clear();
+	for (y = 0; y < 50; y++)
+		for (x = 0; x < 80; x++)
+			draw_char((uint8_t)(x * 7 + y * 3), x, y, (x + y) % 16, (x * 3 + y) % 16);
+	vgamem_flip();
+
+	printf("cpu: sse2=%d avx2=%d\n\n", cpu_has_feature(CPU_FEATURE_SSE2), cpu_has_feature(CPU_FEATURE_AVX2));
+	printf("%-11s %10s %10s %10s\n", "size", "linear", "nearest", "Mpx/s");
+
+	if (i >= argc) {
+		for (x = 0; x < (int)ARRAY_SIZE(sizes); x++)
+			bench_video_blit_size(sizes[x][0], sizes[x][1], iterations);
+		return 0;
+	}
+
+	for (; i < argc; i++) {
+		unsigned int w, h;
+
+		if (sscanf(argv[i], "%ux%u", &w, &h) != 2 || !w || !h) {
+			fprintf(stderr, "%s: bad size %s\n", argv[0], argv[i]);
+			return 2;
+		}
+
+		bench_video_blit_size(w, h, iterations);
+	}
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "audio-stats.h"
+
+testresult_t test_audio_stats_percentiles(void)
+{
+	struct audio_stats stats;
+	uint32_t stage_us[AUDIO_STATS_STAGES] = {0};
+	int i;
+
+	audio_stats_reset(&stats);
+	ASSERT(audio_stats_percentile(&stats, 500) == 0);
+
+	/* 1024 frames at 48kHz is 21333 us. 900 buffers at 25%, 90 at 55%, and
+	 * 10 that blew right through it */
+	for (i = 0; i < 1000; i++) {
+		stage_us[AUDIO_STATS_MIX] = (i < 900) ? 5000 : (i < 990) ? 11000 : 40000;
+		stage_us[AUDIO_STATS_CONVERT] = (i < 990) ? 333 : 0;
+		stage_us[AUDIO_STATS_VIS] = 0;
+		audio_stats_add(&stats, 1024, 48000, stage_us);
+	}
+
+	ASSERT(stats.count == 1000);
+	ASSERT(stats.deadline_us == 21333);
+	ASSERT(stats.overruns == 10);
+	ASSERT(stats.worst_us == 40000);
+	ASSERT(stats.max_us[AUDIO_STATS_MIX] == 40000);
+	ASSERT(stats.max_us[AUDIO_STATS_CONVERT] == 333);
+
+	ASSERT_PRINTF(audio_stats_percentile(&stats, 500) == 26, "%" PRIu32, audio_stats_percentile(&stats, 500));
+	ASSERT_PRINTF(audio_stats_percentile(&stats, 900) == 26, "%" PRIu32, audio_stats_percentile(&stats, 900));
+	ASSERT_PRINTF(audio_stats_percentile(&stats, 990) == 54, "%" PRIu32, audio_stats_percentile(&stats, 990));
+	/* 187% */
+	ASSERT_PRINTF(audio_stats_percentile(&stats, 999) == 188, "%" PRIu32, audio_stats_percentile(&stats, 999));
+
+	/* a buffer a quarter the size taking the same share of its deadline
+	 * counts as just as bad */
+	stage_us[AUDIO_STATS_MIX] = 10000;
+	stage_us[AUDIO_STATS_CONVERT] = 0;
+	audio_stats_add(&stats, 256, 48000, stage_us);
+	ASSERT(stats.worst_us == 10000 && stats.worst_deadline_us == 5333);
+	ASSERT(stats.frames == 256);
+
+	/* way over goes in the last bucket */
+	stage_us[AUDIO_STATS_MIX] = 1000000;
+	audio_stats_add(&stats, 256, 48000, stage_us);
+	ASSERT(stats.histogram[AUDIO_STATS_BUCKETS - 1] == 1);
+	ASSERT(audio_stats_percentile(&stats, 1000) == AUDIO_STATS_BUCKETS * AUDIO_STATS_BUCKET_PERCENT);
+
+	RETURN_PASS;
+}
+
+static void audio_stats_fill(struct audio_stats *stats, uint32_t frames, uint32_t count,
+	uint32_t mix_us, uint32_t every, uint32_t spike_us)
+{
+	uint32_t stage_us[AUDIO_STATS_STAGES] = {0};
+	uint32_t i;
+
+	audio_stats_reset(stats);
+	for (i = 0; i < count; i++) {
+		stage_us[AUDIO_STATS_MIX] = (every && !(i % every)) ? spike_us : mix_us;
+		audio_stats_add(stats, frames, 48000, stage_us);
+	}
+}
+
+testresult_t test_audio_stats_adapt_buffer(void)
+{
+	struct audio_stats stats;
+
+	/* nothing to go on */
+	audio_stats_reset(&stats);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 1024);
+
+	/* 1024 frames at 48kHz is 21333 us; one overrun is enough to grow
+	 * right away, but not past the top */
+	audio_stats_fill(&stats, 1024, 10, 5000, 10, 25000);
+	ASSERT(stats.overruns == 1);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 2048);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 1024) == 1024);
+
+	/* 2% of them at 80%: not until there's a second's worth */
+	audio_stats_fill(&stats, 1024, 40, 5000, 50, 17000);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 1024);
+	audio_stats_fill(&stats, 1024, 100, 5000, 50, 17000);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 2048);
+
+	/* lots of room, but it has to be that way for ten seconds */
+	audio_stats_fill(&stats, 1024, 400, 2000, 0, 0);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 1024);
+	audio_stats_fill(&stats, 1024, 500, 2000, 0, 0);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 512);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 1024, 4096) == 1024);
+
+	/* ... and the odd spike up to half the deadline means it stays put */
+	audio_stats_fill(&stats, 1024, 500, 2000, 100, 11000);
+	ASSERT(audio_stats_adapt_buffer(&stats, 1024, 256, 4096) == 1024);
+
+	RETURN_PASS;
+}
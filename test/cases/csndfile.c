@@ -0,0 +1,440 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+#include "test-tempfile.h"
+
+#include "slurp.h"
+#include "song.h"
+#include "player/sndfile.h"
+
+/* three samples, stored in a different order than they're loaded in */
+static const uint8_t test_sample_jobs_data[] = {
+	/* 0: padding */
+	'x', 'x', 'x', 'x',
+	/* 4: 16-bit signed little endian, 3 samples */
+	0x01, 0x00, 0xFF, 0x7F, 0x00, 0x80,
+	/* 10: 8-bit unsigned, 4 samples */
+	0x80, 0x81, 0x7F, 0x00,
+	/* 14: 8-bit delta, 4 samples */
+	0x01, 0x01, 0x01, 0xFD,
+};
+
+static testresult_t test_csf_sample_jobs_common(slurp_t *fp)
+{
+	static const int8_t expected8u[] = { 0, 1, -1, -128 };
+	static const int8_t expected8d[] = { 1, 2, 3, 0 };
+	static const int16_t expected16[] = { 1, 32767, -32768 };
+	song_sample_t smp[3] = {0};
+	csf_sample_jobs_t *jobs;
+
+	smp[0].length = 4;
+	smp[1].length = 4;
+	smp[2].length = 3;
+
+	ASSERT(slurp_seek(fp, 2, SEEK_SET) == 0);
+
+	jobs = csf_sample_jobs_create(fp);
+	csf_sample_jobs_add(jobs, &smp[0], SF(8,M,LE,PCMU), 10);
+	csf_sample_jobs_add(jobs, &smp[1], SF(8,M,LE,PCMD), 14);
+	csf_sample_jobs_add(jobs, &smp[2], SF(16,M,LE,PCMS), 4);
+	csf_sample_jobs_finish(jobs);
+
+	/* the position shouldn't have moved */
+	ASSERT(slurp_tell(fp) == 2);
+
+	ASSERT(smp[0].data && !memcmp(smp[0].data, expected8u, sizeof(expected8u)));
+	ASSERT(smp[1].data && !memcmp(smp[1].data, expected8d, sizeof(expected8d)));
+	ASSERT(smp[2].data && !memcmp(smp[2].data, expected16, sizeof(expected16)));
+	ASSERT(smp[2].flags & CHN_16BIT);
+
+	for (int i = 0; i < 3; i++)
+		csf_free_sample(smp[i].data);
+
+	RETURN_PASS;
+}
+
+testresult_t test_csf_sample_jobs_memory(void)
+{
+	testresult_t r;
+	slurp_t fp;
+
+	ASSERT(slurp_memstream(&fp, (uint8_t *)test_sample_jobs_data, sizeof(test_sample_jobs_data)) >= 0);
+
+	r = test_csf_sample_jobs_common(&fp);
+
+	unslurp(&fp);
+
+	return r;
+}
+
+testresult_t test_csf_sample_jobs_stdio(void)
+{
+	char tmp[TEST_TEMP_FILE_NAME_LENGTH];
+	testresult_t r;
+	slurp_t fp;
+	FILE *stdfp;
+
+	/* not in memory, so everything gets read right away */
+	stdfp = test_temp_file2(tmp, (const char *)test_sample_jobs_data, sizeof(test_sample_jobs_data));
+	REQUIRE(stdfp);
+
+	REQUIRE(slurp_stdio(&fp, stdfp) == SLURP_OPEN_SUCCESS);
+
+	r = test_csf_sample_jobs_common(&fp);
+
+	unslurp(&fp);
+	fclose(stdfp);
+
+	return r;
+}
+
+/* a wall put up with slurp_limit() should hold whether the sample is decoded
+ * right away or later on (with the file in memory) */
+static void test_csf_sample_jobs_limited(slurp_t *fp, song_sample_t *smp)
+{
+	csf_sample_jobs_t *jobs;
+
+	slurp_seek(fp, 10, SEEK_SET);
+	slurp_limit(fp, 6); /* halfway into the delta sample */
+
+	jobs = csf_sample_jobs_create(fp);
+	csf_sample_jobs_add(jobs, smp, SF(8,M,LE,PCMS), 14);
+	csf_sample_jobs_finish(jobs);
+
+	slurp_unlimit(fp);
+}
+
+testresult_t test_csf_sample_jobs_limit(void)
+{
+	char tmp[TEST_TEMP_FILE_NAME_LENGTH];
+	song_sample_t mem = {0}, now = {0};
+	slurp_t fp;
+	FILE *stdfp;
+
+	mem.length = now.length = 4;
+
+	ASSERT(slurp_memstream(&fp, (uint8_t *)test_sample_jobs_data, sizeof(test_sample_jobs_data)) >= 0);
+	test_csf_sample_jobs_limited(&fp, &mem);
+	unslurp(&fp);
+
+	stdfp = test_temp_file2(tmp, (const char *)test_sample_jobs_data, sizeof(test_sample_jobs_data));
+	REQUIRE(stdfp);
+	REQUIRE(slurp_stdio(&fp, stdfp) == SLURP_OPEN_SUCCESS);
+	test_csf_sample_jobs_limited(&fp, &now);
+	unslurp(&fp);
+	fclose(stdfp);
+
+	/* nothing past the wall */
+	ASSERT(now.data && now.data[0] == 1 && now.data[1] == 1 && !now.data[2] && !now.data[3]);
+	ASSERT(mem.data && !memcmp(mem.data, now.data, 4));
+
+	csf_free_sample(mem.data);
+	csf_free_sample(now.data);
+
+	RETURN_PASS;
+}
+
+/* an XM with one instrument and two 8-bit samples, cut off partway through
+ * the first one's data; returns the size */
+static size_t test_truncated_xm_make(uint8_t *xm)
+{
+	uint8_t *p = xm;
+
+	memcpy(p, "Extended Module: ", 17);
+	p[37] = 0x1a;
+	p[58] = 0x04; p[59] = 0x01; /* version 1.04 */
+	p[60] = 20; /* header size */
+	p[64] = 1; /* song length */
+	p[68] = 1; /* channels */
+	p[72] = 1; /* instruments */
+	p[76] = 6; /* speed */
+	p[78] = 125; /* tempo */
+	p += 80;
+
+	p[0] = 33; /* instrument header size */
+	p[27] = 2; /* samples */
+	p[29] = 40; /* sample header size */
+	p += 33;
+
+	p[0] = 8; /* length */
+	p += 40;
+	p[0] = 4;
+	p += 40;
+
+	/* the first sample only has half of its (delta-encoded) data */
+	p[0] = 10; p[1] = 10; p[2] = 10; p[3] = 10;
+	p += 4;
+
+	return p - xm;
+}
+
+testresult_t test_csf_sample_jobs_truncated_xm(void)
+{
+	static const int8_t expected[] = { 10, 20, 30, 40 };
+	uint8_t xm[256] = {0};
+	song_t *song;
+	slurp_t fp;
+	size_t len;
+	uint32_t i;
+
+	len = test_truncated_xm_make(xm);
+
+	ASSERT(slurp_memstream(&fp, xm, len) >= 0);
+	song = song_create_load_slurp(&fp, 0);
+	unslurp(&fp);
+	REQUIRE(song);
+
+	/* the second sample starts past the end of the file, so there's nothing
+	 * to load; it certainly shouldn't be read from where the first one is */
+	ASSERT(song->samples[2].length == 4);
+	ASSERT(!song->samples[2].data || memcmp(song->samples[2].data, expected, sizeof(expected)));
+	for (i = 0; song->samples[2].data && i < song->samples[2].length; i++)
+		ASSERT(!song->samples[2].data[i]);
+
+	csf_free(song);
+
+	RETURN_PASS;
+}
+
+/* ------------------------------------------------------------------------ */
+
+#define TEST_MULTI_CHANNELS 4
+#define TEST_MULTI_BUFFER (512 * 1024)
+
+struct test_multi_capture {
+	uint8_t *data;
+	size_t pos;
+	int writes;
+};
+
+static void test_multi_write(void *data, const uint8_t *buf, size_t bytes)
+{
+	struct test_multi_capture *c = data;
+
+	if (c->data && c->pos + bytes <= TEST_MULTI_BUFFER)
+		memcpy(c->data + c->pos, buf, bytes);
+	c->pos += bytes;
+	c->writes++;
+}
+
+static void test_multi_silence(void *data, long bytes)
+{
+	struct test_multi_capture *c = data;
+
+	if (c->data && c->pos + bytes <= TEST_MULTI_BUFFER)
+		memset(c->data + c->pos, 0, bytes);
+	c->pos += bytes;
+}
+
+/* a four channel MOD with a looped and a one-shot sample, some notes and a
+ * bunch of volume changes (so there's ramping) */
+static size_t test_multi_make_mod(uint8_t *mod)
+{
+	static const uint16_t periods[TEST_MULTI_CHANNELS] = { 214, 254, 320, 428 };
+	uint8_t *p = mod;
+	int r, c, i;
+
+	memset(mod, 0, 1084);
+	memcpy(p, "multi", 5);
+	p += 20;
+
+	/* sample 1: 2000 bytes, looped */
+	p[22] = 1000 >> 8; p[23] = 1000 & 0xFF;
+	p[25] = 64;
+	p[28] = 1000 >> 8; p[29] = 1000 & 0xFF;
+	p += 30;
+	/* sample 2: 400 bytes, not looped */
+	p[22] = 200 >> 8; p[23] = 200 & 0xFF;
+	p[25] = 64;
+	p[29] = 1;
+	p += 30 * 30;
+
+	p[0] = 1; /* song length */
+	p[1] = 127;
+	p += 130;
+	memcpy(p, "M.K.", 4);
+	p += 4;
+
+	for (r = 0; r < 64; r++) {
+		for (c = 0; c < TEST_MULTI_CHANNELS; c++, p += 4) {
+			int smp = (c == 2 && (r & 1)) ? 2 : 1;
+
+			if (r % (4 + c) && !(c == 2 && (r & 1))) {
+				/* Cxx */
+				p[2] = 0x0C;
+				p[3] = (r * 7 + c * 13) & 63;
+				continue;
+			}
+
+			p[0] = (periods[c] >> 8) & 0x0F;
+			p[1] = periods[c] & 0xFF;
+			p[2] = smp << 4;
+		}
+	}
+
+	for (i = 0; i < 2000; i++)
+		*p++ = (uint8_t)((i & 64) ? (i & 63) * 3 : 192 - (i & 63) * 3);
+	for (i = 0; i < 400; i++)
+		*p++ = (uint8_t)(i * 37);
+
+	return p - mod;
+}
+
+static song_t *test_multi_load(uint8_t *mod, size_t len, struct test_multi_capture *capture, int muted_mask)
+{
+	slurp_t fp;
+	song_t *song;
+	int n;
+
+	slurp_memstream(&fp, mod, len);
+	song = song_create_load_slurp(&fp, 0);
+	unslurp(&fp);
+	if (!song)
+		return NULL;
+
+	csf_set_wave_config(song, 8000, 16, 2);
+	song->mix_flags |= (SNDMIX_DIRECTTODISK | SNDMIX_NOBACKWARDJUMPS);
+	song->repeat_count = -1;
+	csf_set_current_order(song, 0);
+
+	song->multi_write = calloc(MAX_CHANNELS, sizeof(struct multi_write));
+	for (n = 0; n < MAX_CHANNELS; n++) {
+		song->multi_write[n].data = &capture[n];
+		song->multi_write[n].write = test_multi_write;
+		song->multi_write[n].silence = test_multi_silence;
+		song->multi_write[n].muted = !!(muted_mask & (1 << (n % TEST_MULTI_CHANNELS)));
+	}
+
+	return song;
+}
+
+testresult_t test_csf_multi_write_muted(void)
+{
+	/* 0: everything, 1: even channels only, 2: odd channels only */
+	static const int masks[3] = { 0, 0xA, 0x5 };
+	struct test_multi_capture capture[3][MAX_CHANNELS] = {0};
+	uint8_t mod[1084 + 64 * 4 * TEST_MULTI_CHANNELS + 2400];
+	uint8_t buf[4096];
+	song_t *songs[3];
+	size_t len;
+	int s, n, frames[3] = {0};
+
+	len = test_multi_make_mod(mod);
+
+	for (s = 0; s < 3; s++) {
+		for (n = 0; n < TEST_MULTI_CHANNELS; n++)
+			capture[s][n].data = calloc(1, TEST_MULTI_BUFFER);
+
+		songs[s] = test_multi_load(mod, len, capture[s], masks[s]);
+		REQUIRE(songs[s]);
+
+		while (!(songs[s]->flags & SONG_ENDREACHED) && frames[s] < TEST_MULTI_BUFFER / 4)
+			frames[s] += csf_read(songs[s], buf, sizeof(buf));
+	}
+
+	ASSERT(frames[0] > 0);
+	ASSERT(frames[1] == frames[0]);
+	ASSERT(frames[2] == frames[0]);
+
+	for (n = 0; n < TEST_MULTI_CHANNELS; n++) {
+		s = (n & 1) ? 2 : 1;
+
+		/* the channel sounds exactly the same when the others are muted... */
+		ASSERT(capture[0][n].writes > 0);
+		ASSERT(capture[s][n].pos == capture[0][n].pos);
+		ASSERT(!memcmp(capture[s][n].data, capture[0][n].data, MIN(capture[0][n].pos, TEST_MULTI_BUFFER)));
+
+		/* ...and isn't written at all where it's muted */
+		ASSERT(capture[3 - s][n].pos == 0);
+	}
+
+	for (s = 0; s < 3; s++) {
+		free(songs[s]->multi_write);
+		songs[s]->multi_write = NULL;
+		csf_free(songs[s]);
+		for (n = 0; n < TEST_MULTI_CHANNELS; n++)
+			free(capture[s][n].data);
+	}
+
+	RETURN_PASS;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void test_csf_profile_count_lines(void *userdata, SCHISM_UNUSED const char *text)
+{
+	(*(int *)userdata)++;
+}
+
+testresult_t test_csf_profile(void)
+{
+	uint8_t mod[1084 + 64 * 4 * TEST_MULTI_CHANNELS + 2400];
+	uint8_t buf[4096];
+	slurp_t fp;
+	song_t *song;
+	size_t len;
+	int lines = 0, frames = 0;
+
+	len = test_multi_make_mod(mod);
+
+	slurp_memstream(&fp, mod, len);
+	song = song_create_load_slurp(&fp, 0);
+	unslurp(&fp);
+	REQUIRE(song);
+
+	csf_set_wave_config(song, 8000, 16, 2);
+	song->mix_flags |= (SNDMIX_DIRECTTODISK | SNDMIX_NOBACKWARDJUMPS);
+	song->mix_interpolation = SRCMODE_LINEAR;
+	song->repeat_count = -1;
+	csf_set_current_order(song, 0);
+	csf_profile_reset(song);
+
+	while (!(song->flags & SONG_ENDREACHED) && frames < 100000)
+		frames += csf_read(song, buf, sizeof(buf));
+	ASSERT(frames > 0);
+
+	csf_profile_report(song, test_csf_profile_count_lines, &lines);
+
+#ifdef USE_PLAYER_PROFILER
+	/* everything that was started got finished */
+	ASSERT(song->profile.stage == CSF_PROFILE_IDLE);
+
+	ASSERT(song->profile.calls[CSF_PROFILE_VOICES] > 0);
+	ASSERT(song->profile.calls[CSF_PROFILE_TICK] > 0);
+	ASSERT(song->profile.calls[CSF_PROFILE_EFFECTS] > 0);
+	ASSERT(song->profile.calls[CSF_PROFILE_MIX_LINEAR] > 0);
+	ASSERT(song->profile.calls[CSF_PROFILE_MIX_FIR] == 0);
+	ASSERT(song->profile.voice_ticks[CSF_PROFILE_VOICE_CHANNEL] > 0);
+	ASSERT(lines > 0);
+#else
+	/* not compiled in */
+	ASSERT(song->profile.calls[CSF_PROFILE_VOICES] == 0);
+	ASSERT(lines == 0);
+#endif
+
+	csf_free(song);
+
+	RETURN_PASS;
+}
@@ -0,0 +1,364 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+#include "test-tempfile.h"
+
+#include "config.h"
+#include "disko.h"
+#include "fmt.h"
+#include "song.h"
+#include "str.h"
+
+/* bigger than the async backend's blocks, so that it has to hand off a few */
+#define TEST_DISKO_SIZE (1536 * 1024 + 1234)
+
+struct test_disko {
+	disko_t ds;
+	uint8_t *expected;
+	size_t pos, length;
+};
+
+/* writes to the file, and to what the file should end up looking like */
+static void test_disko_write(struct test_disko *t, const uint8_t *buf, size_t len)
+{
+	disko_write(&t->ds, buf, len);
+	memcpy(t->expected + t->pos, buf, len);
+	t->pos += len;
+	t->length = MAX(t->length, t->pos);
+}
+
+static void test_disko_seek(struct test_disko *t, size_t pos)
+{
+	disko_seek(&t->ds, pos, SEEK_SET);
+	t->pos = pos;
+}
+
+static testresult_t test_disko_check_file(const char *filename, const uint8_t *expected, size_t length)
+{
+	uint8_t *buf = calloc(1, length + 1);
+	FILE *fp;
+	size_t n;
+
+	REQUIRE(buf);
+	fp = fopen(filename, "rb");
+	REQUIRE(fp);
+	n = fread(buf, 1, length + 1, fp);
+	fclose(fp);
+
+	ASSERT(n == length);
+	ASSERT(!memcmp(buf, expected, length));
+
+	free(buf);
+
+	RETURN_PASS;
+}
+
+testresult_t test_disko_async(void)
+{
+	static const uint8_t header[44] = "RIFF....WAVEfmt ";
+	struct test_disko t = {0};
+	char tmp[TEST_TEMP_FILE_NAME_LENGTH];
+	uint8_t chunk[7919], patch[4];
+	size_t i;
+
+	REQUIRE(test_temp_file(tmp, NULL, 0));
+	REQUIRE(disko_open_async(&t.ds, tmp, TEST_DISKO_SIZE) == 0);
+	t.expected = calloc(1, TEST_DISKO_SIZE);
+	REQUIRE(t.expected);
+
+	test_disko_write(&t, header, sizeof(header));
+
+	/* "audio", with some silence in between */
+	for (i = 0; t.pos + 2 * sizeof(chunk) < TEST_DISKO_SIZE; i++) {
+		memset(chunk, (int)i + 1, sizeof(chunk));
+		if (i % 5 == 3)
+			test_disko_seek(&t, t.pos + (i * 997) % sizeof(chunk) + 1);
+		else
+			test_disko_write(&t, chunk, sizeof(chunk) - i % 3);
+	}
+
+	/* silence at the end, then a real long silence that skips a whole block */
+	test_disko_seek(&t, t.pos + 100);
+	test_disko_write(&t, chunk, 1);
+	test_disko_seek(&t, TEST_DISKO_SIZE - 1);
+	test_disko_write(&t, chunk, 1);
+
+	/* and fix up the header */
+	ASSERT(disko_tell(&t.ds) == TEST_DISKO_SIZE);
+	memset(patch, 0xAB, sizeof(patch));
+	test_disko_seek(&t, 4);
+	test_disko_write(&t, patch, sizeof(patch));
+	test_disko_seek(&t, 40);
+	test_disko_write(&t, patch, sizeof(patch));
+
+	disko_seek(&t.ds, 0, SEEK_END);
+	ASSERT(disko_tell(&t.ds) == (int64_t)t.length);
+
+	ASSERT(disko_close(&t.ds, 0) == DW_OK);
+	ASSERT(test_disko_check_file(tmp, t.expected, t.length) == SCHISM_TESTRESULT_PASS);
+
+	free(t.expected);
+
+	RETURN_PASS;
+}
+
+testresult_t test_disko_async_error(void)
+{
+	static const char original[] = "don't touch this";
+	char tmp[TEST_TEMP_FILE_NAME_LENGTH];
+	uint8_t *buf;
+	disko_t ds;
+
+	REQUIRE(test_temp_file(tmp, original, sizeof(original) - 1));
+	REQUIRE(disko_open_async(&ds, tmp, 0) == 0);
+
+	/* enough that some of it is already on its way to the disk */
+	buf = calloc(1, TEST_DISKO_SIZE);
+	REQUIRE(buf);
+	disko_write(&ds, buf, TEST_DISKO_SIZE);
+	free(buf);
+
+	disko_seterror(&ds, EINTR);
+	ASSERT(disko_close(&ds, 0) == DW_ERROR);
+	ASSERT(errno == EINTR);
+
+	/* the original file is left alone */
+	ASSERT(test_disko_check_file(tmp, (const uint8_t *)original, sizeof(original) - 1) == SCHISM_TESTRESULT_PASS);
+
+	RETURN_PASS;
+}
+
+/* ------------------------------------------------------------------------ */
+
+#define TEST_EXPORT_CHANNELS 7
+
+/* a few looping notes on every channel but the last, which plays an AdLib
+ * sample, with volume changes so the channels don't all sound the same */
+static song_t *test_disko_export_make_song(void)
+{
+	static const unsigned char adlib[12] = {
+		0x21, 0x21, 0x1D, 0x00, 0xF3, 0xF3, 0x24, 0x24, 0x00, 0x01, 0x0E, 0x00,
+	};
+	song_t *song = csf_allocate();
+	song_sample_t *smp = &song->samples[1];
+	song_note_t *pat;
+	uint32_t i;
+	int r, c;
+
+	smp->length = 1000;
+	smp->data = csf_allocate_sample(smp->length);
+	for (i = 0; i < smp->length; i++)
+		smp->data[i] = (signed char)((i & 64) ? (i & 63) * 3 - 96 : 96 - (i & 63) * 3);
+	smp->loop_start = 0;
+	smp->loop_end = smp->length;
+	smp->flags |= CHN_LOOP;
+	smp->c5speed = 8363;
+	smp->volume = 64 * 4;
+	smp->global_volume = 64;
+
+	smp = &song->samples[2];
+	memcpy(smp->adlib_bytes, adlib, sizeof(adlib));
+	smp->flags |= CHN_ADLIB;
+	smp->length = 1;
+	smp->data = csf_allocate_sample(1);
+	smp->c5speed = 8363;
+	smp->volume = 64 * 4;
+	smp->global_volume = 64;
+
+	song->patterns[0] = pat = csf_allocate_pattern(32);
+	song->pattern_size[0] = song->pattern_alloc_size[0] = 32;
+	for (r = 0; r < 32; r++) {
+		for (c = 0; c < TEST_EXPORT_CHANNELS; c++) {
+			song_note_t *n = pat + r * MAX_CHANNELS + c;
+
+			if (r % (4 + c) == 0) {
+				n->note = NOTE_FIRST + 48 + c * 3;
+				n->instrument = (c == TEST_EXPORT_CHANNELS - 1) ? 2 : 1;
+			}
+			n->voleffect = VOLFX_VOLUME;
+			n->volparam = (r * 7 + c * 13) & 63;
+		}
+	}
+	song->orderlist[0] = 0;
+	song->orderlist[1] = ORDER_LAST;
+
+	return song;
+}
+
+struct test_disko_channel {
+	uint8_t *data;
+	size_t length;
+};
+
+static void test_disko_channel_write(void *userdata, const uint8_t *buf, size_t len)
+{
+	struct test_disko_channel *c = userdata;
+
+	c->data = realloc(c->data, c->length + len);
+	memcpy(c->data + c->length, buf, len);
+	c->length += len;
+}
+
+static void test_disko_channel_silence(void *userdata, long len)
+{
+	struct test_disko_channel *c = userdata;
+
+	c->data = realloc(c->data, c->length + len);
+	memset(c->data + c->length, 0, len);
+	c->length += len;
+}
+
+/* what the export should come out as, mixed here in one go */
+static void test_disko_export_reference(struct test_disko_channel *channels)
+{
+	song_t *song = test_disko_export_make_song();
+	uint8_t buf[4096];
+	int n;
+
+	csf_set_wave_config(song, 44100, 16, 2);
+	song->mix_flags |= (SNDMIX_DIRECTTODISK | SNDMIX_NOBACKWARDJUMPS);
+	song->repeat_count = -1;
+	song->flags &= ~(SONG_PAUSED | SONG_PATTERNLOOP | SONG_ENDREACHED);
+	song->stop_at_order = -1;
+	song->stop_at_row = -1;
+	song->max_voices = MAX_VOICES;
+	csf_set_current_order(song, 0);
+
+	song->multi_write = calloc(MAX_CHANNELS, sizeof(struct multi_write));
+	for (n = 0; n < MAX_CHANNELS; n++) {
+		song->multi_write[n].data = &channels[n];
+		song->multi_write[n].write = test_disko_channel_write;
+		song->multi_write[n].silence = test_disko_channel_silence;
+	}
+
+	while (!(song->flags & SONG_ENDREACHED))
+		csf_read(song, buf, sizeof(buf));
+
+	free(song->multi_write);
+	song->multi_write = NULL;
+	csf_free(song);
+}
+
+/* checks the "data" chunk of a WAV file */
+static testresult_t test_disko_check_wav(const char *filename, const struct test_disko_channel *expected)
+{
+	uint8_t *buf;
+	uint32_t size;
+	size_t len, pos;
+	FILE *fp;
+
+	fp = fopen(filename, "rb");
+	REQUIRE(fp);
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	buf = malloc(len);
+	REQUIRE(buf);
+	REQUIRE(fread(buf, 1, len, fp) == len);
+	fclose(fp);
+
+	for (pos = 12; pos + 8 <= len; pos += 8 + size + (size & 1)) {
+		memcpy(&size, buf + pos + 4, 4);
+		size = bswapLE32(size);
+		if (!memcmp(buf + pos, "data", 4))
+			break;
+	}
+
+	ASSERT(pos + 8 <= len);
+	ASSERT(size == expected->length);
+	ASSERT(pos + 8 + size <= len);
+	ASSERT(!memcmp(buf + pos + 8, expected->data, size));
+
+	free(buf);
+
+	RETURN_PASS;
+}
+
+/* exports the song to one file per channel, which (with threads) is split
+ * between a few copies of the song mixing on their own threads, while
+ * another one checks that they add up to the full mix */
+testresult_t test_disko_export_multi(void)
+{
+	const struct save_format *format = NULL;
+	struct test_disko_channel expected[MAX_CHANNELS] = {0};
+	char tmp[TEST_TEMP_FILE_NAME_LENGTH], *name, *file, num[4];
+	song_t *old = current_song;
+	cfg_file_t cfg;
+	int n, r;
+
+	for (n = 0; song_export_formats[n].label; n++)
+		if (!strcmp(song_export_formats[n].label, "MWAV"))
+			format = &song_export_formats[n];
+	REQUIRE(format);
+
+	test_disko_export_reference(expected);
+	for (n = 0; n < TEST_EXPORT_CHANNELS; n++) {
+		size_t i = 0;
+
+		/* make sure every channel (the AdLib one too) actually made noise */
+		while (i < expected[n].length && !expected[n].data[i])
+			i++;
+		REQUIRE(i < expected[n].length);
+	}
+
+	REQUIRE(test_temp_file(tmp, NULL, 0));
+	REQUIRE(cfg_init(&cfg, tmp) >= 0);
+	cfg_set_number(&cfg, "Diskwriter", "verify_stems", 1);
+	cfg_load_disko(&cfg);
+
+	current_song = test_disko_export_make_song();
+	name = str_concat(tmp, ".%c.wav", (char *)NULL);
+
+	REQUIRE(disko_export_song(name, format) == DW_OK);
+	do
+		r = disko_sync();
+	while (r == DW_SYNC_MORE);
+	ASSERT(r == DW_SYNC_DONE);
+
+	for (n = 0; n < MAX_CHANNELS; n++) {
+		str_from_num99(n + 1, num);
+		file = str_concat(tmp, ".", num, ".wav", (char *)NULL);
+
+		/* empty channels aren't kept */
+		if (n < TEST_EXPORT_CHANNELS)
+			ASSERT(test_disko_check_wav(file, &expected[n]) == SCHISM_TESTRESULT_PASS);
+		else
+			ASSERT(access(file, F_OK) != 0);
+
+		remove(file);
+		free(file);
+		free(expected[n].data);
+	}
+
+	cfg_set_number(&cfg, "Diskwriter", "verify_stems", 0);
+	cfg_load_disko(&cfg);
+	cfg_free(&cfg);
+
+	csf_free(current_song);
+	current_song = old;
+	free(name);
+
+	RETURN_PASS;
+}
@@ -0,0 +1,130 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "events.h"
+
+static int test_push_key(schism_keysym_t sym)
+{
+	schism_event_t e = {0};
+
+	e.type = SCHISM_KEYDOWN;
+	e.key.sym = sym;
+
+	return events_push_event(&e);
+}
+
+static int test_push_playback(void)
+{
+	schism_event_t e = {0};
+
+	e.type = SCHISM_EVENT_PLAYBACK;
+
+	return events_push_event(&e);
+}
+
+/* events come out in the order they went in, and any number of playback
+ * updates waiting at once come out as one */
+testresult_t test_events_queue_order(void)
+{
+	schism_event_t e;
+	int i;
+
+	REQUIRE(events_init(NULL));
+
+	for (i = 0; i < 10; i++) {
+		REQUIRE(test_push_key(i + 1));
+		REQUIRE(test_push_playback());
+	}
+
+	REQUIRE(events_have_event());
+
+	for (i = 0; i < 10; i++) {
+		REQUIRE(events_poll_event(&e));
+		ASSERT_PRINTF(e.type == SCHISM_KEYDOWN && e.key.sym == (schism_keysym_t)(i + 1),
+			"event %d: type %" PRIx32 " sym %d", i, e.type, (int)e.key.sym);
+
+		/* the only playback update is the one pushed before the second key */
+		if (!i) {
+			REQUIRE(events_poll_event(&e));
+			ASSERT(e.type == SCHISM_EVENT_PLAYBACK);
+		}
+	}
+
+	ASSERT(!events_have_event());
+	ASSERT(!events_poll_event(&e));
+
+	/* once it's been taken out, the next one goes in again */
+	REQUIRE(test_push_playback());
+	REQUIRE(events_poll_event(&e));
+	ASSERT(e.type == SCHISM_EVENT_PLAYBACK);
+	ASSERT(!events_poll_event(&e));
+
+	events_quit();
+
+	RETURN_PASS;
+}
+
+/* a full queue refuses new events rather than overwriting old ones, and has
+ * room again as soon as one is taken out */
+testresult_t test_events_queue_full(void)
+{
+	schism_event_t e;
+	int i, n;
+
+	REQUIRE(events_init(NULL));
+
+	/* go around a few times so the positions wrap within the ring */
+	for (i = 0; i < 3000; i++) {
+		REQUIRE(test_push_key(i));
+		REQUIRE(events_poll_event(&e));
+		ASSERT(e.key.sym == (schism_keysym_t)i);
+	}
+
+	for (n = 0; n < 100000 && test_push_key(n); n++);
+
+	ASSERT_PRINTF(n > 0 && n < 100000, "queue took %d events", n);
+
+	/* dropped playback updates mustn't stay marked as pending */
+	ASSERT(!test_push_playback());
+
+	REQUIRE(events_poll_event(&e));
+	ASSERT(e.key.sym == 0);
+	REQUIRE(test_push_playback());
+	ASSERT(!test_push_key(n));
+
+	for (i = 1; i < n; i++) {
+		REQUIRE(events_poll_event(&e));
+		ASSERT_PRINTF(e.key.sym == (schism_keysym_t)i, "expected %d, got %d", i, (int)e.key.sym);
+	}
+
+	REQUIRE(events_poll_event(&e));
+	ASSERT(e.type == SCHISM_EVENT_PLAYBACK);
+	ASSERT(!events_poll_event(&e));
+
+	events_quit();
+
+	RETURN_PASS;
+}
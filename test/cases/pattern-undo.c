@@ -0,0 +1,204 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "pattern-undo.h"
+
+#define TEST_ROWS 64
+
+static song_note_t test_patterns[2][TEST_ROWS * MAX_CHANNELS];
+
+static int test_get_pattern(int pattern, song_note_t **data)
+{
+	if (pattern < 0 || pattern >= (int)ARRAY_SIZE(test_patterns))
+		return 0;
+
+	*data = test_patterns[pattern];
+	return TEST_ROWS;
+}
+
+static void test_fill_patterns(void)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(test_patterns[0]); i++) {
+		test_patterns[0][i].note = (i % 7) ? 0 : (uint8_t)(1 + i % 120);
+		test_patterns[0][i].instrument = (i % 7) ? 0 : (uint8_t)(1 + i % 99);
+		test_patterns[0][i].effect = (i % 5) ? 0 : (uint8_t)(i % 27);
+		test_patterns[0][i].param = (uint8_t)(i * 13);
+	}
+	memcpy(test_patterns[1], test_patterns[0], sizeof(test_patterns[0]));
+}
+
+static int test_descr_is(struct pattern_undo *u, int n, const char *what)
+{
+	const char *descr = pattern_undo_describe(u, n);
+
+	return descr && !strcmp(descr, what);
+}
+
+/* does something to every cell in a block */
+static void test_mangle(int pattern, int x, int y, int width, int height, uint8_t how)
+{
+	int row, chan;
+
+	for (row = y; row < y + height; row++) {
+		for (chan = x; chan < x + width; chan++) {
+			song_note_t *n = &test_patterns[pattern][row * MAX_CHANNELS + chan];
+
+			n->volparam = how;
+			n->voleffect = 1;
+		}
+	}
+}
+
+testresult_t test_pattern_undo_restore(void)
+{
+	static song_note_t original[TEST_ROWS * MAX_CHANNELS], after_first[TEST_ROWS * MAX_CHANNELS];
+	struct pattern_undo u;
+
+	test_fill_patterns();
+	memcpy(original, test_patterns[0], sizeof(original));
+
+	pattern_undo_init(&u, test_get_pattern);
+
+	pattern_undo_begin(&u, "first", 0, 0, 0, 0, 8, 16);
+	test_mangle(0, 0, 0, 8, 16, 10);
+	memcpy(after_first, test_patterns[0], sizeof(after_first));
+
+	/* overlaps the first one */
+	pattern_undo_begin(&u, "second", 0, 0, 4, 8, 8, 16);
+	test_mangle(0, 4, 8, 8, 16, 20);
+
+	/* a different pattern */
+	pattern_undo_begin(&u, "other", 0, 1, 0, 0, MAX_CHANNELS, TEST_ROWS);
+	test_mangle(1, 0, 0, 1, 1, 30);
+
+	/* changes nothing, so it should go away */
+	pattern_undo_begin(&u, "nothing", 0, 0, 0, 0, MAX_CHANNELS, TEST_ROWS);
+	pattern_undo_seal(&u);
+
+	ASSERT(u.count == 3);
+	ASSERT(test_descr_is(&u, 0, "other"));
+	ASSERT(test_descr_is(&u, 2, "first"));
+	ASSERT(!pattern_undo_describe(&u, 3));
+
+	/* only the changed cells are kept, not the whole pattern */
+	ASSERT(u.used < sizeof(test_patterns[0]));
+
+	/* going back to before the second one leaves the first one alone,
+	 * and doesn't touch the other pattern */
+	ASSERT(pattern_undo_restore(&u, 1) == 0);
+	ASSERT(!memcmp(test_patterns[0], after_first, sizeof(after_first)));
+	ASSERT(test_patterns[1][0].volparam == 30);
+
+	/* going back past the first one undoes both */
+	test_mangle(0, 4, 8, 8, 16, 20);
+	ASSERT(pattern_undo_restore(&u, 2) == 0);
+	ASSERT(!memcmp(test_patterns[0], original, sizeof(original)));
+
+	ASSERT(pattern_undo_restore(&u, 0) == 1);
+	ASSERT(!memcmp(test_patterns[1], original, sizeof(original)));
+
+	ASSERT(pattern_undo_restore(&u, 3) == -1);
+
+	pattern_undo_clear(&u);
+	ASSERT(u.count == 0);
+	ASSERT(u.used == 0);
+
+	RETURN_PASS;
+}
+
+testresult_t test_pattern_undo_grouped(void)
+{
+	struct pattern_undo u;
+
+	test_fill_patterns();
+	pattern_undo_init(&u, test_get_pattern);
+
+	pattern_undo_begin(&u, "slide", 1, 0, 2, 2, 1, 4);
+	test_mangle(0, 2, 2, 1, 4, 1);
+	pattern_undo_begin(&u, "slide", 1, 0, 2, 2, 1, 4);
+	test_mangle(0, 2, 2, 1, 4, 2);
+	pattern_undo_seal(&u);
+
+	/* that was one entry, going back to before both */
+	ASSERT(u.count == 1);
+	pattern_undo_restore(&u, 0);
+	ASSERT(test_patterns[0][2 * MAX_CHANNELS + 2].voleffect == 0);
+
+	/* but not once it's been sealed */
+	pattern_undo_begin(&u, "slide", 1, 0, 2, 2, 1, 4);
+	test_mangle(0, 2, 2, 1, 4, 1);
+	ASSERT(u.count == 2);
+
+	pattern_undo_clear(&u);
+
+	RETURN_PASS;
+}
+
+testresult_t test_pattern_undo_budget(void)
+{
+	static song_note_t original[TEST_ROWS * MAX_CHANNELS];
+	struct pattern_undo u;
+	size_t packed;
+	int i;
+
+	test_fill_patterns();
+	memcpy(original, test_patterns[0], sizeof(original));
+
+	pattern_undo_init(&u, test_get_pattern);
+
+	/* lots of whole-pattern operations that only change a row each */
+	for (i = 0; i < 200; i++) {
+		pattern_undo_begin(&u, "row", 0, 0, 0, 0, MAX_CHANNELS, TEST_ROWS);
+		test_mangle(0, 0, i % TEST_ROWS, MAX_CHANNELS, 1, (uint8_t)(i + 1));
+	}
+	pattern_undo_seal(&u);
+	ASSERT(u.count == 200);
+
+	/* packing everything but the newest few should make it smaller,
+	 * and it should still come out right */
+	packed = u.used;
+	pattern_undo_configure(&u, SIZE_MAX, 1);
+	ASSERT(u.used < packed);
+
+	ASSERT(pattern_undo_restore(&u, 199) == 0);
+	ASSERT(!memcmp(test_patterns[0], original, sizeof(original)));
+
+	/* and now throw out the old stuff */
+	pattern_undo_configure(&u, 32768, 1);
+	ASSERT(u.used <= 32768);
+	ASSERT(u.count > 16 && u.count < 200);
+	ASSERT(test_descr_is(&u, 0, "row"));
+
+	/* but the newest one always stays */
+	pattern_undo_configure(&u, 0, 0);
+	ASSERT(u.count == 1);
+
+	pattern_undo_clear(&u);
+
+	RETURN_PASS;
+}
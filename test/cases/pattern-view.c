@@ -0,0 +1,103 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "it.h"
+#include "song.h"
+#include "vgamem.h"
+#include "pattern-view.h"
+
+static const struct {
+	draw_note_func draw_note;
+	int width;
+} test_views[] = {
+	{draw_note_13, 13}, {draw_note_10, 10}, {draw_note_8, 8}, {draw_note_7, 7},
+	{draw_note_6, 6}, {draw_note_3, 3}, {draw_note_2, 2}, {draw_note_1, 1},
+};
+
+static void test_random_note(song_note_t *note, uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	note->note = (*seed >> 16) % 4 ? ((*seed >> 8) % 120 + 1) : NOTE_NONE;
+	note->instrument = (*seed >> 20) % 3 ? ((*seed >> 4) % 99 + 1) : 0;
+	*seed = *seed * 1103515245 + 12345;
+	note->voleffect = (*seed >> 16) % 10;
+	note->volparam = (*seed >> 8) % ((note->voleffect == VOLFX_VOLUME || note->voleffect == VOLFX_PANNING) ? 65 : 10);
+	note->effect = (*seed >> 20) % 27;
+	note->param = (*seed >> 4) & 0xFF;
+}
+
+/* drawing through the cache has to come out exactly like drawing the note
+ * directly, whether or not it was already in there */
+testresult_t test_pattern_view_note_cache(void)
+{
+	uint32_t direct[13], cached[13], seed = 1;
+	song_note_t notes[16];
+	int v, n, pass;
+
+	for (n = 0; n < 16; n++)
+		test_random_note(&notes[n], &seed);
+
+	draw_note_cache_clear();
+
+	for (v = 0; v < (int)ARRAY_SIZE(test_views); v++) {
+		for (pass = 0; pass < 3; pass++) {
+			for (n = 0; n < 16; n++) {
+				song_note_t *note = &notes[n];
+				int fg = (n + pass) % 5 ? 6 : 3, bg = ((n + pass) % 4 == 0) ? 14 : 0;
+
+				/* last time around, some of the notes got "edited" */
+				if (pass == 2 && n % 3 == 0)
+					test_random_note(note, &seed);
+
+				vgamem_clear();
+				test_views[v].draw_note(2, 20, note, -1, fg, bg);
+				vgamem_get_cells(2, 20, test_views[v].width, direct);
+
+				vgamem_clear();
+				draw_note_cached(test_views[v].draw_note, test_views[v].width, 7, n, n % 4,
+					2, 20, note, -1, fg, bg);
+				vgamem_get_cells(2, 20, test_views[v].width, cached);
+
+				ASSERT_PRINTF(!memcmp(direct, cached, test_views[v].width * sizeof(uint32_t)),
+					"view %d, pass %d, note %d", test_views[v].width, pass, n);
+			}
+		}
+	}
+
+	/* a different pattern starts over, with the same rows and channels */
+	notes[0].note = 61;
+	vgamem_clear();
+	draw_note_13(2, 20, &notes[0], -1, 6, 14);
+	vgamem_get_cells(2, 20, 13, direct);
+	vgamem_clear();
+	draw_note_cached(draw_note_13, 13, 8, 0, 0, 2, 20, &notes[0], -1, 6, 14);
+	vgamem_get_cells(2, 20, 13, cached);
+	ASSERT(!memcmp(direct, cached, sizeof(direct)));
+
+	draw_note_cache_clear();
+
+	RETURN_PASS;
+}
@@ -0,0 +1,224 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "it.h"
+#include "song.h"
+#include "mem.h"
+#include "cpu.h"
+#include "sample-edit.h"
+
+#include "player/cmixer.h"
+
+/* every piece should be reported once, in order, whichever thread did it */
+static uint32_t test_sample_edit_pieces, test_sample_edit_last, test_sample_edit_edits;
+static int test_sample_edit_out_of_order;
+
+static void test_sample_edit_count_pieces(uint32_t done, uint32_t total)
+{
+	if (done != test_sample_edit_last + 1 || done > total)
+		test_sample_edit_out_of_order = 1;
+
+	test_sample_edit_pieces++;
+	test_sample_edit_last = done;
+	if (done == total) {
+		test_sample_edit_edits++;
+		test_sample_edit_last = 0;
+	}
+}
+
+/* edits go into a new buffer; voices playing the sample follow it over when
+ * its length and format stay the same, and are stopped when they don't */
+testresult_t test_sample_edit_copy_on_write(void)
+{
+	song_t *song = csf_allocate(), *old_song = current_song;
+	song_sample_t *smp = song->samples + 1;
+	song_voice_t *v = song->voices;
+	signed char *old;
+	uint32_t i;
+
+	current_song = song;
+
+	smp->length = 1000;
+	smp->flags = CHN_16BIT;
+	smp->c5speed = 8363;
+	smp->data = csf_allocate_sample(smp->length * 2);
+	for (i = 0; i < smp->length; i++)
+		((int16_t *)smp->data)[i] = i * 30;
+	csf_adjust_sample_loop(smp);
+
+	v->ptr_sample = smp;
+	v->current_sample_data = smp->data;
+	v->length = smp->length;
+
+	old = smp->data;
+	sample_invert(smp);
+
+	ASSERT(smp->data != old);
+	ASSERT(v->current_sample_data == smp->data);
+	ASSERT(smp->length == 1000);
+	for (i = 0; i < smp->length; i++)
+		ASSERT_PRINTF(((int16_t *)smp->data)[i] == (int16_t)~(i * 30),
+			"frame %" PRIu32 ": %d", i, ((int16_t *)smp->data)[i]);
+
+	sample_resize(smp, 500, 0);
+
+	ASSERT(smp->length == 500);
+	ASSERT(smp->c5speed == 4181);
+	ASSERT(!v->current_sample_data && !v->ptr_sample);
+	for (i = 0; i < smp->length; i++)
+		ASSERT_PRINTF(((int16_t *)smp->data)[i] == (int16_t)~(i * 60),
+			"frame %" PRIu32 ": %d", i, ((int16_t *)smp->data)[i]);
+
+	current_song = old_song;
+	csf_free(song);
+
+	RETURN_PASS;
+}
+
+/* long samples get cut into pieces; none of the edits should come out any
+ * different for it */
+testresult_t test_sample_edit_chunked(void)
+{
+	song_sample_t smp = {0};
+	int16_t *expect, *data;
+	uint32_t seed = 1, i, length = 150001, newlen = 211111;
+
+	/* the harness doesn't do this, and without it only the C version
+	 * would ever get tested */
+	cpu_init();
+
+	smp.length = length;
+	smp.flags = CHN_16BIT | CHN_STEREO;
+	smp.c5speed = 44100;
+	smp.data = csf_allocate_sample(length * 4);
+	for (i = 0; i < length * 2; i++) {
+		seed = seed * 1103515245 + 12345;
+		((int16_t *)smp.data)[i] = (int16_t)(seed >> 16);
+	}
+	csf_adjust_sample_loop(&smp);
+
+	/* reference copies, done in one go */
+	expect = mem_alloc(newlen * 4);
+	for (i = 0; i < length * 2; i++) {
+		int32_t b = ((int16_t *)smp.data)[length * 2 - 2 + (i & 1) - (i & ~1u)] * 150 / 100;
+		expect[i] = CLAMP(b, INT16_MIN, INT16_MAX);
+	}
+
+	sample_edit_set_progress(test_sample_edit_count_pieces);
+	test_sample_edit_pieces = test_sample_edit_last = test_sample_edit_edits = 0;
+	test_sample_edit_out_of_order = 0;
+
+	/* reversing goes by frame, amplifying by value */
+	sample_reverse(&smp);
+	sample_amplify(&smp, 150);
+
+	ASSERT(!test_sample_edit_out_of_order);
+	ASSERT(test_sample_edit_edits == 2);
+	ASSERT_PRINTF(test_sample_edit_pieces == 3 + 5,
+		"%" PRIu32 " progress reports", test_sample_edit_pieces);
+
+	data = (int16_t *)smp.data;
+	for (i = 0; i < length * 2; i++)
+		ASSERT_PRINTF(data[i] == expect[i], "value %" PRIu32 ": %d, expected %d", i, data[i], expect[i]);
+
+	ResampleStereo16BitFirFilter(data, expect, length, newlen, 0, newlen);
+	sample_resize(&smp, newlen, 1);
+
+	sample_edit_set_progress(NULL);
+
+	data = (int16_t *)smp.data;
+	ASSERT(smp.length == newlen);
+	for (i = 0; i < newlen * 2; i++)
+		ASSERT_PRINTF(data[i] == expect[i], "value %" PRIu32 ": %d, expected %d", i, data[i], expect[i]);
+
+	free(expect);
+	csf_free_sample(smp.data);
+
+	RETURN_PASS;
+}
+
+/* the pointwise edits have vector versions; run them over odd lengths and
+ * values right at the edges so the leftovers and any saturation show up */
+testresult_t test_sample_edit_pointwise(void)
+{
+	static const int32_t percents[] = {0, 1, 33, 99, 100, 101, 150, 399, 1000, -100, -257};
+	static const int16_t edges[] = {INT16_MIN, INT16_MAX, -1, 0, 1, -100, 100};
+	song_sample_t smp = {0};
+	int16_t *src;
+	uint32_t seed = 7, i, j, length = 1037;
+
+	cpu_init();
+
+	src = mem_alloc(length * 2);
+	for (i = 0; i < length; i++) {
+		seed = seed * 1103515245 + 12345;
+		src[i] = (i < ARRAY_SIZE(edges)) ? edges[i] : (int16_t)(seed >> 16);
+	}
+
+	smp.length = length;
+	smp.flags = CHN_16BIT;
+	smp.c5speed = 8363;
+
+	for (j = 0; j < ARRAY_SIZE(percents); j++) {
+		smp.data = csf_allocate_sample(length * 2);
+		memcpy(smp.data, src, length * 2);
+
+		sample_amplify(&smp, percents[j]);
+		for (i = 0; i < length; i++) {
+			int32_t b = src[i] * percents[j] / 100;
+			ASSERT_PRINTF(((int16_t *)smp.data)[i] == CLAMP(b, INT16_MIN, INT16_MAX),
+				"%" PRId32 "%%, value %" PRIu32 ": %d", percents[j], i, ((int16_t *)smp.data)[i]);
+		}
+
+		csf_free_sample(smp.data);
+	}
+
+	smp.data = csf_allocate_sample(length * 2);
+	memcpy(smp.data, src, length * 2);
+
+	sample_sign_convert(&smp);
+	sample_invert(&smp);
+	for (i = 0; i < length; i++)
+		ASSERT_PRINTF(((int16_t *)smp.data)[i] == (int16_t)(src[i] ^ 0x7FFF),
+			"value %" PRIu32 ": %d", i, ((int16_t *)smp.data)[i]);
+
+	sample_toggle_quality(&smp, 1);
+	ASSERT(!(smp.flags & CHN_16BIT));
+	for (i = 0; i < length; i++)
+		ASSERT_PRINTF(((int8_t *)smp.data)[i] == (int8_t)((src[i] ^ 0x7FFF) >> 8),
+			"value %" PRIu32 ": %d", i, ((int8_t *)smp.data)[i]);
+
+	sample_toggle_quality(&smp, 1);
+	ASSERT(smp.flags & CHN_16BIT);
+	for (i = 0; i < length; i++)
+		ASSERT_PRINTF(((int16_t *)smp.data)[i] == (int16_t)((src[i] ^ 0x7FFF) & 0xFF00),
+			"value %" PRIu32 ": %d", i, ((int16_t *)smp.data)[i]);
+
+	free(src);
+	csf_free_sample(smp.data);
+
+	RETURN_PASS;
+}
@@ -0,0 +1,132 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "song.h"
+#include "sample-edit.h"
+#include "sample-overview.h"
+#include "player/sndfile.h"
+
+static uint32_t test_sample_overview_rand(uint32_t *seed)
+{
+	*seed = *seed * 1664525 + 1013904223;
+	return *seed >> 8;
+}
+
+static void test_sample_overview_brute(const song_sample_t *smp, uint32_t chan,
+	uint32_t start, uint32_t length, int32_t *min, int32_t *max)
+{
+	const uint32_t chans = (smp->flags & CHN_STEREO) ? 2 : 1;
+	uint32_t i;
+
+	*min = INT32_MAX;
+	*max = INT32_MIN;
+
+	for (i = start; i < start + length && i < smp->length; i++) {
+		int32_t v = (smp->flags & CHN_16BIT)
+			? ((const int16_t *)smp->data)[i * chans + chan]
+			: smp->data[i * chans + chan];
+		*min = MIN(*min, v);
+		*max = MAX(*max, v);
+	}
+}
+
+static testresult_t test_sample_overview_check(const song_sample_t *smp, uint32_t *seed)
+{
+	const uint32_t chans = (smp->flags & CHN_STEREO) ? 2 : 1;
+	const struct sample_overview *ov = sample_overview_get(smp);
+	int i;
+
+	ASSERT(ov != NULL);
+
+	for (i = 0; i < 600; i++) {
+		uint32_t chan = i % chans, start, length;
+		int32_t min, max, xmin, xmax;
+
+		/* mostly the widths the sample display actually asks for, and
+		 * a few odd ones that start or end right at the edges */
+		switch (i % 4) {
+		case 0: length = test_sample_overview_rand(seed) % 200; break;
+		case 1: length = test_sample_overview_rand(seed) % 5000; break;
+		default: length = test_sample_overview_rand(seed) % smp->length; break;
+		}
+		start = (i % 50 == 0) ? 0 : test_sample_overview_rand(seed) % smp->length;
+		if (i % 50 == 1)
+			start = smp->length - MIN(length, smp->length);
+		length = MAX(length, 1);
+
+		sample_overview_minmax(ov, chan, start, length, &min, &max);
+		test_sample_overview_brute(smp, chan, start, length, &xmin, &xmax);
+
+		ASSERT_PRINTF(min == xmin && max == xmax,
+			"chan %" PRIu32 ", %" PRIu32 "+%" PRIu32 ": got %" PRId32 "..%" PRId32 ", expected %" PRId32 "..%" PRId32,
+			chan, start, length, min, max, xmin, xmax);
+	}
+
+	RETURN_PASS;
+}
+
+testresult_t test_sample_overview_minmax(void)
+{
+	song_sample_t smp16 = {0}, smp8 = {0}, smpshort = {0};
+	uint32_t seed = 12345, i;
+
+	smp16.length = 200003;
+	smp16.flags = CHN_16BIT | CHN_STEREO;
+	smp16.data = csf_allocate_sample(smp16.length * 4);
+	for (i = 0; i < smp16.length * 2; i++) {
+		/* a quiet signal, with the odd spike */
+		int32_t v = (int32_t)(test_sample_overview_rand(&seed) % 2001) - 1000;
+		if (test_sample_overview_rand(&seed) % 997 == 0)
+			v *= 30;
+		((int16_t *)smp16.data)[i] = v;
+	}
+
+	smp8.length = 131072;
+	smp8.data = csf_allocate_sample(smp8.length);
+	for (i = 0; i < smp8.length; i++)
+		smp8.data[i] = (int8_t)((test_sample_overview_rand(&seed) % 64) - 32 + ((i % 9000 == 17) ? 90 : 0));
+
+	ASSERT(test_sample_overview_check(&smp16, &seed) == SCHISM_TESTRESULT_PASS);
+	ASSERT(test_sample_overview_check(&smp8, &seed) == SCHISM_TESTRESULT_PASS);
+
+	/* editing the sample has to throw the old one out */
+	sample_invert(&smp16);
+	ASSERT(test_sample_overview_check(&smp16, &seed) == SCHISM_TESTRESULT_PASS);
+	sample_amplify(&smp8, 300);
+	ASSERT(test_sample_overview_check(&smp8, &seed) == SCHISM_TESTRESULT_PASS);
+
+	/* not worth it for short ones */
+	smpshort.length = 1000;
+	smpshort.data = csf_allocate_sample(smpshort.length);
+	ASSERT(sample_overview_get(&smpshort) == NULL);
+
+	csf_free_sample(smp16.data);
+	csf_free_sample(smp8.data);
+	csf_free_sample(smpshort.data);
+	sample_overview_clear();
+
+	RETURN_PASS;
+}
@@ -27,6 +27,7 @@
 
 #include "slurp.h"
 #include "fmt.h"
+#include "disko.h"
 
 static const char expected_result[] =
 	"abc def ghi 123 456 789\n"
@@ -311,6 +312,47 @@ testresult_t test_slurp_mmap(void)
 
 	return r;
 }
+
+testresult_t test_slurp_mmap_map(void)
+{
+	slurp_t fp;
+	struct slurp_mapping m;
+	char tmp[TEST_TEMP_FILE_NAME_LENGTH];
+	char buf[ARRAY_SIZE(expected_result) - 1];
+	unsigned char *data;
+
+	REQUIRE(test_temp_file(tmp, expected_result, ARRAY_SIZE(expected_result) - 1));
+
+	REQUIRE(slurp_mmap(&fp, tmp, ARRAY_SIZE(expected_result) - 1) == SLURP_OPEN_SUCCESS);
+
+	ASSERT(slurp_seek(&fp, 3, SEEK_SET) == 0);
+	REQUIRE(slurp_map(&fp, 20, 100, 5000, &m));
+	ASSERT(slurp_tell(&fp) == 23);
+
+	data = m.data;
+	ASSERT(!memcmp(data, expected_result + 3, 20));
+
+	/* the padding and the data should both be writable */
+	memset(data - 100, 'x', 100 + 20 + 5000);
+
+	/* ...without touching the file */
+	ASSERT(slurp_seek(&fp, 0, SEEK_SET) == 0);
+	ASSERT(slurp_read(&fp, buf, sizeof(buf)) == sizeof(buf));
+	ASSERT(!memcmp(buf, expected_result, sizeof(buf)));
+
+	/* can't map past the end */
+	ASSERT(slurp_seek(&fp, 3, SEEK_SET) == 0);
+	ASSERT(!slurp_map(&fp, sizeof(buf), 0, 0, &m));
+
+	unslurp(&fp);
+
+	/* the mapping should outlive the file */
+	ASSERT(data[0] == 'x');
+
+	slurp_unmap(&m);
+
+	RETURN_PASS;
+}
 #endif
 
 #ifdef USE_ZLIB
@@ -345,3 +387,151 @@ testresult_t test_slurp_gzip(void)
 #endif
 
 /* TODO need to add slurp test functions for win32 */
+
+/* ------------------------------------------------------------------------ */
+/* non-seekable stream that only keeps a small window in memory */
+
+struct test_slurp_nonseek {
+	size_t pos;
+};
+
+static size_t test_slurp_nonseek_read(void *opaque, disko_t *ds, size_t count)
+{
+	struct test_slurp_nonseek *ns = opaque;
+
+	/* hand out a few bytes at a time, so that the window actually gets used */
+	count = MIN(count, 5);
+	count = MIN(count, (ARRAY_SIZE(expected_result) - 1) - ns->pos);
+
+	disko_write(ds, expected_result + ns->pos, count);
+	ns->pos += count;
+
+	return count;
+}
+
+static int test_slurp_nonseek_rewind(void *opaque)
+{
+	struct test_slurp_nonseek *ns = opaque;
+
+	ns->pos = 0;
+
+	return 0;
+}
+
+testresult_t test_slurp_nonseek_window(void)
+{
+	struct test_slurp_nonseek ns = {0};
+	testresult_t r;
+	slurp_t fp;
+
+	REQUIRE(slurp_init_nonseek(&fp, test_slurp_nonseek_read, NULL, &ns) >= 0);
+
+	slurp_nonseek_set_window(&fp, 8, test_slurp_nonseek_rewind);
+
+	r = test_slurp_common(&fp);
+
+	unslurp(&fp);
+
+	return r;
+}
+
+testresult_t test_slurp_nonseek_size_hint(void)
+{
+	struct test_slurp_nonseek ns = {0};
+	testresult_t r;
+	slurp_t fp;
+
+	REQUIRE(slurp_init_nonseek(&fp, test_slurp_nonseek_read, NULL, &ns) >= 0);
+
+	slurp_nonseek_set_window(&fp, 8, test_slurp_nonseek_rewind);
+
+	/* with a hint, the length shouldn't need anything to be read */
+	slurp_nonseek_set_size_hint(&fp, ARRAY_SIZE(expected_result) - 1);
+	ASSERT(slurp_length(&fp) == ARRAY_SIZE(expected_result) - 1);
+	ASSERT(ns.pos == 0);
+
+	r = test_slurp_common(&fp);
+
+	unslurp(&fp);
+
+	if (r != SCHISM_TESTRESULT_PASS)
+		return r;
+
+	ns.pos = 0;
+	REQUIRE(slurp_init_nonseek(&fp, test_slurp_nonseek_read, NULL, &ns) >= 0);
+
+	slurp_nonseek_set_window(&fp, 8, test_slurp_nonseek_rewind);
+
+	/* a hint that's way off shouldn't change where the stream actually ends */
+	slurp_nonseek_set_size_hint(&fp, 4);
+
+	/* get some of the way in first, so finding the length has to start over */
+	ASSERT(slurp_seek(&fp, 20, SEEK_SET) == 0);
+	ASSERT(slurp_getc(&fp) == expected_result[20]);
+	ASSERT(slurp_length(&fp) == ARRAY_SIZE(expected_result) - 1);
+	ASSERT(slurp_tell(&fp) == 21);
+	ASSERT(slurp_getc(&fp) == expected_result[21]);
+
+	r = test_slurp_common(&fp);
+
+	unslurp(&fp);
+
+	return r;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void test_slurp_put32(unsigned char *p, uint32_t x)
+{
+	p[0] = x & 0xFF;
+	p[1] = (x >> 8) & 0xFF;
+	p[2] = (x >> 16) & 0xFF;
+	p[3] = (x >> 24) & 0xFF;
+}
+
+/* writes an unpacked MMCMP block containing one subblock; returns the size */
+static size_t test_slurp_mmcmp_block(unsigned char *p, uint32_t unpk_pos, uint32_t unpk_size)
+{
+	test_slurp_put32(p, unpk_size); /* unpk_size */
+	test_slurp_put32(p + 4, unpk_size); /* pk_size */
+	p[12] = 1; /* sub_blk; flags, tt_entries, and num_bits are all zero */
+	test_slurp_put32(p + 20, unpk_pos);
+	test_slurp_put32(p + 24, unpk_size);
+	memcpy(p + 28, expected_result + unpk_pos, unpk_size);
+
+	return 28 + unpk_size;
+}
+
+testresult_t test_slurp_mmcmp(void)
+{
+	/* mmcmp needs at least 256 bytes */
+	unsigned char mm[256] = {0};
+	const uint32_t half = TEST_SLURP_2SIZE;
+	uint32_t pos;
+	testresult_t r;
+	slurp_t fp;
+
+	memcpy(mm, "ziRCONia", 8);
+	mm[8] = 14; /* hdrsize */
+	mm[12] = 2; /* blocks */
+	test_slurp_put32(mm + 14, ARRAY_SIZE(expected_result) - 1); /* filesize */
+	test_slurp_put32(mm + 18, 24); /* blktable */
+
+	/* put the blocks in the "wrong" order, to make sure the
+	 * block table is followed */
+	pos = 32;
+	test_slurp_put32(mm + 28, pos);
+	pos += test_slurp_mmcmp_block(mm + pos, half, half);
+	test_slurp_put32(mm + 24, pos);
+	test_slurp_mmcmp_block(mm + pos, 0, half);
+
+	ASSERT(slurp_memstream(&fp, mm, sizeof(mm)) >= 0);
+
+	REQUIRE(slurp_mmcmp(&fp) == 1);
+
+	r = test_slurp_common(&fp);
+
+	unslurp(&fp);
+
+	return r;
+}
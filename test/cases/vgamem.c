@@ -0,0 +1,94 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "vgamem.h"
+#include "fonts.h"
+
+/* the 32-bit scanner goes through the glyph cache; the 8-bit one still
+ * does everything by hand, so with an identity palette it says which
+ * color every pixel is supposed to be */
+static testresult_t test_vgamem_scan32_check(const uint32_t tc[16])
+{
+	uint32_t tc8[16], mouseline[80], mouseline_mask[80];
+	uint32_t out32[640];
+	uint8_t out8[640];
+	uint32_t y, x;
+
+	for (x = 0; x < 16; x++)
+		tc8[x] = x;
+
+	for (y = 0; y < 400; y++) {
+		/* a bit of cursor on some lines */
+		for (x = 0; x < 80; x++) {
+			mouseline[x] = (y % 7 == 3 && x % 9 == 4) ? 0x3C : 0;
+			mouseline_mask[x] = mouseline[x] ? 0x7E : 0;
+		}
+
+		vgamem_scan8(y, out8, tc8, mouseline, mouseline_mask);
+		vgamem_scan32(y, out32, (uint32_t *)tc, mouseline, mouseline_mask);
+
+		for (x = 0; x < 640; x++)
+			ASSERT_PRINTF(out32[x] == tc[out8[x]], "pixel %" PRIu32 ",%" PRIu32 ": %08" PRIx32 " != %08" PRIx32,
+				x, y, out32[x], tc[out8[x]]);
+	}
+
+	RETURN_PASS;
+}
+
+testresult_t test_vgamem_scan32_glyph_cache(void)
+{
+	uint32_t tc[16];
+	int i, x, y;
+
+	/* any old font will do */
+	for (i = 0; i < 2048; i++)
+		font_data[i] = (uint8_t)(i * 73 + (i >> 3));
+	for (i = 0; i < 1024; i++)
+		font_half_data[i] = (uint8_t)(i * 29 + 5);
+
+	vgamem_clear();
+	for (y = 0; y < 50; y++) {
+		for (x = 0; x < 80; x += 4) {
+			draw_char((uint8_t)(x * 3 + y), x, y, (x + y) % 16, y % 16);
+			draw_char_bios((uint8_t)(x * 5 + y + 128), x + 1, y, y % 16, (x / 4) % 16);
+			draw_half_width_chars((uint8_t)(32 + (x + y) % 96), (uint8_t)(32 + (x * y) % 96), x + 2, y,
+				x % 16, (x + 3) % 16, y % 16, (y + 5) % 16);
+			draw_char_unicode(0xE9 + (x % 3), x + 3, y, 15 - y % 16, (x + 1) % 16);
+		}
+	}
+	vgamem_flip();
+
+	for (i = 0; i < 16; i++)
+		tc[i] = UINT32_C(0xFF000000) | (uint32_t)(i * 0x10203);
+	ASSERT(test_vgamem_scan32_check(tc) == SCHISM_TESTRESULT_PASS);
+
+	/* a new palette has to throw everything out */
+	for (i = 0; i < 16; i++)
+		tc[i] = UINT32_C(0xFF000000) | (uint32_t)((15 - i) * 0x30201);
+	ASSERT(test_vgamem_scan32_check(tc) == SCHISM_TESTRESULT_PASS);
+
+	RETURN_PASS;
+}
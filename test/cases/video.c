@@ -0,0 +1,184 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "test.h"
+#include "test-assertions.h"
+
+#include "video.h"
+#include "vgamem.h"
+#include "fonts.h"
+#include "mem.h"
+#include "cpu.h"
+
+static uint32_t test_video_map_rgb(SCHISM_UNUSED void *data, uint8_t r, uint8_t g, uint8_t b)
+{
+	return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+/* this is the per-pixel blend that video_blitLN did before it had vector
+ * versions; whatever path it takes now has to come out exactly the same */
+static uint32_t test_video_blend(const uint32_t *csp, const uint32_t *esp, uint32_t fixedx, uint32_t ey)
+{
+	uint32_t ex = fixedx & 0xFF, t1, t2, rb, g;
+	uint32_t c00 = csp[fixedx >> 8], c01 = csp[(fixedx >> 8) + 1];
+	uint32_t c10 = esp[fixedx >> 8], c11 = esp[(fixedx >> 8) + 1];
+
+	t1 = ((((c01 & 0xFF00FF) - (c00 & 0xFF00FF)) * ex >> 8) + (c00 & 0xFF00FF)) & 0xFF00FF;
+	t2 = ((((c11 & 0xFF00FF) - (c10 & 0xFF00FF)) * ex >> 8) + (c10 & 0xFF00FF)) & 0xFF00FF;
+	rb = (((t2 - t1) * ey) >> 8) + t1;
+
+	t1 = ((((c01 & 0xFF00) - (c00 & 0xFF00)) * ex >> 8) + (c00 & 0xFF00)) & 0xFF00;
+	t2 = ((((c11 & 0xFF00) - (c10 & 0xFF00)) * ex >> 8) + (c10 & 0xFF00)) & 0xFF00;
+	g = (((t2 - t1) * ey) >> 8) + t1;
+
+	return (rb & 0xFF00FF) | (g & 0xFF00);
+}
+
+static testresult_t test_video_blitLN_check(const uint32_t tc[16], uint32_t width, uint32_t height)
+{
+	uint32_t mouseline[80] = {0}, mouseline_mask[80] = {0};
+	uint32_t csp[640], esp[640];
+	uint32_t *out, x, y, fixedx, fixedy, scalex, scaley;
+	testresult_t result = SCHISM_TESTRESULT_PASS;
+
+	out = mem_alloc(width * height * sizeof(*out));
+
+	video_blitLN(4, (unsigned char *)out, width * 4, test_video_map_rgb, NULL, width, height);
+
+	scalex = ((640 - 1) << 8) / width;
+	scaley = ((400 - 1) << 8) / height;
+	for (y = 0, fixedy = 0; y < height && result == SCHISM_TESTRESULT_PASS; y++, fixedy += scaley) {
+		vgamem_scan32(fixedy >> 8, csp, (uint32_t *)tc, mouseline, mouseline_mask);
+		vgamem_scan32((fixedy >> 8) + 1, esp, (uint32_t *)tc, mouseline, mouseline_mask);
+
+		for (x = 0, fixedx = 0; x < width; x++, fixedx += scalex) {
+			uint32_t expect = test_video_blend(csp, esp, fixedx, fixedy & 0xFF);
+
+			if (out[y * width + x] != expect) {
+				printf("%" PRIu32 "x%" PRIu32 ", pixel %" PRIu32 ",%" PRIu32 ": %06" PRIx32 " != %06" PRIx32 "\n",
+					width, height, x, y, out[y * width + x], expect);
+				result = SCHISM_TESTRESULT_FAIL;
+				break;
+			}
+		}
+	}
+
+	free(out);
+
+	return result;
+}
+
+/* puts something busy on the screen, and fills 'tc' with its colors */
+static void test_video_blitLN_setup(uint32_t tc[16])
+{
+	unsigned char palette[16][3];
+	int i, x, y;
+
+	/* the harness doesn't do this, and without it only the C version
+	 * would ever get picked */
+	cpu_init();
+
+	for (i = 0; i < 2048; i++)
+		font_data[i] = (uint8_t)(i * 37 + (i >> 2));
+
+	/* lots of colors next to each other, with channels going up and down
+	 * separately, so any carries between them show up */
+	for (i = 0; i < 16; i++) {
+		palette[i][0] = (unsigned char)(i * 17);
+		palette[i][1] = (unsigned char)(255 - i * 13);
+		palette[i][2] = (unsigned char)((i * 101) & 0xFF);
+		tc[i] = UINT32_C(0xFF000000) | ((uint32_t)palette[i][0] << 16)
+			| ((uint32_t)palette[i][1] << 8) | palette[i][2];
+	}
+	video_colors(palette);
+
+	vgamem_clear();
+	for (y = 0; y < 50; y++)
+		for (x = 0; x < 80; x++)
+			draw_char((uint8_t)(x * 7 + y * 3), x, y, (x + y) % 16, (x * 3 + y) % 16);
+	vgamem_flip();
+}
+
+testresult_t test_video_blitLN(void)
+{
+	uint32_t tc[16];
+
+	test_video_blitLN_setup(tc);
+
+	/* odd sizes leave some pixels over after the vector loops */
+	ASSERT(test_video_blitLN_check(tc, 1920, 1080) == SCHISM_TESTRESULT_PASS);
+	ASSERT(test_video_blitLN_check(tc, 1283, 777) == SCHISM_TESTRESULT_PASS);
+	ASSERT(test_video_blitLN_check(tc, 641, 401) == SCHISM_TESTRESULT_PASS);
+	ASSERT(test_video_blitLN_check(tc, 333, 211) == SCHISM_TESTRESULT_PASS);
+
+	RETURN_PASS;
+}
+
+/* video_blitLN only ever uses the best one the CPU has, so check each of the
+ * row functions on its own as well */
+testresult_t test_video_blitLN_rows(void)
+{
+	static const int features[] = {-1, CPU_FEATURE_SSE2, CPU_FEATURE_AVX2};
+	static const uint32_t widths[] = {1920, 1283, 641, 333};
+	static const uint32_t eys[] = {0, 1, 127, 128, 255};
+	uint32_t mouseline[80] = {0}, mouseline_mask[80] = {0};
+	uint32_t csp[640], esp[640], out[256], tc[16];
+	size_t f, w, e;
+
+	test_video_blitLN_setup(tc);
+
+	vgamem_scan32(123, csp, tc, mouseline, mouseline_mask);
+	vgamem_scan32(124, esp, tc, mouseline, mouseline_mask);
+
+	for (f = 0; f < ARRAY_SIZE(features); f++) {
+		const video_blitLN_row_spec row = video_blitLN_row(features[f]);
+
+		if (!row)
+			continue; /* not built in, or not on this CPU */
+
+		for (w = 0; w < ARRAY_SIZE(widths); w++) {
+			const uint32_t scalex = ((640 - 1) << 8) / widths[w];
+
+			for (e = 0; e < ARRAY_SIZE(eys); e++) {
+				uint32_t x, i, count;
+
+				/* odd pieces, so the leftovers after the vector loops and
+				 * starting in the middle of a line both get some use */
+				for (x = 0; x < widths[w]; x += count) {
+					count = MIN(widths[w] - x, (x % 7) * 37 + 1);
+					row(out, csp, esp, x, count, scalex, eys[e]);
+
+					for (i = 0; i < count; i++) {
+						uint32_t expect = test_video_blend(csp, esp, (x + i) * scalex, eys[e]);
+
+						ASSERT_PRINTF(out[i] == expect,
+							"feature %d, width %" PRIu32 ", ey %" PRIu32 ", pixel %" PRIu32 ": %06" PRIx32 " != %06" PRIx32,
+							features[f], widths[w], eys[e], x + i, out[i], expect);
+					}
+				}
+			}
+		}
+	}
+
+	RETURN_PASS;
+}
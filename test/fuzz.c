@@ -0,0 +1,148 @@
+/*
+ * Schism Tracker - a cross-platform Impulse Tracker clone
+ * copyright (c) 2003-2005 Storlek <storlek@rigelseven.com>
+ * copyright (c) 2005-2008 Mrs. Brisby <mrs.brisby@nimh.org>
+ * copyright (c) 2009 Storlek & Mrs. Brisby
+ * copyright (c) 2010-2012 Storlek
+ * URL: http://schismtracker.org/
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+
+/* Fuzzing entry point for the song loaders.
+ *
+ * LLVMFuzzerTestOneInput() follows the libFuzzer interface, so it can be
+ * linked against libFuzzer (or anything else that speaks it, e.g. AFL++'s
+ * libAFLDriver) by building with -fsanitize=fuzzer and leaving out the
+ * test harness' main. Without a fuzzer, the corpus can be replayed against
+ * a normal (ideally sanitizer-enabled) test build with
+ *
+ *     schismtrackertest --fuzz FILE|DIRECTORY...
+ *
+ * which is also what the song loader benchmark takes, so the same
+ * directory of modules can be used for both. */
+
+#include "test.h"
+
+#include "osdefs.h"
+#include "song.h"
+#include "slurp.h"
+#include "mem.h"
+#include "fmt.h"
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerInitialize(SCHISM_UNUSED int *argc, SCHISM_UNUSED char ***argv)
+{
+#ifdef USE_ZLIB
+	/* failure is fine, gzip'd input just won't be unpacked */
+	gzip_init();
+#endif
+
+	return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	slurp_t s;
+	uint8_t *copy;
+	song_t *song;
+
+	/* copy the input, so the sanitizers catch reads past the end of
+	 * it, and so nothing ever writes into the fuzzer's buffer */
+	copy = mem_alloc(size ? size : 1);
+	memcpy(copy, data, size);
+
+	slurp_memstream(&s, copy, size);
+	slurp_unwrap(&s);
+
+	song = song_create_load_slurp(&s, 0);
+	if (song)
+		csf_free(song);
+
+	unslurp(&s);
+	free(copy);
+
+	return 0;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void fuzz_replay_file(const char *path, void *userdata)
+{
+	int *failed = userdata;
+	uint8_t *data;
+	long size;
+	FILE *fp;
+
+	fp = os_fopen(path, "rb");
+	if (!fp) {
+		perror(path);
+		(*failed)++;
+		return;
+	}
+
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET)) {
+		perror(path);
+		fclose(fp);
+		(*failed)++;
+		return;
+	}
+
+	data = mem_alloc(size ? size : 1);
+	if (fread(data, 1, size, fp) != (size_t)size) {
+		perror(path);
+		free(data);
+		fclose(fp);
+		(*failed)++;
+		return;
+	}
+
+	fclose(fp);
+
+	printf("%s\n", path);
+	fflush(stdout); /* so we know which file it was if it crashes */
+
+	LLVMFuzzerTestOneInput(data, size);
+
+	free(data);
+}
+
+int schism_fuzz_main(int argc, char *argv[])
+{
+	int failed = 0, count;
+
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s FILE|DIRECTORY...\n", argv[0]);
+		return 2;
+	}
+
+	LLVMFuzzerInitialize(&argc, &argv);
+
+	count = bench_for_each_file(argc - 1, argv + 1, fuzz_replay_file, &failed);
+
+#ifdef USE_ZLIB
+	gzip_quit();
+#endif
+
+	if (count < 0)
+		return 1;
+
+	printf("Replayed %d files, %d unreadable\n", count - failed, failed);
+
+	return failed ? 1 : 0;
+}
@@ -99,6 +99,11 @@ int schism_test_main(int argc, char **argv)
 	mt_init();
 	SCHISM_RUNTIME_ASSERT(timer_init(), "need timers");
 
+	if (argc > 1 && !strcmp(argv[1], "--bench"))
+		return schism_bench_main(argc - 1, argv + 1);
+	if (argc > 1 && !strcmp(argv[1], "--fuzz"))
+		return schism_fuzz_main(argc - 1, argv + 1);
+
 	if (argc > 1) {
 		char *test_case_name = argv[1];
 		int len = strlen(test_case_name);